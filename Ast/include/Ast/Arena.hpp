@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace language
+{
+    /*
+        Bump pointer allocator owned by a Program. AST nodes and symbol tables created while an arena
+        is installed on the current thread are carved out of it, and the whole arena is released
+        at once when the Program is destroyed. Deallocation is a no-op.
+    */
+    class Arena : public std::pmr::memory_resource
+    {
+    public:
+        Arena(std::size_t chunkSize = 64 * 1024);
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        auto allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) -> void*;
+        auto bytesAllocated() const -> std::size_t;
+
+        // Installs an arena for the current thread until the Scope is destroyed
+        class Scope
+        {
+        public:
+            Scope(Arena& arena);
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+            ~Scope();
+        private:
+            Arena* previous;
+        };
+
+        static auto current() -> Arena*;
+
+        // The current arena, or the default resource when none is installed
+        static auto resource() -> std::pmr::memory_resource*;
+
+    private:
+        auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override;
+        auto do_deallocate(void* p, std::size_t bytes, std::size_t alignment) -> void override;
+        auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override;
+
+        std::size_t chunkSize;
+        std::vector<std::unique_ptr<std::byte[]>> chunks;
+        std::byte* cursor;
+        std::byte* end;
+        std::size_t allocated;
+    };
+
+    /*
+        Base for everything the parser allocates. Objects are placed in the current arena if one is
+        installed and on the heap otherwise, a one pointer tag in front of the object remembers which.
+        Objects in an arena are aligned to alignof(void*).
+    */
+    struct ArenaAllocated
+    {
+        static void* operator new(std::size_t size);
+        static void operator delete(void* p);
+    };
+}
@@ -1,14 +1,17 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <string>
 #include "SymbolTable.hpp"
+#include "Arena.hpp"
 
 namespace language
 {
     struct Visitor;
 
-    struct Visitable
+    struct Visitable : public ArenaAllocated
     {
         virtual void accept(Visitor& v) = 0;
         virtual ~Visitable() = default;
@@ -19,6 +22,7 @@ namespace language
         Plus,Minus,Mul,Div, //Arithmetic
         And,Or,//Logical
         Less,LessEqual,Greater,GreaterEqual,Equal,NotEqual, // Comparison
+        Assign,
     };
 
     /*
@@ -30,10 +34,12 @@ namespace language
 
     /*
         A statement does not produce a value, it has a side effect.
+        Statements and expressions keep the offset of their first token in the source, to point diagnostics at it.
     */
     struct Stmt : public Visitable
     {
         std::string label;
+        std::uint32_t offset = 0; // of the first token in the source
     };
 
     /*
@@ -42,6 +48,7 @@ namespace language
     struct Expr : public Visitable
     {
         SymbolTable::Type* type;
+        std::uint32_t offset = 0; // of the first token in the source
         Expr(SymbolTable::Type* type):
             type{type}
         {}
@@ -49,15 +56,23 @@ namespace language
 
     /*
         A program is a sequence of declarations. 
+        If the program owns an arena it is declared first, so it is released after every node in it.
+        The interner owns the names that variables and functions refer to.
     */
     struct Program 
     {
+        std::unique_ptr<Arena> arena;
+        std::unique_ptr<Interner> names;
         std::vector<std::unique_ptr<Decl>> declarations;
         std::unique_ptr<SymbolTable> sym_table;
+        std::size_t globalsSize = 0; // bytes needed for the offsets of all global variables
 
         Program(std::unique_ptr<SymbolTable> sym_table):
             sym_table{std::move(sym_table)}
         {}
+        Program(std::unique_ptr<Arena> arena, std::unique_ptr<Interner> names, std::unique_ptr<SymbolTable> sym_table):
+            arena{std::move(arena)}, names{std::move(names)}, sym_table{std::move(sym_table)}
+        {}
     };
 
     struct VarDecl : public Decl, public Stmt // A variable declaration can appear at global as well as local scope
@@ -77,18 +92,32 @@ namespace language
         Block(std::vector<std::unique_ptr<Stmt>> stmts, SymbolTable* symbols):
             stmts{std::move(stmts)}, symbols{symbols}
         {}
-        Block(){}
+        Block():
+            symbols{nullptr}
+        {}
         void accept(Visitor& v) override;
     };
 
+    /*
+        Parameters and locals live at their offset in a frame of frameSize bytes.
+        Without a declared return type it is inferred from the return statements, see returnTypeOf.
+    */
     struct FuncDef : public Decl
     {
-        std::string name;
+        std::string_view name; // owned by the interner
         std::unique_ptr<Block> block;
         SymbolTable* params;
         SymbolTable::Type* returnType;
-        FuncDef(std::string name, SymbolTable* params, std::unique_ptr<Block> block);
+        std::vector<SymbolTable::Variable*> parameters;
+        std::size_t frameSize = 0;
+        FuncDef(std::string_view name, SymbolTable* params, std::unique_ptr<Block> block, SymbolTable::Type* returnType = nullptr);
         void accept(Visitor& v) override;
+
+        // The declared or else inferred return type, nullopt if the return statements disagree with it or each other
+        static auto returnTypeOf(Block& block, SymbolTable::Type* declared) -> std::optional<SymbolTable::Type*>;
+        // Whether every path through stmt ends in a return or a loop that never ends, a function with a
+        // return type must not fall off its end
+        static auto returnsOnEveryPath(Stmt& stmt) -> bool;
     };
 
     struct If : public Stmt
@@ -147,7 +176,8 @@ namespace language
         SymbolTable::Function* function;
         std::vector<std::unique_ptr<Expr>> args;
         FuncCall(SymbolTable::Function* function, std::vector<std::unique_ptr<Expr>> args):
-            Expr{function->def->returnType},
+            Expr{function->returnType},
+            function{function},
             args{std::move(args)}
             {}
         void accept(Visitor& v) override;
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+#include "Ast.hpp"
+
+namespace language
+{
+    enum class NodeKind : std::uint8_t
+    {
+        VarDecl, FuncDef, Block, If, While, Return, ExprStmt,
+        FuncCall, BinExpr, StrLiteral, IntLiteral, FloatLiteral, BooleanLiteral, VariableAccess,
+    };
+
+    using NodeIndex = std::uint32_t;
+    constexpr NodeIndex noNode = std::numeric_limits<NodeIndex>::max();
+
+    /*
+        16 byte node, the meaning of a, b and c depends on the kind:
+
+        VarDecl         a = variable,           b = init
+        FuncDef         a = function,           b = block,          c = first node of the subtree
+        Block           a = first list entry,   b = statement count
+        If              a = condition,          b = true branch,    c = false branch or noNode
+        While           a = condition,          b = body
+        Return          a = expression or noNode
+        ExprStmt        a = expression
+        FuncCall        a = function,           b = first list entry, c = argument count
+        BinExpr         a = left,               b = right,          op = BinOperator
+        StrLiteral      a = string
+        IntLiteral      a = value
+        FloatLiteral    a = low bits,           b = high bits
+        BooleanLiteral  a = value
+        VariableAccess  a = variable
+
+        variable, function, string and type are indices into the side tables of FlatAst.
+    */
+    struct FlatNode
+    {
+        NodeKind kind;
+        std::uint8_t op;
+        std::uint16_t type;
+        std::uint32_t a;
+        std::uint32_t b;
+        std::uint32_t c;
+    };
+    static_assert(sizeof(FlatNode) == 16);
+
+    /*
+        Nodes are stored in post-order, children always come before their parent. A function's nodes
+        are therefore the contiguous range [c, index of the FuncDef), which passes can scan linearly.
+        nodes and lists hold no pointers and can be copied or written out as raw memory.
+    */
+    struct FlatAst
+    {
+        std::vector<FlatNode> nodes;
+        std::vector<NodeIndex> lists;           // statements of blocks, arguments of calls
+        std::vector<NodeIndex> declarations;
+
+        std::vector<SymbolTable::Variable*> variables;
+        std::vector<FuncDef*> functions;
+        std::vector<SymbolTable::Type*> types;  // types[0] is the missing type (nullptr)
+        std::vector<std::string> strings;
+
+        auto list(NodeIndex first, std::uint32_t count) const -> std::span<const NodeIndex>;
+        auto type(const FlatNode& node) const -> SymbolTable::Type*;
+        auto subtree(NodeIndex funcDef) const -> std::span<const FlatNode>;
+        auto returnTypes(NodeIndex funcDef) const -> std::vector<SymbolTable::Type*>;
+        static auto returnTypes(std::span<const FlatNode> nodes, std::span<SymbolTable::Type* const> types) -> std::vector<SymbolTable::Type*>;
+        auto intValue(const FlatNode& node) const -> int;
+        auto floatValue(const FlatNode& node) const -> double;
+    };
+
+    auto flatten(Program& program) -> FlatAst;
+    auto flatten(Block& body) -> FlatAst; // of a function, for checks while it is parsed
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "Ast.hpp"
+
+namespace language
+{
+    /*
+        Binary image of a parsed Program: the interned names in symbol order, the symbol table tree
+        with every entry, and the declarations in pre-order. Cross-references to types, variables,
+        functions and scopes are indices into the entries in the order they were written.
+        Reading rebuilds the Program in a fresh arena without lexing or name resolution, the image can be
+        a memory mapped file. A truncated, corrupt or outdated image throws std::runtime_error.
+    */
+    auto serialize(Program& program) -> std::string;
+    auto deserialize(std::string_view image) -> Program;
+}
@@ -1,15 +1,19 @@
 #pragma once
-#include <map>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <memory_resource>
+#include "Arena.hpp"
+#include "Lexer/Interner.hpp"
 
 namespace language
 {
     class FuncDef;
 
-    class SymbolTable
+    class SymbolTable : public ArenaAllocated
     {
     public:
 
@@ -25,7 +29,7 @@ namespace language
 
         struct Variable
         {
-            std::string name;
+            std::string_view name; // owned by the interner
             Type* type;
             Scope scope;
             int offset;
@@ -36,21 +40,45 @@ namespace language
 
         struct Function
         {
-            FuncDef* def;
+            FuncDef* def;       // nullptr while the body is parsed
+            Type* returnType;
         };
 
         using entry_type = std::variant<Variable, Function, Type>;
 
-        SymbolTable(SymbolTable *parent);
+        // Children share the interner and lookup index of their parent, a root creates its own index
+        // and, without a given interner, its own interner
+        SymbolTable(SymbolTable *parent, Interner *names = nullptr);
+        ~SymbolTable();
 
-        entry_type &get(const std::string &key);
-        entry_type &put(const std::string &key, entry_type type);
+        entry_type &get(Symbol key);
+        entry_type &get(std::string_view key);
+        entry_type &put(Symbol key, entry_type type);
+        entry_type &put(std::string_view key, entry_type type);
+        // Like get and put, but nullptr instead of throwing if not found or already defined
+        entry_type *find(Symbol key);
+        entry_type *tryPut(Symbol key, entry_type type);
+        void erase(Symbol key); // the entry is not freed, it lives in the arena
+        const std::pmr::unordered_map<Symbol, entry_type> &entries() const; // of this scope only
 
+        Interner &names();
+
+        /*
+            addChild opens the child scope and close leaves it again, returning the parent.
+            While a scope is open get is a single index lookup, on closed scopes it walks the chain.
+        */
         void addChild(std::unique_ptr<SymbolTable> child);
+        SymbolTable *close();
+
         SymbolTable *parent;
-        std::vector<std::unique_ptr<SymbolTable>> children;
+        std::pmr::vector<std::unique_ptr<SymbolTable>> children;
     private:
-        std::map<std::string, entry_type> table;
-        
+        class Index;
+
+        std::unique_ptr<Interner> ownedNames;
+        Interner *interner;
+        std::unique_ptr<Index> ownedIndex;
+        Index *index;
+        std::pmr::unordered_map<Symbol, entry_type> table;
     };
 }
@@ -0,0 +1,120 @@
+#include "Arena.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace language
+{
+    namespace
+    {
+        thread_local Arena* installed = nullptr;
+
+        /*
+            Every ArenaAllocated object is preceded by the arena it came from (nullptr for the heap).
+            Arena objects only need pointer alignment, heap objects keep the full new alignment.
+        */
+        constexpr std::size_t tagSize = sizeof(Arena*);
+        constexpr std::size_t heapHeaderSize = alignof(std::max_align_t);
+
+        auto tag(void* object) -> Arena*&
+        {
+            return *(static_cast<Arena**>(object) - 1);
+        }
+    }
+
+    Arena::Arena(std::size_t chunkSize) : chunkSize{chunkSize}, cursor{nullptr}, end{nullptr}, allocated{0}
+    {
+    }
+
+    auto Arena::allocate(std::size_t size, std::size_t alignment) -> void*
+    {
+        auto aligned = [&](std::byte* p)
+        {
+            auto address = reinterpret_cast<std::uintptr_t>(p);
+            return p + ((alignment - address % alignment) % alignment);
+        };
+
+        auto p = cursor ? aligned(cursor) : nullptr;
+        if (!p || p + size > end)
+        {
+            // Oversized requests get a chunk of their own so the remainder of the current one is not wasted
+            auto length = std::max(chunkSize, size + alignment);
+            chunks.push_back(std::make_unique_for_overwrite<std::byte[]>(length));
+            auto chunk = chunks.back().get();
+            if (length > chunkSize)
+            {
+                allocated += size;
+                return aligned(chunk);
+            }
+            cursor = chunk;
+            end = chunk + length;
+            p = aligned(cursor);
+        }
+        cursor = p + size;
+        allocated += size;
+        return p;
+    }
+
+    auto Arena::bytesAllocated() const -> std::size_t
+    {
+        return allocated;
+    }
+
+    Arena::Scope::Scope(Arena& arena) : previous{installed}
+    {
+        installed = &arena;
+    }
+
+    Arena::Scope::~Scope()
+    {
+        installed = previous;
+    }
+
+    auto Arena::current() -> Arena*
+    {
+        return installed;
+    }
+
+    auto Arena::resource() -> std::pmr::memory_resource*
+    {
+        return installed ? static_cast<std::pmr::memory_resource*>(installed) : std::pmr::get_default_resource();
+    }
+
+    auto Arena::do_allocate(std::size_t bytes, std::size_t alignment) -> void*
+    {
+        return allocate(bytes, alignment);
+    }
+
+    auto Arena::do_deallocate(void*, std::size_t, std::size_t) -> void
+    {
+    }
+
+    auto Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool
+    {
+        return this == &other;
+    }
+
+    void* ArenaAllocated::operator new(std::size_t size)
+    {
+        std::byte* object;
+        auto arena = Arena::current();
+        if (arena)
+        {
+            object = static_cast<std::byte*>(arena->allocate(tagSize + size, alignof(Arena*))) + tagSize;
+        }
+        else
+        {
+            object = static_cast<std::byte*>(::operator new(heapHeaderSize + size)) + heapHeaderSize;
+        }
+        tag(object) = arena;
+        return object;
+    }
+
+    void ArenaAllocated::operator delete(void* p)
+    {
+        if (p && !tag(p))
+        {
+            ::operator delete(static_cast<std::byte*>(p) - heapHeaderSize);
+        }
+    }
+}
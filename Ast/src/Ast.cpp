@@ -1,4 +1,5 @@
 #include "Ast.hpp"
+#include "FlatAst.hpp"
 #include <algorithm>
 
 namespace language
@@ -53,68 +54,49 @@ namespace language
         v.visit(*this);
     }
 
-    FuncDef::FuncDef(std::string name, SymbolTable *params, std::unique_ptr<Block> block) : name{std::move(name)}, params{params}, block{std::move(block)}
+    FuncDef::FuncDef(std::string_view name, SymbolTable *params, std::unique_ptr<Block> block, SymbolTable::Type *returnType) :
+        name{name}, block{std::move(block)}, params{params}, returnType{returnType}
     {
-        struct ReturnVisitor : public Visitor
-        {
-            std::vector<SymbolTable::Type*> types;
-
-            // TODO Create seperate visitor types for statements and expressions
-
-            // Not interessting
-            virtual void visit(VarDecl &){}
-            virtual void visit(Program &program){}
-            virtual void visit(FuncDef &){}
-            virtual void visit(ExprStmt &) {}
-            virtual void visit(FuncCall &){}
-            virtual void visit(BinExpr &) {}
-            virtual void visit(StrLiteral &){}
-            virtual void visit(IntLiteral &) {}
-            virtual void visit(FloatLiteral &){}
-            virtual void visit(BooleanLiteral &){}
-            virtual void visit(VariableAccess &) {}
-
-            virtual void visit(Block & b)
-            {
-                for(auto& s : b.stmts)
-                {
-                    s->accept(*this);
-                }
-            }
-
-            virtual void visit(If & ifStmt)
-            {
-                ifStmt.trueStmt->accept(*this);
-                if(ifStmt.falseStmt)
-                {
-                    ifStmt.falseStmt->accept(*this);
-                }
-            }
-
-            virtual void visit(While & whileStmt) 
-            {
-                whileStmt.stmt->accept(*this);
-            }
-
-            virtual void visit(Return & returnStmt)
-            {   
-                //Found a returnStmt
-                types.push_back(returnStmt.expr->type);
-            }
-
-        } visitor;
-
-        block->accept(visitor);
-
-        auto all_equal = std::equal(visitor.types.begin(), visitor.types.end() - 1, visitor.types.begin() + 1);
-
-        if(!all_equal)
+    }
+
+    auto FuncDef::returnTypeOf(Block &block, SymbolTable::Type *declared) -> std::optional<SymbolTable::Type*>
+    {
+        // The return statements of the flat body are one linear scan over its nodes
+        auto flat = flatten(block);
+        auto types = FlatAst::returnTypes(flat.nodes, flat.types);
+
+        auto all_equal = types.empty() ||
+                         std::equal(types.begin(), types.end() - 1, types.begin() + 1);
+
+        if(!all_equal || (declared && !types.empty() && types[0] != declared))
         {
-            throw 1;
+            return std::nullopt;
         }
 
-        this->returnType = visitor.types[0]; 
+        return declared ? declared : (types.empty() ? nullptr : types[0]);
+    }
 
+    auto FuncDef::returnsOnEveryPath(Stmt &stmt) -> bool
+    {
+        if (dynamic_cast<Return*>(&stmt))
+        {
+            return true;
+        }
+        if (auto block = dynamic_cast<Block*>(&stmt))
+        {
+            return std::ranges::any_of(block->stmts, [](auto& s) { return returnsOnEveryPath(*s); });
+        }
+        if (auto ifStmt = dynamic_cast<If*>(&stmt))
+        {
+            return ifStmt->falseStmt && returnsOnEveryPath(*ifStmt->trueStmt) && returnsOnEveryPath(*ifStmt->falseStmt);
+        }
+        if (auto whileStmt = dynamic_cast<While*>(&stmt))
+        {
+            // There is no break, while (true) is only left by a return
+            auto condition = dynamic_cast<BooleanLiteral*>(whileStmt->expr.get());
+            return condition && condition->v;
+        }
+        return false;
     }
 
 }
\ No newline at end of file
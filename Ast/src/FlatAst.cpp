@@ -0,0 +1,228 @@
+#include "FlatAst.hpp"
+#include <bit>
+#include <unordered_map>
+
+namespace language
+{
+    namespace
+    {
+        struct Flattener : public Visitor
+        {
+            FlatAst ast;
+            NodeIndex last = noNode;
+            std::unordered_map<SymbolTable::Variable*, std::uint32_t> variableIndices;
+            std::unordered_map<FuncDef*, std::uint32_t> functionIndices;
+            std::unordered_map<SymbolTable::Type*, std::uint16_t> typeIndices{{nullptr, 0}};
+
+            Flattener()
+            {
+                ast.types.push_back(nullptr);
+            }
+
+            template <typename T>
+            static auto intern(std::unordered_map<T*, std::uint32_t>& indices, std::vector<T*>& table, T* entry) -> std::uint32_t
+            {
+                auto [it, inserted] = indices.try_emplace(entry, static_cast<std::uint32_t>(table.size()));
+                if (inserted)
+                {
+                    table.push_back(entry);
+                }
+                return it->second;
+            }
+
+            auto typeIndex(SymbolTable::Type* type) -> std::uint16_t
+            {
+                auto [it, inserted] = typeIndices.try_emplace(type, static_cast<std::uint16_t>(ast.types.size()));
+                if (inserted)
+                {
+                    ast.types.push_back(type);
+                }
+                return it->second;
+            }
+
+            auto emit(NodeKind kind, std::uint32_t a = 0, std::uint32_t b = 0, std::uint32_t c = 0,
+                      SymbolTable::Type* type = nullptr, std::uint8_t op = 0) -> void
+            {
+                last = static_cast<NodeIndex>(ast.nodes.size());
+                ast.nodes.push_back({kind, op, typeIndex(type), a, b, c});
+            }
+
+            auto flatten(Visitable* node) -> NodeIndex
+            {
+                if (!node)
+                {
+                    return noNode;
+                }
+                node->accept(*this);
+                return last;
+            }
+
+            // Flattens the elements first, then stores their indices contiguously in lists
+            template <typename T>
+            auto flattenList(std::vector<std::unique_ptr<T>>& elements) -> std::uint32_t
+            {
+                std::vector<NodeIndex> indices;
+                indices.reserve(elements.size());
+                for (auto& element : elements)
+                {
+                    indices.push_back(flatten(element.get()));
+                }
+                auto first = static_cast<std::uint32_t>(ast.lists.size());
+                ast.lists.insert(ast.lists.end(), indices.begin(), indices.end());
+                return first;
+            }
+
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    ast.declarations.push_back(flatten(decl.get()));
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                auto init = flatten(decl.init.get());
+                emit(NodeKind::VarDecl, intern(variableIndices, ast.variables, decl.var), init, 0, decl.var->type);
+            }
+
+            void visit(FuncDef& def) override
+            {
+                auto first = static_cast<NodeIndex>(ast.nodes.size());
+                auto block = flatten(def.block.get());
+                emit(NodeKind::FuncDef, intern(functionIndices, ast.functions, &def), block, first, def.returnType);
+            }
+
+            void visit(Block& block) override
+            {
+                auto first = flattenList(block.stmts);
+                emit(NodeKind::Block, first, static_cast<std::uint32_t>(block.stmts.size()));
+            }
+
+            void visit(If& ifStmt) override
+            {
+                auto expr = flatten(ifStmt.expr.get());
+                auto trueStmt = flatten(ifStmt.trueStmt.get());
+                auto falseStmt = flatten(ifStmt.falseStmt.get());
+                emit(NodeKind::If, expr, trueStmt, falseStmt);
+            }
+
+            void visit(While& whileStmt) override
+            {
+                auto expr = flatten(whileStmt.expr.get());
+                auto stmt = flatten(whileStmt.stmt.get());
+                emit(NodeKind::While, expr, stmt);
+            }
+
+            void visit(Return& returnStmt) override
+            {
+                auto expr = flatten(returnStmt.expr.get());
+                emit(NodeKind::Return, expr, 0, 0, returnStmt.expr ? returnStmt.expr->type : nullptr);
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                emit(NodeKind::ExprStmt, flatten(exprStmt.expr.get()));
+            }
+
+            void visit(FuncCall& call) override
+            {
+                auto first = flattenList(call.args);
+                emit(NodeKind::FuncCall, intern(functionIndices, ast.functions, call.function->def), first,
+                     static_cast<std::uint32_t>(call.args.size()), call.type);
+            }
+
+            void visit(BinExpr& expr) override
+            {
+                auto left = flatten(expr.leftHs.get());
+                auto right = flatten(expr.rightHs.get());
+                emit(NodeKind::BinExpr, left, right, 0, expr.type, static_cast<std::uint8_t>(expr.op));
+            }
+
+            void visit(StrLiteral& lit) override
+            {
+                ast.strings.push_back(lit.v);
+                emit(NodeKind::StrLiteral, static_cast<std::uint32_t>(ast.strings.size() - 1), 0, 0, lit.type);
+            }
+
+            void visit(IntLiteral& lit) override
+            {
+                emit(NodeKind::IntLiteral, static_cast<std::uint32_t>(lit.v), 0, 0, lit.type);
+            }
+
+            void visit(FloatLiteral& lit) override
+            {
+                auto bits = std::bit_cast<std::uint64_t>(lit.v);
+                emit(NodeKind::FloatLiteral, static_cast<std::uint32_t>(bits), static_cast<std::uint32_t>(bits >> 32), 0, lit.type);
+            }
+
+            void visit(BooleanLiteral& lit) override
+            {
+                emit(NodeKind::BooleanLiteral, lit.v, 0, 0, lit.type);
+            }
+
+            void visit(VariableAccess& access) override
+            {
+                emit(NodeKind::VariableAccess, intern(variableIndices, ast.variables, access.var), 0, 0, access.type);
+            }
+        };
+    }
+
+    auto FlatAst::list(NodeIndex first, std::uint32_t count) const -> std::span<const NodeIndex>
+    {
+        return std::span{lists}.subspan(first, count);
+    }
+
+    auto FlatAst::type(const FlatNode& node) const -> SymbolTable::Type*
+    {
+        return types[node.type];
+    }
+
+    auto FlatAst::subtree(NodeIndex funcDef) const -> std::span<const FlatNode>
+    {
+        const auto& def = nodes[funcDef];
+        return std::span{nodes}.subspan(def.c, funcDef - def.c);
+    }
+
+    auto FlatAst::returnTypes(NodeIndex funcDef) const -> std::vector<SymbolTable::Type*>
+    {
+        return returnTypes(subtree(funcDef), types);
+    }
+
+    auto FlatAst::returnTypes(std::span<const FlatNode> nodes, std::span<SymbolTable::Type* const> types) -> std::vector<SymbolTable::Type*>
+    {
+        std::vector<SymbolTable::Type*> result;
+        for (const auto& node : nodes)
+        {
+            if (node.kind == NodeKind::Return)
+            {
+                result.push_back(types[node.type]);
+            }
+        }
+        return result;
+    }
+
+    auto FlatAst::intValue(const FlatNode& node) const -> int
+    {
+        return static_cast<int>(node.a);
+    }
+
+    auto FlatAst::floatValue(const FlatNode& node) const -> double
+    {
+        return std::bit_cast<double>(static_cast<std::uint64_t>(node.b) << 32 | node.a);
+    }
+
+    auto flatten(Program& program) -> FlatAst
+    {
+        Flattener flattener;
+        flattener.visit(program);
+        return std::move(flattener.ast);
+    }
+
+    auto flatten(Block& body) -> FlatAst
+    {
+        Flattener flattener;
+        flattener.visit(body);
+        return std::move(flattener.ast);
+    }
+}
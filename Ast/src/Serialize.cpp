@@ -0,0 +1,582 @@
+#include "Serialize.hpp"
+#include "FlatAst.hpp"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace language
+{
+    namespace
+    {
+        constexpr std::uint32_t magic = 0x5453414c; // "LAST" in the file
+        constexpr std::uint32_t version = 3; // 2: programs falling off their end are rejected, older images may hold them, 3: source offsets
+        constexpr std::uint32_t none = 0xffffffff;
+
+        enum class EntryKind : std::uint8_t
+        {
+            Type, Variable, Function
+        };
+
+        struct Writer : public Visitor
+        {
+            std::string out;
+            Interner& names;
+            Arena indices; // the maps below only grow, their nodes are bump allocated
+            std::pmr::unordered_map<const SymbolTable::Type*, std::uint32_t> types{&indices};
+            std::pmr::unordered_map<const SymbolTable::Variable*, std::uint32_t> variables{&indices};
+            std::pmr::unordered_map<const SymbolTable::Function*, std::uint32_t> functions{&indices};
+            std::pmr::unordered_map<const SymbolTable*, std::uint32_t> scopes{&indices};
+            std::vector<std::pair<Symbol, const SymbolTable::entry_type*>> later; // of the scope being written
+
+            Writer(Interner& names) : names{names}
+            {
+                types.emplace(nullptr, 0);
+            }
+
+            template <typename T>
+            auto put(T value) -> void
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+
+            auto text(std::string_view value) -> void
+            {
+                put(static_cast<std::uint32_t>(value.size()));
+                out.append(value);
+            }
+
+            auto put(NodeKind kind) -> void
+            {
+                put(static_cast<std::uint8_t>(kind));
+            }
+
+            auto symbol(std::string_view name) -> void
+            {
+                put(names.find(name));
+            }
+
+            // Types before the other entries, variables of a scope only use types of the scopes around it
+            auto scope(const SymbolTable& table) -> void
+            {
+                scopes.emplace(&table, static_cast<std::uint32_t>(scopes.size()));
+                put(static_cast<std::uint32_t>(table.entries().size()));
+                later.clear();
+                for (const auto& [key, entry] : table.entries())
+                {
+                    if (std::holds_alternative<SymbolTable::Type>(entry))
+                    {
+                        this->entry(key, entry);
+                    }
+                    else
+                    {
+                        later.emplace_back(key, &entry);
+                    }
+                }
+                for (auto [key, entry] : later)
+                {
+                    this->entry(key, *entry);
+                }
+                put(static_cast<std::uint32_t>(table.children.size()));
+                for (const auto& child : table.children)
+                {
+                    scope(*child);
+                }
+            }
+
+            auto entry(Symbol key, const SymbolTable::entry_type& entry) -> void
+            {
+                put(key);
+                if (auto type = std::get_if<SymbolTable::Type>(&entry))
+                {
+                    put(EntryKind::Type);
+                    types.emplace(type, static_cast<std::uint32_t>(types.size()));
+                    put(static_cast<std::uint64_t>(type->size));
+                }
+                else if (auto variable = std::get_if<SymbolTable::Variable>(&entry))
+                {
+                    put(EntryKind::Variable);
+                    variables.emplace(variable, static_cast<std::uint32_t>(variables.size()));
+                    put(types.at(variable->type));
+                    put(static_cast<std::uint8_t>(variable->scope));
+                    put(static_cast<std::int32_t>(variable->offset));
+                    put(static_cast<std::uint8_t>(variable->active | variable->alive << 1 | variable->temp << 2));
+                }
+                else
+                {
+                    auto& function = std::get<SymbolTable::Function>(entry);
+                    put(EntryKind::Function);
+                    functions.emplace(&function, static_cast<std::uint32_t>(functions.size()));
+                    put(types.at(function.returnType));
+                }
+            }
+
+            // Statements and expressions end with their source offset
+            auto node(Visitable* node) -> void
+            {
+                node->accept(*this);
+                if (auto stmt = dynamic_cast<Stmt*>(node))
+                {
+                    put(stmt->offset);
+                }
+                else if (auto expr = dynamic_cast<Expr*>(node))
+                {
+                    put(expr->offset);
+                }
+            }
+
+            void visit(Program& program) override
+            {
+                put(magic);
+                put(version);
+                put(static_cast<std::uint64_t>(program.globalsSize));
+                put(static_cast<std::uint32_t>(names.size()));
+                for (Symbol symbol = 0; symbol < names.size(); symbol++)
+                {
+                    text(names.name(symbol));
+                }
+                scope(*program.sym_table);
+                put(static_cast<std::uint32_t>(program.declarations.size()));
+                for (auto& decl : program.declarations)
+                {
+                    node(decl.get());
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                put(NodeKind::VarDecl);
+                put(variables.at(decl.var));
+                node(decl.init.get());
+            }
+
+            void visit(FuncDef& def) override
+            {
+                put(NodeKind::FuncDef);
+                symbol(def.name);
+                put(scopes.at(def.params));
+                put(types.at(def.returnType));
+                put(static_cast<std::uint32_t>(def.frameSize));
+                put(static_cast<std::uint32_t>(def.parameters.size()));
+                for (auto parameter : def.parameters)
+                {
+                    put(variables.at(parameter));
+                }
+                node(def.block.get());
+            }
+
+            void visit(Block& block) override
+            {
+                put(NodeKind::Block);
+                put(block.symbols ? scopes.at(block.symbols) : none);
+                put(static_cast<std::uint32_t>(block.stmts.size()));
+                for (auto& stmt : block.stmts)
+                {
+                    node(stmt.get());
+                }
+            }
+
+            void visit(If& ifStmt) override
+            {
+                put(NodeKind::If);
+                put(static_cast<std::uint8_t>(ifStmt.falseStmt != nullptr));
+                node(ifStmt.expr.get());
+                node(ifStmt.trueStmt.get());
+                if (ifStmt.falseStmt)
+                {
+                    node(ifStmt.falseStmt.get());
+                }
+            }
+
+            void visit(While& whileStmt) override
+            {
+                put(NodeKind::While);
+                node(whileStmt.expr.get());
+                node(whileStmt.stmt.get());
+            }
+
+            void visit(Return& returnStmt) override
+            {
+                put(NodeKind::Return);
+                put(static_cast<std::uint8_t>(returnStmt.expr != nullptr));
+                if (returnStmt.expr)
+                {
+                    node(returnStmt.expr.get());
+                }
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                put(NodeKind::ExprStmt);
+                node(exprStmt.expr.get());
+            }
+
+            void visit(FuncCall& call) override
+            {
+                put(NodeKind::FuncCall);
+                put(functions.at(call.function));
+                put(types.at(call.type)); // recursive calls of functions with inferred return type have none
+                put(static_cast<std::uint32_t>(call.args.size()));
+                for (auto& arg : call.args)
+                {
+                    node(arg.get());
+                }
+            }
+
+            void visit(BinExpr& expr) override
+            {
+                put(NodeKind::BinExpr);
+                put(static_cast<std::uint8_t>(expr.op));
+                put(types.at(expr.type));
+                node(expr.leftHs.get());
+                node(expr.rightHs.get());
+            }
+
+            void visit(StrLiteral& lit) override
+            {
+                put(NodeKind::StrLiteral);
+                put(types.at(lit.type));
+                text(lit.v);
+            }
+
+            void visit(IntLiteral& lit) override
+            {
+                put(NodeKind::IntLiteral);
+                put(types.at(lit.type));
+                put(static_cast<std::int32_t>(lit.v));
+            }
+
+            void visit(FloatLiteral& lit) override
+            {
+                put(NodeKind::FloatLiteral);
+                put(types.at(lit.type));
+                put(lit.v);
+            }
+
+            void visit(BooleanLiteral& lit) override
+            {
+                put(NodeKind::BooleanLiteral);
+                put(types.at(lit.type));
+                put(static_cast<std::uint8_t>(lit.v));
+            }
+
+            void visit(VariableAccess& access) override
+            {
+                put(NodeKind::VariableAccess);
+                put(variables.at(access.var));
+            }
+        };
+
+        class Reader
+        {
+        public:
+            Reader(std::string_view image) : in{image}, at{0}
+            {
+            }
+
+            auto program() -> Program
+            {
+                if (get<std::uint32_t>() != magic || get<std::uint32_t>() != version)
+                {
+                    throw std::runtime_error("Not a program image of this version");
+                }
+                auto arena = std::make_unique<Arena>();
+                Arena::Scope scope{*arena};
+                auto globalsSize = get<std::uint64_t>();
+
+                auto interner = std::make_unique<Interner>();
+                names = interner.get();
+                auto count = get<std::uint32_t>();
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    auto length = get<std::uint32_t>();
+                    if (names->intern(bytes(length)) != i)
+                    {
+                        throw std::runtime_error("Corrupt program image");
+                    }
+                }
+
+                Program program{std::move(arena), std::move(interner), std::make_unique<SymbolTable>(nullptr, names)};
+                program.globalsSize = globalsSize;
+                types.push_back(nullptr);
+                table(*program.sym_table);
+
+                count = get<std::uint32_t>();
+                program.declarations.reserve(count);
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    auto kind = get<NodeKind>();
+                    if (kind == NodeKind::VarDecl)
+                    {
+                        program.declarations.push_back(varDecl());
+                    }
+                    else if (kind == NodeKind::FuncDef)
+                    {
+                        program.declarations.push_back(funcDef());
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Corrupt program image");
+                    }
+                }
+                if (at != in.size())
+                {
+                    throw std::runtime_error("Corrupt program image");
+                }
+                return program;
+            }
+
+        private:
+            template <typename T>
+            auto get() -> T
+            {
+                T value;
+                std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+                return value;
+            }
+
+            auto bytes(std::size_t length) -> std::string_view
+            {
+                if (in.size() - at < length)
+                {
+                    throw std::runtime_error("Truncated program image");
+                }
+                auto result = in.substr(at, length);
+                at += length;
+                return result;
+            }
+
+            template <typename T>
+            static auto lookup(const std::vector<T*>& table, std::uint32_t index) -> T*
+            {
+                if (index >= table.size())
+                {
+                    throw std::runtime_error("Corrupt program image");
+                }
+                return table[index];
+            }
+
+            auto symbol() -> Symbol
+            {
+                auto symbol = get<Symbol>();
+                if (symbol >= names->size())
+                {
+                    throw std::runtime_error("Corrupt program image");
+                }
+                return symbol;
+            }
+
+            // Scopes are entered while they are filled and left again, like the parser leaves them
+            auto table(SymbolTable& scope) -> void
+            {
+                scopes.push_back(&scope);
+                auto count = get<std::uint32_t>();
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    auto key = symbol();
+                    auto kind = get<EntryKind>();
+                    if (kind == EntryKind::Type)
+                    {
+                        auto& type = scope.put(key, SymbolTable::Type{.size = get<std::uint64_t>()});
+                        types.push_back(&std::get<SymbolTable::Type>(type));
+                    }
+                    else if (kind == EntryKind::Variable)
+                    {
+                        auto type = lookup(types, get<std::uint32_t>());
+                        auto storage = get<std::uint8_t>();
+                        auto offset = get<std::int32_t>();
+                        auto flags = get<std::uint8_t>();
+                        auto& variable = scope.put(key, SymbolTable::Variable{
+                            .name = names->name(key),
+                            .type = type,
+                            .scope = static_cast<SymbolTable::Scope>(storage),
+                            .offset = offset,
+                            .active = (flags & 1) != 0,
+                            .alive = (flags & 2) != 0,
+                            .temp = (flags & 4) != 0
+                        });
+                        variables.push_back(&std::get<SymbolTable::Variable>(variable));
+                    }
+                    else if (kind == EntryKind::Function)
+                    {
+                        auto& function = scope.put(key, SymbolTable::Function{
+                            .def = nullptr,
+                            .returnType = lookup(types, get<std::uint32_t>())
+                        });
+                        functions.push_back(&std::get<SymbolTable::Function>(function));
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Corrupt program image");
+                    }
+                }
+                count = get<std::uint32_t>();
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    scope.addChild(std::make_unique<SymbolTable>(&scope));
+                    auto& child = *scope.children.back();
+                    table(child);
+                    child.close();
+                }
+            }
+
+            // Reads the source offset that follows a node
+            template <typename T>
+            auto located(std::unique_ptr<T> node) -> std::unique_ptr<T>
+            {
+                node->offset = get<std::uint32_t>();
+                return node;
+            }
+
+            auto node() -> std::unique_ptr<Stmt>
+            {
+                switch (get<NodeKind>())
+                {
+                case NodeKind::VarDecl:
+                    return varDecl();
+                case NodeKind::Block:
+                    return block();
+                case NodeKind::If:
+                {
+                    auto hasFalse = get<std::uint8_t>() != 0;
+                    auto expr = expression();
+                    auto trueStmt = node();
+                    if (hasFalse)
+                    {
+                        auto falseStmt = node();
+                        return located(std::make_unique<If>(std::move(expr), std::move(trueStmt), std::move(falseStmt)));
+                    }
+                    return located(std::make_unique<If>(std::move(expr), std::move(trueStmt)));
+                }
+                case NodeKind::While:
+                {
+                    auto expr = expression();
+                    return located(std::make_unique<While>(std::move(expr), node()));
+                }
+                case NodeKind::Return:
+                    return located(std::make_unique<Return>(get<std::uint8_t>() != 0 ? expression() : nullptr));
+                case NodeKind::ExprStmt:
+                    return located(std::make_unique<ExprStmt>(expression()));
+                default:
+                    throw std::runtime_error("Corrupt program image");
+                }
+            }
+
+            auto varDecl() -> std::unique_ptr<VarDecl>
+            {
+                auto var = lookup(variables, get<std::uint32_t>());
+                return located(std::make_unique<VarDecl>(var, expression()));
+            }
+
+            auto funcDef() -> std::unique_ptr<FuncDef>
+            {
+                auto name = symbol();
+                auto params = lookup(scopes, get<std::uint32_t>());
+                auto returnType = lookup(types, get<std::uint32_t>());
+                auto frameSize = get<std::uint32_t>();
+                std::vector<SymbolTable::Variable*> parameters(get<std::uint32_t>());
+                for (auto& parameter : parameters)
+                {
+                    parameter = lookup(variables, get<std::uint32_t>());
+                }
+                if (get<NodeKind>() != NodeKind::Block)
+                {
+                    throw std::runtime_error("Corrupt program image");
+                }
+                auto def = std::make_unique<FuncDef>(names->name(name), params, block(), returnType);
+                def->parameters = std::move(parameters);
+                def->frameSize = frameSize;
+                auto& function = std::get<SymbolTable::Function>(params->parent->get(name));
+                function.def = def.get();
+                return def;
+            }
+
+            auto block() -> std::unique_ptr<Block>
+            {
+                auto scope = get<std::uint32_t>();
+                auto symbols = scope == none ? nullptr : lookup(scopes, scope);
+                std::vector<std::unique_ptr<Stmt>> stmts(get<std::uint32_t>());
+                for (auto& stmt : stmts)
+                {
+                    stmt = node();
+                }
+                return located(std::make_unique<Block>(std::move(stmts), symbols));
+            }
+
+            auto expression() -> std::unique_ptr<Expr>
+            {
+                switch (get<NodeKind>())
+                {
+                case NodeKind::FuncCall:
+                {
+                    auto function = lookup(functions, get<std::uint32_t>());
+                    auto type = lookup(types, get<std::uint32_t>());
+                    std::vector<std::unique_ptr<Expr>> args(get<std::uint32_t>());
+                    for (auto& arg : args)
+                    {
+                        arg = expression();
+                    }
+                    auto call = std::make_unique<FuncCall>(function, std::move(args));
+                    call->type = type;
+                    return located(std::move(call));
+                }
+                case NodeKind::BinExpr:
+                {
+                    auto op = static_cast<BinOperator>(get<std::uint8_t>());
+                    auto type = lookup(types, get<std::uint32_t>());
+                    auto left = expression();
+                    auto right = expression();
+                    return located(std::make_unique<BinExpr>(std::move(left), std::move(right), op, type));
+                }
+                case NodeKind::StrLiteral:
+                {
+                    auto type = lookup(types, get<std::uint32_t>());
+                    return located(std::make_unique<StrLiteral>(std::string{bytes(get<std::uint32_t>())}, type));
+                }
+                case NodeKind::IntLiteral:
+                {
+                    auto type = lookup(types, get<std::uint32_t>());
+                    return located(std::make_unique<IntLiteral>(get<std::int32_t>(), type));
+                }
+                case NodeKind::FloatLiteral:
+                {
+                    auto type = lookup(types, get<std::uint32_t>());
+                    return located(std::make_unique<FloatLiteral>(get<double>(), type));
+                }
+                case NodeKind::BooleanLiteral:
+                {
+                    auto type = lookup(types, get<std::uint32_t>());
+                    return located(std::make_unique<BooleanLiteral>(get<std::uint8_t>() != 0, type));
+                }
+                case NodeKind::VariableAccess:
+                    return located(std::make_unique<VariableAccess>(lookup(variables, get<std::uint32_t>())));
+                default:
+                    throw std::runtime_error("Corrupt program image");
+                }
+            }
+
+            std::string_view in;
+            std::size_t at;
+            Interner* names = nullptr;
+            std::vector<SymbolTable::Type*> types;
+            std::vector<SymbolTable::Variable*> variables;
+            std::vector<SymbolTable::Function*> functions;
+            std::vector<SymbolTable*> scopes;
+        };
+    }
+
+    auto serialize(Program& program) -> std::string
+    {
+        Writer writer{program.sym_table->names()};
+        writer.visit(program);
+        return std::move(writer.out);
+    }
+
+    auto deserialize(std::string_view image) -> Program
+    {
+        return Reader{image}.program();
+    }
+}
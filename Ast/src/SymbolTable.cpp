@@ -1,41 +1,208 @@
 #include "SymbolTable.hpp"
 #include <stdexcept>
+#include <limits>
 
 namespace language
 {
+    /*
+        Lookup index for the open scopes of a compilation. heads is indexed by the symbol id (the
+        interner hands out dense ids, so this is a collision free hash table) and points to the
+        innermost binding of that name. Each binding remembers the one it shadows. Bindings form a
+        stack that doubles as undo log: leaving a scope pops its bindings and restores the shadowed ones.
+    */
+    class SymbolTable::Index
+    {
+    public:
+        struct Binding
+        {
+            entry_type *entry;
+            Symbol symbol;
+            std::uint32_t shadowed;
+        };
+
+        static constexpr std::uint32_t unbound = std::numeric_limits<std::uint32_t>::max();
+
+        auto enter(SymbolTable *scope) -> void
+        {
+            scopes.push_back({scope, bindings.size()});
+        }
+
+        auto leave() -> void
+        {
+            auto mark = scopes.back().mark;
+            while (bindings.size() > mark)
+            {
+                heads[bindings.back().symbol] = bindings.back().shadowed;
+                bindings.pop_back();
+            }
+            scopes.pop_back();
+        }
 
-    SymbolTable::SymbolTable(SymbolTable *parent) : parent{parent}
+        auto active() const -> SymbolTable *
+        {
+            return scopes.empty() ? nullptr : scopes.back().scope;
+        }
+
+        auto find(Symbol symbol) const -> const Binding *
+        {
+            if (symbol >= heads.size() || heads[symbol] == unbound)
+            {
+                return nullptr;
+            }
+            return &bindings[heads[symbol]];
+        }
+
+        auto bind(Symbol symbol, entry_type *entry) -> void
+        {
+            if (symbol >= heads.size())
+            {
+                heads.resize(symbol + 1, unbound);
+            }
+            bindings.push_back({entry, symbol, heads[symbol]});
+            heads[symbol] = static_cast<std::uint32_t>(bindings.size() - 1);
+        }
+
+        // The binding stays on the stack, leaving its scope restores what it shadowed as usual
+        auto unbind(Symbol symbol) -> void
+        {
+            heads[symbol] = bindings[heads[symbol]].shadowed;
+        }
+
+    private:
+        struct Scope
+        {
+            SymbolTable *scope;
+            std::size_t mark;
+        };
+
+        std::vector<std::uint32_t> heads;
+        std::vector<Binding> bindings;
+        std::vector<Scope> scopes;
+    };
+
+    SymbolTable::SymbolTable(SymbolTable *parent, Interner *names) : parent{parent}, children{Arena::resource()},
+                                                                    interner{parent ? parent->interner : names},
+                                                                    index{parent ? parent->index : nullptr},
+                                                                    table{Arena::resource()}
     {
+        if (interner == nullptr)
+        {
+            ownedNames = std::make_unique<Interner>();
+            interner = ownedNames.get();
+        }
+        if (index == nullptr)
+        {
+            ownedIndex = std::make_unique<Index>();
+            index = ownedIndex.get();
+            index->enter(this);
+        }
     }
 
-    SymbolTable::entry_type &SymbolTable::get(const std::string &key)
+    SymbolTable::~SymbolTable() = default;
+
+    SymbolTable::entry_type *SymbolTable::find(Symbol key)
     {
-        if (table.contains(key))
+        if (index->active() == this)
         {
-            return table[key];
+            if (auto binding = index->find(key))
+            {
+                return binding->entry;
+            }
+            return nullptr;
         }
-        if (parent != nullptr)
+        for (auto scope = this; scope != nullptr; scope = scope->parent)
         {
-            return parent->get(key);
+            if (auto entry = scope->table.find(key); entry != scope->table.end())
+            {
+                return &entry->second;
+            }
         }
-        else
+        return nullptr;
+    }
+
+    SymbolTable::entry_type &SymbolTable::get(Symbol key)
+    {
+        if (auto entry = find(key))
         {
-            throw std::runtime_error("Symbol " + key + " not found!");
+            return *entry;
         }
+        throw std::runtime_error("Symbol " + std::string{interner->name(key)} + " not found!");
     }
 
-    SymbolTable::entry_type &SymbolTable::put(const std::string &key, entry_type type)
+    SymbolTable::entry_type &SymbolTable::get(std::string_view key)
     {
-        if (table.contains(key))
+        if (auto symbol = interner->find(key); symbol != noSymbol)
         {
-            throw std::runtime_error("Symbol " + key + " already defined!");
+            return get(symbol);
         }
-        return table[key] = type;
+        throw std::runtime_error("Symbol " + std::string{key} + " not found!");
+    }
+
+    SymbolTable::entry_type *SymbolTable::tryPut(Symbol key, entry_type type)
+    {
+        auto [entry, inserted] = table.try_emplace(key, std::move(type));
+        if (!inserted)
+        {
+            return nullptr;
+        }
+        if (index->active() == this)
+        {
+            index->bind(key, &entry->second);
+        }
+        return &entry->second;
+    }
+
+    SymbolTable::entry_type &SymbolTable::put(Symbol key, entry_type type)
+    {
+        if (auto entry = tryPut(key, std::move(type)))
+        {
+            return *entry;
+        }
+        throw std::runtime_error("Symbol " + std::string{interner->name(key)} + " already defined!");
+    }
+
+    SymbolTable::entry_type &SymbolTable::put(std::string_view key, entry_type type)
+    {
+        return put(interner->intern(key), std::move(type));
+    }
+
+    void SymbolTable::erase(Symbol key)
+    {
+        auto entry = table.find(key);
+        if (entry == table.end())
+        {
+            throw std::runtime_error("Symbol " + std::string{interner->name(key)} + " not found!");
+        }
+        if (auto binding = index->find(key); binding && binding->entry == &entry->second)
+        {
+            index->unbind(key);
+        }
+        table.erase(entry);
+    }
+
+    const std::pmr::unordered_map<Symbol, SymbolTable::entry_type> &SymbolTable::entries() const
+    {
+        return table;
+    }
+
+    Interner &SymbolTable::names()
+    {
+        return *interner;
     }
 
     void SymbolTable::addChild(std::unique_ptr<SymbolTable> child)
     {
         children.push_back(std::move(child));
+        index->enter(children.back().get());
+    }
+
+    SymbolTable *SymbolTable::close()
+    {
+        if (index->active() == this)
+        {
+            index->leave();
+        }
+        return parent;
     }
 
-}
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "Interpreter/VirtualMachine.hpp"
+#include "IR/IR.hpp"
+#include "Backend/Jit.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace lang = language;
+
+// The programs of the interpreter benchmark
+static const std::pair<const char*, const char*> programs[] = {
+    {"for", R"(
+        main(): int {
+            var sum = 0;
+            for (var i = 0; i < 3000000; i = i + 1) {
+                sum = sum + i * 2 - i / 3;
+            }
+            return sum;
+        }
+    )"},
+    {"nested", R"(
+        main(): int {
+            var count = 0;
+            for (var i = 0; i < 1500; i = i + 1) {
+                for (var j = 0; j < 1500; j = j + 1) {
+                    if (i < j && j - i < 100) count = count + 1;
+                }
+            }
+            return count;
+        }
+    )"},
+    {"float", R"(
+        main(): float {
+            var pi = 0.0;
+            var sign = 1.0;
+            var k = 0;
+            while (k < 2000000) {
+                pi = pi + sign * 4.0 / (2 * k + 1);
+                sign = 0.0 - sign;
+                k = k + 1;
+            }
+            return pi;
+        }
+    )"},
+    {"calls", R"(
+        fib(n: int): int {
+            if (n < 2) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        main(): int {
+            return fib(25);
+        }
+    )"},
+};
+
+template <typename Run>
+static auto bestOf(int runs, Run run) -> std::pair<lang::Value, double>
+{
+    lang::Value value;
+    auto best = 0.0;
+    for (int i = 0; i < runs; i++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        value = run();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return {value, best};
+}
+
+template <typename Run>
+static auto time(Run run) -> double
+{
+    auto begin = std::chrono::steady_clock::now();
+    run();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static auto check(const std::string& name, const lang::Value& actual, const lang::Value& expected) -> void
+{
+    if (lang::valueToStr(actual) != lang::valueToStr(expected))
+    {
+        std::cerr << name << ": returned " << lang::valueToStr(actual) << " instead of " << lang::valueToStr(expected) << '\n';
+        std::exit(1);
+    }
+}
+
+// The Jit time includes building the IR and compiling, the compile time is also reported on its own
+static auto measure(const std::string& name, const std::string& source) -> void
+{
+    lang::Parser parser{source};
+    auto program = parser.program();
+    auto bytecode = lang::lower(program);
+
+    auto [expected, walked] = bestOf(3, [&] { return lang::Interpreter{program}.run(); });
+    auto [interpreted, executed] = bestOf(3, [&] { return lang::VirtualMachine{bytecode}.run(); });
+    double compileMs = 0;
+    auto [native, jitted] = bestOf(3, [&] {
+        auto module = lang::ir::build(program);
+        lang::x86::Jit jit{module};
+        auto value = jit.run();
+        compileMs = jit.stats().compileMs;
+        return value;
+    });
+    check(name + " (bytecode)", interpreted, expected);
+    check(name + " (jit)", native, expected);
+
+    std::cout << name << ": " << lang::valueToStr(native) << '\n'
+              << "  ast:      " << walked << " ms\n"
+              << "  bytecode: " << executed << " ms (" << walked / executed << "x)\n"
+              << "  jit:      " << jitted << " ms (" << walked / jitted << "x, " << compileMs << " ms compiling)\n";
+}
+
+static auto name(std::size_t i) -> std::string
+{
+    std::string letters;
+    do
+    {
+        letters += static_cast<char>('a' + i % 26);
+        i /= 26;
+    } while (i > 0);
+    return letters;
+}
+
+// Many functions of which main calls two, the lazy Jit only compiles what runs
+static auto coldStart(std::size_t functions) -> void
+{
+    std::stringstream source;
+    for (std::size_t i = 0; i < functions; i++)
+    {
+        auto n = name(i);
+        source << "f_" << n << "(a: int, b: int): int {\n"
+               << "    var x = a + b * 2 - a * 3 * b + 1;\n"
+               << "    while (x > a) x = x - b - 1;\n"
+               << "    return x + " << i << ";\n"
+               << "}\n";
+    }
+    source << "main(): int { return f_" << name(0) << "(3, 4) + f_" << name(functions - 1) << "(5, 6); }\n";
+
+    auto text = source.str();
+    auto begin = std::chrono::steady_clock::now();
+    lang::Parser parser{text};
+    auto program = parser.program();
+    auto parsing = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    lang::ir::Module module;
+    auto building = time([&] { module = lang::ir::build(program); });
+
+    lang::Value lazy, eager, expected;
+    lang::x86::JitStats lazyStats, eagerStats;
+    auto lazyMs = time([&] {
+        lang::x86::Jit jit{module};
+        lazy = jit.run();
+        lazyStats = jit.stats();
+    });
+    auto eagerMs = time([&] {
+        lang::x86::Jit jit{module};
+        jit.compileAll();
+        eager = jit.run();
+        eagerStats = jit.stats();
+    });
+    auto walked = time([&] { expected = lang::Interpreter{program}.run(); });
+    check("cold start (lazy)", lazy, expected);
+    check("cold start (eager)", eager, expected);
+
+    std::cout << "cold start, " << functions << " functions:\n"
+              << "  parse:    " << parsing << " ms\n"
+              << "  ir:       " << building << " ms\n"
+              << "  lazy:     " << lazyMs << " ms (" << lazyStats.compiled << " compiled, " << lazyStats.bytes << " bytes)\n"
+              << "  eager:    " << eagerMs << " ms (" << eagerStats.compiled << " compiled, " << eagerStats.bytes << " bytes)\n"
+              << "  ast:      " << walked << " ms\n";
+}
+
+// Runs the built in programs on the Interpreter, the VirtualMachine and the Jit, then the cold start
+// of a program with the given number of functions
+int main(int argc, char** argv)
+{
+    for (auto [name, source] : programs)
+    {
+        measure(name, source);
+    }
+    coldStart(argc > 1 ? std::max<std::size_t>(std::strtoul(argv[1], nullptr, 10), 1) : 5000);
+}
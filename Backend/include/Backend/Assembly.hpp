@@ -0,0 +1,18 @@
+#pragma once
+#include "Machine.hpp"
+#include <string>
+
+namespace language::x86
+{
+    /*
+        GAS source in AT&T syntax for the System V ABI. Functions are named lang_<name>, the globals live in
+        lang_globals. The C main initializes the globals, calls main of the program and prints its result like
+        the Interpreter, a division by zero or a stack overflow prints an error and exits with status 1.
+        cc file.s links it against the C library.
+    */
+    auto emitAssembly(const MachineModule& module) -> std::string;
+    auto emitAssembly(const ir::Module& module) -> std::string;
+
+    auto regToStr(Reg reg, std::uint8_t size) -> std::string;
+    auto condToStr(Cond cond) -> std::string;
+}
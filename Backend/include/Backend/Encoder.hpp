@@ -0,0 +1,26 @@
+#pragma once
+#include "Machine.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace language::x86
+{
+    /*
+        Where the code of a function goes and the addresses its operands refer to. Globals, float constants,
+        the function table and the runtime routines are addressed relative to rip, so they have to be within
+        2 GB of the code. Calls go through the function table, which holds the address of every function.
+    */
+    struct CodeLayout
+    {
+        std::uintptr_t code = 0;
+        std::uintptr_t globals = 0;
+        std::uintptr_t floats = 0;
+        std::uintptr_t functions = 0;
+        std::uintptr_t stackLimit = 0;
+        std::array<std::uintptr_t, static_cast<std::size_t>(RuntimeRoutine::Count)> runtime = {};
+    };
+
+    // Machine code for a function placed at layout.code, jumps to its labels are resolved within it
+    auto encode(const MachineFunction& function, const CodeLayout& layout) -> std::vector<std::uint8_t>;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "Encoder.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace language::x86
+{
+    /*
+        One reservation of address space, data in front and code behind it, so the code reaches all of it
+        relative to rip. Data pages are readable and writable, code pages readable and executable and only
+        writable while append copies new code to them, no page is ever writable and executable (W^X).
+    */
+    class ExecutableMemory
+    {
+    public:
+        ExecutableMemory(std::size_t dataSize, std::size_t codeSize);
+        ~ExecutableMemory();
+        ExecutableMemory(const ExecutableMemory&) = delete;
+        auto operator=(const ExecutableMemory&) -> ExecutableMemory& = delete;
+
+        auto data() const -> std::byte*;
+        // Where the next append puts its code, 16 byte aligned
+        auto tail() const -> std::uintptr_t;
+        auto append(std::span<const std::uint8_t> code) -> std::uintptr_t;
+        auto codeSize() const -> std::size_t;
+
+    private:
+        std::byte* base;
+        std::size_t dataSize;
+        std::size_t capacity;
+        std::size_t used = 0;
+    };
+
+    struct JitStats
+    {
+        std::size_t compiled = 0; // functions
+        std::size_t bytes = 0;    // of machine code, stubs included
+        double compileMs = 0;     // in instruction selection, register allocation and encoding
+    };
+
+    /*
+        Compiles the functions of a module to machine code on their first call. Every entry of the function table
+        starts out at a stub that puts the function index in r11 and enters the resolver, which saves the argument
+        registers, compiles the function, points its table entry at the code and jumps there. Later calls go
+        straight to the code. A division by zero, a failed compilation or a call that would push below the stack
+        limit unwinds to run with longjmp, which throws a RuntimeError. run sets the limit a reserve above the
+        end of the thread's stack, the reserve is for the resolver compiling and for raising the overflow.
+    */
+    class Jit
+    {
+    public:
+        explicit Jit(const ir::Module& module);
+
+        // Initializes the globals and calls main
+        auto run() -> Value;
+        // Compiles every function now instead of on its first call
+        auto compileAll() -> void;
+        auto stats() const -> const JitStats&;
+
+    private:
+        static auto resolve(Jit* jit, std::size_t function) -> std::uintptr_t;
+        auto compile(std::size_t function) -> std::uintptr_t;
+        auto table() const -> std::uintptr_t*;
+        auto layout() const -> CodeLayout;
+
+        const ir::Module& module;
+        // The data is the function table, the globals, the float pool and the stack limit, in that order
+        std::size_t globalsOffset;
+        std::size_t floatsOffset;
+        std::size_t floatCapacity;
+        std::size_t stackLimitOffset;
+        ExecutableMemory memory;
+        std::vector<double> floats;
+        std::vector<bool> compiled;
+        std::array<std::uintptr_t, static_cast<std::size_t>(RuntimeRoutine::Count)> runtime = {};
+        JitStats statistics;
+    };
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "Machine.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace language::x86
+{
+    // A value lives in reg for its whole lifetime or, if reg is Reg::None, in the stack slot with index slot
+    struct Location
+    {
+        Reg reg = Reg::None;
+        std::size_t slot = 0;
+    };
+
+    /*
+        function is the input with its critical edges split, so the moves of the phis of a block can go to the end
+        of each predecessor. layout is the order the blocks are emitted in, every split edge follows its source.
+    */
+    struct Allocation
+    {
+        ir::Function function;
+        std::vector<ir::BlockId> layout;
+        std::vector<Location> locations;
+        std::vector<Reg> calleeSaved; // the callee saved registers the function has to preserve
+        std::size_t slots = 0;
+    };
+
+    /*
+        Poletto and Sarkar's linear scan over one live interval per value, the hull of every position the value is
+        live at. Constants get no location, they are immediates or loads from the float pool.
+        A value whose interval spans a call gets a callee saved register or a stack slot. rax, rdx, r11,
+        xmm0 and xmm15 are never handed out, instruction selection uses them as scratch registers.
+    */
+    auto allocateRegisters(const ir::Function& function) -> Allocation;
+}
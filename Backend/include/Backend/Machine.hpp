@@ -0,0 +1,119 @@
+#pragma once
+#include "IR/IR.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace language::x86
+{
+    // In encoding order, xmm registers follow the general purpose registers
+    enum class Reg : std::uint8_t
+    {
+        Rax, Rcx, Rdx, Rbx, Rsp, Rbp, Rsi, Rdi,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+        Xmm0, Xmm1, Xmm2, Xmm3, Xmm4, Xmm5, Xmm6, Xmm7,
+        Xmm8, Xmm9, Xmm10, Xmm11, Xmm12, Xmm13, Xmm14, Xmm15,
+        None
+    };
+
+    auto isXmm(Reg reg) -> bool;
+    // Low three bits of the register number, the fourth goes to the REX prefix
+    auto encoding(Reg reg) -> std::uint8_t;
+
+    // Condition codes in encoding order, cc ^ 1 is the negation
+    enum class Cond : std::uint8_t
+    {
+        O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G
+    };
+
+    auto negate(Cond cond) -> Cond;
+
+    enum class Mnemonic : std::uint8_t
+    {
+        Label, // defines the label in dst
+        Mov, MovZxByte, Lea, Push, Pop,
+        Add, Sub, Imul, And, Or, Xor, Neg, Cdq, Idiv, Cmp, Test, Set,
+        Movsd, Addsd, Subsd, Mulsd, Divsd, Ucomisd, Xorpd, Cvtsi2sd, Cvttsd2si,
+        Jmp, J, Call, Ret,
+    };
+
+    /*
+        Frame operands are [rbp + value], Global operands are globals + value and FloatConstant
+        operands name an entry of the float pool, both addressed relative to rip. The StackLimit
+        operand is the word holding the lowest address rsp may reach, relative to rip as well.
+        Runtime operands name a routine of the runtime, like the division by zero handler.
+    */
+    struct Operand
+    {
+        enum class Kind : std::uint8_t
+        {
+            None, Register, Immediate, Frame, Global, FloatConstant, Label, Function, Runtime, StackLimit
+        };
+
+        Kind kind = Kind::None;
+        Reg reg = Reg::None;
+        std::int64_t value = 0;
+
+        auto isMemory() const -> bool
+        {
+            return kind == Kind::Frame || kind == Kind::Global || kind == Kind::FloatConstant || kind == Kind::StackLimit;
+        }
+    };
+
+    auto reg(Reg reg) -> Operand;
+    auto imm(std::int64_t value) -> Operand;
+    auto frame(std::int64_t offset) -> Operand;
+    auto label(std::int64_t id) -> Operand;
+
+    enum class RuntimeRoutine : std::uint8_t
+    {
+        DivisionByZero,
+        CompileFunction, // the Jit's lazy compilation, r11 holds the index of the function
+        StackOverflow,
+        Count
+    };
+
+    /*
+        Two address instructions in AT&T order, the result goes to dst. size is the operand size in bytes,
+        1, 4 or 8. MovZxByte zero extends a byte, Set and J use cond. A Mov of an immediate with size 8
+        loads all 64 bits, a Call or Jmp to a register is indirect.
+    */
+    struct Instruction
+    {
+        Mnemonic op;
+        std::uint8_t size = 4;
+        Cond cond = Cond::O;
+        Operand dst = {};
+        Operand src = {};
+    };
+
+    struct MachineFunction
+    {
+        std::string name;
+        std::vector<Instruction> code;
+        std::size_t spills = 0; // stack slots the register allocator needed
+    };
+
+    /*
+        The lowered functions keep the indices of the ir::Module. main returns a value of mainResult.
+    */
+    struct MachineModule
+    {
+        std::vector<MachineFunction> functions;
+        std::vector<double> floats;
+        std::size_t globalsSize = 0;
+        std::size_t init = 0;
+        std::size_t main = static_cast<std::size_t>(-1);
+        ir::Type mainResult = ir::Type::Void;
+    };
+
+    /*
+        Instruction selection for the System V ABI. int and bool arguments go in rdi, rsi, rdx, rcx, r8 and r9,
+        float arguments in xmm0 to xmm7, any further ones on the stack. Values get registers from a linear scan over
+        the blocks in reverse postorder, values live across a call only get callee saved registers or a stack slot.
+        int division checks for zero and wraps INT_MIN / -1 like the Interpreter. Every prologue compares rsp with
+        the stack limit and enters the StackOverflow routine below it, so deep recursion is reported like in the VM.
+    */
+    auto select(const ir::Module& module) -> MachineModule;
+    auto select(const ir::Module& module, std::size_t function, std::vector<double>& floats) -> MachineFunction;
+}
@@ -0,0 +1,304 @@
+#include "Assembly.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+
+namespace language::x86
+{
+    namespace
+    {
+        constexpr std::size_t stackAllowance = std::size_t{7} << 20;
+
+        auto symbol(const MachineModule& module, std::size_t function) -> std::string
+        {
+            return function == module.init ? "__lang_init" : "lang_" + module.functions[function].name;
+        }
+
+        auto suffix(std::uint8_t size) -> char
+        {
+            return size == 1 ? 'b' : size == 8 ? 'q' : 'l';
+        }
+
+        auto mnemonic(const Instruction& inst) -> std::string
+        {
+            switch (inst.op)
+            {
+            case Mnemonic::Mov:
+                return std::string{"mov"} + suffix(inst.size);
+            case Mnemonic::MovZxByte:
+                return "movzbl";
+            case Mnemonic::Lea:
+                return "leaq";
+            case Mnemonic::Push:
+                return "pushq";
+            case Mnemonic::Pop:
+                return "popq";
+            case Mnemonic::Add:
+                return std::string{"add"} + suffix(inst.size);
+            case Mnemonic::Sub:
+                return std::string{"sub"} + suffix(inst.size);
+            case Mnemonic::Imul:
+                return std::string{"imul"} + suffix(inst.size);
+            case Mnemonic::And:
+                return std::string{"and"} + suffix(inst.size);
+            case Mnemonic::Or:
+                return std::string{"or"} + suffix(inst.size);
+            case Mnemonic::Xor:
+                return std::string{"xor"} + suffix(inst.size);
+            case Mnemonic::Neg:
+                return std::string{"neg"} + suffix(inst.size);
+            case Mnemonic::Cdq:
+                return "cltd";
+            case Mnemonic::Idiv:
+                return std::string{"idiv"} + suffix(inst.size);
+            case Mnemonic::Cmp:
+                return std::string{"cmp"} + suffix(inst.size);
+            case Mnemonic::Test:
+                return std::string{"test"} + suffix(inst.size);
+            case Mnemonic::Set:
+                return "set" + condToStr(inst.cond);
+            case Mnemonic::Movsd:
+                return "movsd";
+            case Mnemonic::Addsd:
+                return "addsd";
+            case Mnemonic::Subsd:
+                return "subsd";
+            case Mnemonic::Mulsd:
+                return "mulsd";
+            case Mnemonic::Divsd:
+                return "divsd";
+            case Mnemonic::Ucomisd:
+                return "ucomisd";
+            case Mnemonic::Xorpd:
+                return "xorpd";
+            case Mnemonic::Cvtsi2sd:
+                return "cvtsi2sdl";
+            case Mnemonic::Cvttsd2si:
+                return "cvttsd2si";
+            case Mnemonic::Jmp:
+                return "jmp";
+            case Mnemonic::J:
+                return "j" + condToStr(inst.cond);
+            case Mnemonic::Call:
+                return "call";
+            case Mnemonic::Ret:
+                return "ret";
+            default:
+                return "";
+            }
+        }
+
+        class Printer
+        {
+        public:
+            Printer(const MachineModule& module) : module{module}
+            {
+            }
+
+            auto run() -> std::string
+            {
+                out += "\t.text\n";
+                for (function = 0; function < module.functions.size(); function++)
+                {
+                    out += std::format("\t.p2align 4\n{}:\n", symbol(module, function));
+                    for (auto& inst : module.functions[function].code)
+                    {
+                        instruction(inst);
+                    }
+                }
+                entry();
+                data();
+                return std::move(out);
+            }
+
+        private:
+            auto operand(const Operand& op, std::uint8_t size) const -> std::string
+            {
+                switch (op.kind)
+                {
+                case Operand::Kind::Register:
+                    return "%" + regToStr(op.reg, size);
+                case Operand::Kind::Immediate:
+                    return std::format("${}", op.value);
+                case Operand::Kind::Frame:
+                    return std::format("{}(%rbp)", op.value);
+                case Operand::Kind::Global:
+                    return std::format("lang_globals+{}(%rip)", op.value);
+                case Operand::Kind::FloatConstant:
+                    return std::format(".LC{}(%rip)", op.value);
+                case Operand::Kind::Label:
+                    return std::format(".Lf{}_{}", function, op.value);
+                case Operand::Kind::Function:
+                    return symbol(module, static_cast<std::size_t>(op.value));
+                case Operand::Kind::Runtime:
+                    switch (static_cast<RuntimeRoutine>(op.value))
+                    {
+                    case RuntimeRoutine::DivisionByZero:
+                        return "__lang_division_by_zero";
+                    case RuntimeRoutine::StackOverflow:
+                        return "__lang_stack_overflow";
+                    default:
+                        return "__lang_compile";
+                    }
+                case Operand::Kind::StackLimit:
+                    return "lang_stack_limit(%rip)";
+                default:
+                    return "";
+                }
+            }
+
+            auto instruction(const Instruction& inst) -> void
+            {
+                if (inst.op == Mnemonic::Label)
+                {
+                    out += operand(inst.dst, 0) + ":\n";
+                    return;
+                }
+                // The operand sizes of the conversions differ, MovZxByte reads a byte and writes 32 bits
+                auto dstSize = inst.size;
+                auto srcSize = inst.size;
+                switch (inst.op)
+                {
+                case Mnemonic::MovZxByte:
+                    dstSize = 4;
+                    srcSize = 1;
+                    break;
+                case Mnemonic::Cvtsi2sd:
+                case Mnemonic::Cvttsd2si:
+                    dstSize = srcSize = 4;
+                    break;
+                default:
+                    break;
+                }
+                out += "\t" + mnemonic(inst);
+                if ((inst.op == Mnemonic::Call || inst.op == Mnemonic::Jmp) && inst.dst.kind == Operand::Kind::Register)
+                    out += "\t*" + operand(inst.dst, 8);
+                else if (inst.src.kind != Operand::Kind::None)
+                    out += "\t" + operand(inst.src, srcSize) + ", " + operand(inst.dst, dstSize);
+                else if (inst.dst.kind != Operand::Kind::None)
+                    out += "\t" + operand(inst.dst, dstSize);
+                out += "\n";
+            }
+
+            auto entry() -> void
+            {
+                out += "\t.globl\tmain\n"
+                       "\t.p2align 4\n"
+                       "main:\n"
+                       "\tpushq\t%rbp\n"
+                       "\tmovq\t%rsp, %rbp\n";
+                // The default stack is 8 MiB, the program may use 7 of them below main
+                out += std::format("\tleaq\t-{}(%rsp), %rax\n"
+                                   "\tmovq\t%rax, lang_stack_limit(%rip)\n",
+                                   stackAllowance);
+                out += std::format("\tcall\t{}\n", symbol(module, module.init));
+                if (module.main < module.functions.size())
+                {
+                    out += std::format("\tcall\t{}\n", symbol(module, module.main));
+                    switch (module.mainResult)
+                    {
+                    case ir::Type::Int:
+                        out += "\tmovl\t%eax, %esi\n"
+                               "\tleaq\t.Lint(%rip), %rdi\n"
+                               "\txorl\t%eax, %eax\n"
+                               "\tcall\tprintf@PLT\n";
+                        break;
+                    case ir::Type::Float:
+                        out += "\tleaq\t.Lfloat(%rip), %rdi\n"
+                               "\tmovl\t$1, %eax\n"
+                               "\tcall\tprintf@PLT\n";
+                        break;
+                    case ir::Type::Bool:
+                        out += "\tleaq\t.Lfalse(%rip), %rdi\n"
+                               "\tleaq\t.Ltrue(%rip), %rsi\n"
+                               "\ttestl\t%eax, %eax\n"
+                               "\tcmovneq\t%rsi, %rdi\n"
+                               "\tcall\tputs@PLT\n";
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                out += "\txorl\t%eax, %eax\n"
+                       "\tpopq\t%rbp\n"
+                       "\tret\n"
+                       "\t.p2align 4\n"
+                       "__lang_division_by_zero:\n"
+                       "\tandq\t$-16, %rsp\n"
+                       "\tleaq\t.Ldivision(%rip), %rdi\n"
+                       "\tcall\tputs@PLT\n"
+                       "\tmovl\t$1, %edi\n"
+                       "\tcall\texit@PLT\n"
+                       "\t.p2align 4\n"
+                       "__lang_stack_overflow:\n"
+                       "\tandq\t$-16, %rsp\n"
+                       "\tleaq\t.Loverflow(%rip), %rdi\n"
+                       "\tcall\tputs@PLT\n"
+                       "\tmovl\t$1, %edi\n"
+                       "\tcall\texit@PLT\n";
+            }
+
+            auto data() -> void
+            {
+                out += "\t.section\t.rodata\n"
+                       ".Lint:\n\t.string\t\"%d\\n\"\n"
+                       ".Lfloat:\n\t.string\t\"%.17g\\n\"\n"
+                       ".Ltrue:\n\t.string\t\"true\"\n"
+                       ".Lfalse:\n\t.string\t\"false\"\n"
+                       ".Ldivision:\n\t.string\t\"Division by zero\"\n"
+                       ".Loverflow:\n\t.string\t\"Stack overflow\"\n"
+                       "\t.p2align 3\n";
+                for (std::size_t i = 0; i < module.floats.size(); i++)
+                {
+                    out += std::format(".LC{}:\n\t.quad\t{:#x}\n", i, std::bit_cast<std::uint64_t>(module.floats[i]));
+                }
+                out += std::format("\t.bss\n"
+                                   "\t.p2align 3\n"
+                                   "lang_stack_limit:\n"
+                                   "\t.zero\t8\n"
+                                   "lang_globals:\n"
+                                   "\t.zero\t{}\n"
+                                   "\t.section\t.note.GNU-stack,\"\",@progbits\n",
+                                   std::max<std::size_t>(module.globalsSize, 8));
+            }
+
+            const MachineModule& module;
+            std::size_t function = 0;
+            std::string out;
+        };
+    }
+
+    auto regToStr(Reg reg, std::uint8_t size) -> std::string
+    {
+        static constexpr std::array<const char*, 16> wide{
+            "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+        static constexpr std::array<const char*, 8> dword{"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"};
+        static constexpr std::array<const char*, 8> byte{"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil"};
+        auto n = static_cast<std::size_t>(reg);
+        if (isXmm(reg))
+            return std::format("xmm{}", n - static_cast<std::size_t>(Reg::Xmm0));
+        if (size == 8)
+            return wide[n];
+        if (n >= 8)
+            return std::string{wide[n]} + (size == 1 ? "b" : "d");
+        return size == 1 ? byte[n] : dword[n];
+    }
+
+    auto condToStr(Cond cond) -> std::string
+    {
+        static constexpr std::array<const char*, 16> names{
+            "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"};
+        return names[static_cast<std::size_t>(cond)];
+    }
+
+    auto emitAssembly(const MachineModule& module) -> std::string
+    {
+        return Printer{module}.run();
+    }
+
+    auto emitAssembly(const ir::Module& module) -> std::string
+    {
+        return emitAssembly(select(module));
+    }
+}
@@ -0,0 +1,405 @@
+#include "Encoder.hpp"
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace language::x86
+{
+    namespace
+    {
+        // Opcodes of the two operand integer instructions, the byte forms are one less
+        struct Alu
+        {
+            std::uint8_t toRm;  // op r/m, reg
+            std::uint8_t toReg; // op reg, r/m
+            std::uint8_t extension;
+        };
+
+        auto alu(Mnemonic op) -> Alu
+        {
+            switch (op)
+            {
+            case Mnemonic::Add:
+                return {0x01, 0x03, 0};
+            case Mnemonic::Or:
+                return {0x09, 0x0B, 1};
+            case Mnemonic::And:
+                return {0x21, 0x23, 4};
+            case Mnemonic::Sub:
+                return {0x29, 0x2B, 5};
+            case Mnemonic::Xor:
+                return {0x31, 0x33, 6};
+            default:
+                return {0x39, 0x3B, 7};
+            }
+        }
+
+        auto number(Reg reg) -> std::uint8_t
+        {
+            return static_cast<std::uint8_t>(reg) & 15;
+        }
+
+        auto fitsByte(std::int64_t value) -> bool
+        {
+            return value >= -128 && value <= 127;
+        }
+
+        auto isRegister(const Operand& op) -> bool
+        {
+            return op.kind == Operand::Kind::Register;
+        }
+
+        // spl, bpl, sil and dil need a REX prefix, without one the encodings mean ah, ch, dh and bh
+        auto needsRexForByte(Reg reg) -> bool
+        {
+            return !isXmm(reg) && number(reg) >= 4 && number(reg) <= 7;
+        }
+
+        class Encoder
+        {
+        public:
+            explicit Encoder(const CodeLayout& layout) : layout{layout}
+            {
+            }
+
+            auto run(const MachineFunction& function) -> std::vector<std::uint8_t>
+            {
+                for (auto& inst : function.code)
+                {
+                    instruction(inst);
+                }
+                for (auto [at, id] : jumps)
+                {
+                    patch(at, static_cast<std::int64_t>(labels.at(id)) - static_cast<std::int64_t>(at + 4));
+                }
+                return std::move(code);
+            }
+
+        private:
+            auto byte(std::uint8_t b) -> void
+            {
+                code.push_back(b);
+            }
+
+            auto immediate(std::int64_t value, std::size_t bytes) -> void
+            {
+                for (std::size_t i = 0; i < bytes; i++)
+                {
+                    byte(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i)));
+                }
+            }
+
+            auto patch(std::size_t at, std::int64_t value) -> void
+            {
+                if (value < INT32_MIN || value > INT32_MAX)
+                {
+                    throw std::runtime_error("Jump target out of range");
+                }
+                for (std::size_t i = 0; i < 4; i++)
+                {
+                    code[at + i] = static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i));
+                }
+            }
+
+            auto address(const Operand& op) const -> std::uintptr_t
+            {
+                switch (op.kind)
+                {
+                case Operand::Kind::Global:
+                    return layout.globals + op.value;
+                case Operand::Kind::FloatConstant:
+                    return layout.floats + 8 * op.value;
+                case Operand::Kind::Function:
+                    return layout.functions + 8 * op.value;
+                case Operand::Kind::StackLimit:
+                    return layout.stackLimit;
+                default:
+                    return layout.runtime[op.value];
+                }
+            }
+
+            // Displacements relative to rip are known once the instruction, immediate included, is complete
+            auto end() -> void
+            {
+                if (rip)
+                {
+                    auto next = static_cast<std::int64_t>(layout.code + code.size());
+                    patch(rip->first, static_cast<std::int64_t>(rip->second) - next);
+                    rip.reset();
+                }
+            }
+
+            /*
+                [prefix] [REX] opcode ModRM [disp] with regField in the reg field and rm as register or memory operand.
+                byteReg and byteRm tell whether the registers are byte registers, which may need an empty REX.
+            */
+            auto modrm(std::optional<std::uint8_t> prefix, bool wide, std::initializer_list<std::uint8_t> opcode,
+                       std::uint8_t regField, const Operand& rm, bool byteReg = false, bool byteRm = false) -> void
+            {
+                if (prefix)
+                {
+                    byte(*prefix);
+                }
+                std::uint8_t rex = 0x40 | (wide ? 8 : 0) | (regField & 8 ? 4 : 0);
+                auto forceRex = byteReg && regField >= 4 && regField <= 7;
+                if (isRegister(rm))
+                {
+                    rex |= number(rm.reg) & 8 ? 1 : 0;
+                    forceRex |= byteRm && needsRexForByte(rm.reg);
+                }
+                if (rex != 0x40 || forceRex)
+                {
+                    byte(rex);
+                }
+                for (auto b : opcode)
+                {
+                    byte(b);
+                }
+
+                auto reg = static_cast<std::uint8_t>((regField & 7) << 3);
+                switch (rm.kind)
+                {
+                case Operand::Kind::Register:
+                    byte(0xC0 | reg | (number(rm.reg) & 7));
+                    break;
+                case Operand::Kind::Frame:
+                    // rbp as base always takes a displacement
+                    if (fitsByte(rm.value))
+                    {
+                        byte(0x40 | reg | 5);
+                        immediate(rm.value, 1);
+                    }
+                    else
+                    {
+                        byte(0x80 | reg | 5);
+                        immediate(rm.value, 4);
+                    }
+                    break;
+                default:
+                    byte(reg | 5);
+                    rip = {code.size(), address(rm)};
+                    immediate(0, 4);
+                    break;
+                }
+            }
+
+            auto mov(const Instruction& inst) -> void
+            {
+                auto wide = inst.size == 8;
+                auto& dst = inst.dst;
+                auto& src = inst.src;
+                if (src.kind == Operand::Kind::Immediate)
+                {
+                    if (isRegister(dst))
+                    {
+                        // movabs for size 8, otherwise the 32 bit move that zero extends
+                        if (wide || number(dst.reg) & 8)
+                        {
+                            byte(0x40 | (wide ? 8 : 0) | (number(dst.reg) & 8 ? 1 : 0));
+                        }
+                        byte(0xB8 + (number(dst.reg) & 7));
+                        immediate(src.value, wide ? 8 : 4);
+                    }
+                    else if (inst.size == 1)
+                    {
+                        modrm(std::nullopt, false, {0xC6}, 0, dst);
+                        immediate(src.value, 1);
+                    }
+                    else
+                    {
+                        modrm(std::nullopt, wide, {0xC7}, 0, dst);
+                        immediate(src.value, 4);
+                    }
+                }
+                else if (isRegister(src))
+                {
+                    auto byteForm = inst.size == 1;
+                    modrm(std::nullopt, wide, {static_cast<std::uint8_t>(byteForm ? 0x88 : 0x89)}, number(src.reg), dst, byteForm, byteForm);
+                }
+                else
+                {
+                    auto byteForm = inst.size == 1;
+                    modrm(std::nullopt, wide, {static_cast<std::uint8_t>(byteForm ? 0x8A : 0x8B)}, number(dst.reg), src, byteForm);
+                }
+            }
+
+            auto arithmetic(const Instruction& inst) -> void
+            {
+                auto wide = inst.size == 8;
+                auto byteForm = inst.size == 1;
+                auto ops = alu(inst.op);
+                auto& dst = inst.dst;
+                auto& src = inst.src;
+                if (src.kind == Operand::Kind::Immediate)
+                {
+                    if (byteForm)
+                    {
+                        modrm(std::nullopt, false, {0x80}, ops.extension, dst, false, true);
+                        immediate(src.value, 1);
+                    }
+                    else if (fitsByte(src.value))
+                    {
+                        modrm(std::nullopt, wide, {0x83}, ops.extension, dst);
+                        immediate(src.value, 1);
+                    }
+                    else
+                    {
+                        modrm(std::nullopt, wide, {0x81}, ops.extension, dst);
+                        immediate(src.value, 4);
+                    }
+                }
+                else if (isRegister(src))
+                {
+                    modrm(std::nullopt, wide, {static_cast<std::uint8_t>(ops.toRm - byteForm)}, number(src.reg), dst, byteForm, byteForm);
+                }
+                else
+                {
+                    modrm(std::nullopt, wide, {static_cast<std::uint8_t>(ops.toReg - byteForm)}, number(dst.reg), src, byteForm);
+                }
+            }
+
+            auto sse(std::uint8_t prefix, std::uint8_t opcode, const Instruction& inst) -> void
+            {
+                modrm(prefix, false, {0x0F, opcode}, number(inst.dst.reg), inst.src);
+            }
+
+            auto jump(std::initializer_list<std::uint8_t> opcode, const Operand& target) -> void
+            {
+                for (auto b : opcode)
+                {
+                    byte(b);
+                }
+                if (target.kind == Operand::Kind::Label)
+                {
+                    jumps.emplace_back(code.size(), target.value);
+                    immediate(0, 4);
+                    return;
+                }
+                rip = {code.size(), address(target)};
+                immediate(0, 4);
+            }
+
+            auto instruction(const Instruction& inst) -> void
+            {
+                auto wide = inst.size == 8;
+                switch (inst.op)
+                {
+                case Mnemonic::Label:
+                    labels[inst.dst.value] = code.size();
+                    break;
+                case Mnemonic::Mov:
+                    mov(inst);
+                    break;
+                case Mnemonic::MovZxByte:
+                    modrm(std::nullopt, false, {0x0F, 0xB6}, number(inst.dst.reg), inst.src, false, true);
+                    break;
+                case Mnemonic::Lea:
+                    modrm(std::nullopt, true, {0x8D}, number(inst.dst.reg), inst.src);
+                    break;
+                case Mnemonic::Push:
+                case Mnemonic::Pop:
+                    if (number(inst.dst.reg) & 8)
+                    {
+                        byte(0x41);
+                    }
+                    byte((inst.op == Mnemonic::Push ? 0x50 : 0x58) + (number(inst.dst.reg) & 7));
+                    break;
+                case Mnemonic::Add:
+                case Mnemonic::Sub:
+                case Mnemonic::And:
+                case Mnemonic::Or:
+                case Mnemonic::Xor:
+                case Mnemonic::Cmp:
+                    arithmetic(inst);
+                    break;
+                case Mnemonic::Imul:
+                    if (inst.src.kind == Operand::Kind::Immediate)
+                    {
+                        auto small = fitsByte(inst.src.value);
+                        modrm(std::nullopt, wide, {static_cast<std::uint8_t>(small ? 0x6B : 0x69)}, number(inst.dst.reg), inst.dst);
+                        immediate(inst.src.value, small ? 1 : 4);
+                    }
+                    else
+                    {
+                        modrm(std::nullopt, wide, {0x0F, 0xAF}, number(inst.dst.reg), inst.src);
+                    }
+                    break;
+                case Mnemonic::Neg:
+                    modrm(std::nullopt, wide, {0xF7}, 3, inst.dst);
+                    break;
+                case Mnemonic::Idiv:
+                    modrm(std::nullopt, wide, {0xF7}, 7, inst.dst);
+                    break;
+                case Mnemonic::Cdq:
+                    byte(0x99);
+                    break;
+                case Mnemonic::Test:
+                    modrm(std::nullopt, wide, {0x85}, number(inst.src.reg), inst.dst);
+                    break;
+                case Mnemonic::Set:
+                    modrm(std::nullopt, false, {0x0F, static_cast<std::uint8_t>(0x90 + static_cast<std::uint8_t>(inst.cond))}, 0, inst.dst, false, true);
+                    break;
+                case Mnemonic::Movsd:
+                    if (isRegister(inst.dst))
+                        sse(0xF2, 0x10, inst);
+                    else
+                        modrm(0xF2, false, {0x0F, 0x11}, number(inst.src.reg), inst.dst);
+                    break;
+                case Mnemonic::Addsd:
+                    sse(0xF2, 0x58, inst);
+                    break;
+                case Mnemonic::Mulsd:
+                    sse(0xF2, 0x59, inst);
+                    break;
+                case Mnemonic::Subsd:
+                    sse(0xF2, 0x5C, inst);
+                    break;
+                case Mnemonic::Divsd:
+                    sse(0xF2, 0x5E, inst);
+                    break;
+                case Mnemonic::Ucomisd:
+                    sse(0x66, 0x2E, inst);
+                    break;
+                case Mnemonic::Xorpd:
+                    sse(0x66, 0x57, inst);
+                    break;
+                case Mnemonic::Cvtsi2sd:
+                    sse(0xF2, 0x2A, inst);
+                    break;
+                case Mnemonic::Cvttsd2si:
+                    sse(0xF2, 0x2C, inst);
+                    break;
+                case Mnemonic::Jmp:
+                    if (isRegister(inst.dst))
+                        modrm(std::nullopt, false, {0xFF}, 4, inst.dst);
+                    else
+                        jump({0xE9}, inst.dst);
+                    break;
+                case Mnemonic::J:
+                    jump({0x0F, static_cast<std::uint8_t>(0x80 + static_cast<std::uint8_t>(inst.cond))}, inst.dst);
+                    break;
+                case Mnemonic::Call:
+                    // Through the function table, so a call to a function that is not compiled yet reaches its stub
+                    modrm(std::nullopt, false, {0xFF}, 2, inst.dst);
+                    break;
+                case Mnemonic::Ret:
+                    byte(0xC3);
+                    break;
+                }
+                end();
+            }
+
+            const CodeLayout& layout;
+            std::vector<std::uint8_t> code;
+            std::unordered_map<std::int64_t, std::size_t> labels;
+            std::vector<std::pair<std::size_t, std::int64_t>> jumps;
+            std::optional<std::pair<std::size_t, std::uintptr_t>> rip;
+        };
+    }
+
+    auto encode(const MachineFunction& function, const CodeLayout& layout) -> std::vector<std::uint8_t>
+    {
+        return Encoder{layout}.run(function);
+    }
+}
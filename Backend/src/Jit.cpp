@@ -0,0 +1,333 @@
+#include "Jit.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstring>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace language::x86
+{
+    namespace
+    {
+        // Everything has to stay within 2 GB of the code, so the reservation is bounded
+        constexpr std::size_t codeReservation = std::size_t{256} << 20;
+        constexpr std::array argumentRegisters{Reg::Rdi, Reg::Rsi, Reg::Rdx, Reg::Rcx, Reg::R8, Reg::R9};
+        constexpr std::size_t floatArguments = 8;
+        constexpr std::size_t stackReserve = std::size_t{256} << 10;
+
+        auto pageSize() -> std::size_t
+        {
+            static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        auto roundUp(std::size_t n, std::size_t to) -> std::size_t
+        {
+            return (n + to - 1) / to * to;
+        }
+
+        // Where a division by zero or a failed compilation continues, set by the innermost Jit::run
+        struct Trap
+        {
+            std::jmp_buf env;
+            std::string message;
+        };
+
+        thread_local Trap* trap = nullptr;
+
+        [[noreturn]] auto raise(const char* message) -> void
+        {
+            trap->message = message;
+            std::longjmp(trap->env, 1);
+        }
+
+        [[noreturn]] auto divisionByZero() -> void
+        {
+            raise("Division by zero");
+        }
+
+        [[noreturn]] auto stackOverflow() -> void
+        {
+            raise("Stack overflow");
+        }
+
+        // The lowest address of the stack of this thread plus the reserve, 0 checks nothing if it is unknown
+        auto stackLimit() -> std::uintptr_t
+        {
+            pthread_attr_t attributes;
+            if (pthread_getattr_np(pthread_self(), &attributes) != 0)
+            {
+                return 0;
+            }
+            void* lowest = nullptr;
+            std::size_t size = 0;
+            auto known = pthread_attr_getstack(&attributes, &lowest, &size) == 0;
+            pthread_attr_destroy(&attributes);
+            return known && size > stackReserve ? reinterpret_cast<std::uintptr_t>(lowest) + stackReserve : 0;
+        }
+
+        auto address(auto* pointer) -> std::int64_t
+        {
+            return static_cast<std::int64_t>(reinterpret_cast<std::uintptr_t>(pointer));
+        }
+
+        auto floatConstants(const ir::Module& module) -> std::size_t
+        {
+            std::size_t count = 0;
+            for (auto& function : module.functions)
+            {
+                count += std::ranges::count_if(function.values, [](auto& inst) { return inst.op == ir::Opcode::Const && inst.type == ir::Type::Float; });
+            }
+            return count;
+        }
+    }
+
+    ExecutableMemory::ExecutableMemory(std::size_t dataSize, std::size_t codeSize)
+        : dataSize{roundUp(std::max<std::size_t>(dataSize, 1), pageSize())}, capacity{roundUp(codeSize, pageSize())}
+    {
+        auto reserved = mmap(nullptr, this->dataSize + capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reserved == MAP_FAILED)
+        {
+            throw std::runtime_error("Could not reserve memory for the Jit");
+        }
+        base = static_cast<std::byte*>(reserved);
+        if (mprotect(base, this->dataSize, PROT_READ | PROT_WRITE) != 0)
+        {
+            munmap(base, this->dataSize + capacity);
+            throw std::runtime_error("Could not map the data of the Jit");
+        }
+    }
+
+    ExecutableMemory::~ExecutableMemory()
+    {
+        munmap(base, dataSize + capacity);
+    }
+
+    auto ExecutableMemory::data() const -> std::byte*
+    {
+        return base;
+    }
+
+    auto ExecutableMemory::tail() const -> std::uintptr_t
+    {
+        return reinterpret_cast<std::uintptr_t>(base + dataSize + used);
+    }
+
+    auto ExecutableMemory::append(std::span<const std::uint8_t> code) -> std::uintptr_t
+    {
+        if (used + code.size() > capacity)
+        {
+            throw std::runtime_error("The Jit ran out of code space");
+        }
+        auto start = base + dataSize + used;
+        auto first = base + dataSize + used / pageSize() * pageSize();
+        auto last = base + dataSize + roundUp(used + code.size(), pageSize());
+        if (mprotect(first, last - first, PROT_READ | PROT_WRITE) != 0)
+        {
+            throw std::runtime_error("Could not make Jit code writable");
+        }
+        std::memcpy(start, code.data(), code.size());
+        if (mprotect(first, last - first, PROT_READ | PROT_EXEC) != 0)
+        {
+            throw std::runtime_error("Could not make Jit code executable");
+        }
+        used = roundUp(used + code.size(), 16);
+        return reinterpret_cast<std::uintptr_t>(start);
+    }
+
+    auto ExecutableMemory::codeSize() const -> std::size_t
+    {
+        return used;
+    }
+
+    Jit::Jit(const ir::Module& module)
+        : module{module},
+          globalsOffset{8 * module.functions.size()},
+          floatsOffset{globalsOffset + roundUp(module.globalsSize, 8)},
+          floatCapacity{floatConstants(module)},
+          stackLimitOffset{floatsOffset + 8 * floatCapacity},
+          memory{stackLimitOffset + 8, codeReservation},
+          compiled(module.functions.size(), false)
+    {
+        // Realigns the stack for the call into C++, which does not come back
+        MachineFunction division{.name = "division by zero"};
+        division.code = {
+            {.op = Mnemonic::And, .size = 8, .dst = reg(Reg::Rsp), .src = imm(-16)},
+            {.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rax), .src = imm(address(&divisionByZero))},
+            {.op = Mnemonic::Call, .dst = reg(Reg::Rax)},
+        };
+        runtime[static_cast<std::size_t>(RuntimeRoutine::DivisionByZero)] = memory.append(encode(division, layout()));
+        MachineFunction overflow{.name = "stack overflow"};
+        overflow.code = {
+            {.op = Mnemonic::And, .size = 8, .dst = reg(Reg::Rsp), .src = imm(-16)},
+            {.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rax), .src = imm(address(&stackOverflow))},
+            {.op = Mnemonic::Call, .dst = reg(Reg::Rax)},
+        };
+        runtime[static_cast<std::size_t>(RuntimeRoutine::StackOverflow)] = memory.append(encode(overflow, layout()));
+
+        // Saves the arguments of the call in flight around resolve, rsp is 16 byte aligned at the call
+        MachineFunction resolver{.name = "resolver"};
+        auto& code = resolver.code;
+        code.push_back({.op = Mnemonic::Push, .size = 8, .dst = reg(Reg::Rbp)});
+        code.push_back({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rbp), .src = reg(Reg::Rsp)});
+        for (auto r : argumentRegisters)
+        {
+            code.push_back({.op = Mnemonic::Push, .size = 8, .dst = reg(r)});
+        }
+        auto floatSlot = [](std::size_t i) { return frame(-8 * static_cast<std::int64_t>(argumentRegisters.size() + i + 1)); };
+        code.push_back({.op = Mnemonic::Sub, .size = 8, .dst = reg(Reg::Rsp), .src = imm(8 * floatArguments)});
+        for (std::size_t i = 0; i < floatArguments; i++)
+        {
+            code.push_back({.op = Mnemonic::Movsd, .dst = floatSlot(i), .src = reg(static_cast<Reg>(static_cast<int>(Reg::Xmm0) + i))});
+        }
+        code.push_back({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rdi), .src = imm(address(this))});
+        code.push_back({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rsi), .src = reg(Reg::R11)});
+        code.push_back({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rax), .src = imm(address(&Jit::resolve))});
+        code.push_back({.op = Mnemonic::Call, .dst = reg(Reg::Rax)});
+        code.push_back({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::R11), .src = reg(Reg::Rax)});
+        for (std::size_t i = 0; i < floatArguments; i++)
+        {
+            code.push_back({.op = Mnemonic::Movsd, .dst = reg(static_cast<Reg>(static_cast<int>(Reg::Xmm0) + i)), .src = floatSlot(i)});
+        }
+        code.push_back({.op = Mnemonic::Lea, .size = 8, .dst = reg(Reg::Rsp), .src = frame(-8 * static_cast<std::int64_t>(argumentRegisters.size()))});
+        for (auto r : argumentRegisters | std::views::reverse)
+        {
+            code.push_back({.op = Mnemonic::Pop, .size = 8, .dst = reg(r)});
+        }
+        code.push_back({.op = Mnemonic::Pop, .size = 8, .dst = reg(Reg::Rbp)});
+        code.push_back({.op = Mnemonic::Jmp, .dst = reg(Reg::R11)});
+        runtime[static_cast<std::size_t>(RuntimeRoutine::CompileFunction)] = memory.append(encode(resolver, layout()));
+
+        // All stubs go to the code space at once, that is two mprotect calls however large the program is
+        std::vector<std::uint8_t> stubs;
+        auto first = memory.tail();
+        for (std::size_t i = 0; i < module.functions.size(); i++)
+        {
+            MachineFunction stub{.name = module.functions[i].name};
+            stub.code = {
+                {.op = Mnemonic::Mov, .dst = reg(Reg::R11), .src = imm(static_cast<std::int64_t>(i))},
+                {.op = Mnemonic::Jmp, .dst = {.kind = Operand::Kind::Runtime, .value = static_cast<std::int64_t>(RuntimeRoutine::CompileFunction)}},
+            };
+            auto at = layout();
+            at.code = first + stubs.size();
+            table()[i] = at.code;
+            auto bytes = encode(stub, at);
+            stubs.insert(stubs.end(), bytes.begin(), bytes.end());
+        }
+        memory.append(stubs);
+        statistics.bytes = memory.codeSize();
+    }
+
+    auto Jit::table() const -> std::uintptr_t*
+    {
+        return reinterpret_cast<std::uintptr_t*>(memory.data());
+    }
+
+    auto Jit::layout() const -> CodeLayout
+    {
+        auto data = reinterpret_cast<std::uintptr_t>(memory.data());
+        return {
+            .code = memory.tail(),
+            .globals = data + globalsOffset,
+            .floats = data + floatsOffset,
+            .functions = data,
+            .stackLimit = data + stackLimitOffset,
+            .runtime = runtime,
+        };
+    }
+
+    // Called by the resolver on machine code frames, so nothing may propagate out of it
+    auto Jit::resolve(Jit* jit, std::size_t function) -> std::uintptr_t
+    {
+        try
+        {
+            return jit->compile(function);
+        }
+        catch (std::exception& e)
+        {
+            trap->message = e.what();
+        }
+        std::longjmp(trap->env, 1);
+    }
+
+    auto Jit::compile(std::size_t function) -> std::uintptr_t
+    {
+        if (compiled[function])
+        {
+            return table()[function];
+        }
+        auto begin = std::chrono::steady_clock::now();
+        auto pooled = floats.size();
+        auto machine = select(module, function, floats);
+        if (floats.size() > pooled)
+        {
+            std::memcpy(memory.data() + floatsOffset + 8 * pooled, floats.data() + pooled, 8 * (floats.size() - pooled));
+        }
+        auto code = encode(machine, layout());
+        auto entry = memory.append(code);
+        table()[function] = entry;
+        compiled[function] = true;
+
+        statistics.compiled++;
+        statistics.bytes += code.size();
+        statistics.compileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        return entry;
+    }
+
+    auto Jit::compileAll() -> void
+    {
+        for (std::size_t i = 0; i < module.functions.size(); i++)
+        {
+            compile(i);
+        }
+    }
+
+    auto Jit::stats() const -> const JitStats&
+    {
+        return statistics;
+    }
+
+    auto Jit::run() -> Value
+    {
+        if (module.main >= module.functions.size())
+        {
+            throw RuntimeError("main is not a function");
+        }
+
+        Trap here;
+        auto outer = std::exchange(trap, &here);
+        if (setjmp(here.env))
+        {
+            trap = outer;
+            throw RuntimeError(here.message);
+        }
+
+        *reinterpret_cast<std::uintptr_t*>(memory.data() + stackLimitOffset) = stackLimit();
+        reinterpret_cast<void (*)()>(table()[module.init])();
+        auto main = table()[module.main];
+        Value result;
+        switch (module.functions[module.main].result)
+        {
+        case ir::Type::Int:
+            result = reinterpret_cast<int (*)()>(main)();
+            break;
+        case ir::Type::Float:
+            result = reinterpret_cast<double (*)()>(main)();
+            break;
+        case ir::Type::Bool:
+            result = reinterpret_cast<int (*)()>(main)() != 0;
+            break;
+        case ir::Type::Void:
+            reinterpret_cast<void (*)()>(main)();
+            break;
+        }
+        trap = outer;
+        return result;
+    }
+}
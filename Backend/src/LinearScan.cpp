@@ -0,0 +1,329 @@
+#include "LinearScan.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+
+namespace language::x86
+{
+    namespace
+    {
+        using ir::BlockId;
+        using ir::Opcode;
+        using ir::ValueId;
+
+        // Caller saved registers come first, an interval that does not span a call takes the first free one
+        constexpr std::array generalRegisters{
+            Reg::Rcx, Reg::Rsi, Reg::Rdi, Reg::R8, Reg::R9, Reg::R10,
+            Reg::Rbx, Reg::R12, Reg::R13, Reg::R14, Reg::R15};
+        constexpr std::array floatRegisters{
+            Reg::Xmm1, Reg::Xmm2, Reg::Xmm3, Reg::Xmm4, Reg::Xmm5, Reg::Xmm6, Reg::Xmm7,
+            Reg::Xmm8, Reg::Xmm9, Reg::Xmm10, Reg::Xmm11, Reg::Xmm12, Reg::Xmm13, Reg::Xmm14};
+
+        auto isCalleeSaved(Reg reg) -> bool
+        {
+            return reg == Reg::Rbx || (reg >= Reg::R12 && reg <= Reg::R15);
+        }
+
+        auto hasPhis(const ir::Function& function, BlockId block) -> bool
+        {
+            auto& instructions = function.blocks[block].instructions;
+            return !instructions.empty() && function.values[instructions.front()].op == Opcode::Phi;
+        }
+
+        // Puts a block with a single Jump on every edge from a block with several successors to a block with phis
+        auto splitCriticalEdges(ir::Function& function) -> std::vector<BlockId>
+        {
+            std::vector<BlockId> layout;
+            auto count = static_cast<BlockId>(function.blocks.size());
+            for (BlockId block = 0; block < count; block++)
+            {
+                layout.push_back(block);
+                if (function.blocks[block].successors.size() < 2)
+                {
+                    continue;
+                }
+                for (std::size_t i = 0; i < function.blocks[block].successors.size(); i++)
+                {
+                    auto target = function.blocks[block].successors[i];
+                    if (!hasPhis(function, target))
+                    {
+                        continue;
+                    }
+                    auto edge = static_cast<BlockId>(function.blocks.size());
+                    auto jump = static_cast<ValueId>(function.values.size());
+                    function.values.push_back({.op = Opcode::Jump, .type = ir::Type::Void, .block = edge});
+                    function.blocks.push_back({.instructions = {jump}, .predecessors = {block}, .successors = {target}});
+                    function.blocks[block].successors[i] = edge;
+                    auto& predecessors = function.blocks[target].predecessors;
+                    *std::ranges::find(predecessors, block) = edge;
+                    layout.push_back(edge);
+                }
+            }
+            return layout;
+        }
+
+        class Bits
+        {
+        public:
+            explicit Bits(std::size_t size) : words((size + 63) / 64)
+            {
+            }
+
+            auto set(std::size_t i) -> void
+            {
+                words[i / 64] |= std::uint64_t{1} << (i % 64);
+            }
+            auto reset(std::size_t i) -> void
+            {
+                words[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+            }
+            auto test(std::size_t i) const -> bool
+            {
+                return words[i / 64] >> (i % 64) & 1;
+            }
+            // Returns whether a bit was added
+            auto merge(const Bits& other) -> bool
+            {
+                auto changed = false;
+                for (std::size_t i = 0; i < words.size(); i++)
+                {
+                    auto merged = words[i] | other.words[i];
+                    changed |= merged != words[i];
+                    words[i] = merged;
+                }
+                return changed;
+            }
+            template <typename F>
+            auto forEach(F f) const -> void
+            {
+                for (std::size_t i = 0; i < words.size(); i++)
+                {
+                    for (auto word = words[i]; word; word &= word - 1)
+                    {
+                        f(i * 64 + std::countr_zero(word));
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::uint64_t> words;
+        };
+
+        struct Interval
+        {
+            ValueId value;
+            std::size_t begin = std::numeric_limits<std::size_t>::max();
+            std::size_t end = 0;
+            bool crossesCall = false;
+
+            auto extend(std::size_t position) -> void
+            {
+                begin = std::min(begin, position);
+                end = std::max(end, position);
+            }
+        };
+
+        /*
+            Phis are defined at the start of their block, the other instructions two positions apart.
+            The operands of a phi are live at the end of the matching predecessor.
+        */
+        auto liveIntervals(const ir::Function& function, const std::vector<BlockId>& layout) -> std::vector<Interval>
+        {
+            auto& blocks = function.blocks;
+            auto& values = function.values;
+            std::vector<Bits> liveIn(blocks.size(), Bits{values.size()});
+            std::vector<Bits> liveOut(blocks.size(), Bits{values.size()});
+            std::vector<Bits> uses(blocks.size(), Bits{values.size()});
+            std::vector<Bits> defs(blocks.size(), Bits{values.size()});
+            for (BlockId block = 0; block < blocks.size(); block++)
+            {
+                for (auto id : blocks[block].instructions)
+                {
+                    if (values[id].op != Opcode::Phi)
+                    {
+                        for (auto operand : values[id].operands)
+                        {
+                            if (!defs[block].test(operand))
+                            {
+                                uses[block].set(operand);
+                            }
+                        }
+                    }
+                    defs[block].set(id);
+                }
+            }
+
+            for (auto changed = true; changed;)
+            {
+                changed = false;
+                for (auto block : layout | std::views::reverse)
+                {
+                    for (auto successor : blocks[block].successors)
+                    {
+                        changed |= liveOut[block].merge(liveIn[successor]);
+                        auto index = std::ranges::find(blocks[successor].predecessors, block) - blocks[successor].predecessors.begin();
+                        for (auto id : blocks[successor].instructions)
+                        {
+                            if (values[id].op != Opcode::Phi)
+                            {
+                                break;
+                            }
+                            auto operand = values[id].operands[index];
+                            changed |= !liveOut[block].test(operand);
+                            liveOut[block].set(operand);
+                        }
+                    }
+                    auto in = liveOut[block];
+                    defs[block].forEach([&](std::size_t id) { in.reset(id); });
+                    in.merge(uses[block]);
+                    changed |= liveIn[block].merge(in);
+                }
+            }
+
+            std::vector<Interval> intervals(values.size());
+            std::vector<std::size_t> calls;
+            std::size_t position = 0;
+            for (auto block : layout)
+            {
+                auto start = position;
+                liveIn[block].forEach([&](std::size_t id) { intervals[id].extend(start); });
+                for (auto id : blocks[block].instructions)
+                {
+                    auto& inst = values[id];
+                    if (inst.op == Opcode::Phi)
+                    {
+                        intervals[id].extend(start);
+                        continue;
+                    }
+                    position += 2;
+                    intervals[id].extend(inst.op == Opcode::Param ? 0 : position);
+                    for (auto operand : inst.operands)
+                    {
+                        intervals[operand].extend(position);
+                    }
+                    if (inst.op == Opcode::Call)
+                    {
+                        calls.push_back(position);
+                    }
+                }
+                position += 2;
+                liveOut[block].forEach([&](std::size_t id) { intervals[id].extend(position); });
+                position += 2;
+            }
+
+            for (ValueId id = 0; id < intervals.size(); id++)
+            {
+                auto& interval = intervals[id];
+                interval.value = id;
+                auto call = std::ranges::upper_bound(calls, interval.begin);
+                interval.crossesCall = call != calls.end() && *call < interval.end;
+            }
+            return intervals;
+        }
+
+        // Orders the general purpose registers caller saved first, like generalRegisters
+        auto rank(Reg reg) -> std::size_t
+        {
+            auto it = std::ranges::find(generalRegisters, reg);
+            return it != generalRegisters.end() ? static_cast<std::size_t>(it - generalRegisters.begin()) : static_cast<std::size_t>(reg);
+        }
+
+        struct Scan
+        {
+            Allocation& allocation;
+            std::vector<Interval> active;
+            std::vector<Reg> free;
+
+            auto spill(ValueId value) -> void
+            {
+                allocation.locations[value] = {.reg = Reg::None, .slot = allocation.slots++};
+            }
+
+            auto run(std::vector<Interval>& intervals) -> void
+            {
+                for (auto& current : intervals)
+                {
+                    std::erase_if(active, [&](const Interval& interval)
+                                  {
+                                      if (interval.end >= current.begin)
+                                          return false;
+                                      free.push_back(allocation.locations[interval.value].reg);
+                                      return true; });
+
+                    auto eligible = [&](Reg reg) { return !current.crossesCall || isCalleeSaved(reg); };
+                    std::ranges::sort(free, {}, rank);
+                    if (auto reg = std::ranges::find_if(free, eligible); reg != free.end())
+                    {
+                        allocation.locations[current.value].reg = *reg;
+                        free.erase(reg);
+                        active.push_back(current);
+                        continue;
+                    }
+
+                    auto victim = active.end();
+                    for (auto it = active.begin(); it != active.end(); it++)
+                    {
+                        if (eligible(allocation.locations[it->value].reg) && (victim == active.end() || it->end > victim->end))
+                        {
+                            victim = it;
+                        }
+                    }
+                    if (victim != active.end() && victim->end > current.end)
+                    {
+                        allocation.locations[current.value].reg = allocation.locations[victim->value].reg;
+                        spill(victim->value);
+                        *victim = current;
+                    }
+                    else
+                    {
+                        spill(current.value);
+                    }
+                }
+            }
+        };
+
+    }
+
+    auto allocateRegisters(const ir::Function& function) -> Allocation
+    {
+        Allocation allocation{.function = function};
+        allocation.layout = splitCriticalEdges(allocation.function);
+        auto& values = allocation.function.values;
+        allocation.locations.resize(values.size());
+
+        auto intervals = liveIntervals(allocation.function, allocation.layout);
+        std::vector<Interval> general;
+        std::vector<Interval> floats;
+        for (auto& interval : intervals)
+        {
+            auto& inst = values[interval.value];
+            if (inst.type == ir::Type::Void || inst.op == Opcode::Const || interval.begin > interval.end)
+                continue;
+            if (values[interval.value].type == ir::Type::Float)
+                floats.push_back(interval);
+            else
+                general.push_back(interval);
+        }
+        auto byBegin = [](const Interval& l, const Interval& r) { return l.begin < r.begin; };
+        std::ranges::stable_sort(general, byBegin);
+        std::ranges::stable_sort(floats, byBegin);
+
+        Scan generalScan{.allocation = allocation, .free = {generalRegisters.begin(), generalRegisters.end()}};
+        generalScan.run(general);
+        Scan floatScan{.allocation = allocation, .free = {floatRegisters.begin(), floatRegisters.end()}};
+        floatScan.run(floats);
+
+        for (auto& location : allocation.locations)
+        {
+            if (isCalleeSaved(location.reg) && std::ranges::find(allocation.calleeSaved, location.reg) == allocation.calleeSaved.end())
+            {
+                allocation.calleeSaved.push_back(location.reg);
+            }
+        }
+        std::ranges::sort(allocation.calleeSaved);
+        return allocation;
+    }
+}
@@ -0,0 +1,39 @@
+#include "Machine.hpp"
+
+namespace language::x86
+{
+    auto isXmm(Reg reg) -> bool
+    {
+        return reg >= Reg::Xmm0 && reg <= Reg::Xmm15;
+    }
+
+    auto encoding(Reg reg) -> std::uint8_t
+    {
+        return static_cast<std::uint8_t>(reg) & 7;
+    }
+
+    auto negate(Cond cond) -> Cond
+    {
+        return static_cast<Cond>(static_cast<std::uint8_t>(cond) ^ 1);
+    }
+
+    auto reg(Reg reg) -> Operand
+    {
+        return {.kind = Operand::Kind::Register, .reg = reg};
+    }
+
+    auto imm(std::int64_t value) -> Operand
+    {
+        return {.kind = Operand::Kind::Immediate, .value = value};
+    }
+
+    auto frame(std::int64_t offset) -> Operand
+    {
+        return {.kind = Operand::Kind::Frame, .reg = Reg::Rbp, .value = offset};
+    }
+
+    auto label(std::int64_t id) -> Operand
+    {
+        return {.kind = Operand::Kind::Label, .value = id};
+    }
+}
@@ -0,0 +1,748 @@
+#include "Machine.hpp"
+#include "LinearScan.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <ranges>
+#include <stdexcept>
+
+namespace language::x86
+{
+    namespace
+    {
+        using ir::BlockId;
+        using ir::Opcode;
+        using ir::Type;
+        using ir::ValueId;
+
+        constexpr std::array intArguments{Reg::Rdi, Reg::Rsi, Reg::Rdx, Reg::Rcx, Reg::R8, Reg::R9};
+        constexpr std::size_t floatArguments = 8;
+
+        auto operator==(const Operand& l, const Operand& r) -> bool
+        {
+            return l.kind == r.kind && l.reg == r.reg && l.value == r.value;
+        }
+
+        auto condition(Opcode op) -> Cond
+        {
+            switch (op)
+            {
+            case Opcode::Lt:
+                return Cond::L;
+            case Opcode::Le:
+                return Cond::LE;
+            case Opcode::Gt:
+                return Cond::G;
+            case Opcode::Ge:
+                return Cond::GE;
+            case Opcode::Eq:
+                return Cond::E;
+            default:
+                return Cond::NE;
+            }
+        }
+
+        auto isComparison(Opcode op) -> bool
+        {
+            return op >= Opcode::Lt && op <= Opcode::Ne;
+        }
+
+        /*
+            Lowers one function of the module. Values in stack slots go through rax or r11 and xmm15 or xmm0,
+            every instruction leaves its result in the location the allocator picked.
+        */
+        class Selector
+        {
+        public:
+            Selector(const ir::Module& module, std::size_t index, std::vector<double>& floats)
+                : module{module}, floats{floats}, allocation{allocateRegisters(module.functions[index])}, function{allocation.function}
+            {
+                out.name = function.name;
+                out.spills = allocation.slots;
+                epilogue = static_cast<std::int64_t>(function.blocks.size());
+                nextLabel = epilogue + 1;
+            }
+
+            auto run() -> MachineFunction
+            {
+                countUses();
+                prologue();
+                for (std::size_t i = 0; i < allocation.layout.size(); i++)
+                {
+                    auto block = allocation.layout[i];
+                    next = i + 1 < allocation.layout.size() ? static_cast<std::int64_t>(allocation.layout[i + 1]) : epilogue;
+                    emit({.op = Mnemonic::Label, .dst = label(block)});
+                    for (auto id : function.blocks[block].instructions)
+                    {
+                        instruction(block, id);
+                    }
+                }
+                emitEpilogue();
+                return std::move(out);
+            }
+
+        private:
+            auto countUses() -> void
+            {
+                uses.assign(function.values.size(), 0);
+                for (auto& block : function.blocks)
+                {
+                    for (auto id : block.instructions)
+                    {
+                        for (auto operand : function.values[id].operands)
+                        {
+                            uses[operand]++;
+                        }
+                    }
+                }
+            }
+
+            auto emit(Instruction instruction) -> void
+            {
+                out.code.push_back(instruction);
+            }
+
+            auto isFloat(ValueId value) const -> bool
+            {
+                return function.values[value].type == Type::Float;
+            }
+
+            auto slotOffset(std::size_t slot) const -> std::int64_t
+            {
+                return -8 * static_cast<std::int64_t>(allocation.calleeSaved.size() + slot + 1);
+            }
+
+            auto location(ValueId value) const -> Operand
+            {
+                auto& loc = allocation.locations[value];
+                return loc.reg != Reg::None ? reg(loc.reg) : frame(slotOffset(loc.slot));
+            }
+
+            // Constants have no location, int and bool ones are immediates and float ones are read from the pool
+            auto operand(ValueId value) -> Operand
+            {
+                auto& inst = function.values[value];
+                if (inst.op != Opcode::Const)
+                    return location(value);
+                if (inst.type == Type::Float)
+                    return floatConstant(inst.real);
+                return imm(static_cast<std::int32_t>(inst.integer));
+            }
+
+            // For instructions that take a register or memory operand, an immediate is loaded into scratch
+            auto notImmediate(ValueId value, Reg scratch) -> Operand
+            {
+                auto op = operand(value);
+                if (op.kind == Operand::Kind::Immediate)
+                {
+                    move(false, reg(scratch), op);
+                    return reg(scratch);
+                }
+                return op;
+            }
+
+            // The register the result of value is computed in, the scratch register if it lives in a stack slot
+            auto target(ValueId value) const -> Operand
+            {
+                auto loc = location(value);
+                return loc.kind == Operand::Kind::Register ? loc : reg(isFloat(value) ? Reg::Xmm15 : Reg::Rax);
+            }
+
+            auto store(ValueId value, Operand result) -> void
+            {
+                move(isFloat(value), location(value), result);
+            }
+
+            // An operand that has to be a register, loaded into scratch if it lives in a stack slot
+            auto inRegister(ValueId value, Reg scratch) -> Operand
+            {
+                auto loc = operand(value);
+                if (loc.kind != Operand::Kind::Register)
+                {
+                    move(isFloat(value), reg(scratch), loc);
+                    return reg(scratch);
+                }
+                return loc;
+            }
+
+            auto move(bool isFloat, Operand dst, Operand src) -> void
+            {
+                if (dst == src)
+                {
+                    return;
+                }
+                if (dst.isMemory() && src.isMemory())
+                {
+                    auto scratch = reg(isFloat ? Reg::Xmm0 : Reg::Rax);
+                    move(isFloat, scratch, src);
+                    src = scratch;
+                }
+                emit({.op = isFloat ? Mnemonic::Movsd : Mnemonic::Mov, .size = 4, .dst = dst, .src = src});
+            }
+
+            struct Move
+            {
+                Operand dst;
+                Operand src;
+                bool isFloat;
+            };
+
+            // Performs all moves as if at once, a cycle is broken up by saving one of its sources in r11 or xmm15
+            auto parallelMove(std::vector<Move> moves) -> void
+            {
+                std::erase_if(moves, [](const Move& m) { return m.dst == m.src; });
+                while (!moves.empty())
+                {
+                    auto ready = std::ranges::find_if(moves, [&](const Move& m)
+                                                      { return std::ranges::none_of(moves, [&](const Move& other) { return other.src == m.dst; }); });
+                    if (ready != moves.end())
+                    {
+                        move(ready->isFloat, ready->dst, ready->src);
+                        moves.erase(ready);
+                        continue;
+                    }
+                    auto blocked = moves.front().src;
+                    auto scratch = reg(moves.front().isFloat ? Reg::Xmm15 : Reg::R11);
+                    move(moves.front().isFloat, scratch, blocked);
+                    for (auto& m : moves)
+                    {
+                        if (m.src == blocked)
+                        {
+                            m.src = scratch;
+                        }
+                    }
+                }
+            }
+
+            // int and bool arguments take the next general purpose register, float arguments the next xmm register.
+            // Reg::None once they run out, those arguments go on the stack in order, 8 bytes each.
+            auto argumentRegisters(const std::vector<Type>& parameters) const -> std::vector<Reg>
+            {
+                std::vector<Reg> registers;
+                std::size_t ints = 0;
+                std::size_t reals = 0;
+                for (auto type : parameters)
+                {
+                    if (type == Type::Float)
+                        registers.push_back(reals < floatArguments ? static_cast<Reg>(static_cast<int>(Reg::Xmm0) + reals++) : Reg::None);
+                    else
+                        registers.push_back(ints < intArguments.size() ? intArguments[ints++] : Reg::None);
+                }
+                return registers;
+            }
+
+            auto prologue() -> void
+            {
+                emit({.op = Mnemonic::Push, .size = 8, .dst = reg(Reg::Rbp)});
+                emit({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rbp), .src = reg(Reg::Rsp)});
+                for (auto saved : allocation.calleeSaved)
+                {
+                    emit({.op = Mnemonic::Push, .size = 8, .dst = reg(saved)});
+                }
+                // rsp is 16 byte aligned at every call
+                auto frameSize = static_cast<std::int64_t>(8 * allocation.slots);
+                if ((8 * allocation.calleeSaved.size() + frameSize) % 16)
+                {
+                    frameSize += 8;
+                }
+                if (frameSize)
+                {
+                    emit({.op = Mnemonic::Sub, .size = 8, .dst = reg(Reg::Rsp), .src = imm(frameSize)});
+                }
+                // Deep recursion ends in the runtime instead of below the stack
+                emit({.op = Mnemonic::Cmp, .size = 8, .dst = reg(Reg::Rsp), .src = {.kind = Operand::Kind::StackLimit}});
+                emit({.op = Mnemonic::J, .cond = Cond::B, .dst = {.kind = Operand::Kind::Runtime, .value = static_cast<std::int64_t>(RuntimeRoutine::StackOverflow)}});
+
+                stackTop = -static_cast<std::int64_t>(8 * allocation.calleeSaved.size()) - frameSize;
+
+                // Stack arguments are above the return address, they are loaded once the registers are free
+                auto registers = argumentRegisters(function.parameters);
+                std::vector<std::int64_t> stackArguments(registers.size());
+                std::int64_t offset = 16;
+                for (std::size_t i = 0; i < registers.size(); i++)
+                {
+                    if (registers[i] == Reg::None)
+                    {
+                        stackArguments[i] = offset;
+                        offset += 8;
+                    }
+                }
+                std::vector<Move> moves;
+                std::vector<Move> loads;
+                for (ValueId id = 0; id < function.values.size(); id++)
+                {
+                    auto& inst = function.values[id];
+                    if (inst.op == Opcode::Param && uses[id])
+                    {
+                        auto index = static_cast<std::size_t>(inst.integer);
+                        if (registers[index] == Reg::None)
+                            loads.push_back({location(id), frame(stackArguments[index]), isFloat(id)});
+                        else
+                            moves.push_back({location(id), reg(registers[index]), isFloat(id)});
+                    }
+                }
+                parallelMove(std::move(moves));
+                for (auto& load : loads)
+                {
+                    move(load.isFloat, load.dst, load.src);
+                }
+            }
+
+            auto emitEpilogue() -> void
+            {
+                emit({.op = Mnemonic::Label, .dst = label(epilogue)});
+                if (allocation.calleeSaved.empty())
+                {
+                    emit({.op = Mnemonic::Mov, .size = 8, .dst = reg(Reg::Rsp), .src = reg(Reg::Rbp)});
+                }
+                else
+                {
+                    emit({.op = Mnemonic::Lea, .size = 8, .dst = reg(Reg::Rsp), .src = frame(-8 * static_cast<std::int64_t>(allocation.calleeSaved.size()))});
+                }
+                for (auto saved : allocation.calleeSaved | std::views::reverse)
+                {
+                    emit({.op = Mnemonic::Pop, .size = 8, .dst = reg(saved)});
+                }
+                emit({.op = Mnemonic::Pop, .size = 8, .dst = reg(Reg::Rbp)});
+                emit({.op = Mnemonic::Ret});
+            }
+
+            auto jump(std::int64_t to) -> void
+            {
+                if (to != next)
+                {
+                    emit({.op = Mnemonic::Jmp, .dst = label(to)});
+                }
+            }
+
+            auto floatConstant(double value) -> Operand
+            {
+                auto bits = std::bit_cast<std::uint64_t>(value);
+                auto it = std::ranges::find_if(floats, [&](double f) { return std::bit_cast<std::uint64_t>(f) == bits; });
+                if (it == floats.end())
+                {
+                    floats.push_back(value);
+                    it = floats.end() - 1;
+                }
+                return {.kind = Operand::Kind::FloatConstant, .value = it - floats.begin()};
+            }
+
+            // A comparison that only feeds the Branch right after it sets the flags for the jump
+            auto fusedComparison(BlockId block, ValueId branch) const -> bool
+            {
+                auto& instructions = function.blocks[block].instructions;
+                auto cond = function.values[branch].operands[0];
+                auto& inst = function.values[cond];
+                if (!isComparison(inst.op) || uses[cond] != 1 || instructions.size() < 2 || instructions[instructions.size() - 2] != cond)
+                {
+                    return false;
+                }
+                return !isFloat(inst.operands[0]) || (inst.op != Opcode::Eq && inst.op != Opcode::Ne);
+            }
+
+            auto instruction(BlockId block, ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                switch (inst.op)
+                {
+                case Opcode::Const:
+                case Opcode::Param:
+                case Opcode::Undef:
+                case Opcode::Phi:
+                    return;
+                case Opcode::Add:
+                case Opcode::Sub:
+                case Opcode::Mul:
+                    if (isFloat(id))
+                        floatArithmetic(id);
+                    else
+                        intArithmetic(id);
+                    return;
+                case Opcode::Div:
+                    if (isFloat(id))
+                        floatArithmetic(id);
+                    else
+                        divide(id);
+                    return;
+                case Opcode::Lt:
+                case Opcode::Le:
+                case Opcode::Gt:
+                case Opcode::Ge:
+                case Opcode::Eq:
+                case Opcode::Ne:
+                {
+                    auto& instructions = function.blocks[block].instructions;
+                    // Only the condition of a fused branch is left to the branch
+                    if (instructions.back() != id && function.values[instructions.back()].op == Opcode::Branch &&
+                        function.values[instructions.back()].operands[0] == id && fusedComparison(block, instructions.back()))
+                    {
+                        return;
+                    }
+                    setFlags(id);
+                    materialize(id, flagCondition(id));
+                    return;
+                }
+                case Opcode::Convert:
+                    convert(id);
+                    return;
+                case Opcode::LoadGlobal:
+                    loadGlobal(id);
+                    return;
+                case Opcode::StoreGlobal:
+                    storeGlobal(id);
+                    return;
+                case Opcode::Call:
+                    call(id);
+                    return;
+                case Opcode::Jump:
+                    phiMoves(block);
+                    jump(function.blocks[block].successors[0]);
+                    return;
+                case Opcode::Branch:
+                    branch(block, id);
+                    return;
+                case Opcode::Return:
+                    if (!inst.operands.empty())
+                    {
+                        auto v = inst.operands[0];
+                        move(isFloat(v), reg(isFloat(v) ? Reg::Xmm0 : Reg::Rax), operand(v));
+                    }
+                    jump(epilogue);
+                    return;
+                }
+            }
+
+            auto arithmeticMnemonic(Opcode op, bool isFloat) const -> Mnemonic
+            {
+                switch (op)
+                {
+                case Opcode::Add:
+                    return isFloat ? Mnemonic::Addsd : Mnemonic::Add;
+                case Opcode::Sub:
+                    return isFloat ? Mnemonic::Subsd : Mnemonic::Sub;
+                case Opcode::Mul:
+                    return isFloat ? Mnemonic::Mulsd : Mnemonic::Imul;
+                default:
+                    return Mnemonic::Divsd;
+                }
+            }
+
+            // Two address form, d = a; d op= b. If d is b it is commuted or b is saved first
+            auto binary(ValueId id, Reg temp) -> void
+            {
+                auto& inst = function.values[id];
+                auto floating = isFloat(id);
+                auto op = arithmeticMnemonic(inst.op, floating);
+                auto d = target(id);
+                auto a = operand(inst.operands[0]);
+                auto b = operand(inst.operands[1]);
+                if (d == b && !(d == a))
+                {
+                    if (inst.op == Opcode::Add || inst.op == Opcode::Mul)
+                    {
+                        emit({.op = op, .dst = d, .src = a});
+                        store(id, d);
+                        return;
+                    }
+                    move(floating, reg(temp), b);
+                    b = reg(temp);
+                }
+                move(floating, d, a);
+                emit({.op = op, .dst = d, .src = b});
+                store(id, d);
+            }
+
+            auto intArithmetic(ValueId id) -> void
+            {
+                binary(id, Reg::R11);
+            }
+
+            auto floatArithmetic(ValueId id) -> void
+            {
+                binary(id, Reg::Xmm0);
+            }
+
+            auto newLabel() -> std::int64_t
+            {
+                return nextLabel++;
+            }
+
+            // idiv traps on a zero divisor and on INT_MIN / -1, the Interpreter reports the first and wraps the second
+            auto divide(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto b = operand(inst.operands[1]);
+                move(false, reg(Reg::Rax), operand(inst.operands[0]));
+                if (b.kind == Operand::Kind::Immediate && b.value != 0 && b.value != -1)
+                {
+                    move(false, reg(Reg::R11), b);
+                    emit({.op = Mnemonic::Cdq});
+                    emit({.op = Mnemonic::Idiv, .dst = reg(Reg::R11)});
+                    store(id, reg(Reg::Rax));
+                    return;
+                }
+                b = notImmediate(inst.operands[1], Reg::R11);
+                auto divide = newLabel();
+                auto done = newLabel();
+                emit({.op = Mnemonic::Cmp, .dst = b, .src = imm(0)});
+                emit({.op = Mnemonic::J, .cond = Cond::E, .dst = {.kind = Operand::Kind::Runtime, .value = static_cast<std::int64_t>(RuntimeRoutine::DivisionByZero)}});
+                emit({.op = Mnemonic::Cmp, .dst = b, .src = imm(-1)});
+                emit({.op = Mnemonic::J, .cond = Cond::NE, .dst = label(divide)});
+                emit({.op = Mnemonic::Neg, .dst = reg(Reg::Rax)});
+                emit({.op = Mnemonic::Jmp, .dst = label(done)});
+                emit({.op = Mnemonic::Label, .dst = label(divide)});
+                emit({.op = Mnemonic::Cdq});
+                emit({.op = Mnemonic::Idiv, .dst = b});
+                emit({.op = Mnemonic::Label, .dst = label(done)});
+                store(id, reg(Reg::Rax));
+            }
+
+            /*
+                ucomisd sets the flags like an unsigned compare and all of ZF, PF and CF if an operand is NaN.
+                a < b is tested as b > a, so above and above or equal are false for NaN like in C++.
+            */
+            auto setFlags(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto l = inst.operands[0];
+                auto r = inst.operands[1];
+                if (isFloat(l))
+                {
+                    if (inst.op == Opcode::Lt || inst.op == Opcode::Le)
+                    {
+                        std::swap(l, r);
+                    }
+                    emit({.op = Mnemonic::Ucomisd, .dst = inRegister(l, Reg::Xmm15), .src = operand(r)});
+                    return;
+                }
+                auto a = operand(l);
+                auto b = operand(r);
+                if (a.kind == Operand::Kind::Immediate || (a.isMemory() && b.isMemory()))
+                {
+                    a = inRegister(l, Reg::Rax);
+                }
+                emit({.op = Mnemonic::Cmp, .dst = a, .src = b});
+            }
+
+            auto flagCondition(ValueId id) const -> Cond
+            {
+                auto& inst = function.values[id];
+                if (!isFloat(inst.operands[0]))
+                {
+                    return condition(inst.op);
+                }
+                switch (inst.op)
+                {
+                case Opcode::Lt:
+                case Opcode::Gt:
+                    return Cond::A;
+                case Opcode::Le:
+                case Opcode::Ge:
+                    return Cond::AE;
+                default:
+                    return condition(inst.op);
+                }
+            }
+
+            // Turns the flags into 0 or 1, a float Eq or Ne also looks at the parity flag NaN sets
+            auto materialize(ValueId id, Cond cond) -> void
+            {
+                auto& inst = function.values[id];
+                emit({.op = Mnemonic::Set, .size = 1, .cond = cond, .dst = reg(Reg::Rax)});
+                if (isComparison(inst.op) && isFloat(inst.operands[0]) && (cond == Cond::E || cond == Cond::NE))
+                {
+                    auto ordered = cond == Cond::E;
+                    emit({.op = Mnemonic::Set, .size = 1, .cond = ordered ? Cond::NP : Cond::P, .dst = reg(Reg::R11)});
+                    emit({.op = ordered ? Mnemonic::And : Mnemonic::Or, .size = 1, .dst = reg(Reg::Rax), .src = reg(Reg::R11)});
+                }
+                emit({.op = Mnemonic::MovZxByte, .dst = target(id), .src = reg(Reg::Rax)});
+                store(id, target(id));
+            }
+
+            auto convert(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto v = inst.operands[0];
+                auto from = function.values[v].type;
+                auto to = inst.type;
+                if (from == to || (from == Type::Bool && to == Type::Int))
+                {
+                    move(to == Type::Float, location(id), operand(v));
+                }
+                else if (to == Type::Float)
+                {
+                    emit({.op = Mnemonic::Cvtsi2sd, .dst = target(id), .src = notImmediate(v, Reg::Rax)});
+                    store(id, target(id));
+                }
+                else if (from == Type::Float && to == Type::Int)
+                {
+                    emit({.op = Mnemonic::Cvttsd2si, .dst = target(id), .src = operand(v)});
+                    store(id, target(id));
+                }
+                else if (from == Type::Float)
+                {
+                    // Any float but 0 and -0 is true, NaN included
+                    emit({.op = Mnemonic::Xorpd, .dst = reg(Reg::Xmm15), .src = reg(Reg::Xmm15)});
+                    emit({.op = Mnemonic::Ucomisd, .dst = reg(Reg::Xmm15), .src = operand(v)});
+                    emit({.op = Mnemonic::Set, .size = 1, .cond = Cond::NE, .dst = reg(Reg::Rax)});
+                    emit({.op = Mnemonic::Set, .size = 1, .cond = Cond::P, .dst = reg(Reg::R11)});
+                    emit({.op = Mnemonic::Or, .size = 1, .dst = reg(Reg::Rax), .src = reg(Reg::R11)});
+                    emit({.op = Mnemonic::MovZxByte, .dst = target(id), .src = reg(Reg::Rax)});
+                    store(id, target(id));
+                }
+                else
+                {
+                    emit({.op = Mnemonic::Cmp, .dst = notImmediate(v, Reg::Rax), .src = imm(0)});
+                    materialize(id, Cond::NE);
+                }
+            }
+
+            auto global(const ir::Instruction& inst) const -> Operand
+            {
+                return {.kind = Operand::Kind::Global, .value = inst.integer};
+            }
+
+            auto loadGlobal(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto d = target(id);
+                if (inst.type == Type::Float)
+                    emit({.op = Mnemonic::Movsd, .dst = d, .src = global(inst)});
+                else if (inst.type == Type::Bool)
+                    emit({.op = Mnemonic::MovZxByte, .dst = d, .src = global(inst)});
+                else
+                    emit({.op = Mnemonic::Mov, .dst = d, .src = global(inst)});
+                store(id, d);
+            }
+
+            auto storeGlobal(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto v = inst.operands[0];
+                auto type = function.values[v].type;
+                auto src = operand(v);
+                if (src.isMemory())
+                {
+                    src = inRegister(v, type == Type::Float ? Reg::Xmm15 : Reg::Rax);
+                }
+                auto op = type == Type::Float ? Mnemonic::Movsd : Mnemonic::Mov;
+                emit({.op = op, .size = static_cast<std::uint8_t>(type == Type::Bool ? 1 : 4), .dst = global(inst), .src = src});
+            }
+
+            // Values live across the call are in callee saved registers or stack slots, the arguments go straight to their registers
+            auto call(ValueId id) -> void
+            {
+                auto& inst = function.values[id];
+                auto& callee = module.functions[inst.integer];
+                auto registers = argumentRegisters(callee.parameters);
+                // Stack arguments are stored below rsp before the registers are set, the area keeps rsp 16 byte aligned
+                auto stacked = static_cast<std::int64_t>(std::ranges::count(registers, Reg::None));
+                auto area = (8 * stacked + 15) / 16 * 16;
+                if (area)
+                {
+                    emit({.op = Mnemonic::Sub, .size = 8, .dst = reg(Reg::Rsp), .src = imm(area)});
+                }
+                std::vector<Move> moves;
+                std::int64_t offset = stackTop - area;
+                for (std::size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    auto v = inst.operands[i];
+                    if (registers[i] == Reg::None)
+                    {
+                        move(isFloat(v), frame(offset), operand(v));
+                        offset += 8;
+                    }
+                    else
+                    {
+                        moves.push_back({reg(registers[i]), operand(v), isFloat(v)});
+                    }
+                }
+                parallelMove(std::move(moves));
+                emit({.op = Mnemonic::Call, .dst = {.kind = Operand::Kind::Function, .value = inst.integer}});
+                if (area)
+                {
+                    emit({.op = Mnemonic::Add, .size = 8, .dst = reg(Reg::Rsp), .src = imm(area)});
+                }
+                if (inst.type != Type::Void && uses[id])
+                {
+                    move(isFloat(id), location(id), reg(isFloat(id) ? Reg::Xmm0 : Reg::Rax));
+                }
+            }
+
+            // Critical edges are split, a block with a successor with phis has no other successor
+            auto phiMoves(BlockId block) -> void
+            {
+                auto successor = function.blocks[block].successors[0];
+                auto& predecessors = function.blocks[successor].predecessors;
+                auto index = std::ranges::find(predecessors, block) - predecessors.begin();
+                std::vector<Move> moves;
+                for (auto id : function.blocks[successor].instructions)
+                {
+                    if (function.values[id].op != Opcode::Phi)
+                    {
+                        break;
+                    }
+                    if (uses[id])
+                    {
+                        moves.push_back({location(id), operand(function.values[id].operands[index]), isFloat(id)});
+                    }
+                }
+                parallelMove(std::move(moves));
+            }
+
+            auto branch(BlockId block, ValueId id) -> void
+            {
+                auto cond = Cond::NE;
+                if (fusedComparison(block, id))
+                {
+                    auto comparison = function.values[id].operands[0];
+                    setFlags(comparison);
+                    cond = flagCondition(comparison);
+                }
+                else
+                {
+                    emit({.op = Mnemonic::Cmp, .dst = notImmediate(function.values[id].operands[0], Reg::Rax), .src = imm(0)});
+                }
+                auto whenTrue = static_cast<std::int64_t>(function.blocks[block].successors[0]);
+                auto whenFalse = static_cast<std::int64_t>(function.blocks[block].successors[1]);
+                if (whenTrue == next)
+                {
+                    emit({.op = Mnemonic::J, .cond = negate(cond), .dst = label(whenFalse)});
+                    return;
+                }
+                emit({.op = Mnemonic::J, .cond = cond, .dst = label(whenTrue)});
+                jump(whenFalse);
+            }
+
+            const ir::Module& module;
+            std::vector<double>& floats;
+            Allocation allocation;
+            const ir::Function& function;
+            MachineFunction out;
+            std::vector<std::size_t> uses;
+            std::int64_t epilogue;
+            std::int64_t nextLabel;
+            std::int64_t next = 0;
+            std::int64_t stackTop = 0; // rsp relative to rbp outside of calls
+        };
+    }
+
+    auto select(const ir::Module& module, std::size_t function, std::vector<double>& floats) -> MachineFunction
+    {
+        return Selector{module, function, floats}.run();
+    }
+
+    auto select(const ir::Module& module) -> MachineModule
+    {
+        MachineModule machine{.globalsSize = module.globalsSize, .init = module.init, .main = module.main};
+        for (std::size_t i = 0; i < module.functions.size(); i++)
+        {
+            machine.functions.push_back(select(module, i, machine.floats));
+        }
+        if (module.main < module.functions.size())
+        {
+            machine.mainResult = module.functions[module.main].result;
+        }
+        return machine;
+    }
+}
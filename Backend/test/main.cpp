@@ -0,0 +1,284 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "IR/IR.hpp"
+#include "Backend/Assembly.hpp"
+#include "Backend/LinearScan.hpp"
+#include "Backend/Jit.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace x86 = language::x86;
+
+static auto interpret(const std::string& source) -> std::string
+{
+    language::Parser p{source};
+    auto program = p.program();
+    language::Interpreter interpreter{program};
+    return language::valueToStr(interpreter.run());
+}
+
+static auto hasToolchain() -> bool
+{
+    return std::system("cc --version > /dev/null 2>&1") == 0;
+}
+
+struct Native
+{
+    std::string output;
+    int status;
+};
+
+// Assembles and links the program with cc, runs it and returns what it printed
+static auto runNative(const std::string& source) -> Native
+{
+    language::Parser p{source};
+    auto program = p.program();
+    auto assembly = x86::emitAssembly(language::ir::build(program));
+
+    auto dir = std::filesystem::temp_directory_path();
+    auto stem = (dir / ("backend_test_" + std::to_string(std::hash<std::string>{}(source)))).string();
+    std::ofstream{stem + ".s"} << assembly;
+    auto link = "cc -o " + stem + " " + stem + ".s";
+    INFO(assembly);
+    REQUIRE(std::system(link.c_str()) == 0);
+
+    Native native{.status = -1};
+    if (auto pipe = popen(stem.c_str(), "r"))
+    {
+        char buffer[256];
+        while (auto n = std::fread(buffer, 1, sizeof buffer, pipe))
+        {
+            native.output.append(buffer, n);
+        }
+        native.status = pclose(pipe);
+    }
+    std::filesystem::remove(stem + ".s");
+    std::filesystem::remove(stem);
+    if (!native.output.empty() && native.output.back() == '\n')
+    {
+        native.output.pop_back();
+    }
+    return native;
+}
+
+// Run by both the assembly and the Jit tests, the results have to match the Interpreter
+static const char* const programs[] = {
+    // Recursion keeps n in a callee saved register across both calls
+    R"(
+        fib(n: int): int {
+            if (n < 2) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        main(): int { return fib(20); }
+    )",
+    R"(
+        main(): int {
+            var count = 0;
+            for (var i = 0; i < 100; i = i + 1)
+                for (var j = 0; j < 100; j = j + 1)
+                    if (i < j && j - i < 10 || i == 50) count = count + i / 3 - j * 2;
+            return count;
+        }
+    )",
+    // Mixed int, float and bool arguments and globals
+    R"(
+        var scale = 2.5;
+        var flag = true;
+        var calls = 0;
+        mix(a: int, x: float, b: bool, c: int, y: float): float {
+            calls = calls + 1;
+            if (b) return a * x + c / y;
+            return x - y;
+        }
+        main(): float {
+            var sum = 0.0;
+            var i = 0;
+            while (i < 10) {
+                sum = sum + mix(i, scale, flag, i * 3, 4.0);
+                flag = flag == false || i < 5;
+                i = i + 1;
+            }
+            return sum + calls;
+        }
+    )",
+    // The rotation swaps a and b through a cycle of phi moves
+    R"(
+        main(): int {
+            var a = 1;
+            var b = 2;
+            var c = 3;
+            var i = 0;
+            while (i < 7) {
+                var t = a;
+                a = b;
+                b = c;
+                c = t;
+                i = i + 1;
+            }
+            return a * 100 + b * 10 + c;
+        }
+    )",
+    // More values live at once than registers, INT_MIN / -1 wraps
+    R"(
+        var seed = 1;
+        main(): int {
+            var a = seed; var b = a + 1; var c = b + 1; var d = c + 1; var e = d + 1; var f = e + 1; var g = f + 1;
+            var h = g + 1; var i = h + 1; var j = i + 1; var k = j + 1; var l = k + 1; var m = l + 1; var n = m + 1; var o = n + 1;
+            var min = 0 - 2147483647 - 1;
+            var w = min / (0 - 1);
+            return a + b * c - d + e * f - g + h * i - j + k * l - m + n * o + w / 1000000 + (w == min);
+        }
+    )",
+    R"(
+        less(x: float, y: float): bool { return x < y; }
+        main(): bool {
+            var z = 0.0;
+            var nan = z / z;
+            var half = true;
+            half = 0.5;
+            return less(nan, 1.0) == false && (nan == nan) == false && nan != nan && half && 3 > 2.5;
+        }
+    )",
+    // Arguments beyond six int and eight float registers go on the stack, with an odd and an even number of them
+    R"(
+        many(a: int, b: int, c: int, d: int, e: int, f: int, g: int, h: int,
+             xa: float, xb: float, xc: float, xd: float, xe: float, xf: float, xg: float, xh: float, xi: float, flag: bool): float {
+            if (flag) return a - b + c * d - e + f * g - h + xa - xb + xc * xd - xe + xf * xg - xh + xi;
+            return many(h, g, f, e, d, c, b, a, xi, xh, xg, xf, xe, xd, xc, xb, xa, true) * 2.0;
+        }
+        seven(a: int, b: int, c: int, d: int, e: int, f: int, g: int): int { return a * 1000000 + b * 100000 + g; }
+        main(): float {
+            var s = 7;
+            return many(1, 2, 3, 4, 5, 6, s, 8, 0.5, 1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5, 8.5, false) + seven(1, 2, 3, 4, 5, 6, s);
+        }
+    )",
+    // x == 2 is a value in a block that ends in a branch on a fused comparison of its own
+    R"(
+        main(): int {
+            var x = 1;
+            var b = x == 2;
+            if (b == false) { return 9; }
+            return 549;
+        }
+    )",
+};
+
+TEST_CASE("Native Code", "[backend]")
+{
+    if (!hasToolchain())
+    {
+        WARN("cc not found, skipping");
+        return;
+    }
+    auto source = std::string{programs[GENERATE(range(std::size_t{0}, std::size(programs)))]};
+    auto expected = interpret(source);
+    auto native = runNative(source);
+    REQUIRE(native.status == 0);
+    if (expected.find('.') != std::string::npos)
+        REQUIRE(std::stod(native.output) == Approx(std::stod(expected)));
+    else
+        REQUIRE(native.output == expected);
+}
+
+TEST_CASE("Linear Scan", "[backend]")
+{
+    language::Parser p{R"(
+        f(n: int): int { return n; }
+        main(): int {
+            var a = f(1); var b = f(2); var c = f(3); var d = f(4); var e = f(5); var g = f(6); var h = f(7);
+            var i = f(8); var j = f(9); var k = f(10); var l = f(11); var m = f(12); var n = f(13); var o = f(14);
+            var x = f(a);
+            return a + b + c + d + e + g + h + i + j + k + l + m + n + o + x;
+        }
+    )"};
+    auto program = p.program();
+    auto module = language::ir::build(program);
+    auto allocation = x86::allocateRegisters(module.functions[module.main]);
+
+    // Fourteen values live across calls only fit in the five callee saved registers and stack slots
+    REQUIRE(allocation.calleeSaved.size() == 5);
+    REQUIRE(allocation.slots >= 9);
+
+    if (hasToolchain())
+    {
+        auto native = runNative(R"(
+            main(): int {
+                var z = 0;
+                return 7 / z;
+            }
+        )");
+        REQUIRE(native.output == "Division by zero");
+        REQUIRE(native.status != 0);
+    }
+}
+
+TEST_CASE("Jit", "[backend]")
+{
+    auto source = std::string{programs[GENERATE(range(std::size_t{0}, std::size(programs)))]};
+    language::Parser p{source};
+    auto program = p.program();
+    auto module = language::ir::build(program);
+    x86::Jit jit{module};
+    REQUIRE(language::valueToStr(jit.run()) == interpret(source));
+}
+
+TEST_CASE("Lazy Compilation", "[backend]")
+{
+    language::Parser p{R"(
+        var count = 0;
+        unused(a: int): int { return a * 2; }
+        divide(a: int, b: int): int { count = count + 1; return a / b; }
+        main(): int { return divide(84, 2) + count; }
+    )"};
+    auto program = p.program();
+    auto module = language::ir::build(program);
+    x86::Jit jit{module};
+
+    // Only the globals initializer, main and divide are compiled, running again reuses their code
+    REQUIRE(std::get<int>(jit.run()) == 43);
+    REQUIRE(jit.stats().compiled == 3);
+    REQUIRE(std::get<int>(jit.run()) == 43);
+    REQUIRE(jit.stats().compiled == 3);
+
+    language::Parser q{R"(
+        divide(a: int, b: int): int { return a / b; }
+        main(): int { return divide(1, 0); }
+    )"};
+    auto failing = q.program();
+    auto failingModule = language::ir::build(failing);
+    x86::Jit trapping{failingModule};
+    REQUIRE_THROWS_AS(trapping.run(), language::RuntimeError);
+    REQUIRE_THROWS_WITH(trapping.run(), "Division by zero");
+}
+
+TEST_CASE("Stack Overflow", "[backend]")
+{
+    std::string source = R"(
+        depth(n: int): int {
+            if (n == 0) return 0;
+            return depth(n - 1) + 1;
+        }
+        main(): int { return depth(100000000); }
+    )";
+    language::Parser p{source};
+    auto program = p.program();
+    auto module = language::ir::build(program);
+
+    // Like the VM the Jit reports the overflow, the process survives it and runs again
+    x86::Jit jit{module};
+    REQUIRE_THROWS_WITH(jit.run(), "Stack overflow");
+    REQUIRE_THROWS_WITH(jit.run(), "Stack overflow");
+
+    if (hasToolchain())
+    {
+        auto native = runNative(source);
+        REQUIRE(native.output == "Stack overflow");
+        REQUIRE(native.status != 0);
+    }
+}
@@ -0,0 +1,87 @@
+#include "../src/Driver.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace lang = language;
+namespace fs = std::filesystem;
+
+// Identifiers are letters and underscores only
+static auto name(std::size_t i) -> std::string
+{
+    std::string letters;
+    do
+    {
+        letters += static_cast<char>('a' + i % 26);
+        i /= 26;
+    } while (i > 0);
+    return letters;
+}
+
+static auto writeUnit(const fs::path& path, std::size_t unit, std::size_t functions) -> void
+{
+    std::ofstream out{path};
+    out << "var unit = " << unit << ";\n"; // distinct content, so each unit has its own cache entry
+    for (std::size_t i = 0; i < functions; i++)
+    {
+        auto n = name(i);
+        out << "var g_" << n << " = " << i << ";\n";
+        out << "f_" << n << "(a: int, b: int) {\n";
+        out << "    var x = a + b * 2 - a * 3 * b + 1;\n";
+        out << "    if (x < a) var z = x + 1 * b; else var w = b - 1 + x;\n";
+        out << "    return x + g_" << n << ";\n";
+        out << "}\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t units = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    std::size_t functions = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+    unsigned maxJobs = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : lang::defaultJobs();
+
+    auto dir = fs::temp_directory_path() / "compiler_bench";
+    fs::create_directories(dir);
+    std::vector<std::string> inputs;
+    for (std::size_t i = 0; i < units; i++)
+    {
+        auto path = dir / ("unit_" + name(i) + ".src");
+        writeUnit(path, i, functions);
+        inputs.push_back(path.string());
+    }
+
+    std::cout << units << " units with " << functions << " functions each\n";
+    double single = 0;
+    for (unsigned jobs = 1; jobs <= maxJobs; jobs *= 2)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        auto results = lang::compileAll(inputs, lang::Options{.jobs = jobs});
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        if (jobs == 1)
+        {
+            single = elapsed.count();
+        }
+        std::cout << jobs << " jobs: " << elapsed.count() << " ms, speed-up " << single / elapsed.count() << "x\n";
+    }
+
+    // Parsed programs from the cache: a cold run parses and writes them, a warm run only maps them
+    auto cache = dir / "cache";
+    for (auto run : {"no cache", "cold cache", "warm cache"})
+    {
+        lang::Options options{.jobs = 1};
+        if (run != std::string_view{"no cache"})
+        {
+            options.cache = cache.string();
+        }
+        auto begin = std::chrono::steady_clock::now();
+        auto results = lang::compileAll(inputs, options);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        std::cout << run << ", 1 job: " << elapsed.count() << " ms\n";
+    }
+
+    fs::remove_all(dir);
+}
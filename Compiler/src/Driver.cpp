@@ -0,0 +1,162 @@
+#include "Driver.hpp"
+#include "SourceFile.hpp"
+#include "ProgramCache.hpp"
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "IR/IR.hpp"
+#include "Optimizer/Optimizer.hpp"
+#include "Backend/Assembly.hpp"
+#include "Backend/Jit.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace language
+{
+    namespace
+    {
+        constexpr int benchRuns = 3;
+
+        auto evaluate(Program& program, const Options& options) -> Value
+        {
+            if (!options.jit)
+            {
+                return Interpreter{program}.run();
+            }
+            auto module = ir::build(program);
+            return x86::Jit{module}.run();
+        }
+
+        auto execute(Program& program, const Options& options) -> std::string
+        {
+            if (!options.bench)
+            {
+                return valueToStr(evaluate(program, options));
+            }
+
+            Value value;
+            std::chrono::duration<double, std::milli> best{};
+            for (int run = 0; run < benchRuns; run++)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                value = evaluate(program, options);
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+                best = run == 0 ? elapsed : std::min(best, elapsed);
+            }
+            return std::format("{} ({} ms, best of {})", valueToStr(value), best.count(), benchRuns);
+        }
+
+        auto parseAll(std::string_view text) -> Program
+        {
+            // Every error of the unit in one go, one per line
+            std::vector<Diagnostic> diagnostics;
+            Parser parser{text, diagnostics};
+            auto program = parser.program();
+            if (!diagnostics.empty())
+            {
+                std::string message;
+                for (auto& diagnostic : diagnostics)
+                {
+                    message += std::format("{}{}:{}: {}", message.empty() ? "" : "\n",
+                                           diagnostic.line, diagnostic.column, diagnostic.message);
+                }
+                throw std::runtime_error(message);
+            }
+            return program;
+        }
+
+        auto parse(std::string_view text, const Options& options) -> Program
+        {
+            if (options.cache.empty())
+            {
+                return parseAll(text);
+            }
+            ProgramCache cache{options.cache};
+            if (auto cached = cache.load(text))
+            {
+                return std::move(*cached);
+            }
+            auto program = parseAll(text);
+            cache.store(text, program);
+            return program;
+        }
+
+        auto compileUnit(const std::string& path, const Options& options) -> UnitResult
+        {
+            try
+            {
+                auto source = SourceFile::open(path);
+                auto program = parse(source.text(), options);
+                auto report = options.optimize ? optimize(program, options.inlineThreshold) : std::string{};
+
+                std::string output;
+                if (options.run || options.bench)
+                {
+                    output = execute(program, options);
+                }
+                if (!report.empty())
+                {
+                    output += (output.empty() ? "" : "\n") + report;
+                }
+                if (options.emitIr)
+                {
+                    output += "\n" + ir::dump(ir::build(program));
+                }
+                if (options.emitAsm)
+                {
+                    auto target = path == "-" ? std::filesystem::path{"a.s"} : std::filesystem::path{path}.replace_extension(".s");
+                    std::ofstream{target} << x86::emitAssembly(ir::build(program));
+                    output += (output.empty() ? "" : "\n") + std::format("assembly written to {}", target.string());
+                }
+                return {path, true, {}, output};
+            }
+            catch (std::exception& e)
+            {
+                return {path, false, e.what(), {}};
+            }
+        }
+    }
+
+    auto compileAll(const std::vector<std::string>& inputs, const Options& options) -> std::vector<UnitResult>
+    {
+        std::vector<UnitResult> results(inputs.size());
+        std::atomic<std::size_t> nextUnit{0};
+
+        auto worker = [&]
+        {
+            for (auto unit = nextUnit++; unit < inputs.size(); unit = nextUnit++)
+            {
+                results[unit] = compileUnit(inputs[unit], options);
+            }
+        };
+
+        // Timings are only meaningful without other units competing for the cores
+        auto jobs = options.bench ? 1 : options.jobs;
+        auto threads = std::clamp<std::size_t>(jobs, 1, std::max<std::size_t>(inputs.size(), 1));
+        if (threads == 1)
+        {
+            worker();
+            return results;
+        }
+
+        std::vector<std::jthread> pool;
+        pool.reserve(threads);
+        for (std::size_t i = 0; i < threads; i++)
+        {
+            pool.emplace_back(worker);
+        }
+        pool.clear(); // joins
+        return results;
+    }
+
+    auto defaultJobs() -> unsigned
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace language
+{
+    auto defaultJobs() -> unsigned;
+
+    struct Options
+    {
+        unsigned jobs = defaultJobs();
+        bool run = false;   // execute main and report its result
+        bool bench = false; // like run, but timed and with the units run one after another
+        bool jit = false; // run or bench machine code compiled in process instead of the Interpreter
+        bool emitIr = false; // print the SSA IR of every unit
+        bool optimize = false; // run the AST optimizations and report what they changed
+        std::size_t inlineThreshold = 32; // largest function in nodes the optimizations inline, 0 for none
+        bool emitAsm = false; // write x86-64 assembly next to every unit, a.s for stdin
+        std::string cache; // directory of parsed programs reused for sources with the same content, empty for none
+    };
+
+    struct UnitResult
+    {
+        std::string path;
+        bool ok;
+        std::string diagnostics;
+        std::string output;
+    };
+
+    /*
+        Compiles every input on its own Parser, Program and SymbolTable, using up to jobs threads.
+        Units share no mutable state. Results are in input order regardless of completion order.
+    */
+    auto compileAll(const std::vector<std::string>& inputs, const Options& options) -> std::vector<UnitResult>;
+}
@@ -0,0 +1,127 @@
+#include "ProgramCache.hpp"
+#include "SourceFile.hpp"
+#include "Ast/Serialize.hpp"
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <random>
+#include <system_error>
+
+namespace language
+{
+    namespace
+    {
+        struct Header
+        {
+            std::uint64_t hash;
+            std::uint64_t size;
+        };
+    }
+
+    auto contentHash(std::string_view text) -> std::uint64_t
+    {
+        // Multiply and xorshift on four independent lanes of 8 byte words, so hashing a source costs
+        // a fraction of mapping its image
+        constexpr std::uint64_t k = 0x9e3779b97f4a7c15;
+        auto mix = [](std::uint64_t h, std::uint64_t word)
+        {
+            h = (h ^ word) * k;
+            return h ^ h >> 29;
+        };
+        std::uint64_t lanes[4] = {k, k + 1, k + 2, k + 3};
+        std::size_t i = 0;
+        for (; i + 32 <= text.size(); i += 32)
+        {
+            for (int lane = 0; lane < 4; lane++)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, text.data() + i + 8 * lane, 8);
+                lanes[lane] = mix(lanes[lane], word);
+            }
+        }
+        auto h = mix(text.size(), lanes[0]);
+        for (int lane = 1; lane < 4; lane++)
+        {
+            h = mix(h, lanes[lane]);
+        }
+        for (; i < text.size(); i += 8)
+        {
+            std::uint64_t word = 0;
+            std::memcpy(&word, text.data() + i, std::min<std::size_t>(8, text.size() - i));
+            h = mix(h, word);
+        }
+        return mix(h, k);
+    }
+
+    ProgramCache::ProgramCache(std::filesystem::path directory) : directory{std::move(directory)}
+    {
+        std::filesystem::create_directories(this->directory);
+    }
+
+    auto ProgramCache::path(std::uint64_t hash) const -> std::filesystem::path
+    {
+        return directory / std::format("{:016x}.ast", hash);
+    }
+
+    auto ProgramCache::load(std::string_view source) const -> std::optional<Program>
+    {
+        auto hash = contentHash(source);
+        auto file = path(hash);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(file, error))
+        {
+            return std::nullopt;
+        }
+        try
+        {
+            auto image = SourceFile::open(file.string());
+            auto text = image.text();
+            Header header{};
+            if (text.size() < sizeof(header))
+            {
+                return std::nullopt;
+            }
+            std::memcpy(&header, text.data(), sizeof(header));
+            if (header.hash != hash || header.size != source.size() || text.size() - sizeof(header) < source.size() ||
+                text.substr(sizeof(header), source.size()) != source)
+            {
+                return std::nullopt;
+            }
+            return deserialize(text.substr(sizeof(header) + source.size()));
+        }
+        catch (std::runtime_error&)
+        {
+            // Unreadable or written by another version, parsing replaces it
+            return std::nullopt;
+        }
+    }
+
+    auto ProgramCache::store(std::string_view source, Program& program) const -> bool
+    {
+        Header header{contentHash(source), source.size()};
+        auto image = serialize(program);
+        auto file = path(header.hash);
+        auto temporary = file;
+        temporary += std::format(".{:08x}.tmp", std::random_device{}());
+        {
+            std::ofstream out{temporary, std::ios::binary};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(source.data(), static_cast<std::streamsize>(source.size()));
+            out.write(image.data(), static_cast<std::streamsize>(image.size()));
+            if (!out.flush())
+            {
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, file, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+}
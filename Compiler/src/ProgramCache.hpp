@@ -0,0 +1,33 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace language
+{
+    auto contentHash(std::string_view text) -> std::uint64_t;
+
+    /*
+        Parsed programs on disk, one file per distinct source named after the hash of its content. A file
+        holds the hash and length of its source, the source itself and the program image, see serialize.
+        The hash only finds the file, a hit needs the stored source to equal the one loaded, so sources
+        with colliding hashes never get each other's program. Files are
+        memory mapped to load them and written under a temporary name that is renamed into place, so
+        units and compilers running at the same time never see half a file.
+    */
+    class ProgramCache
+    {
+    public:
+        explicit ProgramCache(std::filesystem::path directory);
+
+        auto load(std::string_view source) const -> std::optional<Program>; // nothing on a miss or a stale file
+        auto store(std::string_view source, Program& program) const -> bool; // false if the file could not be written
+
+    private:
+        auto path(std::uint64_t hash) const -> std::filesystem::path;
+
+        std::filesystem::path directory;
+    };
+}
@@ -0,0 +1,197 @@
+#include "SourceFile.hpp"
+#include "Lexer/Lexer.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace language
+{
+    namespace
+    {
+        // Token offsets are 32-bit, reject the file before they can wrap
+        auto tooLarge(std::size_t size) -> std::runtime_error
+        {
+            return std::runtime_error("Source of " + std::to_string(size) + " bytes is too large, at most " +
+                                      std::to_string(maxSourceSize) + " bytes are supported");
+        }
+    }
+
+    SourceFile::SourceFile(std::string path) : filePath{std::move(path)}, data{nullptr}, size{0}, isMapped{false}
+    {
+    }
+
+    SourceFile::SourceFile(SourceFile&& other) noexcept : filePath{std::move(other.filePath)},
+                                                          data{std::exchange(other.data, nullptr)},
+                                                          size{std::exchange(other.size, 0)},
+                                                          isMapped{std::exchange(other.isMapped, false)},
+                                                          buffer{std::move(other.buffer)}
+    {
+        if (!isMapped)
+        {
+            data = buffer.data();
+        }
+    }
+
+    SourceFile& SourceFile::operator=(SourceFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            filePath = std::move(other.filePath);
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+            isMapped = std::exchange(other.isMapped, false);
+            buffer = std::move(other.buffer);
+            if (!isMapped)
+            {
+                data = buffer.data();
+            }
+        }
+        return *this;
+    }
+
+    SourceFile::~SourceFile()
+    {
+        unmap();
+    }
+
+    auto SourceFile::unmap() -> void
+    {
+#if !defined(_WIN32)
+        if (isMapped)
+        {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+        isMapped = false;
+        data = nullptr;
+        size = 0;
+    }
+
+#if defined(_WIN32)
+    SourceFile SourceFile::open(const std::string& path)
+    {
+        SourceFile file{path};
+        if (path == "-")
+        {
+            file.buffer.assign(std::istreambuf_iterator<char>{std::cin}, std::istreambuf_iterator<char>{});
+        }
+        else
+        {
+            std::ifstream in{path, std::ios::binary};
+            if (!in)
+            {
+                throw std::runtime_error("Could not open " + path);
+            }
+            file.buffer.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+        }
+        if (file.buffer.size() > maxSourceSize)
+        {
+            throw tooLarge(file.buffer.size());
+        }
+        file.data = file.buffer.data();
+        file.size = file.buffer.size();
+        return file;
+    }
+#else
+    SourceFile SourceFile::open(const std::string& path)
+    {
+        SourceFile file{path};
+        int fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            auto length = static_cast<std::size_t>(info.st_size);
+            if (length > maxSourceSize)
+            {
+                ::close(fd);
+                throw tooLarge(length);
+            }
+            if (void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0); mapping != MAP_FAILED)
+            {
+                ::madvise(mapping, length, MADV_SEQUENTIAL);
+                file.data = static_cast<const char*>(mapping);
+                file.size = length;
+                file.isMapped = true;
+            }
+        }
+
+        if (!file.isMapped)
+        {
+            // Pipes, terminals or mmap failure: stream the input into an owned buffer
+            char chunk[64 * 1024];
+            for (;;)
+            {
+                auto n = ::read(fd, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0)
+                {
+                    auto error = std::strerror(errno);
+                    if (fd != STDIN_FILENO)
+                    {
+                        ::close(fd);
+                    }
+                    throw std::runtime_error("Could not read " + path + ": " + error);
+                }
+                if (n == 0)
+                {
+                    break;
+                }
+                file.buffer.append(chunk, static_cast<std::size_t>(n));
+                if (file.buffer.size() > maxSourceSize)
+                {
+                    if (fd != STDIN_FILENO)
+                    {
+                        ::close(fd);
+                    }
+                    throw tooLarge(file.buffer.size());
+                }
+            }
+            file.data = file.buffer.data();
+            file.size = file.buffer.size();
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        if (fd != STDIN_FILENO)
+        {
+            ::close(fd);
+        }
+        return file;
+    }
+#endif
+
+    auto SourceFile::text() const -> std::string_view
+    {
+        return {data, size};
+    }
+
+    auto SourceFile::path() const -> const std::string&
+    {
+        return filePath;
+    }
+
+    auto SourceFile::mapped() const -> bool
+    {
+        return isMapped;
+    }
+}
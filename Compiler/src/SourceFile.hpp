@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+namespace language
+{
+    /*
+        Read-only view of a source file. Regular files are memory mapped so the lexer can work
+        directly on the page cache, pipes and stdin ("-") are read into an owned buffer.
+    */
+    class SourceFile
+    {
+    public:
+        static SourceFile open(const std::string& path);
+
+        SourceFile(SourceFile&& other) noexcept;
+        SourceFile& operator=(SourceFile&& other) noexcept;
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+        ~SourceFile();
+
+        auto text() const -> std::string_view;
+        auto path() const -> const std::string&;
+        auto mapped() const -> bool;
+
+    private:
+        SourceFile(std::string path);
+        auto unmap() -> void;
+
+        std::string filePath;
+        const char* data;
+        std::size_t size;
+        bool isMapped;
+        std::string buffer;
+    };
+}
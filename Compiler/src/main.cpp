@@ -1,23 +1,82 @@
 #include <string>
-#include "Parser/Parser.hpp"
-#include <exception>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include "Driver.hpp"
 
 namespace lang = language;
 
-int main()
+int main(int argc, char** argv)
 {
-    std::string source_file = R"(
-        = a = 5;
-        = main(){
-
+    lang::Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg{argv[i]};
+        if ((arg == "-j" || arg == "--jobs") && i + 1 < argc)
+        {
+            options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--run")
+        {
+            options.run = true;
+        }
+        else if (arg == "--bench")
+        {
+            options.bench = true;
+        }
+        else if (arg == "--emit-ir")
+        {
+            options.emitIr = true;
+        }
+        else if (arg == "--jit")
+        {
+            options.run = true;
+            options.jit = true;
+        }
+        else if (arg == "-S")
+        {
+            options.emitAsm = true;
+        }
+        else if (arg == "-O")
+        {
+            options.optimize = true;
         }
-    )";
-    lang::Parser p{source_file};
-    try{
-        auto program = p.program();
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            options.cache = argv[++i];
+        }
+        else if (arg == "--inline" && i + 1 < argc)
+        {
+            options.inlineThreshold = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            inputs.push_back(std::move(arg));
+        }
+    }
+    if (inputs.empty())
+    {
+        inputs.push_back("-"); // read the program from stdin
     }
-    catch(std::exception& e)
+
+    int status = 0;
+    for (const auto& result : lang::compileAll(inputs, options))
     {
-        std::cout << e.what() << '\n';
+        if (!result.ok)
+        {
+            std::istringstream lines{result.diagnostics};
+            for (std::string line; std::getline(lines, line);)
+            {
+                std::cout << result.path << ": " << line << '\n';
+            }
+            status = 1;
+        }
+        else if (!result.output.empty())
+        {
+            std::cout << result.path << ": " << result.output << '\n';
+        }
     }
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace language::ir
+{
+    enum class Type : std::uint8_t
+    {
+        Void, Int, Float, Bool
+    };
+
+    enum class Opcode : std::uint8_t
+    {
+        Const, Param, Undef, Phi,
+        Add, Sub, Mul, Div,
+        Lt, Le, Gt, Ge, Eq, Ne,
+        Convert,
+        LoadGlobal, StoreGlobal,
+        Call,
+        Jump, Branch, Return,
+    };
+
+    using ValueId = std::uint32_t;
+    using BlockId = std::uint32_t;
+
+    constexpr ValueId noValue = static_cast<ValueId>(-1);
+    constexpr BlockId noBlock = static_cast<BlockId>(-1);
+
+    /*
+        Every instruction defines the value with its id, three-address instructions name their operands by id.
+        A Const keeps its value in integer or real, Param, LoadGlobal, StoreGlobal and Call keep the
+        parameter index, global offset or function index in integer.
+        The operands of a Phi are in the order of the predecessors of its block.
+    */
+    struct Instruction
+    {
+        Opcode op;
+        Type type;
+        BlockId block;
+        std::vector<ValueId> operands;
+        std::int64_t integer = 0;
+        double real = 0;
+    };
+
+    /*
+        Phis come first and a Jump, Branch or Return last. A Branch continues at successors[0] if its operand is true.
+    */
+    struct Block
+    {
+        std::vector<ValueId> instructions;
+        std::vector<BlockId> predecessors;
+        std::vector<BlockId> successors;
+    };
+
+    /*
+        Blocks are numbered in reverse postorder, so blocks[0] is the entry and every block comes after its dominator.
+        Values are numbered in the order they appear in the blocks.
+    */
+    struct Function
+    {
+        std::string name;
+        Type result;
+        std::vector<Type> parameters;
+        std::vector<Instruction> values;
+        std::vector<Block> blocks;
+    };
+
+    /*
+        The globals are initialized by the function at index init, main is std::size_t(-1) if the program has none.
+    */
+    struct Module
+    {
+        std::vector<Function> functions;
+        std::size_t globalsSize = 0;
+        std::size_t init = 0;
+        std::size_t main = static_cast<std::size_t>(-1);
+    };
+
+    /*
+        Lowers a checked Program into SSA form. Local variables and parameters become values,
+        joins of If, While, And and Or merge them with phis. Globals stay in memory.
+    */
+    auto build(Program& program) -> Module;
+
+    // Immediate dominator of every block, the entry dominates itself
+    auto dominators(const Function& function) -> std::vector<BlockId>;
+
+    // Throws std::logic_error if the function is not well formed SSA
+    auto verify(const Function& function) -> void;
+
+    auto isTerminator(Opcode op) -> bool;
+    auto opcodeToStr(Opcode op) -> std::string;
+    auto typeToStr(Type type) -> std::string;
+
+    auto dump(const Module& module) -> std::string;
+}
@@ -0,0 +1,689 @@
+#include "IR.hpp"
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace language::ir
+{
+    namespace
+    {
+        auto isComparison(BinOperator op) -> bool
+        {
+            return op >= BinOperator::Less && op <= BinOperator::NotEqual;
+        }
+
+        auto binaryOpcode(BinOperator op) -> Opcode
+        {
+            switch (op)
+            {
+            case BinOperator::Plus:
+                return Opcode::Add;
+            case BinOperator::Minus:
+                return Opcode::Sub;
+            case BinOperator::Mul:
+                return Opcode::Mul;
+            case BinOperator::Div:
+                return Opcode::Div;
+            case BinOperator::Less:
+                return Opcode::Lt;
+            case BinOperator::LessEqual:
+                return Opcode::Le;
+            case BinOperator::Greater:
+                return Opcode::Gt;
+            case BinOperator::GreaterEqual:
+                return Opcode::Ge;
+            case BinOperator::Equal:
+                return Opcode::Eq;
+            case BinOperator::NotEqual:
+                return Opcode::Ne;
+            default:
+                throw std::invalid_argument("Not a binary instruction");
+            }
+        }
+
+        /*
+            SSA construction after Braun et al., "Simple and Efficient Construction of Static Single
+            Assignment Form". A variable is read by looking backwards through the predecessors, blocks
+            whose predecessors are not all known yet (loop headers) get incomplete phis that are filled
+            in once the block is sealed. Trivial phis are removed when the function is finished.
+        */
+        class Builder : public Visitor
+        {
+        public:
+            Builder(Program& program, Module& module) : program{program}, module{module},
+                                                        intType{&std::get<SymbolTable::Type>(program.sym_table->get("int"))},
+                                                        floatType{&std::get<SymbolTable::Type>(program.sym_table->get("float"))},
+                                                        boolType{&std::get<SymbolTable::Type>(program.sym_table->get("bool"))},
+                                                        function{nullptr}, def{nullptr}, current{0}, result{noValue}
+            {
+            }
+
+            auto run() -> void
+            {
+                std::vector<FuncDef*> defs;
+                for (auto& decl : program.declarations)
+                {
+                    if (auto def = dynamic_cast<FuncDef*>(decl.get()))
+                    {
+                        indices[def] = module.functions.size();
+                        Function function{.name = std::string{def->name}, .result = type(def->returnType)};
+                        for (auto param : def->parameters)
+                        {
+                            function.parameters.push_back(type(param->type));
+                        }
+                        if (def->name == "main")
+                        {
+                            module.main = module.functions.size();
+                        }
+                        module.functions.push_back(std::move(function));
+                        defs.push_back(def);
+                    }
+                }
+
+                for (std::size_t i = 0; i < defs.size(); i++)
+                {
+                    def = defs[i];
+                    body(module.functions[i], [&] { defs[i]->block->accept(*this); });
+                }
+
+                def = nullptr;
+                module.init = module.functions.size();
+                module.functions.push_back({.name = "<globals>", .result = Type::Void});
+                body(module.functions.back(), [&] { visit(program); });
+            }
+
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    if (dynamic_cast<VarDecl*>(decl.get()))
+                    {
+                        decl->accept(*this);
+                    }
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                auto& var = *decl.var;
+                auto v = valueAs(*decl.init, var.type);
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    emit(Opcode::StoreGlobal, Type::Void, {v}, var.offset);
+                }
+                else
+                {
+                    write(&var, current, v);
+                }
+            }
+
+            void visit(FuncDef&) override
+            {
+            }
+
+            void visit(language::Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    stmt->accept(*this);
+                }
+            }
+
+            void visit(If& ifStmt) override
+            {
+                auto cond = valueAs(*ifStmt.expr, boolType);
+                auto then = newBlock();
+                auto otherwise = ifStmt.falseStmt ? newBlock() : noBlock;
+                auto join = newBlock();
+                branch(cond, then, ifStmt.falseStmt ? otherwise : join);
+
+                seal(then);
+                current = then;
+                ifStmt.trueStmt->accept(*this);
+                jump(join);
+
+                if (ifStmt.falseStmt)
+                {
+                    seal(otherwise);
+                    current = otherwise;
+                    ifStmt.falseStmt->accept(*this);
+                    jump(join);
+                }
+                seal(join);
+                current = join;
+            }
+
+            // The header is sealed after the body, its phis get their operand from the back edge then
+            void visit(While& whileStmt) override
+            {
+                auto header = newBlock();
+                auto loop = newBlock();
+                auto exit = newBlock();
+                jump(header);
+
+                current = header;
+                auto cond = valueAs(*whileStmt.expr, boolType);
+                branch(cond, loop, exit);
+                seal(exit);
+
+                seal(loop);
+                current = loop;
+                whileStmt.stmt->accept(*this);
+                jump(header);
+                seal(header);
+                current = exit;
+            }
+
+            void visit(Return& returnStmt) override
+            {
+                auto returns = type(def->returnType);
+                if (returnStmt.expr && returns != Type::Void)
+                {
+                    emit(Opcode::Return, Type::Void, {valueAs(*returnStmt.expr, def->returnType)});
+                }
+                else
+                {
+                    if (returnStmt.expr)
+                    {
+                        value(*returnStmt.expr);
+                    }
+                    emit(Opcode::Return, Type::Void, returns == Type::Void ? std::vector<ValueId>{} : std::vector{undef(current, returns)});
+                }
+                unreachable();
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                value(*exprStmt.expr);
+            }
+
+            void visit(FuncCall& funcCall) override
+            {
+                auto& callee = *funcCall.function->def;
+                if (funcCall.args.size() != callee.parameters.size())
+                {
+                    throw std::runtime_error(std::format("{} expects {} arguments", callee.name, callee.parameters.size()));
+                }
+                std::vector<ValueId> args;
+                for (std::size_t i = 0; i < funcCall.args.size(); i++)
+                {
+                    args.push_back(valueAs(*funcCall.args[i], callee.parameters[i]->type));
+                }
+                result = emit(Opcode::Call, type(callee.returnType), std::move(args), static_cast<std::int64_t>(indices.at(&callee)));
+            }
+
+            void visit(BinExpr& binExpr) override
+            {
+                if (binExpr.op == BinOperator::Assign)
+                {
+                    assign(binExpr);
+                    return;
+                }
+                if (binExpr.op == BinOperator::And || binExpr.op == BinOperator::Or)
+                {
+                    shortCircuit(binExpr);
+                    return;
+                }
+
+                auto operands = isComparison(binExpr.op) ? operandType(binExpr) : binExpr.type;
+                if (type(operands) != Type::Int && type(operands) != Type::Float && type(operands) != Type::Bool)
+                {
+                    throw std::runtime_error("Operator needs int, float or bool operands");
+                }
+                if (!isComparison(binExpr.op) && type(operands) == Type::Bool)
+                {
+                    throw std::runtime_error("Arithmetic is only defined on int and float");
+                }
+                auto l = valueAs(*binExpr.leftHs, operands);
+                auto r = valueAs(*binExpr.rightHs, operands);
+                result = emit(binaryOpcode(binExpr.op), type(binExpr.type), {l, r});
+            }
+
+            void visit(StrLiteral&) override
+            {
+                throw std::runtime_error("Strings are not supported by the IR");
+            }
+
+            void visit(IntLiteral& lit) override
+            {
+                result = emit(Opcode::Const, Type::Int, {}, lit.v);
+            }
+
+            void visit(FloatLiteral& lit) override
+            {
+                result = emit(Opcode::Const, Type::Float, {}, 0, lit.v);
+            }
+
+            void visit(BooleanLiteral& lit) override
+            {
+                result = emit(Opcode::Const, Type::Bool, {}, lit.v);
+            }
+
+            void visit(VariableAccess& access) override
+            {
+                auto& var = *access.var;
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    result = emit(Opcode::LoadGlobal, type(var.type), {}, var.offset);
+                    return;
+                }
+                result = read(&var, current);
+            }
+
+        private:
+            using Variable = const SymbolTable::Variable*;
+
+            template <typename Body>
+            auto body(Function& target, Body lowerBody) -> void
+            {
+                function = &target;
+                defs.clear();
+                incomplete.clear();
+                sealed.clear();
+                current = newBlock();
+                seal(current);
+
+                if (def)
+                {
+                    for (std::size_t i = 0; i < def->parameters.size(); i++)
+                    {
+                        auto param = def->parameters[i];
+                        write(param, current, emit(Opcode::Param, type(param->type), {}, static_cast<std::int64_t>(i)));
+                    }
+                }
+                lowerBody();
+
+                if (!terminated(current))
+                {
+                    auto returns = function->result;
+                    emit(Opcode::Return, Type::Void, returns == Type::Void ? std::vector<ValueId>{} : std::vector{undef(current, returns)});
+                }
+                finish();
+            }
+
+            auto type(const SymbolTable::Type* type) const -> Type
+            {
+                if (type == nullptr)
+                    return Type::Void;
+                if (type == intType)
+                    return Type::Int;
+                if (type == floatType)
+                    return Type::Float;
+                if (type == boolType)
+                    return Type::Bool;
+                throw std::runtime_error("Unsupported type in the IR");
+            }
+
+            // Mixed int and float compare as float
+            auto operandType(BinExpr& binExpr) const -> SymbolTable::Type*
+            {
+                auto l = type(binExpr.leftHs->type);
+                auto r = type(binExpr.rightHs->type);
+                if (l == Type::Float || r == Type::Float)
+                    return floatType;
+                if (l == Type::Bool && r == Type::Bool &&
+                    (binExpr.op == BinOperator::Equal || binExpr.op == BinOperator::NotEqual))
+                    return boolType;
+                return intType;
+            }
+
+            auto newBlock() -> BlockId
+            {
+                function->blocks.emplace_back();
+                defs.emplace_back();
+                incomplete.emplace_back();
+                sealed.push_back(false);
+                return static_cast<BlockId>(function->blocks.size() - 1);
+            }
+
+            // Statements after a return go to a block without predecessors, finish drops it
+            auto unreachable() -> void
+            {
+                current = newBlock();
+                seal(current);
+            }
+
+            auto terminated(BlockId block) const -> bool
+            {
+                auto& instructions = function->blocks[block].instructions;
+                return !instructions.empty() && isTerminator(function->values[instructions.back()].op);
+            }
+
+            auto emit(Opcode op, Type type, std::vector<ValueId> operands = {}, std::int64_t integer = 0, double real = 0) -> ValueId
+            {
+                auto id = static_cast<ValueId>(function->values.size());
+                function->values.push_back({op, type, current, std::move(operands), integer, real});
+                function->blocks[current].instructions.push_back(id);
+                return id;
+            }
+
+            // Phis and undefs are placed in front of the other instructions of a block
+            auto prepend(BlockId block, Opcode op, Type type) -> ValueId
+            {
+                auto id = static_cast<ValueId>(function->values.size());
+                function->values.push_back({op, type, block, {}});
+                auto& instructions = function->blocks[block].instructions;
+                auto end = std::ranges::find_if(instructions, [&](ValueId v) { return function->values[v].op != Opcode::Phi; });
+                instructions.insert(end, id);
+                return id;
+            }
+
+            auto undef(BlockId block, Type type) -> ValueId
+            {
+                return prepend(block, Opcode::Undef, type);
+            }
+
+            auto edge(BlockId from, BlockId to) -> void
+            {
+                function->blocks[from].successors.push_back(to);
+                function->blocks[to].predecessors.push_back(from);
+            }
+
+            auto jump(BlockId to) -> void
+            {
+                emit(Opcode::Jump, Type::Void);
+                edge(current, to);
+            }
+
+            auto branch(ValueId cond, BlockId then, BlockId otherwise) -> void
+            {
+                emit(Opcode::Branch, Type::Void, {cond});
+                edge(current, then);
+                edge(current, otherwise);
+            }
+
+            auto write(Variable var, BlockId block, ValueId value) -> void
+            {
+                defs[block][var] = value;
+            }
+
+            auto read(Variable var, BlockId block) -> ValueId
+            {
+                if (auto found = defs[block].find(var); found != defs[block].end())
+                {
+                    return found->second;
+                }
+
+                ValueId value;
+                auto& preds = function->blocks[block].predecessors;
+                if (!sealed[block])
+                {
+                    value = prepend(block, Opcode::Phi, type(var->type));
+                    incomplete[block].emplace_back(var, value);
+                }
+                else if (preds.empty())
+                {
+                    value = undef(block, type(var->type));
+                }
+                else if (preds.size() == 1)
+                {
+                    value = read(var, preds[0]);
+                }
+                else
+                {
+                    // Written before the operands are read, so cycles through loops end at this phi
+                    value = prepend(block, Opcode::Phi, type(var->type));
+                    write(var, block, value);
+                    addPhiOperands(var, value);
+                }
+                write(var, block, value);
+                return value;
+            }
+
+            auto addPhiOperands(Variable var, ValueId phi) -> void
+            {
+                auto block = function->values[phi].block;
+                for (std::size_t i = 0; i < function->blocks[block].predecessors.size(); i++)
+                {
+                    auto operand = read(var, function->blocks[block].predecessors[i]);
+                    function->values[phi].operands.push_back(operand);
+                }
+            }
+
+            auto seal(BlockId block) -> void
+            {
+                for (auto [var, phi] : incomplete[block])
+                {
+                    addPhiOperands(var, phi);
+                }
+                incomplete[block].clear();
+                sealed[block] = true;
+            }
+
+            auto value(Expr& expr) -> ValueId
+            {
+                expr.accept(*this);
+                return result;
+            }
+
+            auto valueAs(Expr& expr, SymbolTable::Type* to) -> ValueId
+            {
+                auto v = value(expr);
+                if (type(expr.type) == type(to))
+                {
+                    return v;
+                }
+                if (type(expr.type) == Type::Void || type(to) == Type::Void)
+                {
+                    throw std::runtime_error("Expected a value");
+                }
+                return emit(Opcode::Convert, type(to), {v});
+            }
+
+            auto assign(BinExpr& binExpr) -> void
+            {
+                auto access = dynamic_cast<VariableAccess*>(binExpr.leftHs.get());
+                if (!access)
+                {
+                    throw std::runtime_error("Left side of an assignment has to be a variable");
+                }
+                auto& var = *access->var;
+                auto v = valueAs(*binExpr.rightHs, var.type);
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    emit(Opcode::StoreGlobal, Type::Void, {v}, var.offset);
+                }
+                else
+                {
+                    write(&var, current, v);
+                }
+                result = v;
+            }
+
+            // The right side gets its own block, the join merges both sides with a phi
+            auto shortCircuit(BinExpr& binExpr) -> void
+            {
+                auto l = valueAs(*binExpr.leftHs, boolType);
+                auto from = current;
+                auto right = newBlock();
+                auto join = newBlock();
+                if (binExpr.op == BinOperator::And)
+                    branch(l, right, join);
+                else
+                    branch(l, join, right);
+
+                seal(right);
+                current = right;
+                auto r = valueAs(*binExpr.rightHs, boolType);
+                jump(join);
+                seal(join);
+
+                current = join;
+                auto phi = prepend(join, Opcode::Phi, Type::Bool);
+                for (auto pred : function->blocks[join].predecessors)
+                {
+                    function->values[phi].operands.push_back(pred == from ? l : r);
+                }
+                result = phi;
+            }
+
+            /*
+                Drops unreachable blocks, removes trivial phis until none is left and renumbers
+                blocks in reverse postorder and values in block order.
+            */
+            auto finish() -> void
+            {
+                auto& blocks = function->blocks;
+                auto& values = function->values;
+
+                std::vector<BlockId> postorder;
+                std::vector<bool> visited(blocks.size());
+                std::vector<std::pair<BlockId, std::size_t>> stack{{0, 0}};
+                visited[0] = true;
+                while (!stack.empty())
+                {
+                    auto& [block, next] = stack.back();
+                    if (next < blocks[block].successors.size())
+                    {
+                        // Visited last to first, so the first successor directly follows its block
+                        auto& succs = blocks[block].successors;
+                        auto succ = succs[succs.size() - 1 - next++];
+                        if (!visited[succ])
+                        {
+                            visited[succ] = true;
+                            stack.emplace_back(succ, 0);
+                        }
+                        continue;
+                    }
+                    postorder.push_back(block);
+                    stack.pop_back();
+                }
+
+                // Unreachable predecessors take their phi operands with them
+                for (auto block : postorder)
+                {
+                    auto& preds = blocks[block].predecessors;
+                    for (auto id : blocks[block].instructions)
+                    {
+                        auto& inst = values[id];
+                        if (inst.op != Opcode::Phi)
+                            continue;
+                        std::vector<ValueId> operands;
+                        for (std::size_t i = 0; i < preds.size(); i++)
+                        {
+                            if (visited[preds[i]])
+                                operands.push_back(inst.operands[i]);
+                        }
+                        inst.operands = std::move(operands);
+                    }
+                    std::erase_if(preds, [&](BlockId pred) { return !visited[pred]; });
+                }
+
+                std::vector<ValueId> forward(values.size());
+                for (ValueId id = 0; id < values.size(); id++)
+                {
+                    forward[id] = id;
+                }
+                auto resolve = [&](ValueId id)
+                {
+                    while (forward[id] != id)
+                        id = forward[id];
+                    return id;
+                };
+
+                for (auto changed = true; changed;)
+                {
+                    changed = false;
+                    for (auto block : postorder)
+                    {
+                        for (auto id : blocks[block].instructions)
+                        {
+                            if (values[id].op != Opcode::Phi || forward[id] != id)
+                                continue;
+                            auto same = noValue;
+                            auto trivial = true;
+                            for (auto operand : values[id].operands)
+                            {
+                                operand = resolve(operand);
+                                if (operand == same || operand == id)
+                                    continue;
+                                if (same != noValue)
+                                {
+                                    trivial = false;
+                                    break;
+                                }
+                                same = operand;
+                            }
+                            if (trivial)
+                            {
+                                forward[id] = same != noValue ? same : id;
+                                if (same == noValue)
+                                {
+                                    values[id].op = Opcode::Undef;
+                                    values[id].operands.clear();
+                                }
+                                changed = changed || same != noValue;
+                            }
+                        }
+                    }
+                }
+
+                std::vector<BlockId> blockIds(blocks.size(), noBlock);
+                std::vector<Block> order;
+                for (auto it = postorder.rbegin(); it != postorder.rend(); it++)
+                {
+                    blockIds[*it] = static_cast<BlockId>(order.size());
+                    order.push_back(std::move(blocks[*it]));
+                }
+
+                std::vector<ValueId> valueIds(values.size(), noValue);
+                std::vector<Instruction> renumbered;
+                for (BlockId b = 0; b < order.size(); b++)
+                {
+                    auto& block = order[b];
+                    for (auto& pred : block.predecessors)
+                        pred = blockIds[pred];
+                    for (auto& succ : block.successors)
+                        succ = blockIds[succ];
+                    std::erase_if(block.instructions, [&](ValueId id) { return forward[id] != id; });
+                    // Phis without operands became undefs, they may sit between the remaining phis
+                    std::ranges::stable_partition(block.instructions, [&](ValueId id) { return values[id].op == Opcode::Phi; });
+                    for (auto& id : block.instructions)
+                    {
+                        valueIds[id] = static_cast<ValueId>(renumbered.size());
+                        renumbered.push_back(std::move(values[id]));
+                        renumbered.back().block = b;
+                        id = valueIds[id];
+                    }
+                }
+                for (auto& inst : renumbered)
+                {
+                    for (auto& operand : inst.operands)
+                        operand = valueIds[resolve(operand)];
+                }
+
+                blocks = std::move(order);
+                values = std::move(renumbered);
+            }
+
+            Program& program;
+            Module& module;
+            SymbolTable::Type* intType;
+            SymbolTable::Type* floatType;
+            SymbolTable::Type* boolType;
+            std::unordered_map<const FuncDef*, std::size_t> indices;
+
+            Function* function;
+            FuncDef* def;
+            BlockId current;
+            ValueId result;
+
+            std::vector<std::unordered_map<Variable, ValueId>> defs;
+            std::vector<std::vector<std::pair<Variable, ValueId>>> incomplete;
+            std::vector<bool> sealed;
+        };
+    }
+
+    auto build(Program& program) -> Module
+    {
+        Module module;
+        module.globalsSize = program.globalsSize;
+        Builder{program, module}.run();
+        for (auto& function : module.functions)
+        {
+            verify(function);
+        }
+        return module;
+    }
+}
@@ -0,0 +1,332 @@
+#include "IR.hpp"
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+namespace language::ir
+{
+    auto isTerminator(Opcode op) -> bool
+    {
+        return op == Opcode::Jump || op == Opcode::Branch || op == Opcode::Return;
+    }
+
+    auto opcodeToStr(Opcode op) -> std::string
+    {
+        switch (op)
+        {
+        case Opcode::Const:
+            return "const";
+        case Opcode::Param:
+            return "param";
+        case Opcode::Undef:
+            return "undef";
+        case Opcode::Phi:
+            return "phi";
+        case Opcode::Add:
+            return "add";
+        case Opcode::Sub:
+            return "sub";
+        case Opcode::Mul:
+            return "mul";
+        case Opcode::Div:
+            return "div";
+        case Opcode::Lt:
+            return "lt";
+        case Opcode::Le:
+            return "le";
+        case Opcode::Gt:
+            return "gt";
+        case Opcode::Ge:
+            return "ge";
+        case Opcode::Eq:
+            return "eq";
+        case Opcode::Ne:
+            return "ne";
+        case Opcode::Convert:
+            return "convert";
+        case Opcode::LoadGlobal:
+            return "load";
+        case Opcode::StoreGlobal:
+            return "store";
+        case Opcode::Call:
+            return "call";
+        case Opcode::Jump:
+            return "jump";
+        case Opcode::Branch:
+            return "branch";
+        case Opcode::Return:
+            return "return";
+        default:
+            throw std::invalid_argument("Missing Opcode");
+        }
+    }
+
+    auto typeToStr(Type type) -> std::string
+    {
+        switch (type)
+        {
+        case Type::Void:
+            return "void";
+        case Type::Int:
+            return "int";
+        case Type::Float:
+            return "float";
+        case Type::Bool:
+            return "bool";
+        default:
+            throw std::invalid_argument("Missing Type");
+        }
+    }
+
+    // Cooper, Harvey and Kennedy, blocks in reverse postorder make every intersection walk towards lower ids
+    auto dominators(const Function& function) -> std::vector<BlockId>
+    {
+        std::vector<BlockId> idom(function.blocks.size(), noBlock);
+        if (idom.empty())
+        {
+            return idom;
+        }
+        idom[0] = 0;
+
+        auto intersect = [&](BlockId a, BlockId b)
+        {
+            while (a != b)
+            {
+                while (a > b)
+                    a = idom[a];
+                while (b > a)
+                    b = idom[b];
+            }
+            return a;
+        };
+
+        for (auto changed = true; changed;)
+        {
+            changed = false;
+            for (BlockId block = 1; block < function.blocks.size(); block++)
+            {
+                auto dominator = noBlock;
+                for (auto pred : function.blocks[block].predecessors)
+                {
+                    if (idom[pred] == noBlock)
+                        continue;
+                    dominator = dominator == noBlock ? pred : intersect(pred, dominator);
+                }
+                if (dominator != idom[block])
+                {
+                    idom[block] = dominator;
+                    changed = true;
+                }
+            }
+        }
+        return idom;
+    }
+
+    auto verify(const Function& function) -> void
+    {
+        auto fail = [&](const std::string& message)
+        {
+            throw std::logic_error(std::format("{}: {}", function.name, message));
+        };
+
+        if (function.blocks.empty())
+        {
+            fail("no entry block");
+        }
+
+        struct Position
+        {
+            BlockId block = noBlock;
+            std::size_t index = 0;
+        };
+        std::vector<Position> positions(function.values.size());
+
+        for (BlockId b = 0; b < function.blocks.size(); b++)
+        {
+            auto& block = function.blocks[b];
+            if (block.instructions.empty() || !isTerminator(function.values.at(block.instructions.back()).op))
+            {
+                fail(std::format("b{} has no terminator", b));
+            }
+
+            auto phis = true;
+            for (std::size_t i = 0; i < block.instructions.size(); i++)
+            {
+                auto id = block.instructions[i];
+                if (id >= function.values.size() || positions[id].block != noBlock)
+                {
+                    fail(std::format("%{} is defined twice", id));
+                }
+                positions[id] = {b, i};
+
+                auto& inst = function.values[id];
+                if (inst.block != b)
+                {
+                    fail(std::format("%{} is not in b{}", id, inst.block));
+                }
+                if (inst.op == Opcode::Phi && !phis)
+                {
+                    fail(std::format("phi %{} follows other instructions", id));
+                }
+                phis = phis && inst.op == Opcode::Phi;
+                if (isTerminator(inst.op) && i + 1 != block.instructions.size())
+                {
+                    fail(std::format("terminator %{} in the middle of b{}", id, b));
+                }
+            }
+
+            auto& last = function.values[block.instructions.back()];
+            std::size_t successors = last.op == Opcode::Jump ? 1 : last.op == Opcode::Branch ? 2 : 0;
+            if (block.successors.size() != successors)
+            {
+                fail(std::format("b{} has {} successors", b, block.successors.size()));
+            }
+            for (auto succ : block.successors)
+            {
+                auto& preds = function.blocks.at(succ).predecessors;
+                if (std::ranges::find(preds, b) == preds.end())
+                {
+                    fail(std::format("b{} is missing predecessor b{}", succ, b));
+                }
+            }
+            for (auto pred : block.predecessors)
+            {
+                auto& succs = function.blocks.at(pred).successors;
+                if (std::ranges::find(succs, b) == succs.end())
+                {
+                    fail(std::format("b{} is missing successor b{}", pred, b));
+                }
+            }
+        }
+
+        auto idom = dominators(function);
+        auto dominates = [&](BlockId a, BlockId b)
+        {
+            while (b != a && b != 0)
+                b = idom[b];
+            return a == b;
+        };
+
+        for (BlockId b = 0; b < function.blocks.size(); b++)
+        {
+            auto& block = function.blocks[b];
+            if (b != 0 && idom[b] == noBlock)
+            {
+                fail(std::format("b{} is unreachable", b));
+            }
+            for (std::size_t i = 0; i < block.instructions.size(); i++)
+            {
+                auto id = block.instructions[i];
+                auto& inst = function.values[id];
+                if (inst.op == Opcode::Phi && inst.operands.size() != block.predecessors.size())
+                {
+                    fail(std::format("phi %{} has {} operands for {} predecessors", id, inst.operands.size(), block.predecessors.size()));
+                }
+                for (std::size_t k = 0; k < inst.operands.size(); k++)
+                {
+                    auto operand = inst.operands[k];
+                    if (operand >= positions.size() || positions[operand].block == noBlock)
+                    {
+                        fail(std::format("%{} uses undefined %{}", id, operand));
+                    }
+                    auto def = positions[operand];
+                    auto ok = inst.op == Opcode::Phi ? dominates(def.block, block.predecessors[k])
+                              : def.block == b       ? def.index < i
+                                                     : dominates(def.block, b);
+                    if (!ok)
+                    {
+                        fail(std::format("%{} is not dominated by its operand %{}", id, operand));
+                    }
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        auto instructionToStr(const Module& module, const Function& function, const Instruction& inst) -> std::string
+        {
+            auto operand = [&](std::size_t i) { return std::format("%{}", inst.operands[i]); };
+            auto operands = [&]
+            {
+                std::string list;
+                for (std::size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    list += (i ? ", " : "") + operand(i);
+                }
+                return list;
+            };
+            auto& block = function.blocks[inst.block];
+
+            switch (inst.op)
+            {
+            case Opcode::Const:
+                if (inst.type == Type::Float)
+                    return std::format("const {}", inst.real);
+                if (inst.type == Type::Bool)
+                    return inst.integer ? "const true" : "const false";
+                return std::format("const {}", inst.integer);
+            case Opcode::Param:
+                return std::format("param {}", inst.integer);
+            case Opcode::Phi:
+            {
+                std::string text = "phi";
+                for (std::size_t i = 0; i < inst.operands.size(); i++)
+                {
+                    text += std::format("{} [{}, b{}]", i ? "," : "", operand(i), block.predecessors[i]);
+                }
+                return text;
+            }
+            case Opcode::LoadGlobal:
+                return std::format("load @{}", inst.integer);
+            case Opcode::StoreGlobal:
+                return std::format("store @{}, {}", inst.integer, operand(0));
+            case Opcode::Call:
+                return std::format("call {}({})", module.functions.at(inst.integer).name, operands());
+            case Opcode::Jump:
+                return std::format("jump b{}", block.successors[0]);
+            case Opcode::Branch:
+                return std::format("branch {}, b{}, b{}", operand(0), block.successors[0], block.successors[1]);
+            default:
+                return inst.operands.empty() ? opcodeToStr(inst.op) : opcodeToStr(inst.op) + " " + operands();
+            }
+        }
+    }
+
+    auto dump(const Module& module) -> std::string
+    {
+        std::string text;
+        for (const auto& function : module.functions)
+        {
+            std::string parameters;
+            for (std::size_t i = 0; i < function.parameters.size(); i++)
+            {
+                parameters += (i ? ", " : "") + typeToStr(function.parameters[i]);
+            }
+            text += std::format("function {}({}): {}\n", function.name, parameters, typeToStr(function.result));
+
+            for (BlockId b = 0; b < function.blocks.size(); b++)
+            {
+                auto& block = function.blocks[b];
+                text += std::format("b{}:", b);
+                for (std::size_t i = 0; i < block.predecessors.size(); i++)
+                {
+                    text += std::format("{} b{}", i ? "," : " ; preds", block.predecessors[i]);
+                }
+                text += '\n';
+
+                for (auto id : block.instructions)
+                {
+                    auto& inst = function.values[id];
+                    auto body = instructionToStr(module, function, inst);
+                    if (inst.type == Type::Void)
+                        text += std::format("    {}\n", body);
+                    else
+                        text += std::format("    %{}: {} = {}\n", id, typeToStr(inst.type), body);
+                }
+            }
+            text += '\n';
+        }
+        return text;
+    }
+}
@@ -0,0 +1,81 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "Parser/Parser.hpp"
+#include "IR/IR.hpp"
+#include <algorithm>
+#include <string>
+
+namespace ir = language::ir;
+
+static auto build(const std::string& source) -> ir::Module
+{
+    language::Parser p{source};
+    auto program = p.program();
+    return ir::build(program);
+}
+
+static auto count(const ir::Function& function, ir::Opcode op) -> std::size_t
+{
+    return std::ranges::count_if(function.values, [&](auto& inst) { return inst.op == op; });
+}
+
+TEST_CASE("SSA Joins", "[ssa]")
+{
+    auto module = build(R"(
+        main(): int {
+            var sum = 0;
+            var last = 0;
+            for (var i = 0; i < 10; i = i + 1) {
+                if (i == 3) last = i; else sum = sum + i;
+            }
+            return sum + last;
+        }
+    )");
+    auto& main = module.functions[module.main];
+    auto dump = ir::dump(module);
+    INFO(dump);
+
+    // The loop header merges sum, last and i, the join of the if merges sum and last
+    auto& header = main.blocks[1];
+    REQUIRE(header.predecessors.size() == 2);
+    REQUIRE(std::ranges::count_if(header.instructions, [&](auto id) { return main.values[id].op == ir::Opcode::Phi; }) == 3);
+    REQUIRE(count(main, ir::Opcode::Phi) == 5);
+    REQUIRE(count(main, ir::Opcode::Undef) == 0);
+    for (auto id : header.instructions)
+    {
+        auto& phi = main.values[id];
+        if (phi.op == ir::Opcode::Phi)
+        {
+            REQUIRE(main.values[phi.operands[0]].op == ir::Opcode::Const);
+            REQUIRE(main.values[phi.operands[1]].block > 1);
+        }
+    }
+}
+
+TEST_CASE("Trivial Phis", "[ssa]")
+{
+    auto module = build(R"(
+        var g = 1.5;
+        f(a: int, b: bool): float {
+            var x = a * 1.0;
+            while (b && x < 100) {
+                g = g * 2;
+                if (a > 0) return x;
+            }
+            return x + g;
+        }
+        main(): int { return 0; }
+    )");
+    auto& f = module.functions[0];
+    INFO(ir::dump(module));
+
+    // x is never reassigned, only the short circuit needs a phi. a, 100 and 2 are converted to float
+    REQUIRE(count(f, ir::Opcode::Phi) == 1);
+    REQUIRE(count(f, ir::Opcode::Param) == 2);
+    REQUIRE(count(f, ir::Opcode::Convert) == 3);
+    REQUIRE(count(module.functions[module.init], ir::Opcode::StoreGlobal) == 1);
+    for (auto& function : module.functions)
+    {
+        REQUIRE_NOTHROW(ir::verify(function));
+    }
+}
@@ -0,0 +1,114 @@
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "Interpreter/VirtualMachine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lang = language;
+
+// Loop heavy programs, for loops are desugared into while loops by the parser
+static const std::pair<const char*, const char*> programs[] = {
+    {"for", R"(
+        main(): int {
+            var sum = 0;
+            for (var i = 0; i < 3000000; i = i + 1) {
+                sum = sum + i * 2 - i / 3;
+            }
+            return sum;
+        }
+    )"},
+    {"nested", R"(
+        main(): int {
+            var count = 0;
+            for (var i = 0; i < 1500; i = i + 1) {
+                for (var j = 0; j < 1500; j = j + 1) {
+                    if (i < j && j - i < 100) count = count + 1;
+                }
+            }
+            return count;
+        }
+    )"},
+    {"float", R"(
+        main(): float {
+            var pi = 0.0;
+            var sign = 1.0;
+            var k = 0;
+            while (k < 2000000) {
+                pi = pi + sign * 4.0 / (2 * k + 1);
+                sign = 0.0 - sign;
+                k = k + 1;
+            }
+            return pi;
+        }
+    )"},
+    {"calls", R"(
+        fib(n: int): int {
+            if (n < 2) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        main(): int {
+            return fib(25);
+        }
+    )"},
+};
+
+template <typename Run>
+static auto bestOf(int runs, Run run) -> std::pair<lang::Value, double>
+{
+    lang::Value value;
+    auto best = 0.0;
+    for (int i = 0; i < runs; i++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        value = run();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return {value, best};
+}
+
+static auto measure(const std::string& name, const std::string& source) -> void
+{
+    lang::Parser parser{source};
+    auto program = parser.program();
+    auto module = lang::lower(program);
+
+    auto [expected, walked] = bestOf(3, [&] { return lang::Interpreter{program}.run(); });
+    auto [actual, executed] = bestOf(3, [&] { return lang::VirtualMachine{module}.run(); });
+    if (lang::valueToStr(actual) != lang::valueToStr(expected))
+    {
+        std::cerr << name << ": bytecode returned " << lang::valueToStr(actual)
+                  << " instead of " << lang::valueToStr(expected) << '\n';
+        std::exit(1);
+    }
+
+    std::cout << name << ": " << lang::valueToStr(actual) << '\n'
+              << "  ast:      " << walked << " ms\n"
+              << "  bytecode: " << executed << " ms (" << walked / executed << "x)\n";
+}
+
+// Runs the built in programs, or the given source files, on the Interpreter and on the VirtualMachine
+int main(int argc, char** argv)
+{
+    if (argc == 1)
+    {
+        for (auto [name, source] : programs)
+        {
+            measure(name, source);
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        std::ifstream file{argv[i]};
+        std::stringstream source;
+        source << file.rdbuf();
+        measure(argv[i], source.str());
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace language
+{
+    /*
+        Register operands a, b and c are byte offsets into the current frame, so a variable is
+        the register at its SymbolTable::Variable::offset and temporaries follow the variables.
+        Constants, global offsets and pool indices are 32 bit immediates in b and c,
+        jump distances are relative to the jump and stored in c.
+    */
+#define LANGUAGE_OPCODES(X)                                                           \
+    X(MovI) X(MovF) X(MovB)                                  /* a = b */              \
+    X(ConstI) X(ConstF) X(ConstB)                            /* a = immediate */      \
+    X(GetGI) X(GetGF) X(GetGB)                               /* a = global */         \
+    X(SetGI) X(SetGF) X(SetGB)                               /* global = a */         \
+    X(IToF) X(FToI) X(IToB) X(FToB) X(BToI) X(BToF)          /* a = convert(b) */     \
+    X(AddI) X(SubI) X(MulI) X(DivI)                          /* a = b op c */         \
+    X(AddF) X(SubF) X(MulF) X(DivF)                                                   \
+    X(LtI) X(LeI) X(GtI) X(GeI) X(EqI) X(NeI)                                         \
+    X(LtF) X(LeF) X(GtF) X(GeF) X(EqF) X(NeF)                                         \
+    X(EqB) X(NeB)                                                                     \
+    X(Jump)                                                  /* pc += c */            \
+    X(JumpIf) X(JumpIfNot)                                   /* if a: pc += c */      \
+    X(JumpLtI) X(JumpLeI) X(JumpGtI) X(JumpGeI) X(JumpEqI) X(JumpNeI) /* if a op b */ \
+    X(Call)                                                  /* a = b(frame at c) */  \
+    X(RetI) X(RetF) X(RetB) X(RetV)
+
+    enum class Op : std::uint8_t
+    {
+#define LANGUAGE_OPCODE_ENUM(name) name,
+        LANGUAGE_OPCODES(LANGUAGE_OPCODE_ENUM)
+#undef LANGUAGE_OPCODE_ENUM
+    };
+
+    auto opToStr(Op op) -> std::string;
+
+    struct Instruction
+    {
+        Op op;
+        std::uint16_t a = 0;
+        std::uint16_t b = 0;
+        std::uint16_t c = 0;
+
+        auto immediate() const -> std::int32_t
+        {
+            return static_cast<std::int32_t>(b | (static_cast<std::uint32_t>(c) << 16));
+        }
+        auto distance() const -> std::int16_t
+        {
+            return static_cast<std::int16_t>(c);
+        }
+    };
+
+    static_assert(sizeof(Instruction) == 8);
+
+    // Machine representation of a SymbolTable::Type
+    enum class Kind : std::uint8_t
+    {
+        Void, Int, Float, Bool
+    };
+
+    struct BytecodeFunction
+    {
+        struct Parameter
+        {
+            std::uint16_t offset;
+            Kind kind;
+        };
+
+        std::string name;
+        std::uint32_t entry;
+        std::uint32_t end;
+        std::uint32_t frameSize; // variables and temporaries
+        Kind result;
+        std::vector<Parameter> parameters;
+    };
+
+    /*
+        All functions share one code vector. The globals are initialized by the function at index init,
+        main is std::size_t(-1) if the program has none.
+    */
+    struct Module
+    {
+        std::vector<Instruction> code;
+        std::vector<BytecodeFunction> functions;
+        std::vector<double> floats;
+        std::size_t globalsSize = 0;
+        std::size_t init = 0;
+        std::size_t main = static_cast<std::size_t>(-1);
+    };
+
+    /*
+        Lowers a checked Program to register bytecode. Instructions are typed from Expr::type,
+        mixed operands are converted explicitly and conditions on int comparisons become a single
+        compare and jump.
+    */
+    auto lower(Program& program) -> Module;
+
+    auto disassemble(const Module& module) -> std::string;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace language
+{
+    // monostate is the result of functions without a return value
+    using Value = std::variant<std::monostate, int, double, bool>;
+
+    auto valueToStr(const Value& value) -> std::string;
+
+    class RuntimeError : public std::runtime_error
+    {
+    public:
+        RuntimeError(const std::string& message);
+    };
+
+    /*
+        Evaluates a parsed Program by walking the AST. Variables are not looked up by name, every
+        SymbolTable::Variable is read and written at its offset in the globals or the current frame.
+        int arithmetic wraps around on overflow.
+        Every call recurses on the native stack. Once nested calls take more than stackLimit bytes of
+        it, a RuntimeError reports the overflow, the way the VirtualMachine does for its frame stack.
+    */
+    class Interpreter : public Visitor
+    {
+    public:
+        Interpreter(Program& program, std::size_t stackLimit = 4 << 20);
+
+        // Initializes the globals and calls main
+        auto run() -> Value;
+        auto call(FuncDef& function, std::span<const Value> args = {}) -> Value;
+
+        void visit(VarDecl&) override;
+        void visit(FuncDef&) override;
+        void visit(Block&) override;
+        void visit(If&) override;
+        void visit(While&) override;
+        void visit(Return&) override;
+        void visit(ExprStmt&) override;
+        void visit(FuncCall&) override;
+        void visit(BinExpr&) override;
+        void visit(StrLiteral&) override;
+        void visit(IntLiteral&) override;
+        void visit(FloatLiteral&) override;
+        void visit(BooleanLiteral&) override;
+        void visit(VariableAccess&) override;
+        void visit(Program& program) override;
+
+    private:
+        auto evaluate(Expr& expr) -> Value;
+        auto slot(const SymbolTable::Variable& var) -> std::byte*;
+        auto load(const SymbolTable::Variable& var) -> Value;
+        auto store(const SymbolTable::Variable& var, const Value& value) -> void;
+
+        Program& program;
+        SymbolTable::Type* intType;
+        SymbolTable::Type* floatType;
+        SymbolTable::Type* boolType;
+
+        std::vector<std::byte> globals;
+        std::vector<std::byte> stack;
+        std::size_t frame;
+        std::size_t depth;          // of the pending calls
+        std::uintptr_t stackBase;   // native stack address of the outermost call
+        std::size_t stackLimit;
+        std::vector<Value> args;    // arguments of pending calls
+
+        Value result;
+        bool returning;
+    };
+}
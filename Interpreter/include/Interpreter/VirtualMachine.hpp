@@ -0,0 +1,40 @@
+#pragma once
+#include "Bytecode.hpp"
+#include "Interpreter.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace language
+{
+    /*
+        Executes a lowered Module. A frame is a window of the byte stack, a call moves the window up
+        to the arguments the caller has written, so no values are copied on calls.
+        Dispatch uses computed goto where the compiler supports it and a switch otherwise,
+        defining LANGUAGE_SWITCH_DISPATCH forces the switch.
+    */
+    class VirtualMachine
+    {
+    public:
+        VirtualMachine(const Module& module, std::size_t stackSize = 8 << 20);
+
+        // Initializes the globals and calls main
+        auto run() -> Value;
+        auto call(std::size_t function, std::span<const Value> args = {}) -> Value;
+
+    private:
+        struct CallFrame
+        {
+            const Instruction* pc;
+            std::byte* frame;
+            std::uint16_t result;
+        };
+
+        auto execute(const BytecodeFunction& function, std::byte* frame) -> Value;
+
+        const Module& module;
+        std::vector<std::byte> globals;
+        std::vector<std::byte> stack;
+        std::vector<CallFrame> calls;
+    };
+}
@@ -0,0 +1,659 @@
+#include "Bytecode.hpp"
+#include "Interpreter.hpp"
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+
+namespace language
+{
+    namespace
+    {
+        using Reg = std::uint16_t;
+
+        constexpr std::size_t noTarget = static_cast<std::size_t>(-1);
+
+        auto align8(std::size_t offset) -> std::size_t
+        {
+            return (offset + 7) & ~std::size_t{7};
+        }
+
+        auto isComparison(BinOperator op) -> bool
+        {
+            return op >= BinOperator::Less && op <= BinOperator::NotEqual;
+        }
+
+        auto inverse(BinOperator op) -> BinOperator
+        {
+            switch (op)
+            {
+            case BinOperator::Less:
+                return BinOperator::GreaterEqual;
+            case BinOperator::LessEqual:
+                return BinOperator::Greater;
+            case BinOperator::Greater:
+                return BinOperator::LessEqual;
+            case BinOperator::GreaterEqual:
+                return BinOperator::Less;
+            case BinOperator::Equal:
+                return BinOperator::NotEqual;
+            default:
+                return BinOperator::Equal;
+            }
+        }
+
+        // Comparison opcodes are laid out Lt, Le, Gt, Ge, Eq, Ne
+        auto comparisonIndex(BinOperator op) -> int
+        {
+            return static_cast<int>(op) - static_cast<int>(BinOperator::Less);
+        }
+
+        auto offsetOp(Op first, int index) -> Op
+        {
+            return static_cast<Op>(static_cast<int>(first) + index);
+        }
+
+        auto kindOffset(Kind kind) -> int
+        {
+            return kind == Kind::Int ? 0 : kind == Kind::Float ? 1 : 2;
+        }
+
+        auto hasAssignment(Expr& expr) -> bool
+        {
+            if (auto bin = dynamic_cast<BinExpr*>(&expr))
+            {
+                return bin->op == BinOperator::Assign || hasAssignment(*bin->leftHs) || hasAssignment(*bin->rightHs);
+            }
+            if (auto call = dynamic_cast<FuncCall*>(&expr))
+            {
+                return std::ranges::any_of(call->args, [](auto& arg) { return hasAssignment(*arg); });
+            }
+            return false;
+        }
+
+        /*
+            Statements are lowered by visiting them, expressions are visited with a target register.
+            Without a target an expression picks its own register, variables then need no move at all.
+            Temporaries are 8 byte slots above the variables of the frame and released after every statement.
+        */
+        class Lowering : public Visitor
+        {
+        public:
+            Lowering(Program& program, Module& module) : program{program}, module{module},
+                                                         intType{&std::get<SymbolTable::Type>(program.sym_table->get("int"))},
+                                                         floatType{&std::get<SymbolTable::Type>(program.sym_table->get("float"))},
+                                                         boolType{&std::get<SymbolTable::Type>(program.sym_table->get("bool"))},
+                                                         current{nullptr}, target{noTarget}, location{0},
+                                                         tempBase{0}, top{0}, frameTop{0}
+            {
+            }
+
+            auto run() -> void
+            {
+                std::vector<FuncDef*> defs;
+                for (auto& decl : program.declarations)
+                {
+                    if (auto def = dynamic_cast<FuncDef*>(decl.get()))
+                    {
+                        indices[def] = static_cast<Reg>(module.functions.size());
+                        BytecodeFunction function{.name = std::string{def->name}, .result = kind(def->returnType)};
+                        for (auto param : def->parameters)
+                        {
+                            function.parameters.push_back({reg(param->offset), kind(param->type)});
+                        }
+                        if (def->name == "main")
+                        {
+                            module.main = module.functions.size();
+                        }
+                        module.functions.push_back(std::move(function));
+                        defs.push_back(def);
+                    }
+                }
+                if (module.functions.size() >= 0xffff)
+                {
+                    throw RuntimeError("Too many functions for the bytecode");
+                }
+
+                for (std::size_t i = 0; i < defs.size(); i++)
+                {
+                    current = defs[i];
+                    body(module.functions[i], defs[i]->frameSize, [&] { defs[i]->block->accept(*this); });
+                }
+
+                current = nullptr;
+                module.init = module.functions.size();
+                module.functions.push_back({.name = "<globals>", .result = Kind::Void});
+                body(module.functions.back(), 0, [&] { visit(program); });
+            }
+
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    if (dynamic_cast<VarDecl*>(decl.get()))
+                    {
+                        statement(*decl);
+                    }
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                auto& var = *decl.var;
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    auto value = valueAs(*decl.init, var.type);
+                    emitImmediate(offsetOp(Op::SetGI, kindOffset(kind(var.type))), value, var.offset);
+                }
+                else
+                {
+                    intoAs(*decl.init, reg(var.offset), var.type);
+                }
+            }
+
+            void visit(FuncDef&) override
+            {
+            }
+
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    statement(*stmt);
+                }
+            }
+
+            void visit(If& ifStmt) override
+            {
+                auto otherwise = label();
+                branch(*ifStmt.expr, false, otherwise);
+                statement(*ifStmt.trueStmt);
+                if (ifStmt.falseStmt)
+                {
+                    auto end = label();
+                    jump(Op::Jump, 0, 0, end);
+                    bind(otherwise);
+                    statement(*ifStmt.falseStmt);
+                    bind(end);
+                }
+                else
+                {
+                    bind(otherwise);
+                }
+            }
+
+            // The condition is tested at the bottom, an iteration costs one branch
+            void visit(While& whileStmt) override
+            {
+                auto condition = label();
+                auto loop = label();
+                jump(Op::Jump, 0, 0, condition);
+                bind(loop);
+                statement(*whileStmt.stmt);
+                bind(condition);
+                branch(*whileStmt.expr, true, loop);
+            }
+
+            void visit(Return& returnStmt) override
+            {
+                auto returns = current ? kind(current->returnType) : Kind::Void;
+                if (returnStmt.expr && returns != Kind::Void)
+                {
+                    emit(offsetOp(Op::RetI, kindOffset(returns)), valueAs(*returnStmt.expr, current->returnType));
+                    return;
+                }
+                if (returnStmt.expr)
+                {
+                    value(*returnStmt.expr);
+                }
+                emit(Op::RetV);
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                value(*exprStmt.expr);
+            }
+
+            void visit(FuncCall& funcCall) override
+            {
+                auto& def = *funcCall.function->def;
+                if (funcCall.args.size() != def.parameters.size())
+                {
+                    throw RuntimeError(std::format("{} expects {} arguments", def.name, def.parameters.size()));
+                }
+
+                // The callee frame starts above every live temporary, arguments are written to their parameter slots
+                auto dst = destination();
+                auto saved = top;
+                auto base = align8(top);
+                reserve(base + def.frameSize);
+                for (std::size_t i = 0; i < funcCall.args.size(); i++)
+                {
+                    auto param = def.parameters[i];
+                    intoAs(*funcCall.args[i], reg(base + param->offset), param->type);
+                }
+                emit(Op::Call, dst, indices.at(&def), reg(base));
+                top = saved;
+                location = dst;
+            }
+
+            void visit(BinExpr& binExpr) override
+            {
+                if (binExpr.op == BinOperator::Assign)
+                {
+                    assign(binExpr);
+                    return;
+                }
+                if (binExpr.op == BinOperator::And || binExpr.op == BinOperator::Or)
+                {
+                    // Written to a temporary, the target may be read by the right side
+                    auto dst = temp();
+                    auto end = label();
+                    intoAs(*binExpr.leftHs, dst, boolType);
+                    jump(binExpr.op == BinOperator::And ? Op::JumpIfNot : Op::JumpIf, dst, 0, end);
+                    intoAs(*binExpr.rightHs, dst, boolType);
+                    bind(end);
+                    result(Kind::Bool, dst);
+                    return;
+                }
+                if (isComparison(binExpr.op))
+                {
+                    auto operand = operandKind(binExpr);
+                    auto [l, r] = operands(binExpr, type(operand));
+                    auto dst = destination();
+                    auto index = comparisonIndex(binExpr.op);
+                    auto op = operand == Kind::Int     ? offsetOp(Op::LtI, index)
+                              : operand == Kind::Float ? offsetOp(Op::LtF, index)
+                                                       : offsetOp(Op::EqB, index - comparisonIndex(BinOperator::Equal));
+                    emit(op, dst, l, r);
+                    location = dst;
+                    return;
+                }
+
+                auto resultKind = kind(binExpr.type);
+                if (resultKind != Kind::Int && resultKind != Kind::Float)
+                {
+                    throw RuntimeError("Arithmetic is only defined on int and float");
+                }
+                auto [l, r] = operands(binExpr, binExpr.type);
+                auto dst = destination();
+                auto first = resultKind == Kind::Int ? Op::AddI : Op::AddF;
+                emit(offsetOp(first, static_cast<int>(binExpr.op) - static_cast<int>(BinOperator::Plus)), dst, l, r);
+                location = dst;
+            }
+
+            void visit(StrLiteral&) override
+            {
+                throw RuntimeError("Strings are not supported by the bytecode");
+            }
+
+            void visit(IntLiteral& lit) override
+            {
+                auto dst = destination();
+                emitImmediate(Op::ConstI, dst, lit.v);
+                location = dst;
+            }
+
+            void visit(FloatLiteral& lit) override
+            {
+                auto dst = destination();
+                emitImmediate(Op::ConstF, dst, static_cast<std::int32_t>(module.floats.size()));
+                module.floats.push_back(lit.v);
+                location = dst;
+            }
+
+            void visit(BooleanLiteral& lit) override
+            {
+                auto dst = destination();
+                emit(Op::ConstB, dst, lit.v);
+                location = dst;
+            }
+
+            void visit(VariableAccess& access) override
+            {
+                auto& var = *access.var;
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    auto dst = destination();
+                    emitImmediate(offsetOp(Op::GetGI, kindOffset(kind(var.type))), dst, var.offset);
+                    location = dst;
+                    return;
+                }
+                result(kind(var.type), reg(var.offset));
+            }
+
+        private:
+            template <typename Body>
+            auto body(BytecodeFunction& function, std::size_t variables, Body lowerBody) -> void
+            {
+                function.entry = static_cast<std::uint32_t>(module.code.size());
+                tempBase = top = frameTop = align8(variables);
+                lowerBody();
+                emit(Op::RetV);
+                resolve();
+                function.end = static_cast<std::uint32_t>(module.code.size());
+                function.frameSize = static_cast<std::uint32_t>(frameTop);
+            }
+
+            auto statement(Visitable& stmt) -> void
+            {
+                auto saved = top;
+                stmt.accept(*this);
+                top = saved;
+            }
+
+            auto kind(const SymbolTable::Type* type) const -> Kind
+            {
+                if (type == nullptr)
+                    return Kind::Void;
+                if (type == intType)
+                    return Kind::Int;
+                if (type == floatType)
+                    return Kind::Float;
+                if (type == boolType)
+                    return Kind::Bool;
+                throw RuntimeError("Unsupported type in the bytecode");
+            }
+
+            auto type(Kind kind) const -> SymbolTable::Type*
+            {
+                return kind == Kind::Int ? intType : kind == Kind::Float ? floatType : boolType;
+            }
+
+            // Mixed int and float compare as float, bool only compares for equality with bool
+            auto operandKind(BinExpr& binExpr) const -> Kind
+            {
+                auto l = kind(binExpr.leftHs->type);
+                auto r = kind(binExpr.rightHs->type);
+                if (l == Kind::Float || r == Kind::Float)
+                    return Kind::Float;
+                if (l == Kind::Bool && r == Kind::Bool &&
+                    (binExpr.op == BinOperator::Equal || binExpr.op == BinOperator::NotEqual))
+                    return Kind::Bool;
+                return Kind::Int;
+            }
+
+            auto reg(std::size_t offset) const -> Reg
+            {
+                if (offset > 0xffff)
+                {
+                    throw RuntimeError("Frame exceeds 64 KiB");
+                }
+                return static_cast<Reg>(offset);
+            }
+
+            auto reserve(std::size_t end) -> void
+            {
+                top = align8(end);
+                frameTop = std::max(frameTop, top);
+                reg(top);
+            }
+
+            auto temp() -> Reg
+            {
+                auto offset = top;
+                reserve(top + 8);
+                return reg(offset);
+            }
+
+            auto destination() -> Reg
+            {
+                return target != noTarget ? static_cast<Reg>(target) : temp();
+            }
+
+            // The value of a variable or an assignment is in src, moved only if a target was requested
+            auto result(Kind kind, Reg src) -> void
+            {
+                if (target != noTarget)
+                {
+                    move(kind, static_cast<Reg>(target), src);
+                    src = static_cast<Reg>(target);
+                }
+                location = src;
+            }
+
+            auto value(Expr& expr) -> Reg
+            {
+                auto saved = target;
+                target = noTarget;
+                expr.accept(*this);
+                target = saved;
+                return location;
+            }
+
+            auto into(Expr& expr, Reg dst) -> void
+            {
+                auto saved = target;
+                target = dst;
+                expr.accept(*this);
+                target = saved;
+            }
+
+            auto valueAs(Expr& expr, SymbolTable::Type* to) -> Reg
+            {
+                auto src = value(expr);
+                if (kind(expr.type) == kind(to))
+                {
+                    return src;
+                }
+                auto dst = temp();
+                convert(dst, src, kind(expr.type), kind(to));
+                return dst;
+            }
+
+            auto intoAs(Expr& expr, Reg dst, SymbolTable::Type* to) -> void
+            {
+                if (kind(expr.type) == kind(to))
+                {
+                    into(expr, dst);
+                    return;
+                }
+                convert(dst, value(expr), kind(expr.type), kind(to));
+            }
+
+            // A variable on the left is copied first if the right side assigns to it
+            auto operands(BinExpr& binExpr, SymbolTable::Type* to) -> std::pair<Reg, Reg>
+            {
+                auto l = valueAs(*binExpr.leftHs, to);
+                if (l < tempBase && hasAssignment(*binExpr.rightHs))
+                {
+                    auto copy = temp();
+                    move(kind(to), copy, l);
+                    l = copy;
+                }
+                auto r = valueAs(*binExpr.rightHs, to);
+                return {l, r};
+            }
+
+            auto assign(BinExpr& binExpr) -> void
+            {
+                auto access = dynamic_cast<VariableAccess*>(binExpr.leftHs.get());
+                if (!access)
+                {
+                    throw RuntimeError("Left side of an assignment has to be a variable");
+                }
+                auto& var = *access->var;
+                if (var.scope == SymbolTable::Scope::Global)
+                {
+                    auto value = valueAs(*binExpr.rightHs, var.type);
+                    emitImmediate(offsetOp(Op::SetGI, kindOffset(kind(var.type))), value, var.offset);
+                    result(kind(var.type), value);
+                    return;
+                }
+                auto dst = reg(var.offset);
+                intoAs(*binExpr.rightHs, dst, var.type);
+                result(kind(var.type), dst);
+            }
+
+            auto move(Kind kind, Reg dst, Reg src) -> void
+            {
+                if (dst != src)
+                {
+                    emit(offsetOp(Op::MovI, kindOffset(kind)), dst, src);
+                }
+            }
+
+            auto convert(Reg dst, Reg src, Kind from, Kind to) -> void
+            {
+                if (from == to)
+                {
+                    move(from, dst, src);
+                    return;
+                }
+                if (from == Kind::Void || to == Kind::Void)
+                {
+                    throw RuntimeError("Expected a value");
+                }
+                auto op = from == Kind::Int     ? (to == Kind::Float ? Op::IToF : Op::IToB)
+                          : from == Kind::Float ? (to == Kind::Int ? Op::FToI : Op::FToB)
+                                                : (to == Kind::Int ? Op::BToI : Op::BToF);
+                emit(op, dst, src);
+            }
+
+            // Jumps to target if cond evaluates to when. And and Or short circuit by branching,
+            // int comparisons fuse with the jump.
+            auto branch(Expr& cond, bool when, std::size_t target) -> void
+            {
+                if (auto bin = dynamic_cast<BinExpr*>(&cond))
+                {
+                    if (bin->op == BinOperator::And || bin->op == BinOperator::Or)
+                    {
+                        // a && b jumps if true only when both are, a || b jumps if false only when both are
+                        auto both = (bin->op == BinOperator::And) == when;
+                        if (both)
+                        {
+                            auto skip = label();
+                            branch(*bin->leftHs, !when, skip);
+                            branch(*bin->rightHs, when, target);
+                            bind(skip);
+                        }
+                        else
+                        {
+                            branch(*bin->leftHs, when, target);
+                            branch(*bin->rightHs, when, target);
+                        }
+                        return;
+                    }
+                    if (isComparison(bin->op) && operandKind(*bin) == Kind::Int)
+                    {
+                        auto [l, r] = operands(*bin, intType);
+                        auto op = when ? bin->op : inverse(bin->op);
+                        jump(offsetOp(Op::JumpLtI, comparisonIndex(op)), l, r, target);
+                        return;
+                    }
+                }
+                auto value = valueAs(cond, boolType);
+                jump(when ? Op::JumpIf : Op::JumpIfNot, value, 0, target);
+            }
+
+            auto emit(Op op, std::uint16_t a = 0, std::uint16_t b = 0, std::uint16_t c = 0) -> std::size_t
+            {
+                module.code.push_back({op, a, b, c});
+                return module.code.size() - 1;
+            }
+
+            auto emitImmediate(Op op, Reg a, std::int64_t immediate) -> void
+            {
+                auto bits = static_cast<std::uint32_t>(immediate);
+                emit(op, a, static_cast<std::uint16_t>(bits), static_cast<std::uint16_t>(bits >> 16));
+            }
+
+            auto label() -> std::size_t
+            {
+                labels.push_back(noTarget);
+                return labels.size() - 1;
+            }
+
+            auto bind(std::size_t label) -> void
+            {
+                labels[label] = module.code.size();
+            }
+
+            auto jump(Op op, Reg a, Reg b, std::size_t label) -> void
+            {
+                fixups.emplace_back(emit(op, a, b), label);
+            }
+
+            auto resolve() -> void
+            {
+                for (auto [at, label] : fixups)
+                {
+                    auto distance = static_cast<std::ptrdiff_t>(labels[label]) - static_cast<std::ptrdiff_t>(at);
+                    if (distance < INT16_MIN || distance > INT16_MAX)
+                    {
+                        throw RuntimeError("Jump exceeds the bytecode range");
+                    }
+                    module.code[at].c = static_cast<std::uint16_t>(static_cast<std::int16_t>(distance));
+                }
+                fixups.clear();
+                labels.clear();
+            }
+
+            Program& program;
+            Module& module;
+            SymbolTable::Type* intType;
+            SymbolTable::Type* floatType;
+            SymbolTable::Type* boolType;
+            std::unordered_map<const FuncDef*, Reg> indices;
+
+            FuncDef* current;
+            std::size_t target;
+            Reg location;
+
+            std::size_t tempBase;
+            std::size_t top;
+            std::size_t frameTop;
+
+            std::vector<std::size_t> labels;
+            std::vector<std::pair<std::size_t, std::size_t>> fixups;
+        };
+
+        auto isJump(Op op) -> bool
+        {
+            return op >= Op::Jump && op <= Op::JumpNeI;
+        }
+    }
+
+    auto opToStr(Op op) -> std::string
+    {
+        switch (op)
+        {
+#define LANGUAGE_OPCODE_NAME(name) \
+    case Op::name:                 \
+        return #name;
+            LANGUAGE_OPCODES(LANGUAGE_OPCODE_NAME)
+#undef LANGUAGE_OPCODE_NAME
+        }
+        throw std::invalid_argument("Missing Op");
+    }
+
+    auto lower(Program& program) -> Module
+    {
+        Module module;
+        module.globalsSize = program.globalsSize;
+        Lowering{program, module}.run();
+        return module;
+    }
+
+    auto disassemble(const Module& module) -> std::string
+    {
+        std::string text;
+        for (const auto& function : module.functions)
+        {
+            text += std::format("{}: frame {}\n", function.name, function.frameSize);
+            for (auto at = function.entry; at < function.end; at++)
+            {
+                auto& instruction = module.code[at];
+                text += std::format("{:6} {:10} {} {}", at, opToStr(instruction.op), instruction.a, instruction.b);
+                if (isJump(instruction.op))
+                {
+                    text += std::format(" -> {}\n", at + instruction.distance());
+                }
+                else
+                {
+                    text += std::format(" {}\n", instruction.c);
+                }
+            }
+        }
+        return text;
+    }
+}
@@ -0,0 +1,366 @@
+#include "Interpreter.hpp"
+#include <cstring>
+#include <format>
+
+namespace language
+{
+    namespace
+    {
+        auto toInt(const Value& value) -> int
+        {
+            if (auto i = std::get_if<int>(&value))
+                return *i;
+            if (auto f = std::get_if<double>(&value))
+                return static_cast<int>(*f);
+            if (auto b = std::get_if<bool>(&value))
+                return *b;
+            throw RuntimeError("Expected a value");
+        }
+
+        auto toFloat(const Value& value) -> double
+        {
+            if (auto f = std::get_if<double>(&value))
+                return *f;
+            return toInt(value);
+        }
+
+        auto toBool(const Value& value) -> bool
+        {
+            if (auto b = std::get_if<bool>(&value))
+                return *b;
+            if (auto f = std::get_if<double>(&value))
+                return *f != 0;
+            return toInt(value) != 0;
+        }
+
+        auto wrap(long long value) -> int
+        {
+            return static_cast<int>(static_cast<unsigned>(value));
+        }
+
+        template <typename T>
+        auto arithmetic(BinOperator op, T l, T r) -> Value
+        {
+            switch (op)
+            {
+            case BinOperator::Plus:
+                return l + r;
+            case BinOperator::Minus:
+                return l - r;
+            case BinOperator::Mul:
+                return l * r;
+            case BinOperator::Div:
+                return l / r;
+            case BinOperator::Less:
+                return l < r;
+            case BinOperator::LessEqual:
+                return l <= r;
+            case BinOperator::Greater:
+                return l > r;
+            case BinOperator::GreaterEqual:
+                return l >= r;
+            case BinOperator::Equal:
+                return l == r;
+            case BinOperator::NotEqual:
+                return l != r;
+            default:
+                throw RuntimeError("Invalid operator");
+            }
+        }
+
+        auto intArithmetic(BinOperator op, int l, int r) -> Value
+        {
+            switch (op)
+            {
+            case BinOperator::Plus:
+                return wrap(static_cast<long long>(l) + r);
+            case BinOperator::Minus:
+                return wrap(static_cast<long long>(l) - r);
+            case BinOperator::Mul:
+                return wrap(static_cast<long long>(l) * r);
+            case BinOperator::Div:
+                if (r == 0)
+                {
+                    throw RuntimeError("Division by zero");
+                }
+                return wrap(static_cast<long long>(l) / r);
+            default:
+                return arithmetic(op, l, r);
+            }
+        }
+    }
+
+    RuntimeError::RuntimeError(const std::string& message) : std::runtime_error(message)
+    {
+    }
+
+    auto valueToStr(const Value& value) -> std::string
+    {
+        if (auto i = std::get_if<int>(&value))
+            return std::to_string(*i);
+        if (auto f = std::get_if<double>(&value))
+            return std::format("{}", *f);
+        if (auto b = std::get_if<bool>(&value))
+            return *b ? "true" : "false";
+        return "void";
+    }
+
+    Interpreter::Interpreter(Program& program, std::size_t stackLimit) : program{program},
+                                                 intType{&std::get<SymbolTable::Type>(program.sym_table->get("int"))},
+                                                 floatType{&std::get<SymbolTable::Type>(program.sym_table->get("float"))},
+                                                 boolType{&std::get<SymbolTable::Type>(program.sym_table->get("bool"))},
+                                                 globals(program.globalsSize), frame{0}, depth{0}, stackBase{0}, stackLimit{stackLimit},
+                                                 returning{false}
+    {
+        stack.reserve(1 << 20);
+    }
+
+    auto Interpreter::run() -> Value
+    {
+        auto& main = program.sym_table->get("main");
+        if (!std::holds_alternative<SymbolTable::Function>(main))
+        {
+            throw RuntimeError("main is not a function");
+        }
+        visit(program);
+        depth = 0;
+        return call(*std::get<SymbolTable::Function>(main).def);
+    }
+
+    auto Interpreter::call(FuncDef& function, std::span<const Value> arguments) -> Value
+    {
+        if (arguments.size() != function.parameters.size())
+        {
+            throw RuntimeError(std::format("{} expects {} arguments", function.name, function.parameters.size()));
+        }
+        // How much native stack a call takes depends on the build, so the limit is in bytes of it
+        std::byte marker{};
+        auto here = reinterpret_cast<std::uintptr_t>(&marker);
+        if (depth == 0)
+        {
+            stackBase = here;
+        }
+        else if ((stackBase > here ? stackBase - here : here - stackBase) > stackLimit)
+        {
+            throw RuntimeError("Stack overflow");
+        }
+
+        auto base = stack.size();
+        auto caller = frame;
+        stack.resize(base + function.frameSize);
+        frame = base;
+        for (std::size_t i = 0; i < arguments.size(); i++)
+        {
+            store(*function.parameters[i], arguments[i]);
+        }
+
+        result = std::monostate{};
+        depth++;
+        function.block->accept(*this);
+        depth--;
+        auto value = returning ? result : Value{};
+        returning = false;
+
+        frame = caller;
+        stack.resize(base);
+        return value;
+    }
+
+    auto Interpreter::evaluate(Expr& expr) -> Value
+    {
+        expr.accept(*this);
+        return result;
+    }
+
+    auto Interpreter::slot(const SymbolTable::Variable& var) -> std::byte*
+    {
+        if (var.offset < 0)
+        {
+            throw RuntimeError(std::format("{} has no storage", var.name));
+        }
+        if (var.scope == SymbolTable::Scope::Global)
+        {
+            return globals.data() + var.offset;
+        }
+        return stack.data() + frame + var.offset;
+    }
+
+    auto Interpreter::load(const SymbolTable::Variable& var) -> Value
+    {
+        auto p = slot(var);
+        if (var.type == intType)
+        {
+            int v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        if (var.type == floatType)
+        {
+            double v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        if (var.type == boolType)
+        {
+            return static_cast<bool>(*p);
+        }
+        throw RuntimeError(std::format("{} has an unsupported type", var.name));
+    }
+
+    auto Interpreter::store(const SymbolTable::Variable& var, const Value& value) -> void
+    {
+        auto p = slot(var);
+        if (var.type == intType)
+        {
+            auto v = toInt(value);
+            std::memcpy(p, &v, sizeof(v));
+        }
+        else if (var.type == floatType)
+        {
+            auto v = toFloat(value);
+            std::memcpy(p, &v, sizeof(v));
+        }
+        else if (var.type == boolType)
+        {
+            *p = static_cast<std::byte>(toBool(value));
+        }
+        else
+        {
+            throw RuntimeError(std::format("{} has an unsupported type", var.name));
+        }
+    }
+
+    void Interpreter::visit(Program& program)
+    {
+        for (auto& decl : program.declarations)
+        {
+            decl->accept(*this);
+        }
+    }
+
+    void Interpreter::visit(VarDecl& decl)
+    {
+        store(*decl.var, evaluate(*decl.init));
+    }
+
+    void Interpreter::visit(FuncDef&)
+    {
+    }
+
+    void Interpreter::visit(Block& block)
+    {
+        for (auto& stmt : block.stmts)
+        {
+            stmt->accept(*this);
+            if (returning)
+            {
+                return;
+            }
+        }
+    }
+
+    void Interpreter::visit(If& ifStmt)
+    {
+        if (toBool(evaluate(*ifStmt.expr)))
+        {
+            ifStmt.trueStmt->accept(*this);
+        }
+        else if (ifStmt.falseStmt)
+        {
+            ifStmt.falseStmt->accept(*this);
+        }
+    }
+
+    void Interpreter::visit(While& whileStmt)
+    {
+        while (!returning && toBool(evaluate(*whileStmt.expr)))
+        {
+            whileStmt.stmt->accept(*this);
+        }
+    }
+
+    void Interpreter::visit(Return& returnStmt)
+    {
+        result = returnStmt.expr ? evaluate(*returnStmt.expr) : Value{};
+        returning = true;
+    }
+
+    void Interpreter::visit(ExprStmt& exprStmt)
+    {
+        evaluate(*exprStmt.expr);
+    }
+
+    void Interpreter::visit(FuncCall& funcCall)
+    {
+        auto first = args.size();
+        for (auto& arg : funcCall.args)
+        {
+            auto value = evaluate(*arg);
+            args.push_back(value);
+        }
+        result = call(*funcCall.function->def, std::span{args}.subspan(first));
+        args.resize(first);
+    }
+
+    void Interpreter::visit(BinExpr& binExpr)
+    {
+        switch (binExpr.op)
+        {
+        case BinOperator::Assign:
+        {
+            auto access = dynamic_cast<VariableAccess*>(binExpr.leftHs.get());
+            if (!access)
+            {
+                throw RuntimeError("Left side of an assignment has to be a variable");
+            }
+            store(*access->var, evaluate(*binExpr.rightHs));
+            result = load(*access->var);
+            return;
+        }
+        case BinOperator::And:
+            result = toBool(evaluate(*binExpr.leftHs)) && toBool(evaluate(*binExpr.rightHs));
+            return;
+        case BinOperator::Or:
+            result = toBool(evaluate(*binExpr.leftHs)) || toBool(evaluate(*binExpr.rightHs));
+            return;
+        default:
+            break;
+        }
+
+        auto l = evaluate(*binExpr.leftHs);
+        auto r = evaluate(*binExpr.rightHs);
+        if (std::holds_alternative<double>(l) || std::holds_alternative<double>(r))
+        {
+            result = arithmetic(binExpr.op, toFloat(l), toFloat(r));
+        }
+        else
+        {
+            result = intArithmetic(binExpr.op, toInt(l), toInt(r));
+        }
+    }
+
+    void Interpreter::visit(StrLiteral&)
+    {
+        throw RuntimeError("Strings are not supported by the interpreter");
+    }
+
+    void Interpreter::visit(IntLiteral& lit)
+    {
+        result = lit.v;
+    }
+
+    void Interpreter::visit(FloatLiteral& lit)
+    {
+        result = lit.v;
+    }
+
+    void Interpreter::visit(BooleanLiteral& lit)
+    {
+        result = lit.v;
+    }
+
+    void Interpreter::visit(VariableAccess& access)
+    {
+        result = load(*access.var);
+    }
+}
@@ -0,0 +1,328 @@
+#include "VirtualMachine.hpp"
+#include <cstring>
+#include <format>
+
+#if defined(__GNUC__) && !defined(LANGUAGE_SWITCH_DISPATCH)
+#define LANGUAGE_COMPUTED_GOTO 1
+#endif
+
+namespace language
+{
+    namespace
+    {
+        template <typename T>
+        auto read(const std::byte* p) -> T
+        {
+            T v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        template <typename T>
+        auto write(std::byte* p, T v) -> void
+        {
+            std::memcpy(p, &v, sizeof(v));
+        }
+
+        // int arithmetic wraps around like in the Interpreter
+        auto wrap(unsigned value) -> int
+        {
+            return static_cast<int>(value);
+        }
+
+        auto divide(int l, int r) -> int
+        {
+            if (r == 0)
+            {
+                throw RuntimeError("Division by zero");
+            }
+            return r == -1 ? wrap(0u - static_cast<unsigned>(l)) : l / r;
+        }
+
+        auto store(std::byte* p, Kind kind, const Value& value) -> void
+        {
+            std::visit([&](auto v)
+                       {
+                           if constexpr (std::is_same_v<decltype(v), std::monostate>)
+                           {
+                               throw RuntimeError("Expected a value");
+                           }
+                           else if (kind == Kind::Int)
+                           {
+                               write(p, static_cast<int>(v));
+                           }
+                           else if (kind == Kind::Float)
+                           {
+                               write(p, static_cast<double>(v));
+                           }
+                           else
+                           {
+                               write(p, static_cast<bool>(v));
+                           } },
+                       value);
+        }
+    }
+
+    VirtualMachine::VirtualMachine(const Module& module, std::size_t stackSize) : module{module},
+                                                                                   globals(module.globalsSize),
+                                                                                   stack(stackSize)
+    {
+    }
+
+    auto VirtualMachine::run() -> Value
+    {
+        if (module.main >= module.functions.size())
+        {
+            throw RuntimeError("main is not a function");
+        }
+        execute(module.functions[module.init], stack.data());
+        return call(module.main);
+    }
+
+    auto VirtualMachine::call(std::size_t function, std::span<const Value> args) -> Value
+    {
+        auto& callee = module.functions.at(function);
+        if (args.size() != callee.parameters.size())
+        {
+            throw RuntimeError(std::format("{} expects {} arguments", callee.name, callee.parameters.size()));
+        }
+        for (std::size_t i = 0; i < args.size(); i++)
+        {
+            store(stack.data() + callee.parameters[i].offset, callee.parameters[i].kind, args[i]);
+        }
+        return execute(callee, stack.data());
+    }
+
+    auto VirtualMachine::execute(const BytecodeFunction& function, std::byte* frame) -> Value
+    {
+        auto code = module.code.data();
+        auto functions = module.functions.data();
+        auto floats = module.floats.data();
+        auto stackEnd = stack.data() + stack.size();
+        auto gp = globals.data();
+        auto fp = frame;
+        auto pc = code + function.entry;
+
+        if (fp + function.frameSize > stackEnd)
+        {
+            throw RuntimeError("Stack overflow");
+        }
+        calls.clear();
+
+#if LANGUAGE_COMPUTED_GOTO
+#define LANGUAGE_OPCODE_LABEL(name) &&op_##name,
+        static const void* const targets[] = {LANGUAGE_OPCODES(LANGUAGE_OPCODE_LABEL)};
+#undef LANGUAGE_OPCODE_LABEL
+#define TARGET(name) op_##name:
+#define DISPATCH() goto* targets[static_cast<std::size_t>(pc->op)]
+        DISPATCH();
+#else
+#define TARGET(name) case Op::name:
+#define DISPATCH() continue
+        for (;;)
+        {
+            switch (pc->op)
+            {
+#endif
+#define NEXT() \
+    pc++;      \
+    DISPATCH()
+#define A (fp + pc->a)
+#define B (fp + pc->b)
+#define C (fp + pc->c)
+#define BINARY(name, T, expr)          \
+    TARGET(name)                       \
+    {                                  \
+        auto l = read<T>(B);           \
+        auto r = read<T>(C);           \
+        write(A, expr);                \
+        NEXT();                        \
+    }
+#define CONVERT(name, From, To)                     \
+    TARGET(name)                                    \
+    {                                               \
+        write(A, static_cast<To>(read<From>(B)));   \
+        NEXT();                                     \
+    }
+#define JUMP(name, condition)          \
+    TARGET(name)                       \
+    {                                  \
+        auto l = read<int>(A);         \
+        auto r = read<int>(B);         \
+        pc += (condition) ? pc->distance() : 1; \
+        DISPATCH();                    \
+    }
+#define RETURN(name, T)                           \
+    TARGET(name)                                  \
+    {                                             \
+        auto v = read<T>(A);                      \
+        if (calls.empty())                        \
+            return v;                             \
+        auto& caller = calls.back();              \
+        fp = caller.frame;                        \
+        pc = caller.pc;                           \
+        write(fp + caller.result, v);             \
+        calls.pop_back();                         \
+        DISPATCH();                               \
+    }
+
+        TARGET(MovI)
+        {
+            std::memcpy(A, B, sizeof(int));
+            NEXT();
+        }
+        TARGET(MovF)
+        {
+            std::memcpy(A, B, sizeof(double));
+            NEXT();
+        }
+        TARGET(MovB)
+        {
+            *A = *B;
+            NEXT();
+        }
+        TARGET(ConstI)
+        {
+            write(A, pc->immediate());
+            NEXT();
+        }
+        TARGET(ConstF)
+        {
+            write(A, floats[pc->immediate()]);
+            NEXT();
+        }
+        TARGET(ConstB)
+        {
+            write(A, pc->b != 0);
+            NEXT();
+        }
+        TARGET(GetGI)
+        {
+            std::memcpy(A, gp + pc->immediate(), sizeof(int));
+            NEXT();
+        }
+        TARGET(GetGF)
+        {
+            std::memcpy(A, gp + pc->immediate(), sizeof(double));
+            NEXT();
+        }
+        TARGET(GetGB)
+        {
+            *A = gp[pc->immediate()];
+            NEXT();
+        }
+        TARGET(SetGI)
+        {
+            std::memcpy(gp + pc->immediate(), A, sizeof(int));
+            NEXT();
+        }
+        TARGET(SetGF)
+        {
+            std::memcpy(gp + pc->immediate(), A, sizeof(double));
+            NEXT();
+        }
+        TARGET(SetGB)
+        {
+            gp[pc->immediate()] = *A;
+            NEXT();
+        }
+        CONVERT(IToF, int, double)
+        CONVERT(FToI, double, int)
+        TARGET(IToB)
+        {
+            write(A, read<int>(B) != 0);
+            NEXT();
+        }
+        TARGET(FToB)
+        {
+            write(A, read<double>(B) != 0);
+            NEXT();
+        }
+        CONVERT(BToI, bool, int)
+        CONVERT(BToF, bool, double)
+        BINARY(AddI, int, wrap(static_cast<unsigned>(l) + static_cast<unsigned>(r)))
+        BINARY(SubI, int, wrap(static_cast<unsigned>(l) - static_cast<unsigned>(r)))
+        BINARY(MulI, int, wrap(static_cast<unsigned>(l) * static_cast<unsigned>(r)))
+        BINARY(DivI, int, divide(l, r))
+        BINARY(AddF, double, l + r)
+        BINARY(SubF, double, l - r)
+        BINARY(MulF, double, l * r)
+        BINARY(DivF, double, l / r)
+        BINARY(LtI, int, l < r)
+        BINARY(LeI, int, l <= r)
+        BINARY(GtI, int, l > r)
+        BINARY(GeI, int, l >= r)
+        BINARY(EqI, int, l == r)
+        BINARY(NeI, int, l != r)
+        BINARY(LtF, double, l < r)
+        BINARY(LeF, double, l <= r)
+        BINARY(GtF, double, l > r)
+        BINARY(GeF, double, l >= r)
+        BINARY(EqF, double, l == r)
+        BINARY(NeF, double, l != r)
+        BINARY(EqB, bool, l == r)
+        BINARY(NeB, bool, l != r)
+        TARGET(Jump)
+        {
+            pc += pc->distance();
+            DISPATCH();
+        }
+        TARGET(JumpIf)
+        {
+            pc += read<bool>(A) ? pc->distance() : 1;
+            DISPATCH();
+        }
+        TARGET(JumpIfNot)
+        {
+            pc += read<bool>(A) ? 1 : pc->distance();
+            DISPATCH();
+        }
+        JUMP(JumpLtI, l < r)
+        JUMP(JumpLeI, l <= r)
+        JUMP(JumpGtI, l > r)
+        JUMP(JumpGeI, l >= r)
+        JUMP(JumpEqI, l == r)
+        JUMP(JumpNeI, l != r)
+        TARGET(Call)
+        {
+            auto& callee = functions[pc->b];
+            auto base = C;
+            if (base + callee.frameSize > stackEnd)
+            {
+                throw RuntimeError("Stack overflow");
+            }
+            calls.push_back({pc + 1, fp, pc->a});
+            fp = base;
+            pc = code + callee.entry;
+            DISPATCH();
+        }
+        RETURN(RetI, int)
+        RETURN(RetF, double)
+        RETURN(RetB, bool)
+        TARGET(RetV)
+        {
+            if (calls.empty())
+                return {};
+            auto& caller = calls.back();
+            fp = caller.frame;
+            pc = caller.pc;
+            calls.pop_back();
+            DISPATCH();
+        }
+
+#if !LANGUAGE_COMPUTED_GOTO
+            }
+        }
+#endif
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+#undef A
+#undef B
+#undef C
+#undef BINARY
+#undef CONVERT
+#undef JUMP
+#undef RETURN
+    }
+}
@@ -0,0 +1,145 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "Interpreter/VirtualMachine.hpp"
+#include <string>
+
+static auto run(const std::string& source) -> language::Value
+{
+    language::Parser p{source};
+    auto program = p.program();
+    language::Interpreter interpreter{program};
+    return interpreter.run();
+}
+
+static auto runBytecode(const std::string& source) -> language::Value
+{
+    language::Parser p{source};
+    auto program = p.program();
+    auto module = language::lower(program);
+    language::VirtualMachine vm{module};
+    return vm.run();
+}
+
+TEST_CASE("Recursion", "[function]")
+{
+    std::string source = R"(
+        fib(n: int): int {
+            if (n < 2) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        main(): int {
+            return fib(20);
+        }
+    )";
+
+    REQUIRE(std::get<int>(run(source)) == 6765);
+}
+
+TEST_CASE("Deep Recursion", "[function]")
+{
+    std::string source = R"(
+        depth(n: int): int {
+            if (n == 0) return 0;
+            return depth(n - 1) + 1;
+        }
+        main(): int {
+            return depth(1000000);
+        }
+    )";
+
+    // Both engines report the overflow instead of running out of native stack
+    REQUIRE_THROWS_WITH(run(source), "Stack overflow");
+    REQUIRE_THROWS_WITH(runBytecode(source), "Stack overflow");
+    REQUIRE(std::get<int>(run("depth(n: int): int { if (n == 0) return 0; return depth(n - 1) + 1; }\n"
+                              "main(): int { return depth(1000); }")) == 1000);
+}
+
+TEST_CASE("Loops and Globals", "[statement]")
+{
+    std::string source = R"(
+        var total = 0;
+        var scale = 0.5;
+        add(a: int, b: int): int { return a + b; }
+        main(): float {
+            for (var i = 0; i < 10; i = i + 1) {
+                if (i == 3 || i == 5) total = add(total, 100);
+                else total = add(total, i);
+            }
+            var k = 0;
+            while (k < 4 && true) k = k + 1;
+            return (total + k) * scale;
+        }
+    )";
+
+    // 0+1+2+4+6+7+8+9 + 200 + 4
+    REQUIRE(std::get<double>(run(source)) == 120.5);
+}
+
+TEST_CASE("Bytecode", "[bytecode]")
+{
+    auto source = GENERATE(as<std::string>{},
+        R"(
+            fib(n: int): int {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            main(): int { return fib(15); }
+        )",
+        R"(
+            var total = 0;
+            var scale = 0.5;
+            add(a: int, b: int): int { return a + b; }
+            main(): float {
+                for (var i = 0; i < 10; i = i + 1) {
+                    if (i == 3 || i == 5) total = add(total, 100);
+                    else total = add(total, i);
+                }
+                var k = 0;
+                while (k < 4 && true) k = k + 1;
+                return (total + k) * scale;
+            }
+        )",
+        R"(
+            half(x: float): float { return x / 2; }
+            add(a: int, b: int): int { return a + b; }
+            main(): float {
+                var big = 2147483647;
+                var n = add(add(1, 2), add(3, big));
+                var f = half(7) + 1;
+                return n / (0 - 7) + f;
+            }
+        )",
+        R"(
+            var flag = false;
+            main(): bool {
+                var a = 3;
+                var b = a + (a = 10);
+                flag = b == 13 && a == 10 || false;
+                return flag == (1.5 < a);
+            }
+        )");
+
+    auto expected = run(source);
+    auto actual = runBytecode(source);
+    REQUIRE(language::valueToStr(actual) == language::valueToStr(expected));
+    REQUIRE(actual.index() == expected.index());
+}
+
+TEST_CASE("Fused Loop Condition", "[bytecode]")
+{
+    language::Parser p{R"(
+        main(): int {
+            var sum = 0;
+            for (var i = 0; i < 100; i = i + 1) sum = sum + i;
+            return sum;
+        }
+    )"};
+    auto program = p.program();
+    auto module = language::lower(program);
+
+    // The for loop tests its condition with a single compare and jump at the bottom
+    REQUIRE(language::disassemble(module).find("JumpLtI") != std::string::npos);
+    REQUIRE(std::get<int>(language::VirtualMachine{module}.run()) == 4950);
+}
@@ -0,0 +1,124 @@
+#include "Lexer/Lexer.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+namespace lang = language;
+
+// Synthetic program that looks like generated code: indented, long names, many literals
+static auto makeSource(std::size_t bytes) -> std::string
+{
+    std::string source;
+    source.reserve(bytes + 256);
+    for (int i = 0; source.size() < bytes; i++)
+    {
+        source += "var generated_variable_name_" + std::string(i % 7 + 1, 'x') + " = " + std::to_string(i * 7919) + ";\n";
+        source += "function_" + std::string(i % 3 + 1, 'f') + "(parameter_a: int, parameter_b: float) {\n";
+        source += "                if (parameter_a <= 1234567) return parameter_b * 3.14159265;\n";
+        source += "                while (parameter_a != 0) { parameter_a = parameter_a - 1; }\n";
+        source += "}\n";
+    }
+    return source;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+    auto source = makeSource(megabytes << 20);
+
+    using lang::scan::Kernel;
+    for (auto kernel : {Kernel::Scalar, Kernel::SSE2, Kernel::AVX2})
+    {
+        if (!lang::scan::supported(kernel))
+        {
+            std::cout << lang::scan::kernelToStr(kernel) << ": not supported\n";
+            continue;
+        }
+
+        double best = 0;
+        std::size_t tokens = 0;
+        for (int run = 0; run < 5; run++)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            lang::Lexer lexer{source, kernel};
+            tokens = 0;
+            while (lexer.next().type != lang::TokenType::Eof)
+            {
+                tokens++;
+            }
+            std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+            best = std::max(best, source.size() / seconds.count() / (1 << 20));
+        }
+        std::cout << lang::scan::kernelToStr(kernel) << ": " << best << " MB/s (" << tokens << " tokens)\n";
+    }
+
+    std::cout << "default: " << lang::scan::kernelToStr(lang::scan::best()) << ", line index "
+              << lang::scan::kernelToStr(lang::scan::bestLines()) << "\n";
+
+    // Locating a position builds the line index once, every further position is a binary search
+    for (auto kernel : {Kernel::Scalar, Kernel::SSE2, Kernel::AVX2})
+    {
+        if (!lang::scan::supported(kernel))
+        {
+            continue;
+        }
+
+        double best = 0;
+        std::size_t lines = 0;
+        for (int run = 0; run < 5; run++)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            lang::LineIndex index{source, kernel};
+            lines = index.lines();
+            std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+            best = std::max(best, source.size() / seconds.count() / (1 << 20));
+        }
+        std::cout << lang::scan::kernelToStr(kernel) << " line index: " << best << " MB/s (" << lines << " lines)\n";
+    }
+
+    lang::LineIndex index{source};
+    index.lines();
+    auto begin = std::chrono::steady_clock::now();
+    std::uint64_t sum = 0;
+    constexpr std::uint32_t lookups = 1'000'000;
+    for (std::uint32_t i = 0; i < lookups; i++)
+    {
+        sum += index.locate(static_cast<std::uint32_t>(i * 7919ull % source.size())).line;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << "locate: " << elapsed.count() / lookups << " ns (" << sum % 10 << ")\n";
+
+    // Fuzzer like input, an invalid character in every line
+    auto invalid = source.substr(0, std::min<std::size_t>(source.size(), 4 << 20));
+    for (std::size_t i = 0; i < invalid.size(); i += 61)
+    {
+        invalid[i] = '$';
+    }
+    std::size_t errors = 0;
+    begin = std::chrono::steady_clock::now();
+    lang::Lexer throwing{invalid};
+    for (;;)
+    {
+        try
+        {
+            if (throwing.next().type == lang::TokenType::Eof)
+            {
+                break;
+            }
+        }
+        catch (lang::InvalidToken&)
+        {
+            errors++;
+        }
+    }
+    std::chrono::duration<double, std::milli> exceptions = std::chrono::steady_clock::now() - begin;
+    begin = std::chrono::steady_clock::now();
+    lang::Lexer values{invalid};
+    for (auto token = values.tryNext(); !token || token->type != lang::TokenType::Eof; token = values.tryNext())
+    {
+    }
+    std::chrono::duration<double, std::milli> expected = std::chrono::steady_clock::now() - begin;
+    std::cout << "invalid characters: " << exceptions.count() << " ms with exceptions, " << expected.count()
+              << " ms with expected (" << errors << " errors)\n";
+}
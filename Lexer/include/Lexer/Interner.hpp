@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace language
+{
+    using Symbol = std::uint32_t;
+    constexpr Symbol noSymbol = std::numeric_limits<Symbol>::max();
+
+    /*
+        Maps every distinct identifier of a compilation to a dense id. Each name is stored once and
+        the views handed out by name() stay valid as long as the interner lives.
+    */
+    class Interner
+    {
+    public:
+        auto intern(std::string_view name) -> Symbol;
+        auto find(std::string_view name) const -> Symbol; // noSymbol if the name was never interned
+        auto name(Symbol symbol) const -> std::string_view;
+        auto size() const -> std::size_t;
+
+    private:
+        std::deque<std::string> storage;
+        std::vector<std::string_view> names;
+        std::unordered_map<std::string_view, Symbol> symbols;
+    };
+}
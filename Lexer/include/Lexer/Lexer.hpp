@@ -1,10 +1,22 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
 #include <stdexcept>
-#include <unordered_map>
+#include <memory>
+#include <expected>
+#include "Scan.hpp"
+#include "Interner.hpp"
+#include "LineIndex.hpp"
 
 namespace language
 {
+    namespace scan
+    {
+        struct Functions;
+    }
+
     enum class TokenType
     {
         //Single Character Tokens
@@ -56,36 +68,64 @@ namespace language
 
     std::string tokenTypeToStr(TokenType type);
 
+    /*
+        Thrown for a character no token starts with. The lexer is left behind that character,
+        so lexing can go on with the rest of the buffer.
+    */
     class InvalidToken : public std::runtime_error
     {
     public:
-        InvalidToken(const std::string& chars, int line, int column);
+        InvalidToken(std::string_view program, std::uint32_t offset, Location at);
+        static auto message(std::string_view program, std::uint32_t offset) -> std::string; // without the position
+        std::uint32_t offset; // of the character in the lexer buffer
+        Location at;
     };
 
+    // A character no token starts with, the lexer goes on behind it
+    struct LexError
+    {
+        std::uint32_t offset; // of the character in the lexer buffer
+    };
+
+    // Offsets are 32-bit, the lexer rejects larger buffers instead of letting positions wrap
+    constexpr std::size_t maxSourceSize = std::numeric_limits<std::uint32_t>::max();
+
+    /*
+        The lexem is a view into the source buffer the lexer was created with,
+        offset is the byte position of the lexem in that buffer.
+        Identifiers carry their interned symbol if the lexer was given an interner.
+    */
     struct Token
     {
-        Token(TokenType type, const std::string& lexem = "");
+        Token(TokenType type, std::string_view lexem = "", std::uint32_t offset = 0, Symbol symbol = noSymbol);
         TokenType type;
-        std::string lexem;
+        std::string_view lexem;
+        std::uint32_t offset;
+        Symbol symbol;
     };
 
+    /*
+        The lexer borrows the source buffer, it has to outlive the lexer and every token handed out.
+        Invalid characters are located with lines, an index of the same buffer shared with the owner
+        of the lexer, or with an index of its own built on the first invalid character next throws for.
+    */
     class Lexer
     {
     public:
-        Lexer(const std::string& program);
-        Token next();
+        Lexer(std::string_view program, scan::Kernel kernel = scan::best());
+        Lexer(std::string_view program, Interner* interner, scan::Kernel kernel = scan::best());
+        Lexer(std::string_view program, Interner* interner, LineIndex* lines, scan::Kernel kernel = scan::best());
+        Token next(); // throws InvalidToken
+        std::expected<Token, LexError> tryNext(); // never throws on invalid input
     private:
-        std::string program;
-        std::string::iterator pos;
-        std::unordered_map<std::string_view, TokenType> keywords{
-            {"while", TokenType::While},
-            {"else", TokenType::Else},
-            {"for", TokenType::For},
-            {"if", TokenType::If},
-            {"true", TokenType::BooleanLiteral},
-            {"false", TokenType::BooleanLiteral},
-            {"var", TokenType::Var},
-            {"return", TokenType::Return}
-        };
+        Token token(TokenType type, const char* start) const;
+        std::expected<Token, LexError> invalid(const char* start);
+
+        std::string_view program;
+        const char* pos;
+        const scan::Functions* scanner;
+        Interner* interner;
+        LineIndex* lines;
+        std::shared_ptr<LineIndex> ownedLines; // copies made to lex ahead share it
     };
 }
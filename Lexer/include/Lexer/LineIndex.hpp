@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Scan.hpp"
+
+namespace language
+{
+    // Line and column count from 1, the column in bytes
+    struct Location
+    {
+        std::uint32_t line;
+        std::uint32_t column;
+    };
+
+    /*
+        Turns byte offsets into a source into lines and columns. The start of every line is found with one
+        vectorized scan for newlines the first time a location is asked for, each location is a binary
+        search in there. Like the lexer, the index only borrows the source.
+    */
+    class LineIndex
+    {
+    public:
+        LineIndex(std::string_view source, scan::Kernel kernel = scan::bestLines());
+
+        auto locate(std::uint32_t offset) -> Location; // offset up to the size of the source
+        auto lines() -> std::size_t;
+
+    private:
+        auto build() -> void;
+
+        std::string_view source;
+        scan::Kernel kernel;
+        std::vector<std::uint32_t> starts; // offsets of the lines, empty until the first lookup
+    };
+}
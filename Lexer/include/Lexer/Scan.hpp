@@ -0,0 +1,27 @@
+#pragma once
+#include <string_view>
+
+namespace language::scan
+{
+    /*
+        Implementations of the lexer's inner scanning loops (whitespace, identifiers, digits).
+        All kernels classify characters exactly like the scalar one, they only differ in how many
+        bytes they look at per step.
+    */
+    enum class Kernel
+    {
+        Scalar,
+        SSE2,   // 16 bytes per step
+        AVX2,   // 32 bytes per step
+    };
+
+    auto supported(Kernel kernel) -> bool;
+
+    // The fastest kernel for lexing the running CPU supports. Tokens of source code are short, the
+    // 32 byte loads of AVX2 cost more than they skip, so it is SSE2 even where AVX2 is supported.
+    auto best() -> Kernel;
+    // The fastest kernel for finding line starts, lines are long enough for the widest one to win
+    auto bestLines() -> Kernel;
+
+    auto kernelToStr(Kernel kernel) -> std::string_view;
+}
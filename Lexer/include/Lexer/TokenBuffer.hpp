@@ -0,0 +1,36 @@
+#pragma once
+#include "Lexer.hpp"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace language
+{
+    /*
+        A whole program tokenized up front, stored as parallel arrays (type, offset, length).
+        The last token is always Eof. Like the lexer, the buffer only borrows the source.
+        Tokenizing into a cleared buffer reuses its capacity.
+    */
+    class TokenBuffer
+    {
+    public:
+        TokenBuffer() = default;
+        TokenBuffer(std::string_view program, scan::Kernel kernel = scan::best());
+
+        auto tokenize(std::string_view program, scan::Kernel kernel = scan::best()) -> void;
+        auto clear() -> void;
+
+        auto size() const -> std::size_t;
+        auto type(std::size_t index) const -> TokenType;
+        auto offset(std::size_t index) const -> std::uint32_t;
+        auto lexem(std::size_t index) const -> std::string_view;
+        auto operator[](std::size_t index) const -> Token;
+        auto source() const -> std::string_view;
+
+    private:
+        std::string_view program;
+        std::vector<std::uint8_t> types;
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> lengths;
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Lexer.hpp"
+#include "Scan.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace language::scan
+{
+    enum CharClass : std::uint8_t
+    {
+        Space = 1 << 0,     // ' ', \t, \n, \v, \f, \r like std::isspace in the "C" locale
+        IdChar = 1 << 1,    // a-z, A-Z, _
+        Digit = 1 << 2,     // 0-9
+        Single = 1 << 3,    // characters that always form a token on their own
+    };
+
+    constexpr auto charClasses = []
+    {
+        std::array<std::uint8_t, 256> table{};
+        for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+            table[c] |= Space;
+        for (int c = 'a'; c <= 'z'; c++)
+            table[c] |= IdChar;
+        for (int c = 'A'; c <= 'Z'; c++)
+            table[c] |= IdChar;
+        table['_'] |= IdChar;
+        for (int c = '0'; c <= '9'; c++)
+            table[c] |= Digit;
+        for (unsigned char c : {'+', '-', '/', '*', '(', ')', '{', '}', '[', ']', ',', ';', '.', ':'})
+            table[c] |= Single;
+        return table;
+    }();
+
+    constexpr auto singleTokens = []
+    {
+        std::array<TokenType, 256> table{};
+        table['+'] = TokenType::Plus;
+        table['-'] = TokenType::Minus;
+        table['/'] = TokenType::Slash;
+        table['*'] = TokenType::Star;
+        table['('] = TokenType::OpenParenthesis;
+        table[')'] = TokenType::CloseParenthesis;
+        table['{'] = TokenType::OpenCurlyBracket;
+        table['}'] = TokenType::CloseCurlyBracket;
+        table['['] = TokenType::OpenSquareBracket;
+        table[']'] = TokenType::CloseSquareBracket;
+        table[','] = TokenType::Comma;
+        table[';'] = TokenType::Semicolon;
+        table['.'] = TokenType::Dot;
+        table[':'] = TokenType::Colon;
+        return table;
+    }();
+
+    constexpr auto is(char c, CharClass cls) -> bool
+    {
+        return charClasses[static_cast<unsigned char>(c)] & cls;
+    }
+
+    /*
+        Each function returns the first position in [pos, end) that is not of the scanned class.
+        lineStarts appends the offset from begin of every position right after a \n in [begin, end).
+    */
+    struct Functions
+    {
+        const char* (*whitespace)(const char* pos, const char* end);
+        const char* (*identifier)(const char* pos, const char* end);
+        const char* (*digits)(const char* pos, const char* end);
+        void (*lineStarts)(const char* begin, const char* end, std::vector<std::uint32_t>& starts);
+    };
+
+    auto functions(Kernel kernel) -> const Functions&;
+}
@@ -0,0 +1,33 @@
+#include "Interner.hpp"
+
+namespace language
+{
+    auto Interner::intern(std::string_view name) -> Symbol
+    {
+        if (auto it = symbols.find(name); it != symbols.end())
+        {
+            return it->second;
+        }
+        auto symbol = static_cast<Symbol>(names.size());
+        const auto& stored = storage.emplace_back(name);
+        names.push_back(stored);
+        symbols.emplace(stored, symbol);
+        return symbol;
+    }
+
+    auto Interner::find(std::string_view name) const -> Symbol
+    {
+        auto it = symbols.find(name);
+        return it == symbols.end() ? noSymbol : it->second;
+    }
+
+    auto Interner::name(Symbol symbol) const -> std::string_view
+    {
+        return names[symbol];
+    }
+
+    auto Interner::size() const -> std::size_t
+    {
+        return names.size();
+    }
+}
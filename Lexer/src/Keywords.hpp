@@ -0,0 +1,83 @@
+#pragma once
+#include "Lexer.hpp"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+namespace language::keywords
+{
+    struct Keyword
+    {
+        std::string_view text;
+        TokenType type;
+    };
+
+    // The only place keywords are listed, the hash table below is derived from it at compile time
+    constexpr std::array list{
+        Keyword{"while", TokenType::While},
+        Keyword{"else", TokenType::Else},
+        Keyword{"for", TokenType::For},
+        Keyword{"if", TokenType::If},
+        Keyword{"true", TokenType::BooleanLiteral},
+        Keyword{"false", TokenType::BooleanLiteral},
+        Keyword{"var", TokenType::Var},
+        Keyword{"return", TokenType::Return},
+    };
+
+    constexpr std::size_t tableSize = std::bit_ceil(list.size() * 2);
+    constexpr int tableBits = std::countr_zero(tableSize);
+
+    // Multiplicative hash over the first and last character and the length
+    constexpr auto hash(std::string_view word, std::uint32_t seed) -> std::uint32_t
+    {
+        std::uint32_t key = static_cast<unsigned char>(word.front()) << 16 |
+                            static_cast<unsigned char>(word.back()) << 8 |
+                            static_cast<std::uint32_t>(word.size() & 0xFF);
+        return (key * seed) >> (32 - tableBits);
+    }
+
+    // Smallest odd seed for which no two keywords share a slot
+    constexpr std::uint32_t seed = []
+    {
+        for (std::uint32_t candidate = 1; candidate < (1u << 24); candidate += 2)
+        {
+            std::array<bool, tableSize> used{};
+            bool perfect = true;
+            for (const auto& keyword : list)
+            {
+                auto slot = hash(keyword.text, candidate);
+                perfect = perfect && !used[slot];
+                used[slot] = true;
+            }
+            if (perfect)
+            {
+                return candidate;
+            }
+        }
+        return 0u;
+    }();
+    static_assert(seed != 0, "No perfect hash seed for the keyword list");
+
+    constexpr auto table = []
+    {
+        std::array<Keyword, tableSize> slots{};
+        for (const auto& keyword : list)
+        {
+            slots[hash(keyword.text, seed)] = keyword;
+        }
+        return slots;
+    }();
+
+    // TokenType of an identifier shaped word, Id if it is not a keyword
+    constexpr auto classify(std::string_view word) -> TokenType
+    {
+        const auto& slot = table[hash(word, seed)];
+        return slot.text == word ? slot.type : TokenType::Id;
+    }
+
+    static_assert(classify("return") == TokenType::Return);
+    static_assert(classify("false") == TokenType::BooleanLiteral);
+    static_assert(classify("returns") == TokenType::Id);
+    static_assert(classify("v") == TokenType::Id);
+}
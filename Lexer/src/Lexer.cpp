@@ -1,193 +1,164 @@
 #include "Lexer.hpp"
+#include "CharClass.hpp"
+#include "Keywords.hpp"
 #include <algorithm>
 #include <format>
 
 namespace language
 {
-    Lexer::Lexer(const std::string &program) : program{program}, pos{this->program.begin()}
+    Lexer::Lexer(std::string_view program, scan::Kernel kernel) : Lexer{program, nullptr, kernel}
     {
     }
 
-    class UnexpectedCharacter
+    Lexer::Lexer(std::string_view program, Interner* interner, scan::Kernel kernel) : Lexer{program, interner, nullptr, kernel}
     {
-    };
+    }
+
+    Lexer::Lexer(std::string_view program, Interner* interner, LineIndex* lines, scan::Kernel kernel) :
+        program{program}, pos{this->program.data()}, scanner{&scan::functions(kernel)}, interner{interner}, lines{lines}
+    {
+        if (program.size() > maxSourceSize)
+        {
+            throw std::runtime_error(std::format("Source of {} bytes is too large, at most {} bytes are supported", program.size(), maxSourceSize));
+        }
+    }
 
-    Token::Token(TokenType type, const std::string& lexem):
-        type{type},lexem{lexem}
+    Token::Token(TokenType type, std::string_view lexem, std::uint32_t offset, Symbol symbol):
+        type{type},lexem{lexem},offset{offset},symbol{symbol}
         {}
 
-    InvalidToken::InvalidToken(const std::string& chars, int line, int column):
-        std::runtime_error(std::format("Invalid Token {}... ({},{})", chars, line, column))
+    Token Lexer::token(TokenType type, const char* start) const
+    {
+        return {type, std::string_view{start, pos}, static_cast<std::uint32_t>(start - program.data())};
+    }
+
+    InvalidToken::InvalidToken(std::string_view program, std::uint32_t offset, Location at):
+        std::runtime_error(message(program, offset)), offset{offset}, at{at}
     {}
 
+    auto InvalidToken::message(std::string_view program, std::uint32_t offset) -> std::string
+    {
+        // Up to ten characters of the rest of the line
+        auto shown = program.substr(offset, 10);
+        shown = shown.substr(0, shown.find('\n'));
+        return std::format("Invalid Token {}...", shown);
+    }
+
     Token Lexer::next()
     {
-        pos = std::find_if_not(pos, program.end(), [](auto e){ return std::isspace(e);});
-        if (pos == program.end())
-            return {TokenType::Eof, "$"};
+        auto token = tryNext();
+        if (!token)
+        {
+            if (!lines)
+            {
+                ownedLines = std::make_shared<LineIndex>(program);
+                lines = ownedLines.get();
+            }
+            auto offset = token.error().offset;
+            throw InvalidToken{program, offset, lines->locate(offset)};
+        }
+        return *token;
+    }
+
+    std::expected<Token, LexError> Lexer::invalid(const char* start)
+    {
+        // Lexing can go on behind the character
+        pos = start + 1;
+        return std::unexpected(LexError{static_cast<std::uint32_t>(start - program.data())});
+    }
+
+    std::expected<Token, LexError> Lexer::tryNext()
+    {
+        auto end = program.data() + program.size();
+        pos = scanner->whitespace(pos, end);
+        if (pos == end)
+            return Token{TokenType::Eof, "$", static_cast<std::uint32_t>(program.size())};
         auto start = pos;
-        try
+        auto c = *pos;
+        if (scan::is(c, scan::Single))
+        {
+            pos++;
+            return token(scan::singleTokens[static_cast<unsigned char>(c)], start);
+        }
+        if (scan::is(c, scan::IdChar))
         {
-            switch (auto c = *pos)
+            pos = scanner->identifier(pos, end);
+            auto word = std::string_view{start, pos};
+            auto type = keywords::classify(word);
+            auto t = token(type, start);
+            if (type == TokenType::Id && interner)
             {
-            case '+':
-                pos++;
-                return {TokenType::Plus};
-            case '-':
-                pos++;
-                return {TokenType::Minus};
-            case '/':
-                pos++;
-                return {TokenType::Slash};
-            case '*':
-                pos++;
-                return {TokenType::Star};
-            case '(':
-                pos++;
-                return {TokenType::OpenParenthesis};
-            case ')':
-                pos++;
-                return {TokenType::CloseParenthesis};
-            case '{':
-                pos++;
-                return {TokenType::OpenCurlyBracket};
-            case '}':
-                pos++;
-                return {TokenType::CloseCurlyBracket};
-            case '[':
-                pos++;
-                return {TokenType::OpenSquareBracket};
-            case ']':
-                pos++;
-                return {TokenType::CloseSquareBracket};
-            case ',':
-                pos++;
-                return {TokenType::Comma};
-            case ';':
-                pos++;
-                return {TokenType::Semicolon};
-            case '.':
-                pos++;
-                return {TokenType::Dot};
-            case ':':
-                pos++;
-                return {TokenType::Colon};
-            case '=':
-                pos++;
-                if (pos != program.cend() && *pos == '=')
-                {
-                    pos++;
-                    return {TokenType::DoubleEqual};
-                }
-                return {TokenType::Equal};
-            case '!':
-                pos++;
-                if (pos != program.cend() && *pos == '=')
-                {
-                    pos++;
-                    return {TokenType::ExclamationMarkEqual};
-                }
-                return {TokenType::ExclamationMark};
+                t.symbol = interner->intern(word);
+            }
+            return t;
+        }
+        if (scan::is(c, scan::Digit))
+        {
+            pos = scanner->digits(pos, end);
+            if(pos != end && *pos == '.')
+            {
+                pos = scanner->digits(pos + 1, end);
+                return token(TokenType::FloatingPointLiteral, start);
+            }
+            return token(TokenType::IntegerLiteral, start);
+        }
 
-            case '&':
-                pos++;
-                if (pos != program.cend() && *pos == '&')
-                {
-                    pos++;
-                    return {TokenType::ExclamationMarkEqual};
-                }
-                else
-                {
-                    pos--;
-                    throw UnexpectedCharacter{};
-                }
-            case '|':
+        switch (c)
+        {
+        case '=':
+            pos++;
+            if (pos != end && *pos == '=')
+            {
                 pos++;
-                if (pos != program.cend() && *pos == '|')
-                {
-                    pos++;
-                    return {TokenType::DoublePipe};
-                }
-                else
-                {
-                    pos--;
-                    throw UnexpectedCharacter{};
-                }
-            case '<':
+                return token(TokenType::DoubleEqual, start);
+            }
+            return token(TokenType::Equal, start);
+        case '!':
+            pos++;
+            if (pos != end && *pos == '=')
+            {
                 pos++;
-                if (pos != program.cend() && *pos == '=')
-                {
-                    pos++;
-                    return {TokenType::LessEqual};
-                }
-                return {TokenType::Less};
+                return token(TokenType::ExclamationMarkEqual, start);
+            }
+            return token(TokenType::ExclamationMark, start);
 
-            case '>':
+        case '&':
+            pos++;
+            if (pos != end && *pos == '&')
+            {
                 pos++;
-                if (pos != program.cend() && *pos == '=')
-                {
-                    pos++;
-                    return {TokenType::GreaterEqual};
-                }
-                return {TokenType::Greater};
-
-            default:
-                {
-                    if (std::isalpha(c) || c == '_')
-                    {
-                        while (std::isalpha(*pos) || *pos == '_')
-                        {
-                            pos++;
-                        }
-                        std::string lexem{start, pos};
-                        if (keywords.contains(lexem))
-                        {
-                            return {keywords[lexem], lexem};
-                        }
-                        return {TokenType::Id, lexem};
-                    }
-                    else if (std::isdigit(c))
-                    {
-                        while(std::isdigit(*pos))
-                        {
-                            pos++;
-                        }
-                        if(*pos == '.')
-                        {
-                            pos++;
-                            while(std::isdigit(*pos))
-                            {
-                                pos++;
-                            }
-                            return {TokenType::FloatingPointLiteral, std::string{start,pos}};
-                        }
-                        return {TokenType::IntegerLiteral, std::string{start,pos}};
-                    }
-                    else
-                    {
-                        throw UnexpectedCharacter{};
-                    }
-                }
+                return token(TokenType::DoubleAmpersand, start);
             }
-        }
-        catch (UnexpectedCharacter)
-        {
-            int line = 1;
-            auto iter = start;
-            while(iter != program.cbegin() && *iter != '\n')
+            return invalid(start);
+        case '|':
+            pos++;
+            if (pos != end && *pos == '|')
             {
-                iter--;
+                pos++;
+                return token(TokenType::DoublePipe, start);
+            }
+            return invalid(start);
+        case '<':
+            pos++;
+            if (pos != end && *pos == '=')
+            {
+                pos++;
+                return token(TokenType::LessEqual, start);
             }
-            int column = static_cast<int>(start - iter);
-            while(iter != program.cbegin())
+            return token(TokenType::Less, start);
+
+        case '>':
+            pos++;
+            if (pos != end && *pos == '=')
             {
-                if(*iter == '\n')
-                    line++;
-                iter--;
+                pos++;
+                return token(TokenType::GreaterEqual, start);
             }
-            throw InvalidToken{std::string{start,std::min(start + 10, program.end())}, line,column};
+            return token(TokenType::Greater, start);
+
+        default:
+            return invalid(start);
         }
-        return {TokenType::BooleanLiteral};
     }
 
     std::string tokenTypeToStr(TokenType type)
@@ -216,6 +187,8 @@ namespace language
             return "CloseSquareBracket";
         case TokenType::Comma:
             return "Comma";
+        case TokenType::Colon:
+            return "Colon";
         case TokenType::Semicolon:
             return "Semicolon";
         case TokenType::Dot:
@@ -248,6 +221,8 @@ namespace language
             return "For";
         case TokenType::Else:
             return "Else";
+        case TokenType::Return:
+            return "Return";
         case TokenType::Id:
             return "Id";
         case TokenType::IntegerLiteral:
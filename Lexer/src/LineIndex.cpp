@@ -0,0 +1,37 @@
+#include "LineIndex.hpp"
+#include "CharClass.hpp"
+#include <algorithm>
+
+namespace language
+{
+    LineIndex::LineIndex(std::string_view source, scan::Kernel kernel) : source{source}, kernel{kernel}
+    {
+    }
+
+    auto LineIndex::build() -> void
+    {
+        // Generated sources have lines of a few dozen bytes
+        starts.reserve(source.size() / 32 + 1);
+        starts.push_back(0);
+        scan::functions(kernel).lineStarts(source.data(), source.data() + source.size(), starts);
+    }
+
+    auto LineIndex::locate(std::uint32_t offset) -> Location
+    {
+        if (starts.empty())
+        {
+            build();
+        }
+        auto line = std::ranges::upper_bound(starts, offset) - starts.begin();
+        return {static_cast<std::uint32_t>(line), offset - starts[line - 1] + 1};
+    }
+
+    auto LineIndex::lines() -> std::size_t
+    {
+        if (starts.empty())
+        {
+            build();
+        }
+        return starts.size();
+    }
+}
@@ -0,0 +1,263 @@
+#include "CharClass.hpp"
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LANGUAGE_SCAN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define LANGUAGE_TARGET_AVX2
+#else
+#define LANGUAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace language::scan
+{
+    namespace
+    {
+        template <CharClass cls>
+        auto scalar(const char* pos, const char* end) -> const char*
+        {
+            while (pos != end && is(*pos, cls))
+            {
+                pos++;
+            }
+            return pos;
+        }
+
+        auto scalarLines(const char* begin, const char* pos, const char* end, std::vector<std::uint32_t>& starts) -> void
+        {
+            for (; pos != end; pos++)
+            {
+                if (*pos == '\n')
+                {
+                    starts.push_back(static_cast<std::uint32_t>(pos - begin + 1));
+                }
+            }
+        }
+
+        auto scalarLineStarts(const char* begin, const char* end, std::vector<std::uint32_t>& starts) -> void
+        {
+            scalarLines(begin, begin, end, starts);
+        }
+
+        // One start for every set bit of a block's newline mask
+        inline auto pushLines(unsigned mask, std::uint32_t block, std::vector<std::uint32_t>& starts) -> void
+        {
+            for (; mask; mask &= mask - 1)
+            {
+                starts.push_back(block + std::countr_zero(mask) + 1);
+            }
+        }
+
+#if defined(LANGUAGE_SCAN_X86)
+        // Bytes with first <= byte <= first + count, compared unsigned
+        inline auto inRange(__m128i v, char first, char count) -> __m128i
+        {
+            auto shifted = _mm_sub_epi8(v, _mm_set1_epi8(first));
+            return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(count)), shifted);
+        }
+
+        inline auto matchSSE2(__m128i v, CharClass cls) -> __m128i
+        {
+            switch (cls)
+            {
+            case Space:
+                return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', 4));
+            case IdChar:
+                return _mm_or_si128(inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+            default:
+                return inRange(v, '0', 9);
+            }
+        }
+
+        template <CharClass cls>
+        auto sse2(const char* pos, const char* end) -> const char*
+        {
+            while (end - pos >= 16)
+            {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                auto mismatch = ~static_cast<unsigned>(_mm_movemask_epi8(matchSSE2(v, cls))) & 0xFFFFu;
+                if (mismatch)
+                {
+                    return pos + std::countr_zero(mismatch);
+                }
+                pos += 16;
+            }
+            return scalar<cls>(pos, end);
+        }
+
+        auto sse2Lines(const char* begin, const char* pos, const char* end, std::vector<std::uint32_t>& starts) -> void
+        {
+            auto newline = _mm_set1_epi8('\n');
+            while (end - pos >= 16)
+            {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                pushLines(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))),
+                          static_cast<std::uint32_t>(pos - begin), starts);
+                pos += 16;
+            }
+            scalarLines(begin, pos, end, starts);
+        }
+
+        auto sse2LineStarts(const char* begin, const char* end, std::vector<std::uint32_t>& starts) -> void
+        {
+            sse2Lines(begin, begin, end, starts);
+        }
+
+        LANGUAGE_TARGET_AVX2 inline auto inRange(__m256i v, char first, char count) -> __m256i
+        {
+            auto shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(first));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(count)), shifted);
+        }
+
+        LANGUAGE_TARGET_AVX2 inline auto matchAVX2(__m256i v, CharClass cls) -> __m256i
+        {
+            switch (cls)
+            {
+            case Space:
+                return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange(v, '\t', 4));
+            case IdChar:
+                return _mm256_or_si256(inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+            default:
+                return inRange(v, '0', 9);
+            }
+        }
+
+        // Most tokens end within 16 bytes, so probe one SSE block before switching to 32 byte steps
+        template <CharClass cls>
+        LANGUAGE_TARGET_AVX2 auto avx2(const char* pos, const char* end) -> const char*
+        {
+            if (end - pos >= 16)
+            {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                auto mismatch = ~static_cast<unsigned>(_mm_movemask_epi8(matchSSE2(v, cls))) & 0xFFFFu;
+                if (mismatch)
+                {
+                    return pos + std::countr_zero(mismatch);
+                }
+                pos += 16;
+            }
+            while (end - pos >= 32)
+            {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+                auto mismatch = ~static_cast<unsigned>(_mm256_movemask_epi8(matchAVX2(v, cls)));
+                if (mismatch)
+                {
+                    return pos + std::countr_zero(mismatch);
+                }
+                pos += 32;
+            }
+            return sse2<cls>(pos, end);
+        }
+
+        LANGUAGE_TARGET_AVX2 auto avx2LineStarts(const char* begin, const char* end, std::vector<std::uint32_t>& starts) -> void
+        {
+            auto pos = begin;
+            auto newline = _mm256_set1_epi8('\n');
+            while (end - pos >= 32)
+            {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+                pushLines(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline))),
+                          static_cast<std::uint32_t>(pos - begin), starts);
+                pos += 32;
+            }
+            sse2Lines(begin, pos, end, starts);
+        }
+
+        auto cpuHasAVX2() -> bool
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 1);
+            bool osxsave = info[2] & (1 << 27);
+            __cpuidex(info, 7, 0);
+            bool avx2 = info[1] & (1 << 5);
+            return osxsave && avx2 && (_xgetbv(0) & 0x6) == 0x6;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        constexpr Functions scalarFunctions{scalar<Space>, scalar<IdChar>, scalar<Digit>, scalarLineStarts};
+#if defined(LANGUAGE_SCAN_X86)
+        constexpr Functions sse2Functions{sse2<Space>, sse2<IdChar>, sse2<Digit>, sse2LineStarts};
+        constexpr Functions avx2Functions{avx2<Space>, avx2<IdChar>, avx2<Digit>, avx2LineStarts};
+#endif
+    }
+
+    auto supported(Kernel kernel) -> bool
+    {
+        switch (kernel)
+        {
+#if defined(LANGUAGE_SCAN_X86)
+        case Kernel::SSE2:
+            return true;
+        case Kernel::AVX2:
+        {
+            static const bool avx2 = cpuHasAVX2();
+            return avx2;
+        }
+#endif
+        case Kernel::Scalar:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    auto best() -> Kernel
+    {
+        return supported(Kernel::SSE2) ? Kernel::SSE2 : Kernel::Scalar;
+    }
+
+    auto bestLines() -> Kernel
+    {
+        for (auto kernel : {Kernel::AVX2, Kernel::SSE2})
+        {
+            if (supported(kernel))
+            {
+                return kernel;
+            }
+        }
+        return Kernel::Scalar;
+    }
+
+    auto kernelToStr(Kernel kernel) -> std::string_view
+    {
+        switch (kernel)
+        {
+        case Kernel::Scalar:
+            return "Scalar";
+        case Kernel::SSE2:
+            return "SSE2";
+        case Kernel::AVX2:
+            return "AVX2";
+        default:
+            return "Unknown";
+        }
+    }
+
+    auto functions(Kernel kernel) -> const Functions&
+    {
+        if (!supported(kernel))
+        {
+            kernel = Kernel::Scalar;
+        }
+        switch (kernel)
+        {
+#if defined(LANGUAGE_SCAN_X86)
+        case Kernel::SSE2:
+            return sse2Functions;
+        case Kernel::AVX2:
+            return avx2Functions;
+#endif
+        default:
+            return scalarFunctions;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "TokenBuffer.hpp"
+
+namespace language
+{
+    static_assert(static_cast<int>(TokenType::Eof) <= 0xFF, "TokenType has to fit into the uint8_t type array");
+
+    TokenBuffer::TokenBuffer(std::string_view program, scan::Kernel kernel)
+    {
+        tokenize(program, kernel);
+    }
+
+    auto TokenBuffer::tokenize(std::string_view program, scan::Kernel kernel) -> void
+    {
+        clear();
+        this->program = program;
+
+        // Generated sources average a bit more than four bytes per token
+        auto expected = program.size() / 4 + 1;
+        types.reserve(expected);
+        offsets.reserve(expected);
+        lengths.reserve(expected);
+
+        Lexer lexer{program, kernel};
+        for (;;)
+        {
+            auto token = lexer.next();
+            types.push_back(static_cast<std::uint8_t>(token.type));
+            offsets.push_back(token.offset);
+            lengths.push_back(token.type == TokenType::Eof ? 0 : static_cast<std::uint32_t>(token.lexem.size()));
+            if (token.type == TokenType::Eof)
+            {
+                break;
+            }
+        }
+    }
+
+    auto TokenBuffer::clear() -> void
+    {
+        program = {};
+        types.clear();
+        offsets.clear();
+        lengths.clear();
+    }
+
+    auto TokenBuffer::size() const -> std::size_t
+    {
+        return types.size();
+    }
+
+    auto TokenBuffer::type(std::size_t index) const -> TokenType
+    {
+        return static_cast<TokenType>(types[index]);
+    }
+
+    auto TokenBuffer::offset(std::size_t index) const -> std::uint32_t
+    {
+        return offsets[index];
+    }
+
+    auto TokenBuffer::lexem(std::size_t index) const -> std::string_view
+    {
+        if (type(index) == TokenType::Eof)
+        {
+            return "$";
+        }
+        return program.substr(offsets[index], lengths[index]);
+    }
+
+    auto TokenBuffer::operator[](std::size_t index) const -> Token
+    {
+        return {type(index), lexem(index), offsets[index]};
+    }
+
+    auto TokenBuffer::source() const -> std::string_view
+    {
+        return program;
+    }
+}
@@ -1,6 +1,9 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "Lexer/Lexer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <random>
 
 TEST_CASE("Keywords","[Single Tokens]")
 {
@@ -24,4 +27,249 @@ TEST_CASE("Keywords","[Single Tokens]")
     REQUIRE(tokens[5].type == language::TokenType::BooleanLiteral);
     REQUIRE(tokens[5].lexem == "false");
     REQUIRE(tokens[6].type == language::TokenType::Var);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lexems","[Zero Copy]")
+{
+    std::string prog = "var count = 42;";
+
+    language::Lexer l{prog};
+    std::vector<language::Token> tokens;
+    for(auto t = l.next(); t.type != language::TokenType::Eof;t = l.next())
+    {
+        tokens.push_back(t);
+    }
+
+    REQUIRE(tokens.size() == 5);
+    REQUIRE(tokens[1].lexem == "count");
+    REQUIRE(tokens[1].offset == 4);
+    REQUIRE(tokens[1].lexem.data() == prog.data() + 4);
+    REQUIRE(tokens[3].type == language::TokenType::IntegerLiteral);
+    REQUIRE(tokens[3].lexem == "42");
+    REQUIRE(tokens[3].offset == 12);
+}
+
+
+static auto lex(const std::string& prog, language::scan::Kernel kernel)
+{
+    language::Lexer l{prog, kernel};
+    std::vector<std::pair<language::TokenType, std::string_view>> tokens;
+    for(auto t = l.next(); t.type != language::TokenType::Eof;t = l.next())
+    {
+        tokens.emplace_back(t.type, t.lexem);
+    }
+    return tokens;
+}
+
+TEST_CASE("Scan Kernels","[Differential]")
+{
+    std::vector<std::string> progs{
+        R"(
+        while else for if true false var
+    )",
+        "var count = 42;",
+        R"(
+        var a = 5;
+        fib(n: int) {
+            if (n <= 1) return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+        main() { for (var i = 0; i < 10; i = i + 1) { x = 3.25 * (y / 2); } }
+    )"};
+
+    // Runs of every length around the 16 and 32 byte block boundaries
+    std::string generated;
+    for(int length = 1; length < 70; length++)
+    {
+        generated += std::string(length, ' ') + std::string(length, 'a') + "\t\n" + std::string(length, '7');
+        generated += (length % 2 ? "." + std::string(length, '1') : std::string{"_"}) + std::string(length % 5, '\r') + ";";
+    }
+    progs.push_back(generated);
+
+    using language::scan::Kernel;
+    for(const auto& prog : progs)
+    {
+        auto expected = lex(prog, Kernel::Scalar);
+        for(auto kernel : {Kernel::SSE2, Kernel::AVX2})
+        {
+            if(!language::scan::supported(kernel))
+                continue;
+            INFO(language::scan::kernelToStr(kernel));
+            REQUIRE(lex(prog, kernel) == expected);
+        }
+    }
+}
+
+// The lexer before the scan kernels, classifying with <cctype> one character at a time. An invalid
+// character is an Eof token of its own and lexing goes on behind it.
+static auto reference(const std::string& prog)
+{
+    using language::TokenType;
+    const std::pair<std::string_view, TokenType> keywords[] = {
+        {"while", TokenType::While}, {"else", TokenType::Else}, {"for", TokenType::For}, {"if", TokenType::If},
+        {"true", TokenType::BooleanLiteral}, {"false", TokenType::BooleanLiteral}, {"var", TokenType::Var},
+        {"return", TokenType::Return}};
+    const std::pair<std::string_view, TokenType> operators[] = {
+        {"==", TokenType::DoubleEqual}, {"!=", TokenType::ExclamationMarkEqual}, {"<=", TokenType::LessEqual},
+        {">=", TokenType::GreaterEqual}, {"&&", TokenType::DoubleAmpersand}, {"||", TokenType::DoublePipe},
+        {"+", TokenType::Plus}, {"-", TokenType::Minus}, {"/", TokenType::Slash}, {"*", TokenType::Star},
+        {"(", TokenType::OpenParenthesis}, {")", TokenType::CloseParenthesis}, {"{", TokenType::OpenCurlyBracket},
+        {"}", TokenType::CloseCurlyBracket}, {"[", TokenType::OpenSquareBracket}, {"]", TokenType::CloseSquareBracket},
+        {",", TokenType::Comma}, {";", TokenType::Semicolon}, {".", TokenType::Dot}, {":", TokenType::Colon},
+        {"=", TokenType::Equal}, {"!", TokenType::ExclamationMark}, {"<", TokenType::Less}, {">", TokenType::Greater}};
+    auto is = [](int (*test)(int), char c) { return test(static_cast<unsigned char>(c)) != 0; };
+
+    std::vector<std::pair<TokenType, std::string_view>> tokens;
+    std::string_view rest = prog;
+    std::size_t pos = 0;
+    while (true)
+    {
+        while (pos < prog.size() && is(std::isspace, prog[pos]))
+            pos++;
+        if (pos == prog.size())
+            return tokens;
+        auto start = pos;
+        if (is(std::isalpha, prog[pos]) || prog[pos] == '_')
+        {
+            while (pos < prog.size() && (is(std::isalpha, prog[pos]) || prog[pos] == '_'))
+                pos++;
+            auto word = rest.substr(start, pos - start);
+            auto keyword = std::ranges::find(keywords, word, &std::pair<std::string_view, TokenType>::first);
+            tokens.emplace_back(keyword != std::end(keywords) ? keyword->second : TokenType::Id, word);
+            continue;
+        }
+        if (is(std::isdigit, prog[pos]))
+        {
+            auto type = TokenType::IntegerLiteral;
+            while (pos < prog.size() && is(std::isdigit, prog[pos]))
+                pos++;
+            if (pos < prog.size() && prog[pos] == '.')
+            {
+                type = TokenType::FloatingPointLiteral;
+                pos++;
+                while (pos < prog.size() && is(std::isdigit, prog[pos]))
+                    pos++;
+            }
+            tokens.emplace_back(type, rest.substr(start, pos - start));
+            continue;
+        }
+        auto op = std::ranges::find_if(operators, [&](auto& o) { return rest.substr(start).starts_with(o.first); });
+        if (op != std::end(operators))
+        {
+            pos += op->first.size();
+            tokens.emplace_back(op->second, rest.substr(start, op->first.size()));
+            continue;
+        }
+        pos++;
+        tokens.emplace_back(TokenType::Eof, rest.substr(start, 1));
+    }
+}
+
+static auto lexAll(const std::string& prog, language::scan::Kernel kernel)
+{
+    language::Lexer l{prog, kernel};
+    std::vector<std::pair<language::TokenType, std::string_view>> tokens;
+    while (true)
+    {
+        auto t = l.tryNext();
+        if (!t)
+        {
+            tokens.emplace_back(language::TokenType::Eof, std::string_view{prog}.substr(t.error().offset, 1));
+            continue;
+        }
+        if (t->type == language::TokenType::Eof)
+            return tokens;
+        tokens.emplace_back(t->type, t->lexem);
+    }
+}
+
+TEST_CASE("Reference Lexer","[Differential]")
+{
+    // Fragments of programs glued together at random, with every byte value in between
+    const char* fragments[] = {"while", "else", "for", "if", "true", "false", "var", "return", "_x", "count",
+                               "iffy", "42", "3.25", "7.", "0", "==", "=", "!=", "!", "<=", "<", ">=", ">", "&&",
+                               "&", "||", "|", "+-*/", "(){}[],;.:", " ", "\t", "\n", "\r", "\v", "\f", "  \n  "};
+    std::mt19937 random{2024};
+    for (int run = 0; run < 200; run++)
+    {
+        std::string prog;
+        for (int piece = 0; piece < 300; piece++)
+        {
+            if (random() % 8 == 0)
+                prog += static_cast<char>(random() % 256);
+            else
+                prog += fragments[random() % std::size(fragments)];
+        }
+        auto expected = reference(prog);
+        using language::scan::Kernel;
+        for (auto kernel : {Kernel::Scalar, Kernel::SSE2, Kernel::AVX2})
+        {
+            if (!language::scan::supported(kernel))
+                continue;
+            INFO(language::scan::kernelToStr(kernel) << " run " << run);
+            REQUIRE(lexAll(prog, kernel) == expected);
+        }
+    }
+}
+
+TEST_CASE("Line Index","[Differential]")
+{
+    // Lines of every length around the 16 and 32 byte block boundaries
+    std::string source;
+    for(int length = 0; length < 70; length++)
+    {
+        source += std::string(length, 'a') + "\n";
+    }
+    source += "\n\nlast";
+
+    using language::scan::Kernel;
+    for(auto kernel : {Kernel::Scalar, Kernel::SSE2, Kernel::AVX2})
+    {
+        if(!language::scan::supported(kernel))
+            continue;
+        INFO(language::scan::kernelToStr(kernel));
+        language::LineIndex lines{source, kernel};
+        REQUIRE(lines.lines() == 73);
+        std::uint32_t line = 1, column = 1;
+        for(std::uint32_t offset = 0; offset <= source.size(); offset++)
+        {
+            auto location = lines.locate(offset);
+            REQUIRE(location.line == line);
+            REQUIRE(location.column == column);
+            if(offset < source.size() && source[offset] == '\n')
+            {
+                line++;
+                column = 1;
+            }
+            else
+            {
+                column++;
+            }
+        }
+    }
+
+    std::string prog = "var a = 1;\n  a = $ 2;";
+    language::Lexer l{prog};
+    for(int i = 0; i < 7; i++)
+        l.next();
+    try
+    {
+        l.next();
+        FAIL("no InvalidToken");
+    }
+    catch(language::InvalidToken& invalid)
+    {
+        REQUIRE(std::string{invalid.what()} == "Invalid Token $ 2;...");
+        REQUIRE(invalid.at.line == 2);
+        REQUIRE(invalid.at.column == 7);
+    }
+    REQUIRE(l.next().type == language::TokenType::IntegerLiteral);
+
+    // Without exceptions the error is a value and lexing goes on behind it as well
+    language::Lexer values{"a | b"};
+    REQUIRE(values.tryNext()->type == language::TokenType::Id);
+    auto invalid = values.tryNext();
+    REQUIRE(!invalid);
+    REQUIRE(invalid.error().offset == 2);
+    REQUIRE(values.tryNext()->lexem == "b");
+}
@@ -0,0 +1,110 @@
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "Interpreter/VirtualMachine.hpp"
+#include "IR/IR.hpp"
+#include "Backend/Jit.hpp"
+#include "Optimizer/Loops.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace lang = language;
+
+// Nested for loops with invariant bounds and products of the loop counters
+static const std::pair<const char*, const char*> programs[] = {
+    {"matrix", R"(
+        main(): int {
+            var n = 700;
+            var sum = 0;
+            for (var i = 0; i < n; i = i + 1)
+                for (var j = 0; j < n; j = j + 1)
+                    sum = sum + i * n + j * 4 + (n * n - 1) / 3;
+            return sum;
+        }
+    )"},
+    {"cube", R"(
+        main(): int {
+            var size = 80;
+            var sum = 0;
+            for (var x = 0; x < size; x = x + 1)
+                for (var y = 0; y < size * 2; y = y + 1)
+                    for (var z = 0; z < size; z = z + 2)
+                        sum = sum + x * size * size + y * size + z * 3 - size / 2;
+            return sum;
+        }
+    )"},
+    {"float", R"(
+        main(): float {
+            var scale = 0.5;
+            var acc = 0.0;
+            for (var i = 0; i < 700; i = i + 1)
+                for (var j = 0; j < 700; j = j + 1)
+                    acc = acc + j * scale * (scale + 1.0) + i * 2;
+            return acc;
+        }
+    )"},
+};
+
+template <typename Run>
+static auto bestOf(int runs, Run run) -> std::pair<lang::Value, double>
+{
+    lang::Value value;
+    auto best = 0.0;
+    for (int i = 0; i < runs; i++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        value = run();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return {value, best};
+}
+
+struct Times
+{
+    lang::Value value;
+    double ast;
+    double bytecode;
+    double jit;
+};
+
+static auto measure(lang::Program& program) -> Times
+{
+    auto bytecode = lang::lower(program);
+    auto module = lang::ir::build(program);
+    auto [value, ast] = bestOf(3, [&] { return lang::Interpreter{program}.run(); });
+    auto executed = bestOf(3, [&] { return lang::VirtualMachine{bytecode}.run(); }).second;
+    auto jitted = bestOf(3, [&] { return lang::x86::Jit{module}.run(); }).second;
+    return {value, ast, executed, jitted};
+}
+
+// Runs every program as parsed and after optimizeLoops on the Interpreter, the VirtualMachine and the Jit
+int main()
+{
+    for (auto [name, source] : programs)
+    {
+        lang::Parser plain{source};
+        auto program = plain.program();
+        auto before = measure(program);
+
+        lang::Parser optimized{source};
+        auto loops = optimized.program();
+        auto report = lang::optimizeLoops(loops);
+        auto after = measure(loops);
+
+        if (lang::valueToStr(after.value) != lang::valueToStr(before.value))
+        {
+            std::cerr << name << ": optimized loops returned " << lang::valueToStr(after.value)
+                      << " instead of " << lang::valueToStr(before.value) << '\n';
+            std::exit(1);
+        }
+        std::cout << name << ": " << lang::valueToStr(after.value) << " (" << report.hoisted << " hoisted, "
+                  << report.reduced << " reduced)\n"
+                  << "  ast:      " << before.ast << " ms -> " << after.ast << " ms (" << before.ast / after.ast << "x)\n"
+                  << "  bytecode: " << before.bytecode << " ms -> " << after.bytecode << " ms (" << before.bytecode / after.bytecode << "x)\n"
+                  << "  jit:      " << before.jit << " ms -> " << after.jit << " ms (" << before.jit / after.jit << "x)\n";
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+
+namespace language
+{
+    struct DeadCodeReport
+    {
+        std::size_t unreachable = 0;   // statements that can never execute
+        std::size_t deadStores = 0;    // declarations and assignments of variables that are never read
+        std::size_t deadVariables = 0; // variables whose alive flag was cleared
+        std::size_t removedNodes = 0;
+    };
+
+    /*
+        Removes statements after a Return or after a loop that never exits, the branch an If with a
+        literal condition does not take, expression statements without side effects and stores to
+        variables that are never read. The side effects of a removed store are kept.
+        Repeats until nothing changes, then sets SymbolTable::Variable::alive to whether the variable is read.
+    */
+    auto eliminateDeadCode(Program& program) -> DeadCodeReport;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+
+namespace language
+{
+    struct FoldReport
+    {
+        std::size_t folded = 0;     // operators on literals replaced by their value
+        std::size_t simplified = 0; // identities like x * 1 or true && e
+        std::size_t branches = 0;   // If and While with a constant condition
+        std::size_t removedNodes = 0;
+    };
+
+    /*
+        Folds literal subtrees with the semantics of the Interpreter: int arithmetic wraps around,
+        mixed int and float operands compute in float and division by an int zero is left for
+        the runtime error. An If with a constant condition is replaced by the branch it takes,
+        a While whose condition is false is removed.
+    */
+    auto fold(Program& program) -> FoldReport;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+
+namespace language
+{
+    struct InlineReport
+    {
+        std::size_t inlined = 0;     // calls replaced by a copy of the body of their function
+        std::size_t functions = 0;   // distinct functions inlined at least once
+        std::size_t copiedNodes = 0; // of function bodies, at every call site
+    };
+
+    /*
+        Replaces calls of small functions by a copy of their body. A function is inlined if it is not
+        recursive, has at most threshold nodes and returns only with its last statement. Parameters and
+        locals of the copy become fresh locals of the caller, the result is stored in another one that
+        takes the place of the call. The copy goes in front of the statement with the call, which is only
+        done where no side effect moves past another one, so calls in loop conditions and on the right of
+        && and || stay. Functions are inlined into before they are inlined themselves.
+    */
+    auto inlineCalls(Program& program, std::size_t threshold = 32) -> InlineReport;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+
+namespace language
+{
+    struct LoopReport
+    {
+        std::size_t loops = 0;   // While statements
+        std::size_t counted = 0; // with an induction variable stepped by a constant at the end of the body
+        std::size_t hoisted = 0; // invariant expressions computed once in front of their loop
+        std::size_t reduced = 0; // multiplications of an induction variable replaced by a derived variable
+    };
+
+    /*
+        Optimizes every While, inner loops first, the way the parser leaves for loops: a Block with the init
+        and a While whose body ends with the post expression. Pure expressions reading no variable the loop
+        assigns are computed once in a fresh local in front of the loop, bounds like i < n * 2 included.
+        A counted loop ends its body with i = i + c for an int local i assigned nowhere else in the loop.
+        Every i * k with k an int literal or an int the loop does not assign is replaced by a derived
+        variable that starts as i * k and is stepped by c * k after i, int arithmetic wraps around so it
+        equals the product in every iteration. Globals count as assigned in loops with calls.
+    */
+    auto optimizeLoops(Program& program) -> LoopReport;
+}
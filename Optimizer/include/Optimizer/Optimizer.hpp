@@ -0,0 +1,46 @@
+#pragma once
+#include "Ast/Ast.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace language
+{
+    // Number of nodes reachable from the declarations of the program
+    auto countNodes(Program& program) -> std::size_t;
+    auto countNodes(Visitable& node) -> std::size_t;
+
+    // Without calls, assignments or divisions that may raise an error, dropping the expression is unobservable
+    auto isPure(Expr& expr) -> bool;
+
+    using Variables = std::unordered_set<const SymbolTable::Variable*>;
+
+    // The variables a subtree reads and assigns, the functions it calls and its return statements
+    struct Effects
+    {
+        Variables reads;
+        Variables writes;
+        std::vector<FuncDef*> calls;
+        std::size_t returns = 0;
+    };
+
+    auto effects(Visitable& node) -> Effects;
+
+    // A new local in the frame of def named after name, the suffix keeps it apart from source identifiers
+    auto freshLocal(FuncDef& def, std::string_view name, SymbolTable::Type* type) -> SymbolTable::Variable*;
+
+    // The truth value of a literal used as a condition
+    auto constantCondition(Expr& expr) -> std::optional<bool>;
+
+    /*
+        Runs every AST pass in order on a checked Program and returns one line per pass
+        describing what it changed. The program keeps its meaning, only work that can be
+        done before execution or that can never be observed is removed. Functions with up
+        to inlineThreshold nodes are inlined first, 0 turns inlining off. Loops are optimized
+        after folding, so no literal expression is hoisted out of them.
+    */
+    auto optimize(Program& program, std::size_t inlineThreshold = 32) -> std::string;
+}
@@ -0,0 +1,349 @@
+#include "DeadCode.hpp"
+#include "Optimizer.hpp"
+#include <optional>
+#include <unordered_map>
+
+namespace language
+{
+    namespace
+    {
+        using Reads = std::unordered_map<const SymbolTable::Variable*, std::size_t>;
+
+        // Counts the reads of every variable, the variable an assignment writes to is not read by it
+        struct ReadCounter : public Visitor
+        {
+            Reads reads;
+            std::vector<SymbolTable::Variable*> declared;
+
+            void scan(Visitable* node)
+            {
+                if (node)
+                {
+                    node->accept(*this);
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                declared.push_back(decl.var);
+                scan(decl.init.get());
+            }
+            void visit(FuncDef& def) override
+            {
+                declared.insert(declared.end(), def.parameters.begin(), def.parameters.end());
+                scan(def.block.get());
+            }
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    scan(stmt.get());
+                }
+            }
+            void visit(If& ifStmt) override
+            {
+                scan(ifStmt.expr.get());
+                scan(ifStmt.trueStmt.get());
+                scan(ifStmt.falseStmt.get());
+            }
+            void visit(While& whileStmt) override
+            {
+                scan(whileStmt.expr.get());
+                scan(whileStmt.stmt.get());
+            }
+            void visit(Return& returnStmt) override
+            {
+                scan(returnStmt.expr.get());
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                scan(exprStmt.expr.get());
+            }
+            void visit(FuncCall& funcCall) override
+            {
+                for (auto& arg : funcCall.args)
+                {
+                    scan(arg.get());
+                }
+            }
+            void visit(BinExpr& binExpr) override
+            {
+                if (binExpr.op != BinOperator::Assign || !dynamic_cast<VariableAccess*>(binExpr.leftHs.get()))
+                {
+                    scan(binExpr.leftHs.get());
+                }
+                scan(binExpr.rightHs.get());
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess& access) override
+            {
+                reads[access.var]++;
+            }
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    scan(decl.get());
+                }
+            }
+        };
+
+        auto isEmptyBlock(Stmt& stmt) -> bool
+        {
+            auto block = dynamic_cast<Block*>(&stmt);
+            return block && block->stmts.empty();
+        }
+
+        /*
+            Every statement visit sets completes to whether execution can continue after it,
+            the statements of a Block following one that does not complete are dropped.
+            A visit that removes or replaces its statement leaves the result in replacement.
+        */
+        class Eliminator : public Visitor
+        {
+        public:
+            Eliminator(const Reads& reads, DeadCodeReport& report) : changed{false}, reads{reads}, report{report}, completes{true}
+            {
+            }
+
+            // Whether a variable read count may have changed, which can make more stores dead
+            bool changed;
+
+            void visit(Program& program) override
+            {
+                std::erase_if(program.declarations, [&](auto& decl)
+                              {
+                                  auto var = dynamic_cast<VarDecl*>(decl.get());
+                                  if (!var || !isDead(*var->var) || !isPure(*var->init))
+                                      return false;
+                                  report.deadStores++;
+                                  changed = true;
+                                  return true; });
+                for (auto& decl : program.declarations)
+                {
+                    if (auto def = dynamic_cast<FuncDef*>(decl.get()))
+                    {
+                        def->accept(*this);
+                    }
+                }
+            }
+
+            void visit(FuncDef& def) override
+            {
+                def.block->accept(*this);
+            }
+
+            void visit(Block& block) override
+            {
+                auto live = true;
+                std::vector<std::unique_ptr<Stmt>> kept;
+                for (auto& stmt : block.stmts)
+                {
+                    if (!live)
+                    {
+                        report.unreachable++;
+                        changed = true;
+                        continue;
+                    }
+                    statement(stmt);
+                    live = completes;
+                    if (!isEmptyBlock(*stmt))
+                    {
+                        kept.push_back(std::move(stmt));
+                    }
+                }
+                block.stmts = std::move(kept);
+                completes = live;
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                completes = true;
+                if (!isDead(*decl.var))
+                {
+                    return;
+                }
+                report.deadStores++;
+                changed = true;
+                if (isPure(*decl.init))
+                    replacement = std::make_unique<Block>();
+                else
+                    replacement = std::make_unique<ExprStmt>(std::move(decl.init));
+            }
+
+            void visit(If& ifStmt) override
+            {
+                if (auto cond = constantCondition(*ifStmt.expr))
+                {
+                    auto& taken = *cond ? ifStmt.trueStmt : ifStmt.falseStmt;
+                    auto& skipped = *cond ? ifStmt.falseStmt : ifStmt.trueStmt;
+                    report.unreachable += skipped != nullptr;
+                    changed = true;
+                    std::unique_ptr<Stmt> branch = taken ? std::move(taken) : std::make_unique<Block>();
+                    statement(branch);
+                    replacement = std::move(branch);
+                    return;
+                }
+
+                statement(ifStmt.trueStmt);
+                auto trueCompletes = completes;
+                auto falseCompletes = true;
+                if (ifStmt.falseStmt)
+                {
+                    statement(ifStmt.falseStmt);
+                    falseCompletes = completes;
+                    if (isEmptyBlock(*ifStmt.falseStmt))
+                    {
+                        ifStmt.falseStmt = nullptr;
+                    }
+                }
+                completes = trueCompletes || falseCompletes;
+
+                if (!ifStmt.falseStmt && isEmptyBlock(*ifStmt.trueStmt) && isPure(*ifStmt.expr))
+                {
+                    report.unreachable++;
+                    changed = true;
+                    replacement = std::make_unique<Block>();
+                }
+            }
+
+            // A loop with a true literal condition only ends by returning
+            void visit(While& whileStmt) override
+            {
+                auto cond = constantCondition(*whileStmt.expr);
+                if (cond && !*cond)
+                {
+                    report.unreachable++;
+                    changed = true;
+                    replacement = std::make_unique<Block>();
+                    completes = true;
+                    return;
+                }
+                statement(whileStmt.stmt);
+                completes = !cond;
+            }
+
+            void visit(Return&) override
+            {
+                completes = false;
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                completes = true;
+                // Assignments to variables nobody reads keep only their right side
+                while (auto assign = deadAssignment(*exprStmt.expr))
+                {
+                    report.deadStores++;
+                    changed = true;
+                    exprStmt.expr = std::move(assign->rightHs);
+                }
+                if (isPure(*exprStmt.expr))
+                {
+                    replacement = std::make_unique<Block>();
+                }
+            }
+
+            void visit(FuncCall&) override
+            {
+            }
+            void visit(BinExpr&) override
+            {
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess&) override
+            {
+            }
+
+        private:
+            auto isDead(const SymbolTable::Variable& var) const -> bool
+            {
+                return !reads.contains(&var);
+            }
+
+            auto deadAssignment(Expr& expr) const -> BinExpr*
+            {
+                auto assign = dynamic_cast<BinExpr*>(&expr);
+                if (!assign || assign->op != BinOperator::Assign)
+                {
+                    return nullptr;
+                }
+                auto access = dynamic_cast<VariableAccess*>(assign->leftHs.get());
+                return access && isDead(*access->var) ? assign : nullptr;
+            }
+
+            auto statement(std::unique_ptr<Stmt>& stmt) -> void
+            {
+                completes = true;
+                stmt->accept(*this);
+                if (replacement)
+                {
+                    replacement->offset = stmt->offset; // diagnostics keep pointing at the removed statement
+                    stmt = std::move(replacement);
+                }
+            }
+
+            const Reads& reads;
+            DeadCodeReport& report;
+            bool completes;
+            std::unique_ptr<Stmt> replacement;
+        };
+    }
+
+    auto eliminateDeadCode(Program& program) -> DeadCodeReport
+    {
+        std::optional<Arena::Scope> scope;
+        if (program.arena)
+        {
+            scope.emplace(*program.arena);
+        }
+
+        DeadCodeReport report;
+        auto before = countNodes(program);
+        std::vector<SymbolTable::Variable*> declared;
+        for (auto changed = true; changed;)
+        {
+            ReadCounter counter;
+            counter.visit(program);
+            if (declared.empty())
+            {
+                declared = std::move(counter.declared);
+            }
+            Eliminator eliminator{counter.reads, report};
+            eliminator.visit(program);
+            changed = eliminator.changed;
+        }
+
+        ReadCounter counter;
+        counter.visit(program);
+        for (auto var : declared)
+        {
+            var->alive = counter.reads.contains(var);
+            report.deadVariables += !var->alive;
+        }
+        report.removedNodes = before - countNodes(program);
+        return report;
+    }
+}
@@ -0,0 +1,372 @@
+#include "Fold.hpp"
+#include "Optimizer.hpp"
+#include <optional>
+
+namespace language
+{
+    namespace
+    {
+        // The value of a literal operand, bool and int compare and convert like in the Interpreter
+        struct Constant
+        {
+            enum class Kind
+            {
+                Int, Float, Bool
+            };
+
+            Kind kind;
+            int i = 0;
+            double f = 0;
+            bool b = false;
+
+            auto asInt() const -> int
+            {
+                return kind == Kind::Float ? static_cast<int>(f) : kind == Kind::Bool ? b : i;
+            }
+            auto asFloat() const -> double
+            {
+                return kind == Kind::Float ? f : asInt();
+            }
+            auto truth() const -> bool
+            {
+                return kind == Kind::Float ? f != 0 : asInt() != 0;
+            }
+            auto is(int value) const -> bool
+            {
+                return kind != Kind::Bool && asFloat() == value;
+            }
+        };
+
+        auto constant(Expr& expr) -> std::optional<Constant>
+        {
+            if (auto lit = dynamic_cast<IntLiteral*>(&expr))
+                return Constant{.kind = Constant::Kind::Int, .i = lit->v};
+            if (auto lit = dynamic_cast<FloatLiteral*>(&expr))
+                return Constant{.kind = Constant::Kind::Float, .f = lit->v};
+            if (auto lit = dynamic_cast<BooleanLiteral*>(&expr))
+                return Constant{.kind = Constant::Kind::Bool, .b = lit->v};
+            return std::nullopt;
+        }
+
+        auto wrap(long long value) -> int
+        {
+            return static_cast<int>(static_cast<unsigned>(value));
+        }
+
+        template <typename T>
+        auto compare(BinOperator op, T l, T r) -> bool
+        {
+            switch (op)
+            {
+            case BinOperator::Less:
+                return l < r;
+            case BinOperator::LessEqual:
+                return l <= r;
+            case BinOperator::Greater:
+                return l > r;
+            case BinOperator::GreaterEqual:
+                return l >= r;
+            case BinOperator::Equal:
+                return l == r;
+            default:
+                return l != r;
+            }
+        }
+
+        /*
+            Children are folded before their parent. A visit that replaces its node leaves the
+            replacement in exprReplacement or stmtReplacement, the parent puts it into the slot.
+        */
+        class Folder : public Visitor
+        {
+        public:
+            Folder(Program& program, FoldReport& report) : report{report},
+                                                           intType{&std::get<SymbolTable::Type>(program.sym_table->get("int"))},
+                                                           floatType{&std::get<SymbolTable::Type>(program.sym_table->get("float"))},
+                                                           boolType{&std::get<SymbolTable::Type>(program.sym_table->get("bool"))}
+            {
+            }
+
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    decl->accept(*this);
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                fold(decl.init);
+            }
+
+            void visit(FuncDef& def) override
+            {
+                def.block->accept(*this);
+            }
+
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    fold(stmt);
+                }
+            }
+
+            void visit(If& ifStmt) override
+            {
+                fold(ifStmt.expr);
+                fold(ifStmt.trueStmt);
+                if (ifStmt.falseStmt)
+                {
+                    fold(ifStmt.falseStmt);
+                }
+
+                if (auto cond = constantCondition(*ifStmt.expr))
+                {
+                    report.branches++;
+                    if (*cond)
+                        stmtReplacement = std::move(ifStmt.trueStmt);
+                    else if (ifStmt.falseStmt)
+                        stmtReplacement = std::move(ifStmt.falseStmt);
+                    else
+                        stmtReplacement = std::make_unique<Block>();
+                }
+            }
+
+            void visit(While& whileStmt) override
+            {
+                fold(whileStmt.expr);
+                fold(whileStmt.stmt);
+
+                if (auto cond = constantCondition(*whileStmt.expr); cond && !*cond)
+                {
+                    report.branches++;
+                    stmtReplacement = std::make_unique<Block>();
+                }
+            }
+
+            void visit(Return& returnStmt) override
+            {
+                if (returnStmt.expr)
+                {
+                    fold(returnStmt.expr);
+                }
+            }
+
+            void visit(ExprStmt& exprStmt) override
+            {
+                fold(exprStmt.expr);
+            }
+
+            void visit(FuncCall& funcCall) override
+            {
+                for (auto& arg : funcCall.args)
+                {
+                    fold(arg);
+                }
+            }
+
+            void visit(BinExpr& binExpr) override
+            {
+                fold(binExpr.leftHs);
+                fold(binExpr.rightHs);
+                switch (binExpr.op)
+                {
+                case BinOperator::Assign:
+                    return;
+                case BinOperator::And:
+                case BinOperator::Or:
+                    logical(binExpr);
+                    return;
+                case BinOperator::Plus:
+                case BinOperator::Minus:
+                case BinOperator::Mul:
+                case BinOperator::Div:
+                    arithmetic(binExpr);
+                    return;
+                default:
+                    comparison(binExpr);
+                    return;
+                }
+            }
+
+            void visit(StrLiteral&) override
+            {
+            }
+
+            void visit(IntLiteral&) override
+            {
+            }
+
+            void visit(FloatLiteral&) override
+            {
+            }
+
+            void visit(BooleanLiteral&) override
+            {
+            }
+
+            void visit(VariableAccess&) override
+            {
+            }
+
+        private:
+            auto fold(std::unique_ptr<Expr>& expr) -> void
+            {
+                expr->accept(*this);
+                if (exprReplacement)
+                {
+                    exprReplacement->offset = expr->offset; // it stands for the whole folded expression
+                    expr = std::move(exprReplacement);
+                }
+            }
+
+            auto fold(std::unique_ptr<Stmt>& stmt) -> void
+            {
+                stmt->accept(*this);
+                if (stmtReplacement)
+                {
+                    stmtReplacement->offset = stmt->offset;
+                    stmt = std::move(stmtReplacement);
+                }
+            }
+
+            auto boolean(bool value) -> std::unique_ptr<Expr>
+            {
+                return std::make_unique<BooleanLiteral>(value, boolType);
+            }
+
+            // e replaces its parent only if that keeps the type of the expression
+            auto replaceWith(std::unique_ptr<Expr>& e, SymbolTable::Type* type) -> void
+            {
+                if (e->type == type)
+                {
+                    report.simplified++;
+                    exprReplacement = std::move(e);
+                }
+            }
+
+            // A constant left side decides the result or leaves it to the right side, like the short circuit does
+            auto logical(BinExpr& binExpr) -> void
+            {
+                auto l = constant(*binExpr.leftHs);
+                auto r = constant(*binExpr.rightHs);
+                auto isAnd = binExpr.op == BinOperator::And;
+                if (l)
+                {
+                    if (l->truth() != isAnd)
+                    {
+                        report.folded++;
+                        exprReplacement = boolean(l->truth());
+                    }
+                    else if (r)
+                    {
+                        report.folded++;
+                        exprReplacement = boolean(r->truth());
+                    }
+                    else
+                    {
+                        replaceWith(binExpr.rightHs, binExpr.type);
+                    }
+                }
+                else if (r)
+                {
+                    if (r->truth() == isAnd)
+                    {
+                        replaceWith(binExpr.leftHs, binExpr.type);
+                    }
+                    else if (isPure(*binExpr.leftHs))
+                    {
+                        report.simplified++;
+                        exprReplacement = boolean(r->truth());
+                    }
+                }
+            }
+
+            auto comparison(BinExpr& binExpr) -> void
+            {
+                auto l = constant(*binExpr.leftHs);
+                auto r = constant(*binExpr.rightHs);
+                if (!l || !r)
+                {
+                    return;
+                }
+                report.folded++;
+                if (l->kind == Constant::Kind::Float || r->kind == Constant::Kind::Float)
+                    exprReplacement = boolean(compare(binExpr.op, l->asFloat(), r->asFloat()));
+                else
+                    exprReplacement = boolean(compare(binExpr.op, l->asInt(), r->asInt()));
+            }
+
+            auto arithmetic(BinExpr& binExpr) -> void
+            {
+                auto l = constant(*binExpr.leftHs);
+                auto r = constant(*binExpr.rightHs);
+                auto op = binExpr.op;
+                if (l && r && l->kind != Constant::Kind::Bool && r->kind != Constant::Kind::Bool)
+                {
+                    if (binExpr.type == floatType)
+                    {
+                        auto a = l->asFloat();
+                        auto b = r->asFloat();
+                        auto v = op == BinOperator::Plus ? a + b : op == BinOperator::Minus ? a - b : op == BinOperator::Mul ? a * b : a / b;
+                        report.folded++;
+                        exprReplacement = std::make_unique<FloatLiteral>(v, floatType);
+                    }
+                    else if (binExpr.type == intType && !(op == BinOperator::Div && r->asInt() == 0))
+                    {
+                        long long a = l->asInt();
+                        long long b = r->asInt();
+                        auto v = op == BinOperator::Plus ? a + b : op == BinOperator::Minus ? a - b : op == BinOperator::Mul ? a * b : a / b;
+                        report.folded++;
+                        exprReplacement = std::make_unique<IntLiteral>(wrap(v), intType);
+                    }
+                    return;
+                }
+
+                // x + 0 is not x for float, -0.0 + 0.0 is 0.0
+                auto type = binExpr.type;
+                auto additive = op == BinOperator::Plus && type == intType;
+                if (r && ((r->is(0) && (additive || op == BinOperator::Minus)) ||
+                          (r->is(1) && (op == BinOperator::Mul || op == BinOperator::Div))))
+                {
+                    replaceWith(binExpr.leftHs, type);
+                }
+                else if (l && ((l->is(0) && additive) || (l->is(1) && op == BinOperator::Mul)))
+                {
+                    replaceWith(binExpr.rightHs, type);
+                }
+                else if (op == BinOperator::Mul && type == intType &&
+                         ((r && r->is(0) && isPure(*binExpr.leftHs)) || (l && l->is(0) && isPure(*binExpr.rightHs))))
+                {
+                    report.simplified++;
+                    exprReplacement = std::make_unique<IntLiteral>(0, intType);
+                }
+            }
+
+            FoldReport& report;
+            SymbolTable::Type* intType;
+            SymbolTable::Type* floatType;
+            SymbolTable::Type* boolType;
+            std::unique_ptr<Expr> exprReplacement;
+            std::unique_ptr<Stmt> stmtReplacement;
+        };
+    }
+
+    auto fold(Program& program) -> FoldReport
+    {
+        // New literals go to the arena of the program like the nodes they replace
+        std::optional<Arena::Scope> scope;
+        if (program.arena)
+        {
+            scope.emplace(*program.arena);
+        }
+
+        FoldReport report;
+        auto before = countNodes(program);
+        Folder{program, report}.visit(program);
+        report.removedNodes = before - countNodes(program);
+        return report;
+    }
+}
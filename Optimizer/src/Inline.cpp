@@ -0,0 +1,494 @@
+#include "Inline.hpp"
+#include "Optimizer.hpp"
+#include <algorithm>
+#include <format>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace language
+{
+    namespace
+    {
+        auto containsCall(Expr& expr) -> bool
+        {
+            if (dynamic_cast<FuncCall*>(&expr))
+                return true;
+            auto bin = dynamic_cast<BinExpr*>(&expr);
+            return bin && (containsCall(*bin->leftHs) || containsCall(*bin->rightHs));
+        }
+
+        // Tarjan's algorithm, the functions come out callees first
+        class CallGraph
+        {
+        public:
+            CallGraph(const std::vector<FuncDef*>& defs)
+            {
+                for (auto def : defs)
+                {
+                    callees[def] = effects(*def).calls;
+                }
+                for (auto def : defs)
+                {
+                    if (!index.contains(def))
+                    {
+                        connect(def);
+                    }
+                }
+            }
+
+            std::vector<FuncDef*> order;
+            std::unordered_set<const FuncDef*> recursive;
+
+        private:
+            auto connect(FuncDef* def) -> std::size_t
+            {
+                auto own = index.size();
+                auto low = own;
+                index[def] = own;
+                stack.push_back(def);
+                for (auto callee : callees[def])
+                {
+                    if (callee == def)
+                    {
+                        recursive.insert(def);
+                    }
+                    else if (!index.contains(callee))
+                    {
+                        low = std::min(low, connect(callee));
+                    }
+                    else if (std::ranges::find(stack, callee) != stack.end())
+                    {
+                        low = std::min(low, index[callee]);
+                    }
+                }
+                if (low == own)
+                {
+                    auto first = std::ranges::find(stack, def);
+                    if (stack.end() - first > 1)
+                    {
+                        recursive.insert(first, stack.end());
+                    }
+                    order.insert(order.end(), first, stack.end());
+                    stack.erase(first, stack.end());
+                }
+                return low;
+            }
+
+            std::unordered_map<FuncDef*, std::vector<FuncDef*>> callees;
+            std::unordered_map<FuncDef*, std::size_t> index;
+            std::vector<FuncDef*> stack;
+        };
+
+        // Copies statements of a callee, its parameters and locals are renamed to fresh locals of the caller
+        class Cloner : public Visitor
+        {
+        public:
+            Cloner(FuncDef& caller) : caller{caller}
+            {
+            }
+
+            std::unordered_map<const SymbolTable::Variable*, SymbolTable::Variable*> renamed;
+
+            auto clone(Stmt& stmt) -> std::unique_ptr<Stmt>
+            {
+                stmt.accept(*this);
+                stmtResult->offset = stmt.offset;
+                return std::move(stmtResult);
+            }
+
+            auto clone(Expr& expr) -> std::unique_ptr<Expr>
+            {
+                expr.accept(*this);
+                exprResult->type = expr.type;
+                exprResult->offset = expr.offset;
+                return std::move(exprResult);
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                auto init = clone(*decl.init);
+                auto var = freshLocal(caller, decl.var->name, decl.var->type);
+                renamed[decl.var] = var;
+                stmtResult = std::make_unique<VarDecl>(var, std::move(init));
+            }
+            void visit(FuncDef&) override
+            {
+                throw std::logic_error("Function definitions are not statements");
+            }
+            void visit(Block& block) override
+            {
+                std::vector<std::unique_ptr<Stmt>> stmts;
+                for (auto& stmt : block.stmts)
+                {
+                    stmts.push_back(clone(*stmt));
+                }
+                stmtResult = std::make_unique<Block>(std::move(stmts), nullptr);
+            }
+            void visit(If& ifStmt) override
+            {
+                auto expr = clone(*ifStmt.expr);
+                auto trueStmt = clone(*ifStmt.trueStmt);
+                stmtResult = std::make_unique<If>(std::move(expr), std::move(trueStmt), ifStmt.falseStmt ? clone(*ifStmt.falseStmt) : nullptr);
+            }
+            void visit(While& whileStmt) override
+            {
+                auto expr = clone(*whileStmt.expr);
+                stmtResult = std::make_unique<While>(std::move(expr), clone(*whileStmt.stmt));
+            }
+            void visit(Return& returnStmt) override
+            {
+                stmtResult = std::make_unique<Return>(returnStmt.expr ? clone(*returnStmt.expr) : nullptr);
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                stmtResult = std::make_unique<ExprStmt>(clone(*exprStmt.expr));
+            }
+            void visit(FuncCall& funcCall) override
+            {
+                std::vector<std::unique_ptr<Expr>> args;
+                for (auto& arg : funcCall.args)
+                {
+                    args.push_back(clone(*arg));
+                }
+                exprResult = std::make_unique<FuncCall>(funcCall.function, std::move(args));
+            }
+            void visit(BinExpr& binExpr) override
+            {
+                auto left = clone(*binExpr.leftHs);
+                exprResult = std::make_unique<BinExpr>(std::move(left), clone(*binExpr.rightHs), binExpr.op, binExpr.type);
+            }
+            void visit(StrLiteral& lit) override
+            {
+                exprResult = std::make_unique<StrLiteral>(lit.v, lit.type);
+            }
+            void visit(IntLiteral& lit) override
+            {
+                exprResult = std::make_unique<IntLiteral>(lit.v, lit.type);
+            }
+            void visit(FloatLiteral& lit) override
+            {
+                exprResult = std::make_unique<FloatLiteral>(lit.v, lit.type);
+            }
+            void visit(BooleanLiteral& lit) override
+            {
+                exprResult = std::make_unique<BooleanLiteral>(lit.v, lit.type);
+            }
+            void visit(VariableAccess& access) override
+            {
+                auto var = renamed.find(access.var);
+                exprResult = std::make_unique<VariableAccess>(var != renamed.end() ? var->second : access.var);
+            }
+            void visit(Program&) override
+            {
+                throw std::logic_error("Programs are not statements");
+            }
+
+        private:
+            FuncDef& caller;
+            std::unique_ptr<Stmt> stmtResult;
+            std::unique_ptr<Expr> exprResult;
+        };
+
+        struct Callee
+        {
+            bool inlinable = false;
+            bool writesGlobals = false; // or calls a function, which may
+        };
+
+        // The call to inline and the subtrees of its statement that are evaluated before it
+        struct Site
+        {
+            std::unique_ptr<Expr>* call = nullptr;
+            std::vector<Expr*> before;
+        };
+
+        /*
+            Inlines calls in the statements of one function at a time, innermost statements first.
+            The copies go in front of a statement with inlined calls. In a block they are spliced in, so a function
+            ending in return helper(...) still ends in a return and can be inlined itself.
+        */
+        class Inliner : public Visitor
+        {
+        public:
+            Inliner(std::size_t threshold, InlineReport& report) : threshold{threshold}, report{report}
+            {
+            }
+
+            void visit(Program& program) override
+            {
+                std::vector<FuncDef*> defs;
+                for (auto& decl : program.declarations)
+                {
+                    if (auto def = dynamic_cast<FuncDef*>(decl.get()))
+                    {
+                        defs.push_back(def);
+                    }
+                }
+                CallGraph graph{defs};
+                for (auto def : graph.order)
+                {
+                    def->accept(*this);
+                    auto body = effects(*def);
+                    callees[def] = {
+                        .inlinable = !graph.recursive.contains(def) && countNodes(*def) <= threshold && singleExit(*def, body),
+                        .writesGlobals = !body.calls.empty() || std::ranges::any_of(body.writes, [](auto var) { return var->scope == SymbolTable::Scope::Global; }),
+                    };
+                }
+                report.functions = inlinedFunctions.size();
+            }
+
+            void visit(FuncDef& def) override
+            {
+                caller = &def;
+                statements(def.block->stmts);
+                caller = nullptr;
+            }
+
+            void visit(Block& block) override
+            {
+                statements(block.stmts);
+            }
+
+            void visit(If& ifStmt) override
+            {
+                statement(ifStmt.trueStmt);
+                if (ifStmt.falseStmt)
+                {
+                    statement(ifStmt.falseStmt);
+                }
+            }
+
+            void visit(While& whileStmt) override
+            {
+                statement(whileStmt.stmt);
+            }
+
+            void visit(VarDecl&) override
+            {
+            }
+            void visit(Return&) override
+            {
+            }
+            void visit(ExprStmt&) override
+            {
+            }
+            void visit(FuncCall&) override
+            {
+            }
+            void visit(BinExpr&) override
+            {
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess&) override
+            {
+            }
+
+        private:
+            // Only a final return can be replaced by a store of the result, it has to have the declared type
+            static auto singleExit(FuncDef& def, const Effects& body) -> bool
+            {
+                auto& stmts = def.block->stmts;
+                auto last = stmts.empty() ? nullptr : dynamic_cast<Return*>(stmts.back().get());
+                if (def.returnType == nullptr)
+                {
+                    return body.returns == 0 || (body.returns == 1 && last && !last->expr);
+                }
+                return body.returns == 1 && last && last->expr && last->expr->type == def.returnType;
+            }
+
+            // The expression of a statement that may be preceded by code, a loop condition is evaluated more than once
+            static auto expression(Stmt& stmt) -> std::unique_ptr<Expr>*
+            {
+                if (auto exprStmt = dynamic_cast<ExprStmt*>(&stmt))
+                    return &exprStmt->expr;
+                if (auto decl = dynamic_cast<VarDecl*>(&stmt))
+                    return &decl->init;
+                if (auto returnStmt = dynamic_cast<Return*>(&stmt))
+                    return returnStmt->expr ? &returnStmt->expr : nullptr;
+                if (auto ifStmt = dynamic_cast<If*>(&stmt))
+                    return &ifStmt->expr;
+                return nullptr;
+            }
+
+            auto inlinable(FuncCall& call) const -> bool
+            {
+                auto callee = callees.find(call.function->def);
+                return callee != callees.end() && callee->second.inlinable && call.args.size() == call.function->def->parameters.size();
+            }
+
+            // Walks the expression in evaluation order up to the first call to inline
+            auto locate(std::unique_ptr<Expr>& expr, bool conditional, Site& site) const -> bool
+            {
+                if (!containsCall(*expr))
+                {
+                    site.before.push_back(expr.get());
+                    return false;
+                }
+                if (auto call = dynamic_cast<FuncCall*>(expr.get()))
+                {
+                    for (auto& arg : call->args)
+                    {
+                        if (locate(arg, conditional, site))
+                        {
+                            return true;
+                        }
+                    }
+                    if (!conditional && inlinable(*call))
+                    {
+                        site.call = &expr;
+                        return true;
+                    }
+                    site.before.push_back(expr.get());
+                    return false;
+                }
+                auto& bin = static_cast<BinExpr&>(*expr);
+                if (bin.op == BinOperator::Assign)
+                {
+                    return locate(bin.rightHs, conditional, site);
+                }
+                if (locate(bin.leftHs, conditional, site))
+                {
+                    return true;
+                }
+                return locate(bin.rightHs, conditional || bin.op == BinOperator::And || bin.op == BinOperator::Or, site);
+            }
+
+            // What is evaluated before the call must not have side effects or read what the call writes
+            auto movable(const Site& site, FuncCall& call) const -> bool
+            {
+                Variables written;
+                for (auto& arg : call.args)
+                {
+                    written.merge(effects(*arg).writes);
+                }
+                auto globals = callees.at(call.function->def).writesGlobals;
+                return std::ranges::all_of(site.before, [&](Expr* expr)
+                                           { return isPure(*expr) && std::ranges::none_of(effects(*expr).reads, [&](auto var)
+                                                                                          { return written.contains(var) || (globals && var->scope == SymbolTable::Scope::Global); }); });
+            }
+
+            // A statement on its own, like the branch of an if, becomes a Block of the copies followed by it
+            auto statement(std::unique_ptr<Stmt>& stmt) -> void
+            {
+                std::vector<std::unique_ptr<Stmt>> copies;
+                auto keep = expand(stmt, copies);
+                if (copies.empty())
+                {
+                    return;
+                }
+                auto offset = stmt->offset;
+                if (keep)
+                {
+                    copies.push_back(std::move(stmt));
+                }
+                stmt = std::make_unique<Block>(std::move(copies), nullptr);
+                stmt->offset = offset;
+            }
+
+            // In a list the copies go right in front of the statement, so a final return stays the last statement
+            auto statements(std::vector<std::unique_ptr<Stmt>>& stmts) -> void
+            {
+                std::vector<std::unique_ptr<Stmt>> result;
+                result.reserve(stmts.size());
+                for (auto& stmt : stmts)
+                {
+                    if (expand(stmt, result))
+                    {
+                        result.push_back(std::move(stmt));
+                    }
+                }
+                stmts = std::move(result);
+            }
+
+            // Appends the copies of the calls inlined in the statement, whether the statement is still needed
+            auto expand(std::unique_ptr<Stmt>& stmt, std::vector<std::unique_ptr<Stmt>>& copies) -> bool
+            {
+                stmt->accept(*this);
+                auto root = expression(*stmt);
+                if (!root)
+                {
+                    return true;
+                }
+
+                auto keep = true;
+                for (Site site; locate(*root, false, site); site = {})
+                {
+                    auto& call = static_cast<FuncCall&>(**site.call);
+                    auto& callee = *call.function->def;
+                    auto result = callee.returnType;
+                    // The call of a function without result has to be the whole statement, which goes away
+                    if (!movable(site, call) || (!result && (site.call != root || !dynamic_cast<ExprStmt*>(stmt.get()))))
+                    {
+                        break;
+                    }
+
+                    Cloner cloner{*caller};
+                    for (std::size_t i = 0; i < call.args.size(); i++)
+                    {
+                        auto param = callee.parameters[i];
+                        auto var = freshLocal(*caller, param->name, param->type);
+                        cloner.renamed[param] = var;
+                        auto offset = call.args[i]->offset;
+                        copies.push_back(std::make_unique<VarDecl>(var, std::move(call.args[i])));
+                        copies.back()->offset = offset;
+                    }
+                    auto& body = callee.block->stmts;
+                    auto last = body.empty() ? nullptr : dynamic_cast<Return*>(body.back().get());
+                    for (std::size_t i = 0; i < body.size() - (last != nullptr); i++)
+                    {
+                        copies.push_back(cloner.clone(*body[i]));
+                        report.copiedNodes += countNodes(*copies.back());
+                    }
+
+                    report.inlined++;
+                    inlinedFunctions.insert(&callee);
+                    if (!result)
+                    {
+                        keep = false;
+                        break;
+                    }
+                    auto var = freshLocal(*caller, callee.name, result);
+                    auto offset = call.offset;
+                    copies.push_back(std::make_unique<VarDecl>(var, cloner.clone(*last->expr)));
+                    copies.back()->offset = offset;
+                    report.copiedNodes += countNodes(*copies.back());
+                    *site.call = std::make_unique<VariableAccess>(var);
+                    (*site.call)->offset = offset;
+                }
+                return keep;
+            }
+
+            std::size_t threshold;
+            InlineReport& report;
+            std::unordered_map<const FuncDef*, Callee> callees;
+            std::unordered_set<const FuncDef*> inlinedFunctions;
+            FuncDef* caller = nullptr;
+        };
+    }
+
+    auto inlineCalls(Program& program, std::size_t threshold) -> InlineReport
+    {
+        std::optional<Arena::Scope> scope;
+        if (program.arena)
+        {
+            scope.emplace(*program.arena);
+        }
+
+        InlineReport report;
+        Inliner{threshold, report}.visit(program);
+        return report;
+    }
+}
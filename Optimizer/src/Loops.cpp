@@ -0,0 +1,461 @@
+#include "Loops.hpp"
+#include "Optimizer.hpp"
+#include <map>
+#include <optional>
+#include <utility>
+
+namespace language
+{
+    namespace
+    {
+        // The expressions directly in statements, nested statements included
+        struct Roots : public Visitor
+        {
+            std::vector<std::unique_ptr<Expr>*> exprs;
+
+            void visit(VarDecl& decl) override
+            {
+                exprs.push_back(&decl.init);
+            }
+            void visit(FuncDef&) override
+            {
+            }
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    stmt->accept(*this);
+                }
+            }
+            void visit(If& ifStmt) override
+            {
+                exprs.push_back(&ifStmt.expr);
+                ifStmt.trueStmt->accept(*this);
+                if (ifStmt.falseStmt)
+                {
+                    ifStmt.falseStmt->accept(*this);
+                }
+            }
+            void visit(While& whileStmt) override
+            {
+                exprs.push_back(&whileStmt.expr);
+                whileStmt.stmt->accept(*this);
+            }
+            void visit(Return& returnStmt) override
+            {
+                if (returnStmt.expr)
+                {
+                    exprs.push_back(&returnStmt.expr);
+                }
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                exprs.push_back(&exprStmt.expr);
+            }
+            void visit(FuncCall&) override
+            {
+            }
+            void visit(BinExpr&) override
+            {
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess&) override
+            {
+            }
+            void visit(Program&) override
+            {
+            }
+        };
+
+        auto wrap(long long value) -> int
+        {
+            return static_cast<int>(static_cast<unsigned>(value));
+        }
+
+        // i = i + c or i = c + i or i = i - c
+        struct Induction
+        {
+            SymbolTable::Variable* var;
+            int step;
+        };
+
+        // A factor of a product with the induction variable, either a variable or a literal value
+        using Factor = std::pair<SymbolTable::Variable*, int>;
+
+        /*
+            Every statement visit optimizes the loops in it. The declarations a While needs in front of it
+            are left in prelude, statement puts them and the loop in a Block.
+        */
+        class LoopOptimizer : public Visitor
+        {
+        public:
+            LoopOptimizer(Program& program, LoopReport& report) : intType{&std::get<SymbolTable::Type>(program.sym_table->get("int"))}, report{report}
+            {
+            }
+
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    if (auto def = dynamic_cast<FuncDef*>(decl.get()))
+                    {
+                        def->accept(*this);
+                    }
+                }
+            }
+
+            void visit(FuncDef& def) override
+            {
+                function = &def;
+                for (auto& stmt : def.block->stmts)
+                {
+                    statement(stmt);
+                }
+            }
+
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    statement(stmt);
+                }
+            }
+
+            void visit(If& ifStmt) override
+            {
+                statement(ifStmt.trueStmt);
+                if (ifStmt.falseStmt)
+                {
+                    statement(ifStmt.falseStmt);
+                }
+            }
+
+            // Outer loops hoist first, so an invariant goes in front of the outermost loop it is invariant in.
+            // Inner loops are reduced first, so the outer loop sees the products hoisted out of them
+            void visit(While& whileStmt) override
+            {
+                report.loops++;
+                loop = effects(whileStmt);
+                Roots roots;
+                whileStmt.accept(roots);
+                for (auto root : roots.exprs)
+                {
+                    if (hoist(*root))
+                    {
+                        precompute(*root);
+                    }
+                }
+
+                auto hoisted = std::move(prelude);
+                prelude.clear();
+                statement(whileStmt.stmt);
+                prelude = std::move(hoisted);
+
+                loop = effects(whileStmt);
+                reduce(whileStmt);
+            }
+
+            void visit(VarDecl&) override
+            {
+            }
+            void visit(Return&) override
+            {
+            }
+            void visit(ExprStmt&) override
+            {
+            }
+            void visit(FuncCall&) override
+            {
+            }
+            void visit(BinExpr&) override
+            {
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess&) override
+            {
+            }
+
+        private:
+            auto statement(std::unique_ptr<Stmt>& stmt) -> void
+            {
+                stmt->accept(*this);
+                if (!prelude.empty())
+                {
+                    auto offset = stmt->offset;
+                    prelude.push_back(std::move(stmt));
+                    stmt = std::make_unique<Block>(std::move(prelude), nullptr);
+                    stmt->offset = offset;
+                    prelude.clear();
+                }
+            }
+
+            auto invariant(const SymbolTable::Variable& var) const -> bool
+            {
+                return !loop.writes.contains(&var) && (var.scope != SymbolTable::Scope::Global || loop.calls.empty());
+            }
+
+            // Whether the whole expression is invariant, its largest invariant subtrees are precomputed otherwise
+            auto hoist(std::unique_ptr<Expr>& expr) -> bool
+            {
+                if (auto access = dynamic_cast<VariableAccess*>(expr.get()))
+                {
+                    return invariant(*access->var);
+                }
+                if (auto call = dynamic_cast<FuncCall*>(expr.get()))
+                {
+                    for (auto& arg : call->args)
+                    {
+                        if (hoist(arg))
+                        {
+                            precompute(arg);
+                        }
+                    }
+                    return false;
+                }
+                auto bin = dynamic_cast<BinExpr*>(expr.get());
+                if (!bin)
+                {
+                    return !dynamic_cast<StrLiteral*>(expr.get());
+                }
+                if (bin->op == BinOperator::Assign)
+                {
+                    if (hoist(bin->rightHs))
+                    {
+                        precompute(bin->rightHs);
+                    }
+                    return false;
+                }
+                auto left = hoist(bin->leftHs);
+                auto right = hoist(bin->rightHs);
+                if (left && right && isPure(*bin))
+                {
+                    return true;
+                }
+                if (left)
+                {
+                    precompute(bin->leftHs);
+                }
+                if (right)
+                {
+                    precompute(bin->rightHs);
+                }
+                return false;
+            }
+
+            // Only operators are worth a local, a pure expression can be evaluated even if the loop never runs
+            auto precompute(std::unique_ptr<Expr>& expr) -> void
+            {
+                if (!dynamic_cast<BinExpr*>(expr.get()))
+                {
+                    return;
+                }
+                auto var = freshLocal(*function, "invariant", expr->type);
+                auto offset = expr->offset;
+                prelude.push_back(std::make_unique<VarDecl>(var, std::move(expr)));
+                prelude.back()->offset = offset;
+                expr = std::make_unique<VariableAccess>(var);
+                expr->offset = offset;
+                report.hoisted++;
+            }
+
+            auto induction(Stmt& stmt) const -> std::optional<Induction>
+            {
+                auto exprStmt = dynamic_cast<ExprStmt*>(&stmt);
+                auto assign = exprStmt ? dynamic_cast<BinExpr*>(exprStmt->expr.get()) : nullptr;
+                if (!assign || assign->op != BinOperator::Assign)
+                {
+                    return std::nullopt;
+                }
+                auto target = dynamic_cast<VariableAccess*>(assign->leftHs.get());
+                auto update = dynamic_cast<BinExpr*>(assign->rightHs.get());
+                if (!target || target->var->type != intType || target->var->scope == SymbolTable::Scope::Global || !update ||
+                    update->type != intType || (update->op != BinOperator::Plus && update->op != BinOperator::Minus))
+                {
+                    return std::nullopt;
+                }
+                auto is = [&](Expr& expr)
+                {
+                    auto access = dynamic_cast<VariableAccess*>(&expr);
+                    return access && access->var == target->var;
+                };
+                auto left = dynamic_cast<IntLiteral*>(update->leftHs.get());
+                auto right = dynamic_cast<IntLiteral*>(update->rightHs.get());
+                if (is(*update->leftHs) && right)
+                {
+                    return Induction{target->var, update->op == BinOperator::Plus ? right->v : wrap(-static_cast<long long>(right->v))};
+                }
+                if (update->op == BinOperator::Plus && left && is(*update->rightHs))
+                {
+                    return Induction{target->var, left->v};
+                }
+                return std::nullopt;
+            }
+
+            auto factor(const Induction& induction, Expr& mul, Expr& other) const -> std::optional<Factor>
+            {
+                auto access = dynamic_cast<VariableAccess*>(&mul);
+                if (!access || access->var != induction.var)
+                {
+                    return std::nullopt;
+                }
+                if (auto lit = dynamic_cast<IntLiteral*>(&other))
+                {
+                    return Factor{nullptr, lit->v};
+                }
+                auto var = dynamic_cast<VariableAccess*>(&other);
+                if (var && var->var->type == intType && var->var != induction.var && invariant(*var->var))
+                {
+                    return Factor{var->var, 0};
+                }
+                return std::nullopt;
+            }
+
+            auto products(std::unique_ptr<Expr>& expr, const Induction& induction, std::vector<std::pair<std::unique_ptr<Expr>*, Factor>>& found) const -> void
+            {
+                if (auto call = dynamic_cast<FuncCall*>(expr.get()))
+                {
+                    for (auto& arg : call->args)
+                    {
+                        products(arg, induction, found);
+                    }
+                    return;
+                }
+                auto bin = dynamic_cast<BinExpr*>(expr.get());
+                if (!bin)
+                {
+                    return;
+                }
+                if (bin->op == BinOperator::Mul && bin->type == intType)
+                {
+                    auto k = factor(induction, *bin->leftHs, *bin->rightHs);
+                    if (!k)
+                    {
+                        k = factor(induction, *bin->rightHs, *bin->leftHs);
+                    }
+                    if (k)
+                    {
+                        found.emplace_back(&expr, *k);
+                        return;
+                    }
+                }
+                products(bin->leftHs, induction, found);
+                products(bin->rightHs, induction, found);
+            }
+
+            auto reduce(While& whileStmt) -> void
+            {
+                auto body = dynamic_cast<Block*>(whileStmt.stmt.get());
+                auto step = body && !body->stmts.empty() ? induction(*body->stmts.back()) : std::nullopt;
+                if (!step)
+                {
+                    return;
+                }
+                auto post = std::move(body->stmts.back());
+                body->stmts.pop_back();
+                auto rest = effects(whileStmt);
+                if (rest.writes.contains(step->var))
+                {
+                    body->stmts.push_back(std::move(post));
+                    return;
+                }
+                report.counted++;
+
+                std::vector<std::pair<std::unique_ptr<Expr>*, Factor>> found;
+                Roots roots;
+                whileStmt.accept(roots);
+                for (auto root : roots.exprs)
+                {
+                    products(*root, *step, found);
+                }
+                body->stmts.push_back(std::move(post));
+
+                std::map<Factor, SymbolTable::Variable*> derived;
+                for (auto [slot, k] : found)
+                {
+                    auto& var = derived[k];
+                    if (!var)
+                    {
+                        var = derive(*step, k, *body);
+                    }
+                    auto offset = (*slot)->offset;
+                    *slot = std::make_unique<VariableAccess>(var);
+                    (*slot)->offset = offset;
+                    report.reduced++;
+                }
+            }
+
+            // Declares the variable for i * k in front of the loop and steps it at the end of the body
+            auto derive(const Induction& induction, const Factor& k, Block& body) -> SymbolTable::Variable*
+            {
+                auto factor = [&]() -> std::unique_ptr<Expr>
+                {
+                    if (k.first)
+                        return std::make_unique<VariableAccess>(k.first);
+                    return std::make_unique<IntLiteral>(k.second, intType);
+                };
+                auto var = freshLocal(*function, induction.var->name, intType);
+                prelude.push_back(std::make_unique<VarDecl>(var, std::make_unique<BinExpr>(std::make_unique<VariableAccess>(induction.var), factor(), BinOperator::Mul, intType)));
+
+                std::unique_ptr<Expr> step;
+                if (!k.first)
+                {
+                    step = std::make_unique<IntLiteral>(wrap(static_cast<long long>(induction.step) * k.second), intType);
+                }
+                else if (induction.step == 1)
+                {
+                    step = factor();
+                }
+                else
+                {
+                    auto scaled = freshLocal(*function, "step", intType);
+                    prelude.push_back(std::make_unique<VarDecl>(scaled, std::make_unique<BinExpr>(factor(), std::make_unique<IntLiteral>(induction.step, intType), BinOperator::Mul, intType)));
+                    step = std::make_unique<VariableAccess>(scaled);
+                }
+                auto next = std::make_unique<BinExpr>(std::make_unique<VariableAccess>(var), std::move(step), BinOperator::Plus, intType);
+                body.stmts.push_back(std::make_unique<ExprStmt>(std::make_unique<BinExpr>(std::make_unique<VariableAccess>(var), std::move(next), BinOperator::Assign, intType)));
+                return var;
+            }
+
+            SymbolTable::Type* intType;
+            LoopReport& report;
+            FuncDef* function = nullptr;
+            Effects loop;
+            std::vector<std::unique_ptr<Stmt>> prelude;
+        };
+    }
+
+    auto optimizeLoops(Program& program) -> LoopReport
+    {
+        std::optional<Arena::Scope> scope;
+        if (program.arena)
+        {
+            scope.emplace(*program.arena);
+        }
+
+        LoopReport report;
+        LoopOptimizer{program, report}.visit(program);
+        return report;
+    }
+}
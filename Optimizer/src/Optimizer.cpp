@@ -0,0 +1,283 @@
+#include "Optimizer.hpp"
+#include "Fold.hpp"
+#include "DeadCode.hpp"
+#include "Inline.hpp"
+#include "Loops.hpp"
+#include <format>
+
+namespace language
+{
+    namespace
+    {
+        struct NodeCounter : public Visitor
+        {
+            std::size_t nodes = 0;
+
+            void count(Visitable* node)
+            {
+                if (node)
+                {
+                    node->accept(*this);
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                nodes++;
+                count(decl.init.get());
+            }
+            void visit(FuncDef& def) override
+            {
+                nodes++;
+                count(def.block.get());
+            }
+            void visit(Block& block) override
+            {
+                nodes++;
+                for (auto& stmt : block.stmts)
+                {
+                    count(stmt.get());
+                }
+            }
+            void visit(If& ifStmt) override
+            {
+                nodes++;
+                count(ifStmt.expr.get());
+                count(ifStmt.trueStmt.get());
+                count(ifStmt.falseStmt.get());
+            }
+            void visit(While& whileStmt) override
+            {
+                nodes++;
+                count(whileStmt.expr.get());
+                count(whileStmt.stmt.get());
+            }
+            void visit(Return& returnStmt) override
+            {
+                nodes++;
+                count(returnStmt.expr.get());
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                nodes++;
+                count(exprStmt.expr.get());
+            }
+            void visit(FuncCall& funcCall) override
+            {
+                nodes++;
+                for (auto& arg : funcCall.args)
+                {
+                    count(arg.get());
+                }
+            }
+            void visit(BinExpr& binExpr) override
+            {
+                nodes++;
+                count(binExpr.leftHs.get());
+                count(binExpr.rightHs.get());
+            }
+            void visit(StrLiteral&) override
+            {
+                nodes++;
+            }
+            void visit(IntLiteral&) override
+            {
+                nodes++;
+            }
+            void visit(FloatLiteral&) override
+            {
+                nodes++;
+            }
+            void visit(BooleanLiteral&) override
+            {
+                nodes++;
+            }
+            void visit(VariableAccess&) override
+            {
+                nodes++;
+            }
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    count(decl.get());
+                }
+            }
+        };
+
+        struct EffectCollector : public Visitor
+        {
+            Effects effects;
+
+            void scan(Visitable* node)
+            {
+                if (node)
+                {
+                    node->accept(*this);
+                }
+            }
+
+            void visit(VarDecl& decl) override
+            {
+                effects.writes.insert(decl.var);
+                scan(decl.init.get());
+            }
+            void visit(FuncDef& def) override
+            {
+                scan(def.block.get());
+            }
+            void visit(Block& block) override
+            {
+                for (auto& stmt : block.stmts)
+                {
+                    scan(stmt.get());
+                }
+            }
+            void visit(If& ifStmt) override
+            {
+                scan(ifStmt.expr.get());
+                scan(ifStmt.trueStmt.get());
+                scan(ifStmt.falseStmt.get());
+            }
+            void visit(While& whileStmt) override
+            {
+                scan(whileStmt.expr.get());
+                scan(whileStmt.stmt.get());
+            }
+            void visit(Return& returnStmt) override
+            {
+                effects.returns++;
+                scan(returnStmt.expr.get());
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                scan(exprStmt.expr.get());
+            }
+            void visit(FuncCall& funcCall) override
+            {
+                effects.calls.push_back(funcCall.function->def);
+                for (auto& arg : funcCall.args)
+                {
+                    scan(arg.get());
+                }
+            }
+            void visit(BinExpr& binExpr) override
+            {
+                auto target = binExpr.op == BinOperator::Assign ? dynamic_cast<VariableAccess*>(binExpr.leftHs.get()) : nullptr;
+                if (target)
+                    effects.writes.insert(target->var);
+                else
+                    scan(binExpr.leftHs.get());
+                scan(binExpr.rightHs.get());
+            }
+            void visit(StrLiteral&) override
+            {
+            }
+            void visit(IntLiteral&) override
+            {
+            }
+            void visit(FloatLiteral&) override
+            {
+            }
+            void visit(BooleanLiteral&) override
+            {
+            }
+            void visit(VariableAccess& access) override
+            {
+                effects.reads.insert(access.var);
+            }
+            void visit(Program& program) override
+            {
+                for (auto& decl : program.declarations)
+                {
+                    scan(decl.get());
+                }
+            }
+        };
+
+        // Every variable gets its own naturally aligned slot, like the parser allocates them
+        auto allocate(std::size_t& size, const SymbolTable::Type& type) -> int
+        {
+            size = (size + type.size - 1) / type.size * type.size;
+            auto offset = static_cast<int>(size);
+            size += type.size;
+            return offset;
+        }
+    }
+
+    auto countNodes(Program& program) -> std::size_t
+    {
+        NodeCounter counter;
+        counter.visit(program);
+        return counter.nodes;
+    }
+
+    auto countNodes(Visitable& node) -> std::size_t
+    {
+        NodeCounter counter;
+        counter.count(&node);
+        return counter.nodes;
+    }
+
+    auto effects(Visitable& node) -> Effects
+    {
+        EffectCollector collector;
+        node.accept(collector);
+        return std::move(collector.effects);
+    }
+
+    // The interner size makes the name unique
+    auto freshLocal(FuncDef& def, std::string_view name, SymbolTable::Type* type) -> SymbolTable::Variable*
+    {
+        auto& names = def.params->names();
+        auto symbol = names.intern(std::format("{}.{}", name, names.size()));
+        auto& var = def.params->put(symbol, SymbolTable::Variable{
+            .name = names.name(symbol),
+            .type = type,
+            .scope = SymbolTable::Scope::Local,
+            .offset = allocate(def.frameSize, *type),
+            .active = true,
+            .alive = true,
+            .temp = true
+        });
+        return &std::get<SymbolTable::Variable>(var);
+    }
+
+    auto isPure(Expr& expr) -> bool
+    {
+        if (auto bin = dynamic_cast<BinExpr*>(&expr))
+        {
+            auto divisor = dynamic_cast<IntLiteral*>(bin->rightHs.get());
+            auto safe = bin->op != BinOperator::Div || (divisor && divisor->v != 0) || dynamic_cast<FloatLiteral*>(bin->rightHs.get());
+            return bin->op != BinOperator::Assign && safe && isPure(*bin->leftHs) && isPure(*bin->rightHs);
+        }
+        return dynamic_cast<FuncCall*>(&expr) == nullptr && dynamic_cast<StrLiteral*>(&expr) == nullptr;
+    }
+
+    auto constantCondition(Expr& expr) -> std::optional<bool>
+    {
+        if (auto lit = dynamic_cast<BooleanLiteral*>(&expr))
+            return lit->v;
+        if (auto lit = dynamic_cast<IntLiteral*>(&expr))
+            return lit->v != 0;
+        if (auto lit = dynamic_cast<FloatLiteral*>(&expr))
+            return lit->v != 0;
+        return std::nullopt;
+    }
+
+    auto optimize(Program& program, std::size_t inlineThreshold) -> std::string
+    {
+        auto inlining = inlineThreshold > 0 ? inlineCalls(program, inlineThreshold) : InlineReport{};
+        auto folding = fold(program);
+        auto loops = optimizeLoops(program);
+        auto deadCode = eliminateDeadCode(program);
+        return std::format("inline: {} calls of {} functions, {} nodes copied\n"
+                           "fold: {} folded, {} simplified, {} branches, {} nodes removed\n"
+                           "loops: {} loops, {} counted, {} hoisted, {} reduced\n"
+                           "dead code: {} unreachable, {} dead stores, {} dead variables, {} nodes removed",
+                           inlining.inlined, inlining.functions, inlining.copiedNodes,
+                           folding.folded, folding.simplified, folding.branches, folding.removedNodes,
+                           loops.loops, loops.counted, loops.hoisted, loops.reduced,
+                           deadCode.unreachable, deadCode.deadStores, deadCode.deadVariables, deadCode.removedNodes);
+    }
+}
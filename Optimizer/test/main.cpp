@@ -0,0 +1,258 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "Parser/Parser.hpp"
+#include "Interpreter/Interpreter.hpp"
+#include "Optimizer/Optimizer.hpp"
+#include "Optimizer/Fold.hpp"
+#include "Optimizer/DeadCode.hpp"
+#include "Optimizer/Inline.hpp"
+#include "Optimizer/Loops.hpp"
+#include "Interpreter/VirtualMachine.hpp"
+#include <string>
+
+static auto run(language::Program& program) -> std::string
+{
+    return language::valueToStr(language::Interpreter{program}.run());
+}
+
+TEST_CASE("Constant Folding", "[fold]")
+{
+    std::string source = R"(
+        var big = 2147483647 + 1;
+        var half = 1 / 2 + 1.0 / 4;
+        main(): float {
+            var x = big * 1 + 0;
+            var y = (2 * 3 + 4) * x;
+            var z = 0;
+            if (1 < 2 && true) z = y / 1; else z = 7;
+            while (false || 3 > 4) z = z + 1;
+            var zero = 1 / 0 * 0;
+            if (z * 0 == 0) return z - 0 + half * 1.0;
+            return 0.0;
+        }
+    )";
+    language::Parser p{source};
+    auto program = p.program();
+    auto before = language::countNodes(program);
+
+    auto report = language::fold(program);
+
+    // 2147483647 + 1, 1 / 2, 1.0 / 4, 0 + 0.25, 2 * 3, 6 + 4, 1 < 2, true && true, 3 > 4, false || false, 0 == 0
+    REQUIRE(report.folded == 11);
+    // * 1, + 0, y / 1, z * 0, - 0, half * 1.0
+    REQUIRE(report.simplified == 6);
+    REQUIRE(report.branches == 3);
+    REQUIRE(report.removedNodes == before - language::countNodes(program));
+    REQUIRE(report.removedNodes > 20);
+    // 1 / 0 is left for the runtime error
+    REQUIRE_THROWS_AS(run(program), language::RuntimeError);
+}
+
+TEST_CASE("Folding Keeps Semantics", "[fold]")
+{
+    std::string source = R"(
+        var calls = 0;
+        count(): bool { calls = calls + 1; return true; }
+        main(): int {
+            var a = 7;
+            var b = count() && false;
+            var c = false && count();
+            var d = a * 0 + 2 * 1;
+            var e = (0 - 2147483647 - 1) / (0 - 1);
+            if (b || c) return 0 - 1;
+            return calls * 100 + d + e;
+        }
+    )";
+    language::Parser original{source};
+    auto expected = original.program();
+    language::Parser p{source};
+    auto program = p.program();
+    auto report = language::fold(program);
+
+    REQUIRE(report.folded > 0);
+    REQUIRE(run(program) == run(expected));
+}
+
+TEST_CASE("Dead Code", "[deadcode]")
+{
+    std::string source = R"(
+        var calls = 0;
+        var unused = 3 * 4;
+        count(): int { calls = calls + 1; return calls; }
+        main(): int {
+            var a = 1;
+            var b = a + 2;
+            var c = count();
+            var d = 0;
+            d = count() + 1;
+            a + b;
+            if (false) { a = 5; }
+            while (a < 3) {
+                a = a + 1;
+                return a * 10 + calls;
+                a = 7;
+            }
+            return 0;
+            d = 1;
+        }
+    )";
+    language::Parser original{source};
+    auto expected = original.program();
+    language::Parser p{source};
+    auto program = p.program();
+
+    auto report = language::eliminateDeadCode(program);
+
+    // if (false), a = 7 and d = 1
+    REQUIRE(report.unreachable == 3);
+    // unused, c, d, d = count() + 1 and b once the pure a + b is gone
+    REQUIRE(report.deadStores == 5);
+    REQUIRE(report.deadVariables == 4);
+    REQUIRE(report.removedNodes > 15);
+    REQUIRE(run(program) == run(expected));
+    REQUIRE(run(program) == "22");
+
+    auto& main = *dynamic_cast<language::FuncDef*>(program.declarations.back().get());
+    REQUIRE(std::get<language::SymbolTable::Variable>(main.block->symbols->get("a")).alive);
+    REQUIRE_FALSE(std::get<language::SymbolTable::Variable>(main.block->symbols->get("b")).alive);
+}
+
+TEST_CASE("Inlining", "[inline]")
+{
+    std::string source = R"(
+        var g = 0;
+        sq(x: int): int { return x * x; }
+        scale(x: float, by: int): float { var y = x * by; y = y + 1; return y; }
+        bump(): int { g = g + 1; return g; }
+        note(n: int) { g = g + n; }
+        fib(n: int): int { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }
+        sign(n: int): int { if (n < 0) return 0 - 1; return 1; }
+        main(): float {
+            var a = sq(sq(3));
+            note(a);
+            var b = g + bump();
+            var c = bump() + g;
+            if (a > 0 && sq(2) == 4) a = a + 1;
+            var i = 0;
+            while (sq(i) < 50) i = i + 1;
+            var s = scale(1.5, i);
+            return a + b + c + fib(10) + sign(0 - 3) + s;
+        }
+    )";
+    language::Parser original{source};
+    auto expected = original.program();
+    language::Parser p{source};
+    auto program = p.program();
+
+    auto report = language::inlineCalls(program);
+
+    // sq twice, note, the bump in c and scale. The bump in b would move past the read of g it changes,
+    // sq on the right of && and in the loop condition is not always evaluated once, fib and sign stay
+    REQUIRE(report.inlined == 5);
+    REQUIRE(report.functions == 4);
+    REQUIRE(report.copiedNodes > 20);
+    REQUIRE(run(program) == run(expected));
+    REQUIRE(language::valueToStr(language::VirtualMachine{language::lower(program)}.run()) == run(expected));
+
+    // Helpers that end in return helper(...) still end in a return once inlined into, so chains collapse
+    std::string chained = R"(
+        add(a: int, b: int): int { return a + b; }
+        twice(x: int): int { return add(x, x); }
+        quad(x: int): int { return twice(twice(x)); }
+        main(): int { var t = quad(3); return t; }
+    )";
+    language::Parser c{chained};
+    auto collapsed = c.program();
+    auto chain = language::inlineCalls(collapsed);
+    REQUIRE(chain.inlined == 4);
+    REQUIRE(chain.functions == 3);
+    REQUIRE(language::effects(*collapsed.declarations.back()).calls.empty());
+    REQUIRE(run(collapsed) == "12");
+}
+
+TEST_CASE("Inlining Threshold", "[inline]")
+{
+    std::string source = R"(
+        sq(x: int): int { return x * x; }
+        cube(x: int): int { var y = sq(x); return y * x; }
+        main(): int { return sq(4) + cube(3); }
+    )";
+    language::Parser small{source};
+    auto program = small.program();
+    // sq is six nodes, cube grows past the threshold once sq is inlined into it and its call stays
+    auto report = language::inlineCalls(program, 6);
+    REQUIRE(report.inlined == 2);
+    REQUIRE(report.functions == 1);
+    REQUIRE(run(program) == "43");
+
+    language::Parser none{source};
+    auto untouched = none.program();
+    REQUIRE(language::inlineCalls(untouched, 5).inlined == 0);
+
+    language::Parser all{source};
+    auto optimized = all.program();
+    REQUIRE(language::optimize(optimized).starts_with("inline: 3 calls of 2 functions"));
+    REQUIRE(run(optimized) == "43");
+}
+
+TEST_CASE("Loop Optimization", "[loops]")
+{
+    std::string source = R"(
+        var g = 3;
+        id(x: int): int { return x; }
+        main(): int {
+            var n = 7;
+            var sum = 0;
+            for (var i = 0; i < n * 2; i = i + 1) {
+                for (var j = 10; j > 0; j = j - 3) {
+                    sum = sum + i * n + j * 5 + (n * n + g) / 2;
+                }
+            }
+            var k = 0;
+            while (k < 20) {
+                sum = sum + k * 4 + id(g * 2);
+                k = k + 2;
+                k = k + 1;
+            }
+            return sum;
+        }
+    )";
+    language::Parser original{source};
+    auto expected = original.program();
+    language::Parser p{source};
+    auto program = p.program();
+
+    auto report = language::optimizeLoops(program);
+
+    REQUIRE(report.loops == 3);
+    // k is stepped twice, so only the two for loops are counted
+    REQUIRE(report.counted == 2);
+    // n * 2 and (n * n + g) / 2 in front of the outer loop, i * n in front of the inner one.
+    // g * 2 stays, the call may assign g
+    REQUIRE(report.hoisted == 3);
+    // j * 5 in the inner loop and i * n, now in front of the inner loop, in the outer loop
+    REQUIRE(report.reduced == 2);
+    REQUIRE(run(program) == run(expected));
+    REQUIRE(language::valueToStr(language::VirtualMachine{language::lower(program)}.run()) == run(expected));
+}
+
+TEST_CASE("Induction Wraps Around", "[loops]")
+{
+    std::string source = R"(
+        main(): int {
+            var sum = 0;
+            var big = 1000000;
+            for (var i = 0 - 5; i < 4000; i = i + 7)
+                sum = sum + i * big - i * 3;
+            return sum;
+        }
+    )";
+    language::Parser original{source};
+    auto expected = original.program();
+    language::Parser p{source};
+    auto program = p.program();
+
+    auto report = language::optimizeLoops(program);
+    REQUIRE(report.reduced == 2);
+    REQUIRE(run(program) == run(expected));
+}
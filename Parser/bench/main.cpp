@@ -0,0 +1,186 @@
+#include "Parser/Parser.hpp"
+#include "Parser/Incremental.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace lang = language;
+
+// Identifiers are letters and underscores only
+static auto name(std::size_t i) -> std::string
+{
+    std::string letters;
+    do
+    {
+        letters += static_cast<char>('a' + i % 26);
+        i /= 26;
+    } while (i > 0);
+    return letters;
+}
+
+// Synthetic program with many small functions, each a handful of scopes and expression trees
+static auto makeSource(std::size_t functions) -> std::string
+{
+    std::string source;
+    for (std::size_t i = 0; i < functions; i++)
+    {
+        auto n = name(i);
+        source += "var g_" + n + " = " + std::to_string(i) + ";\n";
+        source += "f_" + n + "(a: int, b: int) {\n";
+        source += "    var x = a + b * 2 - a * 3 * b + 1;\n";
+        source += "    var y = x - 3 * a + 1 / b + 7 + g_" + n + ";\n";
+        source += "    if (x < y) var z = x + 1 * y; else var w = y - 1 + x;\n";
+        source += "    while (x <= 10) var t = x * 2 + y * 3 - a;\n";
+        source += "    return x + y;\n";
+        source += "}\n";
+    }
+    return source;
+}
+
+// Small units that each fail deep in an expression, like fuzzer output or code under edit
+static auto makeInvalidUnits(std::size_t count) -> std::vector<std::string>
+{
+    const char* errors[] = {"x + ;", "x * q", "x $ 1", "(x + 1"};
+    std::vector<std::string> units;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto n = name(i);
+        std::string nested = "a";
+        for (int depth = 0; depth < 12; depth++)
+        {
+            nested = "(" + nested + " + " + std::to_string(depth) + ") * b";
+        }
+        std::string unit = "var g_" + n + " = " + std::to_string(i) + ";\n";
+        unit += "f_" + n + "(a: int, b: int) {\n";
+        unit += "    var x = " + nested + ";\n";
+        unit += "    if (x < 10) { while (x > 0) { x = x - g_" + n + "; } }\n";
+        unit += "    return " + nested + " + " + errors[i % 4] + ";\n";
+        unit += "}\n";
+        units.push_back(std::move(unit));
+    }
+    return units;
+}
+
+// Long flat expressions over every operator level, like generated code, with the number of operands
+static auto makeExpressions(std::size_t functions) -> std::pair<std::string, std::size_t>
+{
+    const char* ops[] = {" + ", " * ", " - ", " < ", " / ", " && ", " + ", " == ", " * ", " || "};
+    std::string source;
+    std::size_t operands = 0;
+    for (std::size_t i = 0; i < functions; i++)
+    {
+        source += "f_" + name(i) + "(a: int, b: int) {\n    var x = a";
+        operands++;
+        for (int operand = 1; operand < 64; operand++)
+        {
+            source += ops[(i + operand) % 10];
+            source += operand % 3 == 0 ? "b" : operand % 3 == 1 ? std::to_string(operand) : "(a - 1)";
+            operands += operand % 3 == 2 ? 2 : 1;
+        }
+        source += ";\n    return x;\n}\n";
+    }
+    return {std::move(source), operands};
+}
+
+static auto peakRssKiB() -> long
+{
+#if defined(_WIN32)
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t functions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    auto source = makeSource(functions);
+    auto baseline = peakRssKiB();
+
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    std::chrono::duration<double, std::milli> parse{}, destroy{};
+    {
+        lang::Parser parser{source};
+        auto program = parser.program();
+        parse = clock::now() - begin;
+        begin = clock::now();
+    }
+    destroy = clock::now() - begin;
+
+    std::cout << "source:  " << source.size() / (1 << 20) << " MB, " << functions << " functions\n";
+    std::cout << "parse:   " << parse.count() << " ms\n";
+    std::cout << "destroy: " << destroy.count() << " ms\n";
+    std::cout << "peak RSS above source: " << (peakRssKiB() - baseline) / 1024 << " MB\n";
+
+    // Single character edits in the middle of a 100k line file, like typing in an editor
+    constexpr std::size_t lines = 100000;
+    lang::IncrementalParser incremental{makeSource(lines / 8)};
+    auto at = incremental.source().find("b * 2", incremental.source().size() / 2) + 4;
+    constexpr int edits = 1000;
+    std::size_t lexed = 0;
+    begin = clock::now();
+    for (int i = 0; i < edits; i++)
+    {
+        // Types a digit and deletes it again
+        lexed += (i % 2 == 0 ? incremental.edit({at, at, "1"}) : incremental.edit({at, at + 1, ""})).lexed;
+    }
+    std::chrono::duration<double, std::micro> reparse = clock::now() - begin;
+
+    begin = clock::now();
+    {
+        lang::Parser parser{incremental.source()};
+        auto program = parser.program();
+    }
+    std::chrono::duration<double, std::micro> full = clock::now() - begin;
+
+    std::cout << "edit in " << lines << " lines: " << reparse.count() / edits << " us, " << lexed / edits
+              << " bytes lexed (full parse " << full.count() << " us)\n";
+
+    auto [expressions, operands] = makeExpressions(20000);
+    begin = clock::now();
+    {
+        lang::Parser parser{expressions};
+        auto program = parser.program();
+    }
+    std::chrono::duration<double, std::nano> expressionParse = clock::now() - begin;
+    std::cout << "expressions: " << expressions.size() / (1 << 20) << " MB, " << expressionParse.count() / operands
+              << " ns per operand\n";
+
+    auto invalid = makeInvalidUnits(20000);
+    std::size_t failed = 0;
+    begin = clock::now();
+    for (auto& unit : invalid)
+    {
+        try
+        {
+            lang::Parser parser{unit};
+            parser.program();
+        }
+        catch (std::runtime_error&)
+        {
+            failed++;
+        }
+    }
+    std::chrono::duration<double, std::micro> throwing = clock::now() - begin;
+
+    failed = 0;
+    begin = clock::now();
+    for (auto& unit : invalid)
+    {
+        lang::Parser parser{unit};
+        failed += !parser.parse();
+    }
+    std::chrono::duration<double, std::micro> values = clock::now() - begin;
+    std::cout << "invalid units: " << throwing.count() / invalid.size() << " us with exceptions, "
+              << values.count() / invalid.size() << " us with expected (" << failed << " failed)\n";
+}
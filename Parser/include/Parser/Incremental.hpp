@@ -0,0 +1,63 @@
+#pragma once
+#include "Parser.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace language
+{
+    // Replaces the bytes [begin, end) of the source by text
+    struct TextEdit
+    {
+        std::size_t begin;
+        std::size_t end;
+        std::string_view text;
+    };
+
+    struct ReparseStats
+    {
+        std::size_t reparsed = 0; // declarations parsed again
+        std::size_t reused = 0;   // declarations kept untouched
+        std::size_t lexed = 0;    // bytes of source lexed
+        bool full = false;        // the edit needed a parse of the whole source
+    };
+
+    /*
+        Keeps a Program in sync with a source under edit, the way an editor or language server needs it.
+        An edit only re-lexes the window between the declarations around it and parses the declarations
+        in there again. Every other declaration, and everything pointing to it, stays as it is, only the
+        source offsets of the nodes after the edit move along: global names declared again keep their
+        symbol table entry. If the declarations in the window can not
+        simply take the place of the old ones, because a global name went away or changed its type or
+        return type, a name is used before its declaration or the window does not parse on its own, the
+        whole source is parsed instead.
+        A failed parse throws and keeps the last Program that parsed, the edited source is kept as well
+        and the next edit parses everything it left broken again.
+    */
+    class IncrementalParser
+    {
+    public:
+        explicit IncrementalParser(std::string source);
+
+        auto edit(const TextEdit& edit) -> ReparseStats;
+        auto program() -> Program&;  // nodes of replaced declarations are released with it
+        auto source() const -> const std::string&;
+
+    private:
+        auto parse() -> void;
+        auto declared(Decl& decl) -> std::pair<Symbol, SymbolTable::entry_type*>;
+        auto shiftSpans(std::size_t from, std::ptrdiff_t delta) -> void;
+        auto shiftDeclarations(std::size_t from, std::ptrdiff_t delta) -> void; // source offsets of their nodes
+        auto damage(std::size_t first, std::size_t last, Span window, std::ptrdiff_t delta) -> void;
+
+        std::string text;
+        std::optional<Program> current;
+        std::vector<Span> spans;        // of the declarations of current in text
+        std::optional<Span> damaged;    // text that did not parse yet
+        std::unordered_map<const SymbolTable::entry_type*, std::size_t> position; // declaration of each global name
+    };
+}
@@ -1,56 +1,130 @@
 #pragma once
 #include "Lexer/Lexer.hpp"
+#include "Lexer/TokenBuffer.hpp"
 #include "Ast/Ast.hpp"
 #include <string>
 #include <memory>
 #include <concepts>
+#include <expected>
+#include <optional>
 #include <stdexcept>
 #include <format>
 #include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "Ast/SymbolTable.hpp"
 
 namespace language
 {
-    class UnexpectedToken : public std::runtime_error
+    // Byte range [begin, end) of a declaration in the source, from its first to the end of its last token
+    struct Span
+    {
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    // A problem found while parsing, line and column count from 1, the column in bytes
+    struct Diagnostic
+    {
+        std::uint32_t line;
+        std::uint32_t column;
+        std::uint32_t offset; // in the source
+        std::string message;
+    };
+
+    // The first problem of a program that was parsed with Parser::program
+    class ParseError : public std::runtime_error
     {
     public:
-        template <std::same_as<TokenType>... TArgs>
-        UnexpectedToken(const Token &token, TArgs... expectedTokenTypes) : std::runtime_error(std::format(
-                                                                               "Unexpected Token {} at ({},{}), expected any of " +
-                                                                                   ((tokenTypeToStr(expectedTokenTypes) + ", ") + ...),
-                                                                               tokenTypeToStr(token.type), token.lexem))
+        explicit ParseError(Diagnostic diagnostic) : std::runtime_error(diagnostic.message), diagnostic{std::move(diagnostic)}
         {
         }
+
+        Diagnostic diagnostic;
     };
 
+    template <typename T>
+    using Parsed = std::expected<T, Diagnostic>;
+
+    /*
+        Every grammar rule returns its node or the diagnostic of the first problem in it, errors are
+        handed up as values and nothing is thrown on invalid input. Only program and declarations turn
+        the diagnostic into an exception.
+    */
     class Parser
     {
     public:
-        Parser(const std::string &program);
-        auto program() -> Program;
-        auto declaration() -> std::unique_ptr<Decl>;
-        auto variableDeclaration() -> std::unique_ptr<VarDecl>;
-        auto functionDefinition() -> std::unique_ptr<FuncDef>;
-        auto parameterList() -> void;
-        auto block() -> std::unique_ptr<Block>;
-        auto statement() -> std::unique_ptr<Stmt>;
-        auto ifStatement() -> std::unique_ptr<If>;
-        auto whileStatement() -> std::unique_ptr<While>;
-        auto forStatement() -> std::unique_ptr<Stmt>;
-        auto returnStatement() -> std::unique_ptr<Return>;
-        auto expressionStatement() -> std::unique_ptr<ExprStmt>;
-        auto assignment() -> std::unique_ptr<Expr>;
-        auto logicalOr() -> std::unique_ptr<Expr>;
-        auto logicalAnd() -> std::unique_ptr<Expr>;
-        auto comparision() -> std::unique_ptr<Expr>;
-        auto term() -> std::unique_ptr<Expr>;
-        auto product() -> std::unique_ptr<Expr>;
-        auto primary() -> std::unique_ptr<Expr>;
-        auto argumentList() -> std::vector<std::unique_ptr<Expr>>;
+        using Entries = std::unordered_map<Symbol, SymbolTable::entry_type*>;
+
+        Parser(std::string_view program); // program has to outlive the parser and the resulting Program
+        Parser(const TokenBuffer& tokens); // parses pretokenized input, tokens has to outlive the parser
+
+        /*
+            Parses the whole program without stopping at the first error. Every lexical, syntax or name
+            error is added to diagnostics, then the parser skips ahead to the end of the statement, the end
+            of the block or the next top level declaration and goes on from there. The Program only holds
+            what parsed, it is only good to run if no diagnostic was added.
+        */
+        Parser(std::string_view program, std::vector<Diagnostic>& diagnostics);
+
+        /*
+            Continues program with the declarations in window, the part of its source that starts at byte
+            base. Redeclaring one of the replaced global names reuses its root entry, so the rest of the
+            program that points to it stays valid. See IncrementalParser.
+        */
+        Parser(std::string_view window, std::uint32_t base, Program& program, Entries replaced);
+
+        auto parse() -> Parsed<Program>;
+        auto program() -> Program; // throws ParseError
+        auto declarations() -> std::vector<std::unique_ptr<Decl>>; // of the window, adds them to its root scope, throws ParseError
+        auto rollback() -> void; // leaves the continued program as it was before declarations()
+        auto spans() const -> const std::vector<Span>&; // of the parsed declarations
+        // Root entries the window refers to, each with the index of the window declaration it is used in
+        auto references() const -> const std::vector<std::pair<const SymbolTable::entry_type*, std::size_t>>&;
+        auto declaration() -> Parsed<std::unique_ptr<Decl>>;
+        auto variableDeclaration() -> Parsed<std::unique_ptr<VarDecl>>;
+        auto functionDefinition() -> Parsed<std::unique_ptr<FuncDef>>;
+        auto parameterList() -> Parsed<std::vector<SymbolTable::Variable*>>;
+        auto typeSpecifier() -> Parsed<SymbolTable::Type*>;
+        auto block() -> Parsed<std::unique_ptr<Block>>;
+        auto statement() -> Parsed<std::unique_ptr<Stmt>>;
+        auto ifStatement() -> Parsed<std::unique_ptr<If>>;
+        auto whileStatement() -> Parsed<std::unique_ptr<While>>;
+        auto forStatement() -> Parsed<std::unique_ptr<Stmt>>;
+        auto returnStatement() -> Parsed<std::unique_ptr<Return>>;
+        auto expressionStatement() -> Parsed<std::unique_ptr<ExprStmt>>;
+        // Binary operators binding tighter than precedence, see the operator table in Parser.cpp
+        auto expression(int precedence = 0) -> Parsed<std::unique_ptr<Expr>>;
+        auto prefix() -> Parsed<std::unique_ptr<Expr>>;
+        auto primary() -> Parsed<std::unique_ptr<Expr>>;
+        auto argumentList() -> Parsed<std::vector<std::unique_ptr<Expr>>>;
 
     private:
         auto advance() -> void;
+        auto lex() -> Token;
         auto peek() -> const Token &;
+        auto symbol(const Token &token) -> Symbol;
+        auto allocate(std::size_t& size, const SymbolTable::Type& type) -> int;
+        auto redeclare(Symbol name) -> SymbolTable::entry_type*;
+        auto global(const Token& name, SymbolTable::entry_type entry) -> Parsed<SymbolTable::entry_type*>;
+        auto arithmeticType(const Expr& left, const Expr& right) -> SymbolTable::Type*;
+        auto fail(const Token& at, std::string message) -> std::unexpected<Diagnostic>;
+        auto invalid(std::uint32_t offset) -> Diagnostic;
+        auto report(Diagnostic diagnostic) -> void;
+        auto recover(Diagnostic diagnostic, SymbolTable* scope) -> void;
+        auto skipStatement() -> void;
+        auto skipDeclaration() -> void;
+
+        template <std::same_as<TokenType>... TArgs>
+        auto unexpected(TArgs... expectedTokenTypes) -> std::unexpected<Diagnostic>
+        {
+            std::string expected;
+            ((expected += (expected.empty() ? "" : ", ") + tokenTypeToStr(expectedTokenTypes)), ...);
+            // The position is in the Diagnostic
+            return fail(peek(), std::format("Unexpected Token {} '{}', expected any of {}",
+                                            tokenTypeToStr(peek().type), peek().lexem, expected));
+        }
 
         template <typename... TArgs>
         auto match(TokenType first, TArgs... tokenTypes) -> bool
@@ -67,25 +141,60 @@ namespace language
         }
 
         template <std::same_as<TokenType>... TArgs>
-        auto consume(TokenType first, TArgs... tokenTypes) -> void
+        auto consume(TokenType first, TArgs... tokenTypes) -> Parsed<void>
         {
-            if (peek().type == first)
+            if (peek().type != first)
+            {
+                return unexpected(first);
+            }
+            advance();
+            if constexpr (sizeof...(tokenTypes) > 0)
             {
-                advance();
-                if constexpr (sizeof...(tokenTypes) > 0)
-                {
-                    consume(tokenTypes...);
-                }
+                return consume(tokenTypes...);
             }
-            else
+            return {};
+        }
+
+        // Gives a parsed statement or expression the source offset of its first token
+        template <typename T>
+        static auto located(Parsed<std::unique_ptr<T>> node, std::uint32_t offset) -> Parsed<std::unique_ptr<T>>
+        {
+            if (node)
             {
-                throw UnexpectedToken(peek(), first);
+                (*node)->offset = offset;
             }
+            return node;
         }
 
+        std::unique_ptr<Interner> ownedNames; // handed over to the Program
+        Interner* names;
+        std::uint32_t base;         // of the lexer buffer in the source
+        std::string_view source;    // up to the end of a window
+        LineIndex lines;            // of source
+        std::vector<Diagnostic>* diagnostics; // errors are collected instead of returned if set
+        std::optional<std::uint32_t> invalidAt; // first invalid character otherwise, the input ends there
         Lexer lexer;
         Token next;
+        TokenType last;             // type of the token advanced over last
         SymbolTable* top;
+        SymbolTable::Type* intType;
+        SymbolTable::Type* floatType;
+        SymbolTable::Type* boolType;
+        std::size_t frameSize;      // of the function being parsed
+        std::size_t globalsSize;
+        const TokenBuffer* tokens;
+        std::size_t cursor;
+        std::uint32_t consumed;     // end of the last token advanced over
+        std::vector<Span> declSpans;
+
+        // State of a continued program, to resolve redeclarations and to undo the parse
+        Program* continued;
+        Entries replaced;
+        std::vector<std::pair<SymbolTable::entry_type*, SymbolTable::entry_type>> overwritten;
+        std::vector<Symbol> declared;
+        std::size_t childrenBefore;
+        std::size_t globalsBefore;
+        std::vector<std::pair<const SymbolTable::entry_type*, std::size_t>> used;
     };
 
 }
@@ -0,0 +1,367 @@
+#include "Incremental.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace language
+{
+    namespace
+    {
+        // Moves the source offsets of every statement and expression under a declaration
+        struct OffsetShifter : public Visitor
+        {
+            explicit OffsetShifter(std::uint32_t by) : by{by}
+            {
+            }
+
+            std::uint32_t by;
+
+            void visit(VarDecl& decl) override
+            {
+                decl.offset += by;
+                decl.init->accept(*this);
+            }
+            void visit(FuncDef& def) override
+            {
+                def.block->accept(*this);
+            }
+            void visit(Block& block) override
+            {
+                block.offset += by;
+                for (auto& stmt : block.stmts)
+                {
+                    stmt->accept(*this);
+                }
+            }
+            void visit(If& ifStmt) override
+            {
+                ifStmt.offset += by;
+                ifStmt.expr->accept(*this);
+                ifStmt.trueStmt->accept(*this);
+                if (ifStmt.falseStmt)
+                {
+                    ifStmt.falseStmt->accept(*this);
+                }
+            }
+            void visit(While& whileStmt) override
+            {
+                whileStmt.offset += by;
+                whileStmt.expr->accept(*this);
+                whileStmt.stmt->accept(*this);
+            }
+            void visit(Return& returnStmt) override
+            {
+                returnStmt.offset += by;
+                if (returnStmt.expr)
+                {
+                    returnStmt.expr->accept(*this);
+                }
+            }
+            void visit(ExprStmt& exprStmt) override
+            {
+                exprStmt.offset += by;
+                exprStmt.expr->accept(*this);
+            }
+            void visit(FuncCall& call) override
+            {
+                call.offset += by;
+                for (auto& arg : call.args)
+                {
+                    arg->accept(*this);
+                }
+            }
+            void visit(BinExpr& expr) override
+            {
+                expr.offset += by;
+                expr.leftHs->accept(*this);
+                expr.rightHs->accept(*this);
+            }
+            void visit(StrLiteral& lit) override
+            {
+                lit.offset += by;
+            }
+            void visit(IntLiteral& lit) override
+            {
+                lit.offset += by;
+            }
+            void visit(FloatLiteral& lit) override
+            {
+                lit.offset += by;
+            }
+            void visit(BooleanLiteral& lit) override
+            {
+                lit.offset += by;
+            }
+            void visit(VariableAccess& access) override
+            {
+                access.offset += by;
+            }
+            void visit(Program&) override
+            {
+            }
+        };
+    }
+
+    IncrementalParser::IncrementalParser(std::string source) : text{std::move(source)}
+    {
+        parse();
+    }
+
+    auto IncrementalParser::program() -> Program&
+    {
+        return *current;
+    }
+
+    auto IncrementalParser::source() const -> const std::string&
+    {
+        return text;
+    }
+
+    auto IncrementalParser::parse() -> void
+    {
+        Parser parser{text};
+        auto program = parser.program();
+        // Assigning would release the old arena before the nodes in it
+        current.reset();
+        current.emplace(std::move(program));
+        spans = parser.spans();
+        damaged.reset();
+        position.clear();
+        for (std::size_t i = 0; i < current->declarations.size(); i++)
+        {
+            position[declared(*current->declarations[i]).second] = i;
+        }
+    }
+
+    auto IncrementalParser::declared(Decl& decl) -> std::pair<Symbol, SymbolTable::entry_type*>
+    {
+        auto def = dynamic_cast<FuncDef*>(&decl);
+        auto name = def ? def->name : dynamic_cast<VarDecl&>(decl).var->name;
+        auto& root = *current->sym_table;
+        auto symbol = root.names().find(name);
+        return {symbol, &root.get(symbol)};
+    }
+
+    auto IncrementalParser::damage(std::size_t first, std::size_t last, Span window, std::ptrdiff_t delta) -> void
+    {
+        // The old declarations stay until the window parses, their spans cover all of it
+        std::fill(spans.begin() + first, spans.begin() + last, window);
+        shiftSpans(last, delta);
+        shiftDeclarations(last, delta);
+        damaged = window;
+    }
+
+    auto IncrementalParser::shiftSpans(std::size_t from, std::ptrdiff_t delta) -> void
+    {
+        // Unsigned wrap around adds negative deltas too
+        auto by = static_cast<std::uint32_t>(delta);
+        for (auto span = spans.begin() + from; span != spans.end(); span++)
+        {
+            span->begin += by;
+            span->end += by;
+        }
+    }
+
+    auto IncrementalParser::shiftDeclarations(std::size_t from, std::ptrdiff_t delta) -> void
+    {
+        if (delta == 0)
+        {
+            return;
+        }
+        OffsetShifter shifter{static_cast<std::uint32_t>(delta)}; // wraps around for negative deltas
+        for (auto decl = current->declarations.begin() + from; decl != current->declarations.end(); decl++)
+        {
+            (*decl)->accept(shifter);
+        }
+    }
+
+    auto IncrementalParser::edit(const TextEdit& edit) -> ReparseStats
+    {
+        if (edit.begin > edit.end || edit.end > text.size())
+        {
+            throw std::out_of_range("Edit outside of the source");
+        }
+        auto delta = static_cast<std::ptrdiff_t>(edit.text.size()) - static_cast<std::ptrdiff_t>(edit.end - edit.begin);
+        auto size = text.size();
+        text.replace(edit.begin, edit.end - edit.begin, edit.text);
+
+        // Until here the region is in the coordinates of the source before the edit
+        auto begin = edit.begin;
+        auto end = edit.end;
+        if (damaged)
+        {
+            begin = std::min<std::size_t>(begin, damaged->begin);
+            end = std::max<std::size_t>(end, damaged->end);
+        }
+
+        // Declarations touching the region, an edit right at their border can change their first token
+        auto first = static_cast<std::size_t>(std::partition_point(spans.begin(), spans.end(), [&](Span span)
+        {
+            return span.end < begin;
+        }) - spans.begin());
+        auto last = static_cast<std::size_t>(std::partition_point(spans.begin() + first, spans.end(), [&](Span span)
+        {
+            return span.begin <= end;
+        }) - spans.begin());
+
+        // The window runs from the end of the declaration before to the start of the one after. Declarations
+        // end with ; or }, but the last token of the window must not run into the next declaration.
+        std::size_t windowBegin = first > 0 ? spans[first - 1].end : 0;
+        std::size_t windowEnd = size;
+        for (; last < spans.size(); last++)
+        {
+            windowEnd = spans[last].begin;
+            auto at = windowEnd + delta;
+            if (at == windowBegin)
+            {
+                break;
+            }
+            auto c = static_cast<unsigned char>(text[at - 1]);
+            if (!(std::isalnum(c) || c == '_' || c == '.'))
+            {
+                break;
+            }
+            windowEnd = size;
+        }
+        Span window{static_cast<std::uint32_t>(windowBegin), static_cast<std::uint32_t>(windowEnd + delta)};
+
+        auto& program = *current;
+        auto& root = *program.sym_table;
+        Parser::Entries replaced;
+        std::vector<std::pair<SymbolTable::entry_type*, SymbolTable::entry_type>> before;
+        std::vector<SymbolTable*> scopes;
+        for (auto i = first; i < last; i++)
+        {
+            auto [symbol, entry] = declared(*program.declarations[i]);
+            replaced.emplace(symbol, entry);
+            before.emplace_back(entry, *entry);
+            if (auto def = dynamic_cast<FuncDef*>(program.declarations[i].get()))
+            {
+                scopes.push_back(def->params);
+            }
+        }
+
+        ReparseStats stats;
+        auto full = [&]
+        {
+            try
+            {
+                parse();
+            }
+            catch (...)
+            {
+                damage(first, last, window, delta);
+                throw;
+            }
+            stats.reparsed = current->declarations.size();
+            stats.lexed = text.size();
+            stats.full = true;
+            return stats;
+        };
+
+        std::optional<Parser> parser;
+        std::vector<std::unique_ptr<Decl>> decls;
+        try
+        {
+            parser.emplace(std::string_view{text}.substr(window.begin, window.end - window.begin), window.begin,
+                           program, std::move(replaced));
+            decls = parser->declarations();
+        }
+        catch (...)
+        {
+            damage(first, last, window, delta);
+            throw;
+        }
+        std::unordered_map<const SymbolTable::entry_type*, std::size_t> renewed;
+        for (std::size_t i = 0; i < decls.size(); i++)
+        {
+            renewed[declared(*decls[i]).second] = i;
+        }
+
+        // Every other declaration has to see the same globals as before
+        auto fits = std::ranges::all_of(before, [&](const auto& old)
+        {
+            auto& [entry, value] = old;
+            if (!renewed.contains(entry) || entry->index() != value.index())
+            {
+                return false;
+            }
+            if (auto variable = std::get_if<SymbolTable::Variable>(&value))
+            {
+                return std::get<SymbolTable::Variable>(*entry).type == variable->type;
+            }
+            return std::get<SymbolTable::Function>(*entry).returnType ==
+                   std::get<SymbolTable::Function>(value).returnType;
+        });
+        // and the window may only use names declared before, a function itself too
+        fits = fits && std::ranges::all_of(parser->references(), [&](const auto& reference)
+        {
+            auto [entry, user] = reference;
+            if (auto declaration = renewed.find(entry); declaration != renewed.end())
+            {
+                return declaration->second < user ||
+                       (declaration->second == user && std::holds_alternative<SymbolTable::Function>(*entry));
+            }
+            auto declaration = position.find(entry);
+            return declaration != position.end() && declaration->second < first;
+        });
+        if (!fits)
+        {
+            // The nodes go before the arena they are in
+            parser->rollback();
+            decls.clear();
+            return full();
+        }
+
+        // Scopes of the old functions go, the order of the children does not matter
+        for (auto scope : scopes)
+        {
+            auto child = std::ranges::find(root.children, scope, &std::unique_ptr<SymbolTable>::get);
+            *child = std::move(root.children.back());
+            root.children.pop_back();
+        }
+        auto& reparsed = parser->spans();
+        if (reparsed.size() == last - first)
+        {
+            std::ranges::copy(reparsed, spans.begin() + first);
+        }
+        else
+        {
+            spans.erase(spans.begin() + first, spans.begin() + last);
+            spans.insert(spans.begin() + first, reparsed.begin(), reparsed.end());
+        }
+        auto shift = static_cast<std::ptrdiff_t>(decls.size()) - static_cast<std::ptrdiff_t>(last - first);
+        shiftSpans(first + decls.size(), delta);
+        shiftDeclarations(last, delta);
+        if (shift != 0)
+        {
+            for (auto& [entry, declaration] : position)
+            {
+                if (declaration >= last)
+                {
+                    declaration += shift;
+                }
+            }
+        }
+        for (auto& [entry, declaration] : renewed)
+        {
+            position[entry] = first + declaration;
+        }
+
+        stats.reparsed = decls.size();
+        stats.reused = program.declarations.size() - (last - first);
+        stats.lexed = window.end - window.begin;
+        if (shift == 0)
+        {
+            std::ranges::move(decls, program.declarations.begin() + first);
+        }
+        else
+        {
+            program.declarations.erase(program.declarations.begin() + first, program.declarations.begin() + last);
+            program.declarations.insert(program.declarations.begin() + first,
+                                        std::make_move_iterator(decls.begin()), std::make_move_iterator(decls.end()));
+        }
+        damaged.reset();
+        return stats;
+    }
+}
@@ -1,16 +1,159 @@
 #include "Parser.hpp"
+#include <charconv>
+#include <algorithm>
+#include <array>
+
+// Hands the diagnostic of a failed rule up to the caller, name holds the result otherwise
+#define LANGUAGE_TRY(name, rule)                             \
+    auto name = (rule);                                      \
+    if (!name)                                               \
+    {                                                        \
+        return std::unexpected(std::move(name.error()));     \
+    }
 
+#define LANGUAGE_CHECK(rule)                                 \
+    if (auto checked = (rule); !checked)                     \
+    {                                                        \
+        return std::unexpected(std::move(checked.error()));  \
+    }
 
 namespace language
 {
-    Parser::Parser(const std::string &program) : lexer{program},
-                                                 next{lexer.next()}, top{nullptr}
+    namespace
+    {
+        // What the type of a binary expression is
+        enum class Result
+        {
+            Operand,    // the one of the left operand
+            Arithmetic, // see Parser::arithmeticType
+            Bool,
+        };
+
+        struct BinaryOperator
+        {
+            int precedence = 0; // higher binds tighter, 0 if the token is no binary operator
+            BinOperator op{};
+            Result result{};
+            bool rightAssociative = false;
+        };
+
+        /*
+            The binary operators by token, a new one is a single entry. Operators of the same precedence
+            are left associative unless marked otherwise: a - b - c is (a - b) - c and a = b = c is a = (b = c).
+        */
+        constexpr auto binaryOperators = []
+        {
+            std::array<BinaryOperator, static_cast<std::size_t>(TokenType::Eof) + 1> table{};
+            auto set = [&](TokenType token, int precedence, BinOperator op, Result result, bool rightAssociative = false)
+            {
+                table[static_cast<std::size_t>(token)] = {precedence, op, result, rightAssociative};
+            };
+            set(TokenType::Equal, 1, BinOperator::Assign, Result::Operand, true);
+            set(TokenType::DoublePipe, 2, BinOperator::Or, Result::Bool);
+            set(TokenType::DoubleAmpersand, 3, BinOperator::And, Result::Bool);
+            set(TokenType::Less, 4, BinOperator::Less, Result::Bool);
+            set(TokenType::LessEqual, 4, BinOperator::LessEqual, Result::Bool);
+            set(TokenType::Greater, 4, BinOperator::Greater, Result::Bool);
+            set(TokenType::GreaterEqual, 4, BinOperator::GreaterEqual, Result::Bool);
+            set(TokenType::DoubleEqual, 4, BinOperator::Equal, Result::Bool);
+            set(TokenType::ExclamationMarkEqual, 4, BinOperator::NotEqual, Result::Bool);
+            set(TokenType::Plus, 5, BinOperator::Plus, Result::Arithmetic);
+            set(TokenType::Minus, 5, BinOperator::Minus, Result::Arithmetic);
+            set(TokenType::Star, 6, BinOperator::Mul, Result::Arithmetic);
+            set(TokenType::Slash, 6, BinOperator::Div, Result::Arithmetic);
+            return table;
+        }();
+
+        // Of - and !, above every binary operator
+        constexpr int prefixPrecedence = 7;
+    }
+
+    Parser::Parser(std::string_view program) : ownedNames{std::make_unique<Interner>()}, names{ownedNames.get()},
+                                                 base{0}, source{program}, lines{program}, diagnostics{nullptr},
+                                                 lexer{program, names, &lines},
+                                                 next{lex()}, last{TokenType::Semicolon}, top{nullptr},
+                                                 intType{nullptr}, floatType{nullptr}, boolType{nullptr},
+                                                 frameSize{0}, globalsSize{0},
+                                                 tokens{nullptr}, cursor{0}, consumed{0},
+                                                 continued{nullptr}, childrenBefore{0}, globalsBefore{0}
+    {
+    }
+
+    Parser::Parser(const TokenBuffer& tokens) : ownedNames{std::make_unique<Interner>()}, names{ownedNames.get()},
+                                                base{0}, source{tokens.source()}, lines{tokens.source()}, diagnostics{nullptr},
+                                                lexer{tokens.source(), names, &lines},
+                                                next{tokens[0]}, last{TokenType::Semicolon}, top{nullptr},
+                                                intType{nullptr}, floatType{nullptr}, boolType{nullptr},
+                                                frameSize{0}, globalsSize{0},
+                                                tokens{&tokens}, cursor{0}, consumed{0},
+                                                continued{nullptr}, childrenBefore{0}, globalsBefore{0}
+    {
+    }
+
+    Parser::Parser(std::string_view program, std::vector<Diagnostic>& diagnostics) :
+        ownedNames{std::make_unique<Interner>()}, names{ownedNames.get()},
+        base{0}, source{program}, lines{program}, diagnostics{&diagnostics},
+        lexer{program, names, &lines},
+        next{lex()}, last{TokenType::Semicolon}, top{nullptr},
+        intType{nullptr}, floatType{nullptr}, boolType{nullptr},
+        frameSize{0}, globalsSize{0},
+        tokens{nullptr}, cursor{0}, consumed{0},
+        continued{nullptr}, childrenBefore{0}, globalsBefore{0}
+    {
+    }
+
+    Parser::Parser(std::string_view window, std::uint32_t base, Program& program, Entries replaced) :
+        names{&program.sym_table->names()}, base{base},
+        // The window is part of the source, lines are counted from its start
+        source{window.data() - base, base + window.size()}, lines{source}, diagnostics{nullptr},
+        lexer{window, names},
+        next{lex()}, last{TokenType::Semicolon}, top{program.sym_table.get()},
+        intType{&std::get<SymbolTable::Type>(top->get("int"))},
+        floatType{&std::get<SymbolTable::Type>(top->get("float"))},
+        boolType{&std::get<SymbolTable::Type>(top->get("bool"))},
+        frameSize{0}, globalsSize{program.globalsSize},
+        tokens{nullptr}, cursor{0}, consumed{0},
+        continued{&program}, replaced{std::move(replaced)},
+        childrenBefore{top->children.size()}, globalsBefore{program.globalsSize}
     {
     }
 
     auto Parser::advance() -> void
     {
-        next = lexer.next();
+        consumed = next.offset + static_cast<std::uint32_t>(next.lexem.size());
+        last = next.type;
+        if (tokens)
+        {
+            cursor = std::min(cursor + 1, tokens->size() - 1);
+            next = (*tokens)[cursor];
+        }
+        else
+        {
+            next = lex();
+        }
+    }
+
+    auto Parser::lex() -> Token
+    {
+        while (true)
+        {
+            auto token = lexer.tryNext();
+            if (token)
+            {
+                return *token;
+            }
+            if (!diagnostics)
+            {
+                // The input ends at the character, whatever fails because of that reports it instead
+                if (!invalidAt)
+                {
+                    invalidAt = token.error().offset;
+                }
+                return {TokenType::Eof, "", token.error().offset};
+            }
+            // The lexer went on behind the character
+            report(invalid(token.error().offset));
+        }
     }
 
     auto Parser::peek() -> const Token &
@@ -18,26 +161,221 @@ namespace language
         return next;
     }
 
-    auto Parser::program() -> Program
+    auto Parser::symbol(const Token &token) -> Symbol
     {
-        Program prog{std::make_unique<SymbolTable>(top)};
+        // Tokens from a TokenBuffer are not interned yet
+        return token.symbol != noSymbol ? token.symbol : names->intern(token.lexem);
+    }
+
+    auto Parser::parse() -> Parsed<Program>
+    {
+        auto arena = std::make_unique<Arena>();
+        Arena::Scope scope{*arena};
+        Program prog{std::move(arena), std::move(ownedNames), std::make_unique<SymbolTable>(top, names)};
         top = prog.sym_table.get();
-        top->put("int", SymbolTable::Type{.size = 4});
-        top->put("float", SymbolTable::Type{.size = 4});
-        top->put("bool", SymbolTable::Type{.size = 1});
+        intType = &std::get<SymbolTable::Type>(top->put("int", SymbolTable::Type{.size = 4}));
+        floatType = &std::get<SymbolTable::Type>(top->put("float", SymbolTable::Type{.size = 8}));
+        boolType = &std::get<SymbolTable::Type>(top->put("bool", SymbolTable::Type{.size = 1}));
+        globalsSize = 0;
 
         while (!match(TokenType::Eof))
         {
-            prog.declarations.push_back(declaration());
+            auto begin = peek().offset;
+            auto decl = declaration();
+            if (decl)
+            {
+                prog.declarations.push_back(std::move(*decl));
+                declSpans.push_back({base + begin, base + consumed});
+                continue;
+            }
+            if (!diagnostics)
+            {
+                return std::unexpected(std::move(decl.error()));
+            }
+            recover(std::move(decl.error()), prog.sym_table.get());
+            if (peek().offset == begin)
+            {
+                advance();
+            }
+            skipDeclaration();
+        }
+        if (invalidAt)
+        {
+            return std::unexpected(invalid(*invalidAt));
         }
+        prog.globalsSize = globalsSize;
         return prog;
     }
 
-    auto Parser::declaration() -> std::unique_ptr<Decl>
+    auto Parser::program() -> Program
+    {
+        auto prog = parse();
+        if (!prog)
+        {
+            throw ParseError{std::move(prog.error())};
+        }
+        return std::move(*prog);
+    }
+
+    auto Parser::declarations() -> std::vector<std::unique_ptr<Decl>>
+    {
+        Arena::Scope scope{*continued->arena};
+        std::vector<std::unique_ptr<Decl>> decls;
+        std::optional<Diagnostic> error;
+        try
+        {
+            while (!match(TokenType::Eof))
+            {
+                auto begin = peek().offset;
+                auto decl = declaration();
+                if (!decl)
+                {
+                    error = std::move(decl.error());
+                    break;
+                }
+                decls.push_back(std::move(*decl));
+                declSpans.push_back({base + begin, base + consumed});
+            }
+        }
+        catch (...)
+        {
+            // Allocations can still throw
+            rollback();
+            throw;
+        }
+        if (!error && invalidAt)
+        {
+            error = invalid(*invalidAt);
+        }
+        if (error)
+        {
+            rollback();
+            throw ParseError{std::move(*error)};
+        }
+        continued->globalsSize = globalsSize;
+        return decls;
+    }
+
+    auto Parser::rollback() -> void
+    {
+        auto& root = *continued->sym_table;
+        while (top != &root)
+        {
+            top = top->close();
+        }
+        for (auto name : declared)
+        {
+            root.erase(name);
+        }
+        for (auto entry = overwritten.rbegin(); entry != overwritten.rend(); entry++)
+        {
+            *entry->first = entry->second;
+        }
+        root.children.erase(root.children.begin() + childrenBefore, root.children.end());
+        continued->globalsSize = globalsBefore;
+        declared.clear();
+        overwritten.clear();
+    }
+
+    auto Parser::fail(const Token& at, std::string message) -> std::unexpected<Diagnostic>
+    {
+        if (invalidAt)
+        {
+            return std::unexpected(invalid(*invalidAt));
+        }
+        auto offset = base + at.offset;
+        auto [line, column] = lines.locate(offset);
+        return std::unexpected(Diagnostic{.line = line, .column = column, .offset = offset, .message = std::move(message)});
+    }
+
+    auto Parser::invalid(std::uint32_t offset) -> Diagnostic
+    {
+        offset += base;
+        auto at = lines.locate(offset);
+        return {.line = at.line, .column = at.column, .offset = offset, .message = InvalidToken::message(source, offset)};
+    }
+
+    auto Parser::report(Diagnostic diagnostic) -> void
+    {
+        // A token lexed ahead fails again when it is reached
+        if (!diagnostics->empty() && diagnostics->back().offset == diagnostic.offset)
+        {
+            return;
+        }
+        diagnostics->push_back(std::move(diagnostic));
+    }
+
+    auto Parser::recover(Diagnostic diagnostic, SymbolTable* scope) -> void
+    {
+        report(std::move(diagnostic));
+        while (top != scope)
+        {
+            top = top->close();
+        }
+    }
+
+    auto Parser::skipStatement() -> void
+    {
+        // Up to the ; or } that ends the statement, or the } of the enclosing block
+        std::size_t depth = 0;
+        while (!match(TokenType::Eof))
+        {
+            auto type = peek().type;
+            if (type == TokenType::CloseCurlyBracket && depth == 0)
+            {
+                return;
+            }
+            advance();
+            if (type == TokenType::OpenCurlyBracket)
+            {
+                depth++;
+            }
+            else if ((type == TokenType::CloseCurlyBracket && --depth == 0) ||
+                     (type == TokenType::Semicolon && depth == 0))
+            {
+                return;
+            }
+        }
+    }
+
+    auto Parser::skipDeclaration() -> void
+    {
+        // Up to a var or an identifier outside of any block that follows a ; or a }, see FOLLOW(D) in Grammar.txt
+        std::size_t depth = 0;
+        while (!match(TokenType::Eof))
+        {
+            if (depth == 0 && (match(TokenType::Var) ||
+                               (match(TokenType::Id) && (last == TokenType::Semicolon || last == TokenType::CloseCurlyBracket))))
+            {
+                return;
+            }
+            if (match(TokenType::OpenCurlyBracket))
+            {
+                depth++;
+            }
+            else if (match(TokenType::CloseCurlyBracket) && depth > 0)
+            {
+                depth--;
+            }
+            advance();
+        }
+    }
+
+    auto Parser::spans() const -> const std::vector<Span>&
+    {
+        return declSpans;
+    }
+
+    auto Parser::references() const -> const std::vector<std::pair<const SymbolTable::entry_type*, std::size_t>>&
+    {
+        return used;
+    }
+
+    auto Parser::declaration() -> Parsed<std::unique_ptr<Decl>>
     {
         if (match(TokenType::Var))
         {
-            return variableDeclaration();
+            return located(variableDeclaration(), base + peek().offset);
         }
         else if (match(TokenType::Id))
         {
@@ -45,373 +383,525 @@ namespace language
         }
         else
         {
-            throw UnexpectedToken(peek(), TokenType::Var, TokenType::Id);
+            return unexpected(TokenType::Var, TokenType::Id);
         }
     }
 
-    auto Parser::variableDeclaration() -> std::unique_ptr<VarDecl>
+    auto Parser::variableDeclaration() -> Parsed<std::unique_ptr<VarDecl>>
     {
-        consume(TokenType::Var);
-        auto varName = peek().lexem;
-        consume(TokenType::Id, TokenType::Equal);
-        auto init = assignment();
-        consume(TokenType::Semicolon);
-
-        auto& vardecl = top->put(varName, SymbolTable::Variable{
-            .name = varName,
-            .type = init->type,
-            .scope = (top->parent == nullptr ? SymbolTable::Scope::Global : SymbolTable::Scope::Local),
-            .offset = -1,
+        LANGUAGE_CHECK(consume(TokenType::Var));
+        auto name = peek();
+        LANGUAGE_CHECK(consume(TokenType::Id, TokenType::Equal));
+        LANGUAGE_TRY(init, expression());
+        auto varName = symbol(name);
+        if ((*init)->type == nullptr)
+        {
+            return fail(peek(), std::format("Cannot infer the type of {}", names->name(varName)));
+        }
+        LANGUAGE_CHECK(consume(TokenType::Semicolon));
+
+        auto global = top->parent == nullptr;
+        SymbolTable::Variable variable{
+            .name = names->name(varName),
+            .type = (*init)->type,
+            .scope = (global ? SymbolTable::Scope::Global : SymbolTable::Scope::Local),
+            .offset = 0,
             .active = true,
             .alive = true,
             .temp = false
-        });
-
-        return std::make_unique<VarDecl>(&std::get<SymbolTable::Variable>(vardecl), std::move(init));
+        };
+        if (global)
+        {
+            LANGUAGE_TRY(vardecl, this->global(name, variable));
+            return std::make_unique<VarDecl>(&std::get<SymbolTable::Variable>(**vardecl), std::move(*init));
+        }
+        variable.offset = allocate(frameSize, *variable.type);
+        auto vardecl = top->tryPut(varName, variable);
+        if (!vardecl)
+        {
+            return fail(name, std::format("Symbol {} already defined!", names->name(varName)));
+        }
+        return std::make_unique<VarDecl>(&std::get<SymbolTable::Variable>(*vardecl), std::move(*init));
     }
 
-    auto Parser::functionDefinition() -> std::unique_ptr<FuncDef>
+    auto Parser::functionDefinition() -> Parsed<std::unique_ptr<FuncDef>>
     {
-        auto funcName = peek().lexem;
-        consume(TokenType::Id);
-        parameterList();
-        auto def =  std::make_unique<FuncDef>(funcName, top, block());
-        top = top->parent;
-        top->put(std::move(funcName), SymbolTable::Function{def.get()});
-        return std::move(def);
+        auto name = peek();
+        LANGUAGE_CHECK(consume(TokenType::Id));
+        auto funcName = symbol(name);
+
+        // Declared before the body so the function can call itself
+        LANGUAGE_TRY(entry, global(name, SymbolTable::Function{
+            .def = nullptr,
+            .returnType = nullptr
+        }));
+        auto& function = std::get<SymbolTable::Function>(**entry);
+
+        frameSize = 0;
+        LANGUAGE_TRY(params, parameterList());
+        if (match(TokenType::Colon))
+        {
+            advance();
+            LANGUAGE_TRY(type, typeSpecifier());
+            function.returnType = *type;
+        }
+
+        LANGUAGE_TRY(body, located(block(), base + peek().offset));
+        auto returnType = FuncDef::returnTypeOf(**body, function.returnType);
+        if (!returnType)
+        {
+            return fail(name, std::format("Return types of {} do not match", names->name(funcName)));
+        }
+        if (*returnType && !FuncDef::returnsOnEveryPath(**body))
+        {
+            return fail(name, std::format("{} does not return a value on every path", names->name(funcName)));
+        }
+        auto def = std::make_unique<FuncDef>(names->name(funcName), top, std::move(*body), *returnType);
+        def->parameters = std::move(*params);
+        def->frameSize = frameSize;
+        top = top->close();
+        function.def = def.get();
+        function.returnType = def->returnType;
+        return def;
     }
 
-    auto Parser::parameterList() -> void
+    auto Parser::parameterList() -> Parsed<std::vector<SymbolTable::Variable*>>
     {
         top->addChild(std::make_unique<SymbolTable>(top));
         top = top->children[top->children.size()-1].get();
-        int offset = 0;
-        consume(TokenType::OpenParenthesis);
+        std::vector<SymbolTable::Variable*> params;
+        LANGUAGE_CHECK(consume(TokenType::OpenParenthesis));
         while (peek().type != TokenType::CloseParenthesis)
         {
-            auto paraName = peek().lexem;
-            consume(TokenType::Id, TokenType::Colon);
-            auto typeName = peek().lexem;
-            consume(TokenType::Id);
-
-            auto& type = top->get(typeName);
-            if(!std::holds_alternative<SymbolTable::Type>(type))
-            {
-                throw 1;
-            }
-
-            top->put(paraName, SymbolTable::Variable{
-                .name = paraName,
-                .type = &std::get<SymbolTable::Type>(type),
+            auto name = peek();
+            LANGUAGE_CHECK(consume(TokenType::Id, TokenType::Colon));
+            LANGUAGE_TRY(type, typeSpecifier());
+
+            auto paraName = symbol(name);
+            auto para = top->tryPut(paraName, SymbolTable::Variable{
+                .name = names->name(paraName),
+                .type = *type,
                 .scope = SymbolTable::Scope::Para,
-                .offset = offset,
+                .offset = allocate(frameSize, **type),
                 .active = true,
                 .alive = true, // ????
                 .temp = false
             });
-
-            offset += std::get<SymbolTable::Type>(type).size;
+            if (!para)
+            {
+                return fail(name, std::format("Symbol {} already defined!", names->name(paraName)));
+            }
+            params.push_back(&std::get<SymbolTable::Variable>(*para));
 
             if (peek().type == TokenType::Comma)
                 advance();
         }
-        consume(TokenType::CloseParenthesis);
+        LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
+        return params;
+    }
+
+    auto Parser::typeSpecifier() -> Parsed<SymbolTable::Type*>
+    {
+        if (!match(TokenType::Id))
+        {
+            return unexpected(TokenType::Id);
+        }
+        // Looked up before advancing, so errors point at the name
+        auto typeName = symbol(peek());
+        auto type = top->find(typeName);
+        if (!type)
+        {
+            return fail(peek(), std::format("Symbol {} not found!", names->name(typeName)));
+        }
+        if(!std::holds_alternative<SymbolTable::Type>(*type))
+        {
+            return fail(peek(), std::format("{} is not a type", names->name(typeName)));
+        }
+        advance();
+        return &std::get<SymbolTable::Type>(*type);
+    }
+
+    auto Parser::arithmeticType(const Expr& left, const Expr& right) -> SymbolTable::Type*
+    {
+        // int op float is computed in float
+        return left.type == floatType || right.type == floatType ? floatType : left.type;
+    }
+
+    auto Parser::allocate(std::size_t& size, const SymbolTable::Type& type) -> int
+    {
+        // Every variable gets its own naturally aligned slot
+        size = (size + type.size - 1) / type.size * type.size;
+        auto offset = static_cast<int>(size);
+        size += type.size;
+        return offset;
+    }
+
+    auto Parser::redeclare(Symbol name) -> SymbolTable::entry_type*
+    {
+        auto old = replaced.find(name);
+        if (old == replaced.end())
+        {
+            return nullptr;
+        }
+        auto entry = old->second;
+        replaced.erase(old);
+        overwritten.emplace_back(entry, *entry);
+        return entry;
+    }
+
+    auto Parser::global(const Token& name, SymbolTable::entry_type entry) -> Parsed<SymbolTable::entry_type*>
+    {
+        auto globalName = symbol(name);
+        auto reused = redeclare(globalName);
+        if (auto variable = std::get_if<SymbolTable::Variable>(&entry))
+        {
+            // A redeclared variable of the same type keeps its slot
+            auto old = reused ? std::get_if<SymbolTable::Variable>(reused) : nullptr;
+            variable->offset = old && old->type == variable->type ? old->offset : allocate(globalsSize, *variable->type);
+        }
+        if (reused)
+        {
+            *reused = std::move(entry);
+            return reused;
+        }
+        auto put = top->tryPut(globalName, std::move(entry));
+        if (!put)
+        {
+            return fail(name, std::format("Symbol {} already defined!", names->name(globalName)));
+        }
+        if (continued)
+        {
+            declared.push_back(globalName);
+        }
+        return put;
     }
 
-    auto Parser::block() -> std::unique_ptr<Block>
+    auto Parser::block() -> Parsed<std::unique_ptr<Block>>
     {
         top->addChild(std::make_unique<SymbolTable>(top));
         top = top->children[top->children.size()-1].get();
-        consume(TokenType::OpenCurlyBracket);
+        auto scope = top;
+        LANGUAGE_CHECK(consume(TokenType::OpenCurlyBracket));
         std::vector<std::unique_ptr<Stmt>> stmts;
-        while (peek().type != TokenType::CloseCurlyBracket)
+        while (!match(TokenType::CloseCurlyBracket, TokenType::Eof))
         {
-            stmts.push_back(statement());
+            auto stmt = statement();
+            if (stmt)
+            {
+                stmts.push_back(std::move(*stmt));
+                continue;
+            }
+            if (!diagnostics)
+            {
+                return std::unexpected(std::move(stmt.error()));
+            }
+            recover(std::move(stmt.error()), scope);
+            skipStatement();
         }
-        consume(TokenType::CloseCurlyBracket);
+        LANGUAGE_CHECK(consume(TokenType::CloseCurlyBracket));
         auto blck = std::make_unique<Block>(std::move(stmts), top);
-        top = top->parent;
-        return std::move(blck);
+        top = top->close();
+        return blck;
     }
 
-    auto Parser::statement() -> std::unique_ptr<Stmt>
+    auto Parser::statement() -> Parsed<std::unique_ptr<Stmt>>
     {
+        auto offset = base + peek().offset;
         if (match(TokenType::If))
         {
-            return ifStatement();
+            return located(ifStatement(), offset);
         }
         else if (match(TokenType::While))
         {
-            return whileStatement();
+            return located(whileStatement(), offset);
         }
         else if (match(TokenType::For))
         {
-            return forStatement();
+            return located(forStatement(), offset);
         }
         else if (match(TokenType::Var))
         {
-            return variableDeclaration();
+            return located(variableDeclaration(), offset);
         }
         else if (match(TokenType::Return))
         {
-            return returnStatement();
+            return located(returnStatement(), offset);
+        }
+        else if (match(TokenType::OpenCurlyBracket))
+        {
+            return located(block(), offset);
         }
         else if (match(TokenType::IntegerLiteral,
                        TokenType::FloatingPointLiteral,
                        TokenType::StringLiteral,
                        TokenType::BooleanLiteral,
-                       TokenType::OpenParenthesis))
+                       TokenType::OpenParenthesis,
+                       TokenType::Id,
+                       TokenType::Minus,
+                       TokenType::ExclamationMark))
         {
-            return expressionStatement();
+            return located(expressionStatement(), offset);
         }
         else
         {
-            throw UnexpectedToken(peek(),
-                                  TokenType::If,
-                                  TokenType::While,
-                                  TokenType::For,
-                                  TokenType::Var,
-                                  TokenType::OpenParenthesis,
-                                  TokenType::IntegerLiteral,
-                                  TokenType::FloatingPointLiteral,
-                                  TokenType::StringLiteral,
-                                  TokenType::BooleanLiteral);
+            return unexpected(TokenType::If,
+                              TokenType::While,
+                              TokenType::For,
+                              TokenType::Var,
+                              TokenType::Return,
+                              TokenType::OpenCurlyBracket,
+                              TokenType::OpenParenthesis,
+                              TokenType::Id,
+                              TokenType::IntegerLiteral,
+                              TokenType::FloatingPointLiteral,
+                              TokenType::StringLiteral,
+                              TokenType::BooleanLiteral,
+                              TokenType::Minus,
+                              TokenType::ExclamationMark);
         }
     }
 
-    auto Parser::ifStatement() -> std::unique_ptr<If>
+    auto Parser::ifStatement() -> Parsed<std::unique_ptr<If>>
     {
-        consume(TokenType::If, TokenType::OpenParenthesis);
-        auto expr = assignment();
-        consume(TokenType::CloseParenthesis);
-        auto stmt = statement();
+        LANGUAGE_CHECK(consume(TokenType::If, TokenType::OpenParenthesis));
+        LANGUAGE_TRY(expr, expression());
+        LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
+        LANGUAGE_TRY(stmt, statement());
         if (match(TokenType::Else))
         {
             advance();
-            return std::make_unique<If>(std::move(expr), std::move(stmt), statement());
+            LANGUAGE_TRY(falseStmt, statement());
+            return std::make_unique<If>(std::move(*expr), std::move(*stmt), std::move(*falseStmt));
         }
-        return std::make_unique<If>(std::move(expr), std::move(stmt));
+        return std::make_unique<If>(std::move(*expr), std::move(*stmt));
     }
 
-    auto Parser::whileStatement() -> std::unique_ptr<While>
+    auto Parser::whileStatement() -> Parsed<std::unique_ptr<While>>
     {
-        consume(TokenType::While, TokenType::OpenParenthesis);
-        auto expr = assignment();
-        consume(TokenType::CloseParenthesis);
-        auto stmt = statement();
-        return std::make_unique<While>(std::move(expr), std::move(stmt));
+        LANGUAGE_CHECK(consume(TokenType::While, TokenType::OpenParenthesis));
+        LANGUAGE_TRY(expr, expression());
+        LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
+        LANGUAGE_TRY(stmt, statement());
+        return std::make_unique<While>(std::move(*expr), std::move(*stmt));
     }
 
-    auto Parser::forStatement() -> std::unique_ptr<Stmt>
+    auto Parser::forStatement() -> Parsed<std::unique_ptr<Stmt>>
     {
-        consume(TokenType::For, TokenType::OpenParenthesis);
-        auto init = statement();
-        auto exprStmt = expressionStatement();
-        auto post = assignment();
+        auto offset = base + peek().offset;
+        LANGUAGE_CHECK(consume(TokenType::For, TokenType::OpenParenthesis));
+        LANGUAGE_TRY(init, statement());
+        LANGUAGE_TRY(exprStmt, expressionStatement());
+        auto postOffset = base + peek().offset;
+        LANGUAGE_TRY(post, expression());
 
         auto blck = std::make_unique<Block>();
-        blck->stmts.push_back(std::move(init));
+        blck->stmts.push_back(std::move(*init));
 
-        consume(TokenType::CloseParenthesis);
+        LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
 
-        auto stmt = statement();
+        LANGUAGE_TRY(stmt, statement());
 
         auto loopBody = std::make_unique<Block>();
-        loopBody->stmts.push_back(std::move(stmt));
-        loopBody->stmts.push_back(std::make_unique<ExprStmt>(std::move(post)));
+        loopBody->stmts.push_back(std::move(*stmt));
+        loopBody->stmts.push_back(std::make_unique<ExprStmt>(std::move(*post)));
+        loopBody->stmts.back()->offset = postOffset;
+        loopBody->offset = offset;
 
         auto whileStmt = std::make_unique<While>(
-            std::move(exprStmt->expr),
+            std::move((*exprStmt)->expr),
             std::move(loopBody));
+        whileStmt->offset = offset;
 
         blck->stmts.push_back(std::move(whileStmt));
 
-        return std::move(blck);
+        return blck;
     }
 
-    auto Parser::returnStatement() -> std::unique_ptr<Return>
+    auto Parser::returnStatement() -> Parsed<std::unique_ptr<Return>>
     {
-        consume(TokenType::Return);
-        auto ret =  std::make_unique<Return>(assignment());
-        consume(TokenType::Semicolon);
-        return std::move(ret);
-    }
-
-    auto Parser::expressionStatement() -> std::unique_ptr<ExprStmt>
-    {
-        auto expr = assignment();
-        consume(TokenType::Semicolon);
-        return std::make_unique<ExprStmt>(std::move(expr));
-    }
-
-    auto Parser::assignment() -> std::unique_ptr<Expr>
-    {
-        auto lo = logicalOr();
-        if (match(TokenType::Equal))
-        {
-            advance();
-            return std::make_unique<BinExpr>(std::move(lo), assignment(), BinOperator::Equal, lo->type);     //TODO Type Check/Conversion
-        }
-        return lo;
-    }
-
-    auto Parser::logicalOr() -> std::unique_ptr<Expr>
-    {
-        auto la = logicalAnd();
-        while (match(TokenType::DoublePipe))
+        LANGUAGE_CHECK(consume(TokenType::Return));
+        if (match(TokenType::Semicolon))
         {
             advance();
-            la = std::make_unique<BinExpr>(std::move(la), logicalAnd(), BinOperator::Or, la->type);
+            return std::make_unique<Return>();
         }
-        return la;
+        LANGUAGE_TRY(expr, expression());
+        LANGUAGE_CHECK(consume(TokenType::Semicolon));
+        return std::make_unique<Return>(std::move(*expr));
     }
 
-    auto Parser::logicalAnd() -> std::unique_ptr<Expr>
+    auto Parser::expressionStatement() -> Parsed<std::unique_ptr<ExprStmt>>
     {
-        auto comp = comparision();
-        while (match(TokenType::DoubleAmpersand))
-        {
-            advance();
-            comp = std::make_unique<BinExpr>(std::move(comp), comparision(), BinOperator::And, comp->type);
-        }
-        return comp;
+        LANGUAGE_TRY(expr, expression());
+        LANGUAGE_CHECK(consume(TokenType::Semicolon));
+        return std::make_unique<ExprStmt>(std::move(*expr));
     }
 
-    auto Parser::comparision() -> std::unique_ptr<Expr>
+    auto Parser::expression(int precedence) -> Parsed<std::unique_ptr<Expr>>
     {
-        auto ter = term();
-        while (match(TokenType::Less,
-                     TokenType::LessEqual,
-                     TokenType::Greater,
-                     TokenType::GreaterEqual,
-                     TokenType::DoubleEqual,
-                     TokenType::ExclamationMarkEqual))
+        LANGUAGE_TRY(left, prefix());
+        while (true)
         {
-#pragma warning(push)
-#pragma warning(disable : 4715)
-            auto op = [this]() -> BinOperator
+            auto& binary = binaryOperators[static_cast<std::size_t>(peek().type)];
+            if (binary.precedence <= precedence)
             {
-                switch (this->peek().type)
-                {
-                case TokenType::Less:
-                    return BinOperator::Less;
-                case TokenType::LessEqual:
-                    return BinOperator::LessEqual;
-                case TokenType::Greater:
-                    return BinOperator::Greater;
-                case TokenType::GreaterEqual:
-                    return BinOperator::GreaterEqual;
-                case TokenType::Equal:
-                    return BinOperator::Equal;
-                case TokenType::ExclamationMarkEqual:
-                    return BinOperator::NotEqual;
-                }
-            }();
-#pragma warning(pop)
-
+                return left;
+            }
             advance();
-            ter = std::make_unique<BinExpr>(std::move(ter), term(), op, ter->type);
+            LANGUAGE_TRY(right, expression(binary.rightAssociative ? binary.precedence - 1 : binary.precedence));
+            auto type = binary.result == Result::Bool       ? boolType
+                        : binary.result == Result::Arithmetic ? arithmeticType(**left, **right)
+                                                              : (*left)->type; // TODO Type Check/Conversion
+            auto offset = (*left)->offset;
+            *left = std::make_unique<BinExpr>(std::move(*left), std::move(*right), binary.op, type);
+            (*left)->offset = offset;
         }
-        return ter;
     }
-    auto Parser::term() -> std::unique_ptr<Expr>
+
+    auto Parser::prefix() -> Parsed<std::unique_ptr<Expr>>
     {
-        auto p = product();
-        while (match(TokenType::Plus, TokenType::Minus))
+        // Prefix operators are rewritten to binary ones, the way for loops become while loops
+        auto offset = base + peek().offset;
+        if (match(TokenType::Minus))
         {
-            auto op = peek().type == TokenType::Plus ? BinOperator::Plus : BinOperator::Minus;
             advance();
-            p = std::make_unique<BinExpr>(std::move(p), product(), op, p->type);
+            LANGUAGE_TRY(operand, expression(prefixPrecedence));
+            std::unique_ptr<Expr> zero;
+            if ((*operand)->type == floatType)
+            {
+                zero = std::make_unique<FloatLiteral>(0.0, floatType);
+            }
+            else
+            {
+                zero = std::make_unique<IntLiteral>(0, intType);
+            }
+            zero->offset = offset;
+            auto type = arithmeticType(*zero, **operand);
+            return located<Expr>(std::make_unique<BinExpr>(std::move(zero), std::move(*operand), BinOperator::Minus, type), offset);
         }
-        return p;
-    }
-
-    auto Parser::product() -> std::unique_ptr<Expr>
-    {
-        auto p = primary();
-        while (match(TokenType::Star, TokenType::Slash))
+        if (match(TokenType::ExclamationMark))
         {
-            auto op = peek().type == TokenType::Star ? BinOperator::Mul : BinOperator::Div;
             advance();
-            p = std::make_unique<BinExpr>(std::move(p), primary(), op, p->type);
+            LANGUAGE_TRY(operand, expression(prefixPrecedence));
+            auto no = std::make_unique<BooleanLiteral>(false, boolType);
+            no->offset = offset;
+            return located<Expr>(std::make_unique<BinExpr>(std::move(*operand), std::move(no), BinOperator::Equal, boolType), offset);
         }
-        return p;
+        return located(primary(), offset);
     }
 
-    auto Parser::primary() -> std::unique_ptr<Expr>
+    auto Parser::primary() -> Parsed<std::unique_ptr<Expr>>
     {
         if (match(TokenType::IntegerLiteral))
         {
-            auto lit = peek().lexem;
+            auto token = peek();
+            int v{};
+            auto [end, error] = std::from_chars(token.lexem.data(), token.lexem.data() + token.lexem.size(), v);
+            if (error != std::errc{} || end != token.lexem.data() + token.lexem.size())
+            {
+                return fail(token, std::format("Integer literal {} is out of range", token.lexem));
+            }
             advance();
-            return std::make_unique<IntLiteral>(std::stoi(lit), &std::get<SymbolTable::Type>(top->get("int")));
+            return std::make_unique<IntLiteral>(v, intType);
         }
         else if (match(TokenType::FloatingPointLiteral))
         {
-            auto lit = peek().lexem;
+            auto token = peek();
+            double v{};
+            auto [end, error] = std::from_chars(token.lexem.data(), token.lexem.data() + token.lexem.size(), v);
+            if (error != std::errc{} || end != token.lexem.data() + token.lexem.size())
+            {
+                return fail(token, std::format("Floating point literal {} is out of range", token.lexem));
+            }
             advance();
-            return std::make_unique<FloatLiteral>(std::stod(lit), &std::get<SymbolTable::Type>(top->get("float")));
+            return std::make_unique<FloatLiteral>(v, floatType);
         }
         else if (match(TokenType::BooleanLiteral))
         {
             auto lit = peek().lexem;
             advance();
-            return std::make_unique<BooleanLiteral>(lit == "true" ? true : false, &std::get<SymbolTable::Type>(top->get("bool")));
+            return std::make_unique<BooleanLiteral>(lit == "true" ? true : false, boolType);
         }
         else if (match(TokenType::StringLiteral))
         {
             auto lit = peek().lexem;
             advance();
-            return std::make_unique<StrLiteral>(lit, nullptr); // TODO
+            return std::make_unique<StrLiteral>(std::string{lit}, nullptr); // TODO
+        }
+        else if (match(TokenType::OpenParenthesis))
+        {
+            advance();
+            LANGUAGE_TRY(expr, expression());
+            LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
+            return expr;
         }
         else if (match(TokenType::Id))
         {
-            auto name = peek().lexem;
+            // Errors point at the name, the token after it tells a call from a variable without lexing ahead
+            auto token = peek();
+            auto name = symbol(token);
+            auto entry = top->find(name);
+            if (!entry)
+            {
+                return fail(token, std::format("Symbol {} not found!", names->name(name)));
+            }
             advance();
             if (match(TokenType::OpenParenthesis))
             {
-                auto args = argumentList();
-                auto& function = top->get(name);
-                if(!std::holds_alternative<SymbolTable::Function>(function))
+                if(!std::holds_alternative<SymbolTable::Function>(*entry))
+                {
+                    return fail(token, std::format("{} is not a function", names->name(name)));
+                }
+                if (continued)
                 {
-                    throw 1;
+                    used.emplace_back(entry, declSpans.size());
                 }
-                return std::make_unique<FuncCall>(&std::get<SymbolTable::Function>(function), std::move(args));
+                LANGUAGE_TRY(args, argumentList());
+                return std::make_unique<FuncCall>(&std::get<SymbolTable::Function>(*entry), std::move(*args));
             }
-            auto& variable = top->get(name);
-
-            if(!std::holds_alternative<SymbolTable::Variable>(variable))
+            if(!std::holds_alternative<SymbolTable::Variable>(*entry))
             {
-                throw 1;
+                return fail(token, std::format("{} is not a variable", names->name(name)));
+            }
+            if (continued && std::get<SymbolTable::Variable>(*entry).scope == SymbolTable::Scope::Global)
+            {
+                used.emplace_back(entry, declSpans.size());
             }
 
-            return std::make_unique<VariableAccess>(&std::get<SymbolTable::Variable>(variable));
+            return std::make_unique<VariableAccess>(&std::get<SymbolTable::Variable>(*entry));
         }
         else
         {
-            throw UnexpectedToken(peek(),
-                                  TokenType::IntegerLiteral,
-                                  TokenType::FloatingPointLiteral,
-                                  TokenType::BooleanLiteral,
-                                  TokenType::StringLiteral,
-                                  TokenType::Id);
+            // Reached through prefix, so - and ! would have done as well
+            return unexpected(TokenType::IntegerLiteral,
+                              TokenType::FloatingPointLiteral,
+                              TokenType::BooleanLiteral,
+                              TokenType::StringLiteral,
+                              TokenType::OpenParenthesis,
+                              TokenType::Id,
+                              TokenType::Minus,
+                              TokenType::ExclamationMark);
         }
     }
 
-    auto Parser::argumentList() -> std::vector<std::unique_ptr<Expr>>
+    auto Parser::argumentList() -> Parsed<std::vector<std::unique_ptr<Expr>>>
     {
-        consume(TokenType::OpenParenthesis);
+        LANGUAGE_CHECK(consume(TokenType::OpenParenthesis));
         std::vector<std::unique_ptr<Expr>> args;
         while (!match(TokenType::CloseParenthesis))
         {
-            args.push_back(assignment());
-            if (match(TokenType::Semicolon))
+            LANGUAGE_TRY(arg, expression());
+            args.push_back(std::move(*arg));
+            if (match(TokenType::Comma))
             {
                 advance();
             }
         }
-        consume(TokenType::CloseParenthesis);
+        LANGUAGE_CHECK(consume(TokenType::CloseParenthesis));
         return args;
     }
 
 }
+
+#undef LANGUAGE_TRY
+#undef LANGUAGE_CHECK
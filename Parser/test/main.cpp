@@ -1,6 +1,11 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "Parser/Parser.hpp"
+#include "Parser/Incremental.hpp"
+#include "Ast/Serialize.hpp"
+#include "Ast/FlatAst.hpp"
+#include <algorithm>
+#include <tuple>
 #include <string>
 
 TEST_CASE("Global Variables", "[variable]")
@@ -21,4 +26,505 @@ TEST_CASE("Global Variables", "[variable]")
     REQUIRE(dynamic_cast<language::IntLiteral &>(*varA.init).v == 5);
     REQUIRE(varB.var->name == "b");
     REQUIRE(dynamic_cast<language::BooleanLiteral &>(*varB.init).v == true);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Token Buffer", "[variable]")
+{
+    std::string source = R"(
+        var a = 5;
+        var b = a;
+    )";
+
+    language::TokenBuffer tokens{source};
+    REQUIRE(tokens.size() == 11);
+    REQUIRE(tokens.type(10) == language::TokenType::Eof);
+    REQUIRE(tokens.lexem(1) == "a");
+
+    language::Parser p{tokens};
+
+    auto program = p.program();
+
+    auto &varA = dynamic_cast<language::VarDecl &>(*program.declarations[0]);
+    auto &varB = dynamic_cast<language::VarDecl &>(*program.declarations[1]);
+
+    REQUIRE(varA.var->name == "a");
+    REQUIRE(dynamic_cast<language::VariableAccess &>(*varB.init).var == varA.var);
+}
+
+
+TEST_CASE("Flat Ast", "[function]")
+{
+    std::string source = R"(
+        var a = 5;
+        f(x: int) {
+            var y = x * 2;
+            if (y < a) return y;
+            return x;
+        }
+    )";
+
+    language::Parser p{source};
+    auto program = p.program();
+    auto flat = language::flatten(program);
+
+    REQUIRE(flat.declarations.size() == 2);
+    const auto& func = flat.nodes[flat.declarations[1]];
+    REQUIRE(func.kind == language::NodeKind::FuncDef);
+    REQUIRE(flat.functions[func.a]->name == "f");
+
+    auto& def = dynamic_cast<language::FuncDef &>(*program.declarations[1]);
+    auto returnTypes = flat.returnTypes(flat.declarations[1]);
+    REQUIRE(returnTypes.size() == 2);
+    REQUIRE(returnTypes[0] == def.returnType);
+
+    // A body on its own flattens too, the parser checks the return types of each function on it
+    auto body = language::flatten(*def.block);
+    REQUIRE(body.nodes.back().kind == language::NodeKind::Block);
+    REQUIRE(language::FlatAst::returnTypes(body.nodes, body.types) == returnTypes);
+
+    const auto& block = flat.nodes[func.b];
+    REQUIRE(block.kind == language::NodeKind::Block);
+    auto stmts = flat.list(block.a, block.b);
+    REQUIRE(stmts.size() == 3);
+    const auto& decl = flat.nodes[stmts[0]];
+    const auto& product = flat.nodes[decl.b];
+    REQUIRE(product.kind == language::NodeKind::BinExpr);
+    REQUIRE(static_cast<language::BinOperator>(product.op) == language::BinOperator::Mul);
+    REQUIRE(flat.intValue(flat.nodes[product.b]) == 2);
+}
+
+
+TEST_CASE("Shadowing", "[variable]")
+{
+    std::string source = R"(
+        var a = 5;
+        f(a: int) {
+            var b = a;
+            return b;
+        }
+        var c = a;
+    )";
+
+    language::Parser p{source};
+    auto program = p.program();
+
+    auto &global = dynamic_cast<language::VarDecl &>(*program.declarations[0]);
+    auto &f = dynamic_cast<language::FuncDef &>(*program.declarations[1]);
+    auto &b = dynamic_cast<language::VarDecl &>(*f.block->stmts[0]);
+    auto &c = dynamic_cast<language::VarDecl &>(*program.declarations[2]);
+
+    auto parameter = dynamic_cast<language::VariableAccess &>(*b.init).var;
+    REQUIRE(parameter->scope == language::SymbolTable::Scope::Para);
+    REQUIRE(dynamic_cast<language::VariableAccess &>(*c.init).var == global.var);
+
+    // Closed scopes are still searchable through the tree
+    auto &entry = f.block->symbols->get("a");
+    REQUIRE(&std::get<language::SymbolTable::Variable>(entry) == parameter);
+}
+
+// Same tree shape, literals and locals, globals may sit in other slots
+static auto sameTree(language::Program& expectedProgram, language::Program& actualProgram) -> bool
+{
+    auto expected = language::flatten(expectedProgram);
+    auto actual = language::flatten(actualProgram);
+    auto node = [](const language::FlatNode& n)
+    {
+        return std::tuple{n.kind, n.op, n.type, n.a, n.b, n.c};
+    };
+    auto variable = [](const language::SymbolTable::Variable* v)
+    {
+        return std::tuple{v->name, v->type->size, v->scope,
+                          v->scope == language::SymbolTable::Scope::Global ? 0 : v->offset};
+    };
+    return std::ranges::equal(expected.nodes, actual.nodes, {}, node, node) && expected.lists == actual.lists &&
+           std::ranges::equal(expected.variables, actual.variables, {}, variable, variable);
+}
+
+// Source offsets of every statement and expression, depth first
+static auto offsets(language::Program& program) -> std::vector<std::uint32_t>
+{
+    std::vector<std::uint32_t> result;
+    auto expression = [&](auto& self, language::Expr& expr) -> void
+    {
+        result.push_back(expr.offset);
+        if (auto bin = dynamic_cast<language::BinExpr*>(&expr))
+        {
+            self(self, *bin->leftHs);
+            self(self, *bin->rightHs);
+        }
+        else if (auto call = dynamic_cast<language::FuncCall*>(&expr))
+        {
+            for (auto& arg : call->args)
+            {
+                self(self, *arg);
+            }
+        }
+    };
+    auto statement = [&](auto& self, language::Stmt& stmt) -> void
+    {
+        result.push_back(stmt.offset);
+        if (auto decl = dynamic_cast<language::VarDecl*>(&stmt))
+        {
+            expression(expression, *decl->init);
+        }
+        else if (auto block = dynamic_cast<language::Block*>(&stmt))
+        {
+            for (auto& s : block->stmts)
+            {
+                self(self, *s);
+            }
+        }
+        else if (auto ifStmt = dynamic_cast<language::If*>(&stmt))
+        {
+            expression(expression, *ifStmt->expr);
+            self(self, *ifStmt->trueStmt);
+            if (ifStmt->falseStmt)
+            {
+                self(self, *ifStmt->falseStmt);
+            }
+        }
+        else if (auto whileStmt = dynamic_cast<language::While*>(&stmt))
+        {
+            expression(expression, *whileStmt->expr);
+            self(self, *whileStmt->stmt);
+        }
+        else if (auto returnStmt = dynamic_cast<language::Return*>(&stmt); returnStmt && returnStmt->expr)
+        {
+            expression(expression, *returnStmt->expr);
+        }
+        else if (auto exprStmt = dynamic_cast<language::ExprStmt*>(&stmt))
+        {
+            expression(expression, *exprStmt->expr);
+        }
+    };
+    for (auto& decl : program.declarations)
+    {
+        if (auto def = dynamic_cast<language::FuncDef*>(decl.get()))
+        {
+            statement(statement, *def->block);
+        }
+        else
+        {
+            statement(statement, dynamic_cast<language::VarDecl&>(*decl));
+        }
+    }
+    return result;
+}
+
+static auto sameAsFullParse(language::IncrementalParser& incremental) -> bool
+{
+    language::Parser p{incremental.source()};
+    auto program = p.program();
+    return sameTree(program, incremental.program()) && offsets(program) == offsets(incremental.program());
+}
+
+TEST_CASE("Incremental Reparsing", "[incremental]")
+{
+    std::string source = R"(var a = 5;
+f(x: int) {
+    return x * 2;
+}
+g(y: int) {
+    return f(y) + a;
+}
+var b = g(1);
+)";
+
+    language::IncrementalParser incremental{source};
+    auto& program = incremental.program();
+    auto* f = program.declarations[1].get();
+    auto* g = program.declarations[2].get();
+
+    SECTION("An edit in a body only parses its function")
+    {
+        auto at = source.find("x * 2");
+        auto stats = incremental.edit({at + 4, at + 5, "32"});
+        REQUIRE(!stats.full);
+        REQUIRE(stats.reparsed == 1);
+        REQUIRE(stats.reused == 3);
+        REQUIRE(program.declarations[1].get() != f);
+        REQUIRE(program.declarations[2].get() == g);
+        REQUIRE(sameAsFullParse(incremental));
+
+        // The call in g refers to the same entry as the new definition
+        auto& def = dynamic_cast<language::FuncDef&>(*program.declarations[1]);
+        auto& body = dynamic_cast<language::Return&>(*dynamic_cast<language::FuncDef&>(*g).block->stmts[0]);
+        auto& call = dynamic_cast<language::FuncCall&>(*dynamic_cast<language::BinExpr&>(*body.expr).leftHs);
+        REQUIRE(call.function->def == &def);
+    }
+
+    SECTION("New declarations between others")
+    {
+        auto at = source.find("g(y");
+        auto stats = incremental.edit({at, at, "var c = a + 1;\nh() { return c; }\n"});
+        REQUIRE(!stats.full);
+        REQUIRE(stats.reparsed == 3);
+        REQUIRE(program.declarations.size() == 6);
+        REQUIRE(sameAsFullParse(incremental));
+
+        at = incremental.source().find("+ a;");
+        stats = incremental.edit({at + 2, at + 3, "h()"});
+        REQUIRE(!stats.full);
+        REQUIRE(sameAsFullParse(incremental));
+    }
+
+    SECTION("Changed globals fall back to a full parse")
+    {
+        auto at = source.find("var a = 5");
+        auto stats = incremental.edit({at + 8, at + 9, "5.0"});
+        REQUIRE(stats.full);
+        REQUIRE(sameAsFullParse(incremental));
+
+        // A forward reference is an error like in a full parse
+        at = incremental.source().find("x * 2");
+        REQUIRE_THROWS(incremental.edit({at, at + 1, "b"}));
+    }
+
+    SECTION("Broken text keeps the last program until it parses again")
+    {
+        auto at = source.find("return x");
+        REQUIRE_THROWS(incremental.edit({at, at + 6, "retur"}));
+        REQUIRE(program.declarations[1].get() == f);
+
+        // Edits elsewhere parse the broken part again
+        at = incremental.source().find("var b");
+        REQUIRE_THROWS(incremental.edit({at, at, " "}));
+        at = incremental.source().find("retur");
+        auto stats = incremental.edit({at + 5, at + 5, "n"});
+        REQUIRE(!stats.full);
+        REQUIRE(sameAsFullParse(incremental));
+    }
+}
+
+TEST_CASE("Program Image", "[serialize]")
+{
+    std::string source = R"(
+        var a = 5;
+        var s = 1.5;
+        f(x: int, y: float): float {
+            var z = x * 2;
+            if (z < a && true) return y;
+            while (z > 0) { z = z - 1; }
+            return f(z, y + s);
+        }
+        g() {
+            f(1, 2.0);
+            return;
+        }
+    )";
+
+    language::Parser p{source};
+    auto program = p.program();
+    auto image = language::serialize(program);
+    auto copy = language::deserialize(image);
+
+    REQUIRE(sameTree(program, copy));
+    REQUIRE(offsets(copy) == offsets(program));
+    REQUIRE(copy.globalsSize == program.globalsSize);
+    auto& f = dynamic_cast<language::FuncDef&>(*copy.declarations[2]);
+    REQUIRE(f.name == "f");
+    REQUIRE(f.frameSize == dynamic_cast<language::FuncDef&>(*program.declarations[2]).frameSize);
+    REQUIRE(std::get<language::SymbolTable::Function>(copy.sym_table->get("f")).def == &f);
+    REQUIRE(&std::get<language::SymbolTable::Variable>(f.block->symbols->get("x")) == f.parameters[0]);
+
+    // The copy writes an image of the same size, damaged images are rejected
+    REQUIRE(language::serialize(copy).size() == image.size());
+    REQUIRE_THROWS_AS(language::deserialize(std::string_view{image}.substr(0, image.size() / 2)), std::runtime_error);
+    image[0] = 'X';
+    REQUIRE_THROWS_AS(language::deserialize(image), std::runtime_error);
+}
+
+TEST_CASE("Error Recovery", "[recovery]")
+{
+    std::string source = R"(var a = 5;
+f(x: int) {
+    var y = x + ;
+    if (x > 1) { x = 2 $ 3; }
+    return x;
+}
+var b = ;
+g() {
+    return f(a) + c;
+}
+var d = a;
+)";
+
+    std::vector<language::Diagnostic> diagnostics;
+    language::Parser p{source, diagnostics};
+    auto program = p.program();
+
+    REQUIRE(diagnostics.size() == 5);
+    auto at = [&](std::uint32_t line, std::uint32_t column)
+    {
+        return std::ranges::any_of(diagnostics, [&](const language::Diagnostic& diagnostic)
+        {
+            return diagnostic.line == line && diagnostic.column == column;
+        });
+    };
+    REQUIRE(at(3, 17)); // ;
+    REQUIRE(at(4, 24)); // $
+    REQUIRE(at(4, 26)); // 3
+    REQUIRE(at(7, 9));  // ;
+    REQUIRE(at(9, 19)); // c
+    REQUIRE(diagnostics[0].message.starts_with("Unexpected Token Semicolon ';', expected"));
+    REQUIRE(diagnostics[0].line == 3);
+    REQUIRE(diagnostics[0].column == 17);
+    REQUIRE(diagnostics[4].message.find("c not found") != std::string::npos);
+
+    // Declarations with errors in their statements stay, the rest go
+    REQUIRE(program.declarations.size() == 4);
+    auto& f = dynamic_cast<language::FuncDef&>(*program.declarations[1]);
+    REQUIRE(f.block->stmts.size() == 2);
+    REQUIRE(dynamic_cast<language::VarDecl&>(*program.declarations[3]).var->name == "d");
+
+    // Without diagnostics the first error throws
+    REQUIRE_THROWS_AS(language::Parser{source}.program(), std::runtime_error);
+}
+
+TEST_CASE("Errors as Values", "[expected]")
+{
+    auto error = [](std::string source)
+    {
+        auto parsed = language::Parser{source}.parse();
+        REQUIRE(!parsed);
+        // The throwing interface reports the same diagnostic
+        try
+        {
+            language::Parser{source}.program();
+            FAIL("no ParseError");
+        }
+        catch (language::ParseError& thrown)
+        {
+            REQUIRE(thrown.diagnostic.offset == parsed.error().offset);
+            REQUIRE(thrown.diagnostic.message == parsed.error().message);
+        }
+        return parsed.error();
+    };
+
+    auto missing = error("f(x: int) {\n    return x + ;\n}");
+    REQUIRE(missing.line == 2);
+    REQUIRE(missing.column == 16);
+
+    // The input ends at an invalid character, it is reported instead of what fails because of it
+    auto invalid = error("var a = 1;\nf() { return a # 1; }");
+    REQUIRE(invalid.line == 2);
+    REQUIRE(invalid.column == 16);
+    REQUIRE(invalid.message.starts_with("Invalid Token #"));
+
+    REQUIRE(error("f(): int { return true; }").message == "Return types of f do not match");
+    REQUIRE(error("f(a: int, a: int) { }").column == 11);
+    REQUIRE(error("f() { return return 1; }").message.starts_with("Unexpected Token Return 'return'"));
+
+    // Falling off the end of a function with a return type is rejected instead of left to each engine
+    REQUIRE(error("main(): int { var x = 3; if (x > 5) { return 1; } }").message ==
+            "main does not return a value on every path");
+    REQUIRE(error("f(x: int) { if (x > 5) return 1; }").line == 1);
+    REQUIRE(language::Parser{std::string_view{
+        "f(x: int): int { if (x > 5) { return 1; } else return 2; } g(): int { while (true) { } } h() { }"}}.parse());
+
+    // Literals that do not fit are errors, not zero
+    REQUIRE(error("f(): int { return 2147483648; }").message == "Integer literal 2147483648 is out of range");
+    REQUIRE(error("var a = 1" + std::string(400, '0') + ".5;").column == 9);
+    REQUIRE(language::Parser{std::string_view{"var a = 2147483647; var b = 1.;"}}.parse().has_value());
+    REQUIRE(language::Parser{std::string_view{"var a = 1 + 2;"}}.parse()->declarations.size() == 1);
+}
+
+TEST_CASE("Operator Precedence", "[expression]")
+{
+    // Parenthesizes every binary expression of the initializer of the last declaration
+    auto tree = [](std::string source)
+    {
+        language::Parser p{source};
+        auto program = p.program();
+        auto print = [](auto& self, language::Expr& expr) -> std::string
+        {
+            const char* ops[] = {"+", "-", "*", "/", "&&", "||", "<", "<=", ">", ">=", "==", "!=", "="};
+            if (auto bin = dynamic_cast<language::BinExpr*>(&expr))
+            {
+                return "(" + self(self, *bin->leftHs) + " " + ops[static_cast<int>(bin->op)] + " " +
+                       self(self, *bin->rightHs) + ")";
+            }
+            if (auto var = dynamic_cast<language::VariableAccess*>(&expr))
+            {
+                return std::string{var->var->name};
+            }
+            if (auto lit = dynamic_cast<language::BooleanLiteral*>(&expr))
+            {
+                return lit->v ? "true" : "false";
+            }
+            if (auto lit = dynamic_cast<language::FloatLiteral*>(&expr))
+            {
+                return std::to_string(static_cast<int>(lit->v)) + ".0";
+            }
+            return std::to_string(dynamic_cast<language::IntLiteral&>(expr).v);
+        };
+        return print(print, *dynamic_cast<language::VarDecl&>(*program.declarations.back()).init);
+    };
+    std::string vars = "var a = 1; var b = 2; var c = 3; var d = true; var x = 1.5;\n";
+
+    REQUIRE(tree(vars + "var e = a - b - c;") == "((a - b) - c)");
+    REQUIRE(tree(vars + "var e = a = b = c;") == "(a = (b = c))");
+    REQUIRE(tree(vars + "var e = a + b * c - a / b;") == "((a + (b * c)) - (a / b))");
+    REQUIRE(tree(vars + "var e = d || a < b && b + 1 != c;") == "(d || ((a < b) && ((b + 1) != c)))");
+    REQUIRE(tree(vars + "var e = (a + b) * c;") == "((a + b) * c)");
+
+    // Prefix operators bind tightest and become binary expressions
+    REQUIRE(tree(vars + "var e = -a * b;") == "((0 - a) * b)");
+    REQUIRE(tree(vars + "var e = - -x;") == "(0.0 - (0.0 - x))");
+    REQUIRE(tree(vars + "var e = !d && a < b;") == "((d == false) && (a < b))");
+
+    auto missing = language::Parser{std::string_view{"var a = ;"}}.parse();
+    REQUIRE(missing.error().message.ends_with("OpenParenthesis, Id, Minus, ExclamationMark"));
+
+    auto negated = vars + "var e = -x;";
+    language::Parser p{negated};
+    auto program = p.program();
+    auto& x = std::get<language::SymbolTable::Variable>(program.sym_table->get("x"));
+    REQUIRE(dynamic_cast<language::VarDecl&>(*program.declarations.back()).init->type == x.type);
+}
+
+TEST_CASE("Source Offsets", "[expression]")
+{
+    std::string source = R"(var a = 5;
+f(x: int): int {
+    for (var i = 0; i < x; i = i + 1) { a = -a; }
+    if (!(x < a)) return f(x - 1);
+    return x;
+}
+)";
+
+    language::Parser p{source};
+    auto program = p.program();
+    auto at = [&](std::string_view text) { return static_cast<std::uint32_t>(source.find(text)); };
+
+    auto& a = dynamic_cast<language::VarDecl&>(*program.declarations[0]);
+    REQUIRE(a.offset == at("var a"));
+    REQUIRE(a.init->offset == at("5"));
+
+    auto& f = dynamic_cast<language::FuncDef&>(*program.declarations[1]);
+    REQUIRE(f.block->offset == at("{\n"));
+
+    // The for loop becomes a block holding the while loop, both point at the for
+    auto& loop = dynamic_cast<language::Block&>(*f.block->stmts[0]);
+    REQUIRE(loop.offset == at("for"));
+    REQUIRE(loop.stmts[0]->offset == at("var i"));
+    auto& whileStmt = dynamic_cast<language::While&>(*loop.stmts[1]);
+    REQUIRE(whileStmt.offset == at("for"));
+    REQUIRE(whileStmt.expr->offset == at("i < x"));
+    auto& body = dynamic_cast<language::Block&>(*whileStmt.stmt);
+    REQUIRE(body.stmts[1]->offset == at("i = i + 1"));
+
+    // Binary expressions start with their left operand, prefix ones with the operator
+    auto& assign = dynamic_cast<language::BinExpr&>(*dynamic_cast<language::ExprStmt&>(*dynamic_cast<language::Block&>(*body.stmts[0]).stmts[0]).expr);
+    REQUIRE(assign.offset == at("a = -a"));
+    REQUIRE(assign.rightHs->offset == at("-a"));
+    REQUIRE(dynamic_cast<language::BinExpr&>(*assign.rightHs).rightHs->offset == at("a; }"));
+
+    auto& ifStmt = dynamic_cast<language::If&>(*f.block->stmts[1]);
+    REQUIRE(ifStmt.offset == at("if"));
+    REQUIRE(ifStmt.expr->offset == at("!("));
+    auto& returnStmt = dynamic_cast<language::Return&>(*ifStmt.trueStmt);
+    REQUIRE(returnStmt.offset == at("return f"));
+    REQUIRE(returnStmt.expr->offset == at("f(x - 1)"));
+    REQUIRE(dynamic_cast<language::FuncCall&>(*returnStmt.expr).args[0]->offset == at("x - 1"));
+}